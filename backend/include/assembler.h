@@ -1,5 +1,8 @@
 /*
-Uses two passes to convert the assembly to machine code
+Uses two passes to convert the assembly to machine code.
+The per-line result of both passes is kept so that an edit of a few lines
+only re-encodes those lines and the instructions whose label targets moved,
+and whole programs are cached by content so a repeat assemble is a copy.
 */
 
 #pragma once
@@ -8,15 +11,68 @@ Uses two passes to convert the assembly to machine code
 #include "symbol_table.h"
 #include "memory.h"
 #include "constants.h"
+#include "assembly_cache.h"
+#include "program_file.h"
 
 class Assembler {
     SymbolTable symbols;
-    Memory& memory;  
-    Parser parser;   
-    
+    Memory& memory;
+    Parser parser;
+    std::vector<AssembledLine> lines;
+    std::shared_ptr<AssemblyCache> cache;  // may be shared with other assemblers
+    bool lastWasCacheHit = false;
+    bool loadedFromFile = false;  // program came from a binary image, there is no source to edit
+    std::vector<uint32_t> unsupported;  // addresses of the loaded words the CPU cannot decode
+    PagedMemory dataImage;  // data memory as the program starts, copies share its pages
+    uint32_t entryPoint = RISCV_CONSTANTS::TEXT_SEGMENT_START;
+    uint32_t globalPointer = RISCV_CONSTANTS::DATA_SEGMENT_START;
+
+    static std::vector<std::string> splitLines(const std::string& input);
+    AssembledLine scanLine(const std::string& text, uint32_t& address, SymbolTable& table);
+    void encodeLine(AssembledLine& line);
+    void storeLine(const AssembledLine& line);
+    void eraseLine(const AssembledLine& line, uint32_t address);
+    void updateExitAddress();
+    void assembleLines(const std::vector<std::string>& source);
+    size_t editLines(size_t firstLine, size_t lastLine, const std::vector<std::string>& replaced);
+    void restore(const ProgramImage& image);
+    std::shared_ptr<ProgramImage> snapshot(const std::string& normalized) const;
+
 public:
-    Assembler(Memory &memory) : parser(memory), memory(memory) {} ;
+    Assembler(Memory &memory, std::shared_ptr<AssemblyCache> cache = std::make_shared<AssemblyCache>())
+        : memory(memory), parser(memory), cache(std::move(cache)) {}
 
+    // Assembles the program, or restores it from the cache when the same source was seen before
     void assemble(const std::string& input);
-};
 
+    // Replaces source lines [firstLine, lastLine) (0-based) with `replacement`
+    // and patches the assembled program in memory in place.
+    // Returns the number of lines that had to be re-encoded. A failed edit leaves the program unchanged.
+    size_t edit(size_t firstLine, size_t lastLine, const std::string& replacement);
+
+    // Writes the last assembled program back into memory without reparsing it
+    void reload();
+    // Gives another memory the program's initial data, exit address and mapped ranges.
+    // The data pages are shared copy-on-write, writes to either memory stay on their side
+    void storeData(Memory& target) const;
+
+    // Forgets the last program, the cache is kept
+    void clear();
+
+    // Writes the program to `path` in the format picked by its extension, returns the file size
+    size_t save(const std::string& path);
+    // Replaces the program with a native image or an ELF executable stored in `path`
+    void load(const std::string& path);
+    uint32_t getEntryPoint() const { return entryPoint; }
+    uint32_t getGlobalPointer() const { return globalPointer; }
+    const std::vector<uint32_t>& getUnsupported() const { return unsupported; }
+
+    AssemblyCache& getCache() { return *cache; }
+    const SymbolTable& getSymbols() const { return symbols; }
+
+    // The source line (0-based) that emitted the instruction at `address`, false when there is no source
+    bool findSourceLine(uint32_t address, size_t& line) const;
+    const std::string& getSourceLine(size_t line) const { return lines[line].text; }
+
+    void dumpMachineCode(JsonWriter& out) const;
+};
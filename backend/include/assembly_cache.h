@@ -0,0 +1,48 @@
+/*
+Content-addressed LRU cache of assembled programs, keyed by a hash of the
+normalized source. Images can optionally be persisted to a cache directory
+so they survive restarts and are shared between processes. One cache may
+serve every session of a process, all of its members are thread safe.
+*/
+
+#pragma once
+
+#include "program_image.h"
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+class AssemblyCache {
+    size_t capacity = 64;
+    std::string directory;  // empty when images are kept in memory only
+
+    // Most recently used first
+    std::list<std::pair<uint64_t, std::shared_ptr<const ProgramImage>>> entries;
+    std::unordered_map<uint64_t, decltype(entries)::iterator> index;
+    std::mutex mutex;  // guards the settings, `entries` and `index`, never held during file I/O
+
+    std::string imagePath(uint64_t key) const;
+    // Both expect `mutex` to be held
+    void insertEntry(uint64_t key, std::shared_ptr<const ProgramImage> image);
+    void trim();
+
+public:
+    std::atomic<uint64_t> hits{0};
+    std::atomic<uint64_t> misses{0};
+    std::atomic<uint64_t> diskHits{0};
+
+    // Strips comments and surrounding whitespace from every line, keeping line numbers intact
+    static std::string normalize(const std::string& source);
+    static uint64_t hash(const std::string& normalized);
+
+    void setCapacity(size_t entries);
+    void setDirectory(const std::string& path);
+
+    // Returns the cached image for `normalized` or nullptr, updating the counters
+    std::shared_ptr<const ProgramImage> find(uint64_t key, const std::string& normalized);
+    void insert(uint64_t key, std::shared_ptr<const ProgramImage> image);
+};
@@ -0,0 +1,47 @@
+/*
+`run` on a worker thread for the interactive loop, so that `pause`, `cancel` and
+`status` are answered while a program executes; any other command waits until it
+stops. Every `progressInterval` the run prints
+{ "progress": { "cycles", "instructions", "pc" } }, and once it stops it prints
+the usual `run` response. Output from both threads is serialised by `outputMutex`.
+*/
+
+#pragma once
+
+#include "session.h"
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <ostream>
+#include <thread>
+
+class BackgroundRun {
+    Session& session;
+    std::ostream& out;
+    std::ostream& err;
+    std::mutex& outputMutex;
+    std::chrono::milliseconds progressInterval;
+
+    RunControl control;
+    std::thread worker;
+    std::atomic<bool> active{false};
+    std::chrono::steady_clock::time_point lastProgress;
+
+    void reportProgress();
+
+public:
+    BackgroundRun(Session& session, std::ostream& out, std::ostream& err, std::mutex& outputMutex,
+                  std::chrono::milliseconds progressInterval);
+    ~BackgroundRun();
+
+    bool running() const { return active; }
+
+    // Waits for the previous run first
+    void start(const RunBudget& budget);
+    void wait();
+
+    // Asks the run to stop after its current slice, returns false when nothing is running
+    bool stop(RunControl::Request request);
+
+    void writeStatus(JsonWriter& json) const;
+};
@@ -0,0 +1,49 @@
+/*
+Batch mode (`main --batch <dir> [--jobs N] [--config pipeline,forward,prediction]
+[--max-cycles N] [--run-ms N] [--l1 "cache options"] [--dram "dram options"]
+[--prefetch "prefetch options"] [--latency "latency options"]`): assembles and runs every .asm file below a
+directory on a work-stealing thread pool, each program in its own session, and
+prints one JSON record per program in path order:
+
+    { "file", "status": "exited" | "stopped" | "error", "error"?, "stopped"?,
+      "clock_cycles", <run counters>, "registers", "data_hash", "data_bytes" }
+
+followed by a { "batch": { ... } } summary line. Without --max-cycles every program
+gets DEFAULT_MAX_CYCLES, so a program that never exits is reported as stopped;
+--max-cycles 0 lifts the limit.
+*/
+
+#pragma once
+
+#include "cache.h"
+#include "functional_units.h"
+#include "prefetcher.h"
+#include "session.h"
+#include <optional>
+#include <ostream>
+#include <string>
+
+namespace Batch {
+
+constexpr uint64_t DEFAULT_MAX_CYCLES = 1000000;
+
+struct Options {
+    unsigned jobs = 1;
+    bool pipeline = false;
+    bool dataForward = false;
+    bool branchPrediction = false;
+    RunBudget budget{DEFAULT_MAX_CYCLES};  // cycles and milliseconds apply per program
+    std::optional<CacheConfig> caches;  // instruction and data caches of every program
+    std::optional<DramConfig> dram;     // behind those caches
+    std::optional<PrefetcherConfig> prefetch;  // next line and stride prefetchers for them
+    std::optional<FunctionalUnitConfig> latency;  // multi-cycle MUL, DIV and REM
+
+    // Sets the modes from a comma separated list, throws on an unknown one
+    void parseConfig(const std::string& config);
+};
+
+// Returns the number of programs that failed to assemble or run
+size_t run(const std::string& directory, const Options& options, const SessionOptions& sessionOptions,
+           std::ostream& out);
+
+}
@@ -0,0 +1,40 @@
+/*
+Length-prefixed binary command protocol, an alternative to the JSON line protocol.
+A client switches to it by sending the text command `protocol binary`; after the
+JSON acknowledgement every request and response is a frame:
+
+    u32 length | payload[length]                       (little endian)
+    request payload:   u8 opcode | arguments
+    response payload:  u8 status (0 ok, 1 error) | u8 opcode | body
+
+State bodies have a fixed layout (see writeState) and memory is returned as raw
+byte ranges, so clients decode responses without any JSON parsing. A request longer
+than MAX_FRAME is skipped and answered with an error.
+*/
+
+#pragma once
+
+#include "session.h"
+#include <istream>
+#include <ostream>
+
+namespace BinaryProtocol {
+
+constexpr uint32_t VERSION = 1;
+constexpr uint32_t MAX_FRAME = 64 * 1024 * 1024;
+
+enum Opcode : uint8_t {
+    ASSEMBLE = 1,     // source bytes                          -> program
+    EDIT = 2,         // u32 first, u32 last, source bytes     -> program
+    STEP = 3,         //                                       -> state
+    RUN = 4,          // [u32 cycles, u32 instructions, u32 ms] -> state
+    TOGGLE = 5,       // u8 0 pipeline, 1 forwarding, 2 branch prediction -> state
+    READ_MEMORY = 6,  // u32 address, u32 length               -> raw bytes
+    STATE = 7,        //                                       -> state
+    LOAD = 8,         // path bytes                            -> program
+};
+
+// Serves frames for `session` until the input ends
+void serve(std::istream& in, std::ostream& out, Session& session);
+
+}
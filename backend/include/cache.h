@@ -0,0 +1,105 @@
+/*
+Set associative cache timing model for the instruction fetches and the loads and
+stores of Cpu. It keeps tags only, the data stays in Memory, so a cache changes
+how many cycles an access takes and never the value it returns.
+
+  size, line, ways   geometry in bytes, bytes and lines per set, all powers of two
+  replacement        lru, plru (tree pseudo LRU) or random
+  write              back (dirty lines are written when evicted) or through (every store goes down)
+  allocate           whether a store miss brings its line in
+  hit, miss          cycles of an access that hits, and of one that misses including the line fill
+
+With a Dram behind the cache, a miss takes `hit` cycles plus the fill from the Dram
+instead of `miss`, and dirty evictions and written through stores are posted to it.
+
+Prefetches fill a line without stalling anyone. The first demand access to such a
+line finds it useful when the fill has arrived and late, waiting for the rest of the
+fill, when it has not. A prefetched line evicted before any demand access was useless.
+*/
+
+#pragma once
+
+#include "dram.h"
+#include "json_writer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct CacheConfig {
+    enum class Replacement { LRU, PLRU, RANDOM };
+    enum class WritePolicy { BACK, THROUGH };
+
+    uint32_t size = 4096;
+    uint32_t lineSize = 32;
+    uint32_t ways = 2;
+    Replacement replacement = Replacement::LRU;
+    WritePolicy write = WritePolicy::BACK;
+    bool writeAllocate = true;
+    uint32_t hitLatency = 1;
+    uint32_t missLatency = 20;
+
+    // `key=value` options over the defaults, e.g. "size=8192 ways=4 replacement=plru"
+    static CacheConfig parse(const std::string& arguments);
+};
+
+struct CacheStats {
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t hits = 0;
+    uint64_t misses = 0;
+    uint64_t evictions = 0;   // valid lines replaced by a fill
+    uint64_t writebacks = 0;  // dirty lines among them
+    uint64_t prefetches = 0;  // fills issued by prefetch(), lines already present are not counted
+    uint64_t prefetchUseful = 0;
+    uint64_t prefetchLate = 0;
+    uint64_t prefetchUseless = 0;
+};
+
+class Cache {
+public:
+    explicit Cache(const CacheConfig& config);
+
+    // The cycles an access issued in cycle `now` takes. One spanning two lines takes the slower of both
+    uint32_t access(uint32_t address, uint32_t size, bool write, Dram* memory = nullptr, uint64_t now = 0);
+    // Starts filling the line of `address` in cycle `now` unless it is present
+    void prefetch(uint32_t address, Dram* memory = nullptr, uint64_t now = 0);
+
+    const CacheConfig& config() const { return settings; }
+    const CacheStats& stats() const { return counters; }
+
+    // Invalidates every line and zeroes the counters
+    void clear();
+
+    // { "size", "line", "ways", ..., "hits", "misses", ... }
+    void dump(JsonWriter& out) const;
+
+private:
+    struct Line {
+        uint32_t tag = 0;
+        bool valid = false;
+        bool dirty = false;
+        bool prefetched = false;  // filled by prefetch() and not yet accessed
+        uint64_t readyAt = 0;     // cycle the prefetched fill arrives
+        uint64_t lastUse = 0;     // LRU stamp
+    };
+
+    CacheConfig settings;
+    CacheStats counters;
+    uint32_t sets;
+    uint32_t offsetBits;
+    uint32_t setBits;
+    std::vector<Line> lines;        // sets * ways, set by set
+    std::vector<uint32_t> plruBits; // one tree per set, node i has children 2i+1 and 2i+2
+    uint64_t useClock = 0;
+    uint32_t randomState = 0x2545F491;
+
+    uint32_t accessLine(uint32_t lineAddress, bool write, Dram* memory, uint64_t now);
+    // The way holding `tag`, `ways` when it is missing
+    uint32_t find(uint32_t set, uint32_t tag) const;
+    // Evicts the victim of `set` for `tag`, adding the cycles waited to post a dirty victim to `cycles`
+    Line& replace(uint32_t set, uint32_t tag, Dram* memory, uint64_t now, uint32_t& cycles);
+    uint32_t victim(uint32_t set);
+    void touch(uint32_t set, uint32_t way);
+};
+
+const char* replacementName(CacheConfig::Replacement replacement);
@@ -21,14 +21,18 @@ namespace RISCV_CONSTANTS {
         SB, SH, SW, SD,
         BEQ, BNE, BLT, BGE,
         JAL, JALR,
-        LUI, AUIPC
+        LUI, AUIPC,
+        CSRRW, CSRRS, CSRRC,
+        CSRR, CSRW, RDCYCLE, RDTIME, RDINSTRET
     };
 
     // Memory segment starting addresses
     constexpr uint32_t TEXT_SEGMENT_START = 0x00000000;
     constexpr uint32_t DATA_SEGMENT_START = 0x10000000;
+    constexpr uint32_t DATA_SEGMENT_END = 0x20000000;  // one past the last data address
     constexpr uint32_t HEAP_START = 0x10008000;
     constexpr uint32_t STACK_START = 0x7FFFFFDC;
+    constexpr uint32_t STACK_END = 0x80000000;  // one past the last stack address
 
     // Instruction sizes (4 * 8 = 32 bits)
     constexpr uint32_t INSTRUCTION_SIZE = 4; 
@@ -44,6 +48,7 @@ namespace RISCV_CONSTANTS {
     constexpr uint32_t OPCODE_U_TYPE_AUIPC = 0b0010111;
     constexpr uint32_t OPCODE_UJ_TYPE_JAL = 0b1101111;
     // constexpr uint32_t OPCODE_I_TYPE_ENV = 0b1110011;
+    constexpr uint32_t OPCODE_I_TYPE_CSR = 0b1110011;
 
 
     // add, and, or, sll, slt, sra, srl, sub, xor, mul, div, rem
@@ -91,6 +96,11 @@ namespace RISCV_CONSTANTS {
     // JALR function code
     constexpr uint32_t FUNCT3_JALR = 0b000; // Jump And Link Register
 
+    // Zicsr function codes, the CSR number takes the place of the immediate
+    constexpr uint32_t FUNCT3_CSRRW = 0b001;
+    constexpr uint32_t FUNCT3_CSRRS = 0b010;
+    constexpr uint32_t FUNCT3_CSRRC = 0b011;
+
     //sb, sw, sd, sh
     // Store function codes
     constexpr uint32_t FUNCT3_SB = 0b000;
@@ -142,6 +152,29 @@ namespace RISCV_CONSTANTS {
         {"x31", 31}, {"t6", 31}
     };
 
+    // Counter CSRs. The user ones (0xCxx) are read only, the machine ones (0xBxx) can be written.
+    // time ticks with cycle, the hpmcounters count pipeline events:
+    // 3 bubbles, 4 data hazards, 5 data hazard bubbles, 6 control hazards,
+    // 7 control hazard bubbles, 8 branch mispredictions, 9 instruction cache misses,
+    // 10 data cache misses, 11 cycles stalled on cache misses, 12 bubbles waiting on MUL, DIV and REM
+    constexpr uint32_t CSR_CYCLE = 0xC00;
+    constexpr uint32_t CSR_TIME = 0xC01;
+    constexpr uint32_t CSR_INSTRET = 0xC02;
+    constexpr uint32_t CSR_COUNTERS = 13;  // cycle, time, instret and hpmcounter3 to hpmcounter12
+    inline const unordered_map<string, uint32_t> CSRS = {
+        {"cycle", 0xC00}, {"time", 0xC01}, {"instret", 0xC02},
+        {"cycleh", 0xC80}, {"timeh", 0xC81}, {"instreth", 0xC82},
+        {"mcycle", 0xB00}, {"minstret", 0xB02}, {"mcycleh", 0xB80}, {"minstreth", 0xB82},
+        {"hpmcounter3", 0xC03}, {"hpmcounter4", 0xC04}, {"hpmcounter5", 0xC05},
+        {"hpmcounter6", 0xC06}, {"hpmcounter7", 0xC07}, {"hpmcounter8", 0xC08},
+        {"hpmcounter9", 0xC09}, {"hpmcounter10", 0xC0A}, {"hpmcounter11", 0xC0B},
+        {"hpmcounter12", 0xC0C},
+        {"mhpmcounter3", 0xB03}, {"mhpmcounter4", 0xB04}, {"mhpmcounter5", 0xB05},
+        {"mhpmcounter6", 0xB06}, {"mhpmcounter7", 0xB07}, {"mhpmcounter8", 0xB08},
+        {"mhpmcounter9", 0xB09}, {"mhpmcounter10", 0xB0A}, {"mhpmcounter11", 0xB0B},
+        {"mhpmcounter12", 0xB0C}
+    };
+
     //Skipping floating point operations for now
 
     // Some Assembler Directives
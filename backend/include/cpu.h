@@ -5,10 +5,17 @@
 #include <unordered_map>
 #include <memory>
 #include <map>
+#include <functional>
 #include "memory.h"
 #include "instruction.h"
+#include "cycle_generator.h"
+#include "execution_profile.h"
+#include "cache.h"
+#include "prefetcher.h"
+#include "functional_units.h"
 
 class Instruction;
+class TraceWriter;
 
 enum Step { FETCH, DECODE, EXECUTE, MEMORY, WRITEBACK };
 
@@ -36,6 +43,34 @@ public:
     uint32_t totalControlHazards;
     uint32_t totalBranchMissPredictions;
 
+    // The same events attributed to the instructions involved, cleared by reset()
+    ExecutionProfile profile;
+    // The profile counters of the instruction at `pc`, nullptr outside the program
+    PcCounters* countersAt(uint32_t pc);
+
+    // Zicsr counter CSRs, see RISCV_CONSTANTS::CSRS. Unknown CSRs and writes to read only ones throw
+    uint32_t readCsr(uint32_t csr) const;
+    void writeCsr(uint32_t csr, uint32_t value);
+    // cycle, time, instret and the hpmcounters by the low 5 bits of their CSR number
+    uint64_t counter(uint32_t index) const;
+    uint64_t counterOffsets[32] = {0};  // moved by writes to the machine counters
+
+    // L1 caches, nullptr for an ideal memory where every access takes one cycle.
+    // A miss freezes the whole pipeline, or the current stage without pipelining, until its line arrives
+    std::unique_ptr<Cache> instructionCache;
+    std::unique_ptr<Cache> dataCache;
+    // Serves the fills and writebacks of the caches, nullptr for their fixed miss latency
+    std::unique_ptr<Dram> dram;
+    // Fill the caches ahead of demand, nullptr for none. Each acts only while its cache exists
+    std::unique_ptr<NextLinePrefetcher> instructionPrefetcher;
+    std::unique_ptr<StridePrefetcher> dataPrefetcher;
+    uint32_t memoryStall = 0;  // cycles left of the current miss
+    uint64_t totalMemoryStallCycles = 0;
+    // Multi-cycle MUL, DIV and REM, nullptr for single cycle ones
+    std::unique_ptr<FunctionalUnits> functionalUnits;
+    // Cycles waited on them: bubbles with pipelining, extra execute cycles without
+    uint32_t totalFunctionalUnitBubbles = 0;
+
     bool pipeline;
     bool data_forward;
     bool loadToStoreForwarding = false;
@@ -57,7 +92,12 @@ public:
 
     int numberOfBubbles;
 
-    static Step currentStep;
+    Step currentStep = FETCH;
+
+    // Called for every instruction retired without pipelining, PC already holds the next PC
+    std::function<void(const Instruction&)> onRetire;
+    // Streams every retired instruction, and with occupancy every pipelined cycle, to a trace file
+    TraceWriter* traceWriter = nullptr;
 
     Memory& memory;
 
@@ -70,6 +110,14 @@ public:
     void execute();  
     void memory_update(); 
     void write_back();  
+    void traceAccess(const Instruction& instruction);
+    void traceRetire(const Instruction& instruction);
+    void traceOccupancy();
+    void accessDataCache(const Instruction& instruction);
+    // Stalls for an access of `cycles`, the first of which the stage itself takes
+    void waitForMemory(uint32_t cycles);
+    // Holds the instruction just decoded until its operands and functional unit are ready
+    void waitForFunctionalUnits();
 
     // Takes each instruction from the assembled instructions and executes 1 stage of the 5 stages
     void step();
@@ -77,11 +125,22 @@ public:
     // Executes entire machine code in a single go
     void run();
 
-    void dumpRegisters();
-    std::string dumpPipelineStages();
-    void dumpDataForwardPath();
+    // Runs until the program finishes or `clock`/`totalInstructions` reach the limits.
+    // Returns true once the program has finished.
+    bool runUntil(uint64_t clockLimit, uint64_t instructionLimit);
+    bool finished() const;
+
+    // The same execution as a coroutine that yields the clock every `cyclesPerYield` cycles,
+    // so one thread can interleave many programs. It ends when the program finishes or a limit is reached.
+    CycleGenerator execution(uint64_t cyclesPerYield, uint64_t clockLimit = UINT64_MAX, uint64_t instructionLimit = UINT64_MAX);
+
+    void dumpRegisters(JsonWriter& out) const;
+    void dumpPipelineStages(JsonWriter& out) const;
+    void dumpDataForwardPath(JsonWriter& out);
 
     std::unique_ptr<Instruction> decodeInstructionFun(uint32_t instr);
+    // Whether decodeInstructionFun knows the opcode of `instr`, used to vet loaded programs
+    static bool canDecode(uint32_t instr);
     // instr to check, index of rdVec, rsNo to check(rs1 or rs2, 0 for rs1, 1 for rs2)
     void checkDataForwarding(std::unique_ptr<Instruction>& decodedInstruction, int indexOfRDVec, int rsNo);
     void doDataForwarding();
@@ -89,6 +148,10 @@ public:
     int32_t signExtend(uint32_t value, uint32_t bits);
 
     void reset();
+    // Drops the instructions in flight and turns every mode off, as in a freshly started simulator
+    void resetPipeline();
+    // Drops the instructions in flight and keeps the modes
+    void flushPipeline();
 
     
 };
\ No newline at end of file
@@ -0,0 +1,63 @@
+/*
+Generator coroutine used to run a program piecewise: `next()` resumes the coroutine
+up to its next `co_yield` and returns false once it has finished. The last yielded
+clock is kept in `value()`. Nothing runs until the first `next()`, and destroying
+the generator abandons the execution wherever it was suspended.
+*/
+
+#pragma once
+
+#include <coroutine>
+#include <cstdint>
+#include <exception>
+#include <utility>
+
+class CycleGenerator {
+public:
+    struct promise_type {
+        uint64_t current = 0;
+        std::exception_ptr error;
+
+        CycleGenerator get_return_object() {
+            return CycleGenerator(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_always final_suspend() noexcept { return {}; }
+        std::suspend_always yield_value(uint64_t clock) noexcept {
+            current = clock;
+            return {};
+        }
+        void return_void() noexcept {}
+        void unhandled_exception() { error = std::current_exception(); }
+    };
+
+    CycleGenerator(CycleGenerator&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+    CycleGenerator& operator=(CycleGenerator&& other) noexcept {
+        if (this != &other) {
+            if (handle) handle.destroy();
+            handle = std::exchange(other.handle, {});
+        }
+        return *this;
+    }
+    ~CycleGenerator() {
+        if (handle) handle.destroy();
+    }
+
+    // Runs to the next yield, an exception thrown by the coroutine is rethrown here
+    bool next() {
+        if (done()) return false;
+        handle.resume();
+        if (handle.promise().error) {
+            std::rethrow_exception(std::exchange(handle.promise().error, nullptr));
+        }
+        return !handle.done();
+    }
+
+    bool done() const { return !handle || handle.done(); }
+    uint64_t value() const { return handle.promise().current; }
+
+private:
+    explicit CycleGenerator(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+
+    std::coroutine_handle<promise_type> handle;
+};
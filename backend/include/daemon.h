@@ -0,0 +1,29 @@
+/*
+Daemon mode (`main --daemon`): one process hosts many independent sessions.
+Every input line starts with a session id, followed by the usual command
+(and the JSON payload for `assemble`/`edit`), e.g.
+
+    alice assemble
+    {"input_code": "addi x5, x0, 1"}
+    bob step
+
+A session is created by its first command, and `<id> close` destroys it.
+Commands run on a pool of worker threads; commands of one session run in order,
+different sessions run in parallel. A `run` is a coroutine resumed for one slice
+per turn, so a few workers interleave any number of running sessions, and
+`status`, `pause` and `cancel` are answered at once. Every response line is
+prefixed with its session id, both on stdout and on stderr.
+*/
+
+#pragma once
+
+#include "session.h"
+#include <istream>
+#include <ostream>
+
+namespace Daemon {
+
+// Serves until the input ends and every queued command has finished
+void serve(std::istream& in, std::ostream& out, std::ostream& err, const SessionOptions& options, unsigned threads);
+
+}
@@ -1,6 +1,7 @@
 /*
 Handles the assembler directives: .text, .data,
-.byte, .half, .word, .dword, .asciz.
+.byte, .half, .word, .dword, .asciz, .space/.zero, .fill,
+.align/.p2align/.balign and .incbin.
 */
 
 #pragma once
@@ -13,8 +14,15 @@ class DirectiveHandler {
     enum class Segment { TEXT, DATA };
     Segment currentSegment = Segment::TEXT;
     Memory& memory; 
+    uint32_t alignment = 0;  // boundary of the last directive when it was an .align
+
+    void reserve(uint32_t& address, uint64_t size, const std::string& directive);
+    std::string resolveInclude(const std::string& file);
 
 public:
+    // Directory .incbin files are read from, .incbin is rejected while it is empty
+    static std::string includeDirectory;
+
     DirectiveHandler(Memory& mem) : memory(mem) {}  
 
     void process(const std::string& line, uint32_t& address, bool firstPass);
@@ -22,4 +30,10 @@ public:
     bool isInHalfWordRange(int value);
     bool isInWordRange(int value);
     bool isDirective(const std::string& line);
+    bool isSegmentDirective(const std::string& line);
+    // The boundary the last processed directive padded to, zero unless it was .align/.p2align/.balign
+    uint32_t lastAlignment() const { return alignment; }
+
+    bool inDataSegment() const { return currentSegment == Segment::DATA; }
+    void setDataSegment(bool data) { currentSegment = data ? Segment::DATA : Segment::TEXT; }
 };
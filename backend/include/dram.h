@@ -0,0 +1,75 @@
+/*
+Main memory timing behind the caches: the line fills and writebacks of both caches
+go to a set of DRAM banks, each keeping its last row open.
+
+  row hit       the row is already open in the bank            `hit` cycles
+  row closed    nothing is open yet, activate it               `closed` cycles
+  row conflict  another row is open, precharge and activate    `conflict` cycles
+
+Consecutive `row` byte blocks go to consecutive banks, so a sequential walk stays
+in open rows while a stride of `row * banks` bytes conflicts in one bank every time.
+A bank serves one request at a time, fills are waited for and writebacks are posted.
+At most `queue` requests are outstanding, a new one waits for the oldest to finish.
+*/
+
+#pragma once
+
+#include "json_writer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct DramConfig {
+    uint32_t banks = 8;
+    uint32_t rowSize = 2048;
+    uint32_t rowHitLatency = 10;
+    uint32_t rowClosedLatency = 20;
+    uint32_t rowConflictLatency = 30;
+    uint32_t queue = 8;
+
+    // `key=value` options over the defaults, e.g. "banks=4 row=1024 conflict=40"
+    static DramConfig parse(const std::string& arguments);
+};
+
+struct DramStats {
+    uint64_t reads = 0;
+    uint64_t writes = 0;
+    uint64_t rowHits = 0;
+    uint64_t rowClosed = 0;
+    uint64_t rowConflicts = 0;
+    uint64_t readCycles = 0;   // from the fill request until its line arrives
+    uint64_t queueCycles = 0;  // requests spent waiting for a free queue entry
+};
+
+class Dram {
+public:
+    explicit Dram(const DramConfig& config);
+
+    // A line fill issued in cycle `now`, returns the cycles until the line arrives
+    uint32_t read(uint32_t address, uint64_t now);
+    // A posted write, returns the cycles the writer waits for a queue entry
+    uint32_t write(uint32_t address, uint64_t now);
+
+    const DramConfig& config() const { return settings; }
+    const DramStats& stats() const { return counters; }
+
+    // Closes every row, empties the queue and zeroes the counters
+    void clear();
+
+    void dump(JsonWriter& out) const;
+
+private:
+    struct Bank {
+        bool open = false;
+        uint32_t row = 0;
+        uint64_t readyAt = 0;  // cycle the bank finishes its last request
+    };
+
+    DramConfig settings;
+    DramStats counters;
+    std::vector<Bank> banks;
+    std::vector<uint64_t> pending;  // completion cycles of the outstanding requests
+
+    // Returns the cycle the request was accepted into the queue, `done` the cycle it completes
+    uint64_t issue(uint32_t address, uint64_t now, uint64_t& done);
+};
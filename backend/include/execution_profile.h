@@ -0,0 +1,44 @@
+/*
+Per-PC counters of a run, kept in a table parallel to the instruction memory:
+slot i belongs to the instruction at base + 4 * i. They say which instructions
+the pipeline stalls on, where the global counters of Cpu only give totals.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+struct PcCounters {
+    uint64_t executions = 0;           // times the instruction retired
+    uint64_t dataBubblesSuffered = 0;  // bubbles it waited in decode for an operand
+    uint64_t dataBubblesCaused = 0;    // bubbles later instructions waited for its result
+    uint64_t unitBubbles = 0;          // bubbles it waited in decode for a multi-cycle result or a busy unit
+    uint64_t controlBubbles = 0;       // fetch slots lost after it redirected the PC
+    uint64_t mispredictions = 0;
+    uint64_t forwardsIn = 0;           // operands forwarded to it
+    uint64_t forwardsOut = 0;          // results forwarded from it
+
+    uint64_t stalls() const { return dataBubblesSuffered + unitBubbles + controlBubbles; }
+};
+
+class ExecutionProfile {
+    uint32_t base = 0;
+    std::vector<PcCounters> counters;
+
+public:
+    // Zeroed counters for the instructions from `first` to `last`
+    void cover(uint32_t first, uint32_t last);
+    // The counters of the instruction at `pc`, nullptr outside the covered range
+    PcCounters* find(uint32_t pc) {
+        size_t slot = (pc - base) / 4;
+        return pc >= base && slot < counters.size() ? &counters[slot] : nullptr;
+    }
+
+    size_t size() const { return counters.size(); }
+    uint32_t pcOf(size_t slot) const { return base + 4 * static_cast<uint32_t>(slot); }
+    const PcCounters& operator[](size_t slot) const { return counters[slot]; }
+
+    void clear() { counters.clear(); }
+};
@@ -0,0 +1,53 @@
+/*
+Execution latencies of the M extension. MUL runs on the multiplier, DIV and REM
+share the divider, everything else takes the usual single execute cycle.
+
+  mul, div, rem     cycles from the start of the operation until its result can be used
+  multiplier,       pipelined (a new operation may start every cycle) or blocking
+  divider           (the unit is busy until its current operation completes)
+
+The pipeline holds an instruction in decode until the results it reads are ready
+and, for a MUL, DIV or REM, until its unit is free. Without pipelining the execute
+stage of such an instruction simply takes its latency.
+*/
+
+#pragma once
+
+#include "json_writer.h"
+#include <cstdint>
+#include <string>
+
+struct FunctionalUnitConfig {
+    uint32_t mulLatency = 3;
+    uint32_t divLatency = 20;
+    uint32_t remLatency = 20;
+    bool pipelinedMultiplier = true;
+    bool pipelinedDivider = false;
+
+    // `key=value` options over the defaults, e.g. "mul=4 div=32 divider=pipelined"
+    static FunctionalUnitConfig parse(const std::string& arguments);
+};
+
+class FunctionalUnits {
+public:
+    explicit FunctionalUnits(const FunctionalUnitConfig& config);
+
+    // Cycles the instruction `name` takes to execute, 1 for anything but MUL, DIV and REM
+    uint32_t latency(const std::string& name) const;
+    // The first cycle `name` may start executing: once `rs1` and `rs2` are ready and its unit
+    // is free. Registers 32 and up are not read
+    uint64_t readyAt(const std::string& name, uint32_t rs1, uint32_t rs2) const;
+    // Records that `name`, writing `rd`, started executing in cycle `now`
+    void issue(const std::string& name, uint32_t rd, uint64_t now);
+
+    const FunctionalUnitConfig& config() const { return settings; }
+    // Forgets the operations in flight
+    void clear();
+    void dump(JsonWriter& out) const;
+
+private:
+    FunctionalUnitConfig settings;
+    uint64_t registerReadyAt[32] = {0};
+    uint64_t multiplierFreeAt = 0;
+    uint64_t dividerFreeAt = 0;
+};
@@ -0,0 +1,43 @@
+/*
+Optional HTTP and WebSocket front end (`main --http <port>`) serving the endpoints
+of server/server.js straight from the simulator, without a Node process and a
+stdin/stdout hop in between. A single epoll loop handles every connection.
+
+  POST /assemble                       {"id"?, "code"}  machine code, data segment and the session id
+  POST /step, /run                     {"id"}           CPU state
+  POST /pipeline, /data_forward, /branch_prediction
+       (also /dataForward, /branchPrediction)  {"id"}   CPU state after toggling the mode
+  GET  /ws?id=<id>                     WebSocket upgrade bound to that session
+
+Every WebSocket text message is one command line: `step [n]` streams up to n step
+states (one message each, stopping at exit), `run` and the toggles answer with one
+state, and `assemble`/`edit` take their JSON payload on the following lines.
+Commands that name files on the server (`save`, `load`, `record`) are refused.
+
+Everything runs on the loop's thread, so every run gets the --run-ms budget
+(RUN_MILLISECONDS without one) and cannot ask for more, and `step n` stops at the
+same budget. Sessions unused for `idleSeconds` are dropped unless a WebSocket is
+bound to them; at `maxSessions` a new one replaces the least recently used.
+*/
+
+#pragma once
+
+#include "session.h"
+#include <cstdint>
+#include <string>
+
+namespace HttpServer {
+
+constexpr uint64_t RUN_MILLISECONDS = 1000;
+
+struct ServerOptions {
+    std::string host = "127.0.0.1";  // "0.0.0.0" listens on every interface
+    uint16_t port = 0;               // 0 picks a free one
+    size_t maxSessions = 256;
+    uint64_t idleSeconds = 15 * 60;
+};
+
+// Listens on `server.host`, prints { "http": port } and never returns
+void serve(const ServerOptions& server, const SessionOptions& options);
+
+}
@@ -12,6 +12,7 @@ class InstructionFactory {
 public:
     static std::unique_ptr<Instruction> create(const std::string& inst, 
                                                const std::vector<std::string>& operands,
+                                               const std::vector<uint32_t>& operandSymbols,  // symbol id per operand or NO_SYMBOL
                                                const SymbolTable& symbols,
                                                uint32_t address);
 };
@@ -0,0 +1,50 @@
+/*
+Streaming reader for the JSON objects that follow `assemble` and `edit` on stdin.
+The object is decoded straight from the stream buffer as it arrives, so it may
+span several lines, and string values are fully unescaped (\" \\ \/ \b \f \n \r \t
+and \uXXXX including surrogate pairs, encoded as UTF-8) into buffers that are kept
+between requests. Nested objects and arrays are skipped.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+class JsonRequest {
+    struct Field {
+        std::string key;
+        std::string value;  // unescaped string, or the literal text of any other value
+        bool isString;
+    };
+
+    std::vector<Field> fields;  // the first fieldCount entries belong to the current request
+    size_t fieldCount = 0;
+    std::streambuf* source = nullptr;
+    int last = 0;  // last character consumed, used to resynchronise after an error
+
+    int next();
+    int peek();
+    int skipWhitespace();
+    void expect(char c);
+    void parseString(std::string& out);
+    void parseLiteral(std::string& out);
+    void skipNested();
+    void appendUtf8(std::string& out, uint32_t codePoint);
+    uint32_t parseHex4();
+    void parseObject();
+    const Field* find(const std::string& key) const;
+
+public:
+    // Reads the next object, skipping blank space before it and the line break after it.
+    // On malformed input the rest of the line is discarded and runtime_error is thrown.
+    void read(std::istream& in);
+
+    bool hasString(const std::string& key) const;
+    // The decoded value stays valid until the next read
+    const std::string& getString(const std::string& key) const;
+    size_t getNumber(const std::string& key) const;
+};
@@ -0,0 +1,53 @@
+/*
+Buffered writer for the JSON responses printed on stdout.
+Values are formatted straight into one reusable buffer (hex through lookup tables,
+decimals with std::to_chars) and the whole response is written with a single
+flush, instead of pushing every value through iostream manipulators.
+*/
+
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+class JsonWriter {
+    std::string buffer;
+
+public:
+    JsonWriter& raw(const char* text) { buffer.append(text); return *this; }
+    JsonWriter& raw(const std::string& text) { buffer.append(text); return *this; }
+    JsonWriter& raw(char c) { buffer.push_back(c); return *this; }
+
+    // 0x%08x, without quotes
+    JsonWriter& hex(uint32_t value);
+    // "0x%08x"
+    JsonWriter& hexString(uint32_t value) { raw('"').hex(value); return raw('"'); }
+    // "0x%08x": used as an object key
+    JsonWriter& hexKey(uint32_t value) { hexString(value); return raw(": "); }
+
+    template <typename T>
+    JsonWriter& number(T value) {
+        char digits[24];
+        auto result = std::to_chars(digits, digits + sizeof(digits), value);
+        buffer.append(digits, result.ptr);
+        return *this;
+    }
+
+    // Quoted and escaped
+    JsonWriter& string(const std::string& text);
+
+    // Reopens the object that was just closed so that more members can be appended
+    JsonWriter& reopen();
+
+    JsonWriter& onOff(bool value) { return raw(value ? "\"On\"" : "\"Off\""); }
+    JsonWriter& boolean(bool value) { return raw(value ? "true" : "false"); }
+
+    // Drops a partly written response
+    void clear() { buffer.clear(); }
+    const std::string& str() const { return buffer; }
+
+    // Writes the response followed by a newline and clears the buffer, keeping its capacity
+    void flush(std::ostream& out);
+};
@@ -0,0 +1,88 @@
+/*
+Locality of an address stream (instruction fetches or loads and stores), measured
+without assuming any cache:
+
+  reuse distance  the number of distinct lines touched between two accesses to the
+                  same line, in power of two buckets. A fully associative LRU cache
+                  of C lines hits exactly the accesses with a distance below C, which
+                  gives the miss ratio of every such cache size at once.
+  heat map        reads and writes per page
+  working set     distinct lines touched in every window of `window` accesses
+
+Reuse distances come from a Fenwick tree over access times holding a mark at the
+last access of every line: the marks after a line's previous access count the
+distinct lines since. Times are renumbered whenever the tree fills, so it stays
+about twice the number of distinct lines and an access costs O(log lines). Lines
+live in an open addressing table, which keeps a few hundred million accesses to
+a few minutes.
+*/
+
+#pragma once
+
+#include "json_writer.h"
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct LocalityConfig {
+    uint32_t lineSize = 64;
+    uint32_t pageSize = 4096;
+    uint64_t window = 10000;
+    size_t pages = 32;  // hottest pages reported
+
+    // Applies one `key=value` option, returns false when the key is not a locality option
+    bool apply(const std::string& option);
+};
+
+class LocalityAnalysis {
+public:
+    explicit LocalityAnalysis(const LocalityConfig& config);
+
+    void access(uint32_t address, bool write);
+
+    uint64_t accesses() const { return total; }
+
+    // { "accesses", "lines", "reuse": { "cold", "histogram", "missRatio" }, "pages", "workingSet" }
+    void dump(JsonWriter& out) const;
+
+private:
+    struct LineState {
+        uint32_t line = 0;
+        uint32_t time = 0;     // slot of its last access in the tree
+        uint32_t window = 0;   // last window it was counted in
+        bool used = false;
+    };
+    struct PageHeat {
+        uint64_t reads = 0;
+        uint64_t writes = 0;
+    };
+
+    LocalityConfig settings;
+    uint32_t lineShift;
+    uint32_t pageShift;
+
+    std::vector<LineState> lines;  // open addressing with linear probing, a power of two long
+    size_t lineCount = 0;
+    std::vector<uint32_t> tree;    // Fenwick tree, 1-based
+    uint32_t now = 0;              // next free time slot
+
+    uint64_t total = 0;
+    uint64_t cold = 0;
+    std::vector<uint64_t> histogram;  // bucket 0 is distance 0, bucket k is [2^(k-1), 2^k)
+
+    std::unordered_map<uint32_t, PageHeat> pages;
+    uint32_t lastPage = 0;
+    PageHeat* lastHeat = nullptr;  // of `lastPage`, map nodes do not move
+
+    uint32_t windowIndex = 0;
+    uint64_t windowAccesses = 0;
+    uint32_t windowLines = 0;
+    std::vector<uint32_t> workingSet;
+
+    // The entry of `line`, a new unused one when it has not been seen
+    LineState& find(uint32_t line);
+    void add(uint32_t time, int32_t delta);
+    uint32_t prefix(uint32_t time) const;  // marks at times below `time`
+    void compact();
+};
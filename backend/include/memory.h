@@ -10,14 +10,21 @@ Stores memory for text and data segment
 #include <string>
 #include <limits>
 #include <map>
+#include <memory>
+#include "paged_memory.h"
+#include "json_writer.h"
 
 class Memory {
 
 public:
 
-    std::map<uint32_t, uint32_t> instructionMemory;
-    std::map<uint32_t, int> dataMemory;
-    std::map<uint32_t, int> stackMemory;
+    using Text = std::map<uint32_t, uint32_t>;
+
+    Text instructionMemory;
+    // Set on copies made for side runs: the CPU then fetches from this text, shared by every copy
+    std::shared_ptr<const Text> sharedText;
+    PagedMemory dataMemory;
+    PagedMemory stackMemory;
     std::string comment;
     std::vector<std::string> pipelineComments;
     uint32_t exitAddress;
@@ -25,19 +32,29 @@ public:
     const uint32_t STACK_END   = 0x80000000;
     const uint32_t DATA_START  = 0x10000000;
     const uint32_t DATA_END    = 0x20000000;
+    // [start, end) of the data an ELF executable placed outside the data segment.
+    // Part of the program like its instructions, so reset() keeps them
+    std::vector<std::pair<uint32_t, uint32_t>> mappedData;
 
     void storeInstruction(uint32_t address, uint32_t machineCode);
     void storeData(uint32_t address, uint8_t value);
     void storeDataBytes(uint32_t address, const std::vector<uint8_t>& values);
     void storeString(uint32_t address, const std::string& str);
+    void eraseInstruction(uint32_t address);
+    void eraseData(uint32_t address, uint32_t size);
     uint32_t fetchInstruction(uint32_t address) const;
+    // The text the CPU executes
+    const Text& text() const { return sharedText ? *sharedText : instructionMemory; }
     uint8_t fetchData(uint32_t address) const;
+    // Loads and stores outside the stack go to data memory when this holds
+    bool isDataAddress(uint32_t address) const;
+    void fetchDataBlock(uint32_t address, uint8_t* out, size_t size) const;
     const std::map<uint32_t, uint32_t>& getInstructionMemory() const;
-    const std::map<uint32_t, int>& getDataMemory() const;
-    void dumpMemory();
-    void dumpInstructions();
-    void dumpStack();
-    void dumpComments();
+    const PagedMemory& getDataMemory() const;
+    void dumpMemory(JsonWriter& out) const;
+    void dumpInstructions(JsonWriter& out) const;
+    void dumpStack(JsonWriter& out) const;
+    void dumpComments(JsonWriter& out);
 
     void reset();
 };
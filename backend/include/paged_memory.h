@@ -0,0 +1,61 @@
+/*
+Sparse byte addressable memory made of 4 KiB pages.
+Pages are allocated on the first write into them, untouched memory reads as zero.
+Every page remembers which of its bytes were written so that dumps list exactly
+the bytes a program stored. Copies share pages until one side writes (copy-on-write).
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+
+class PagedMemory {
+public:
+    static constexpr uint32_t PAGE_BITS = 12;
+    static constexpr uint32_t PAGE_SIZE = 1u << PAGE_BITS;
+
+    struct Page {
+        uint8_t bytes[PAGE_SIZE] = {};
+        uint64_t written[PAGE_SIZE / 64] = {};
+    };
+
+private:
+    std::map<uint32_t, std::shared_ptr<Page>> pages;  // keyed by page number
+
+    const Page* findPage(uint32_t pageNumber) const;
+    Page& writablePage(uint32_t pageNumber);
+
+public:
+    uint8_t read(uint32_t address) const;
+    void write(uint32_t address, uint8_t value);
+
+    void readBlock(uint32_t address, uint8_t* out, size_t size) const;
+    void writeBlock(uint32_t address, const uint8_t* data, size_t size);
+    void fill(uint32_t address, uint8_t value, size_t size);
+    void erase(uint32_t address, size_t size);
+
+    bool isWritten(uint32_t address) const;
+    bool anyWritten(uint32_t address, size_t size) const;
+    size_t pageCount() const { return pages.size(); }
+    bool empty() const { return pages.empty(); }
+    void clear() { pages.clear(); }
+
+    // Calls f(address, value) for every written byte in ascending address order
+    template <typename F>
+    void forEachWritten(F f) const {
+        for (const auto& [pageNumber, page] : pages) {
+            uint32_t base = pageNumber << PAGE_BITS;
+            for (uint32_t w = 0; w < PAGE_SIZE / 64; w++) {
+                uint64_t bits = page->written[w];
+                while (bits) {
+                    uint32_t offset = w * 64 + __builtin_ctzll(bits);
+                    f(base + offset, page->bytes[offset]);
+                    bits &= bits - 1;
+                }
+            }
+        }
+    }
+};
@@ -9,6 +9,23 @@
 #include "memory.h"
 #include <memory>
 #include <map>
+#include <vector>
+
+// What a single source line contributed in the first pass. The assembler keeps
+// this per line so that an edit can re-layout the program without reparsing it.
+struct LineInfo {
+    struct LabelUse {
+        uint32_t operand;  // index of the operand naming the label
+        uint32_t symbol;   // symbol id of the label
+    };
+    std::vector<uint32_t> labels;        // symbol ids of the labels defined on the line
+    std::vector<LabelUse> labelUses;     // label operands of branches and jumps
+    bool setsSegment = false;            // line is a .text or .data directive
+    bool isInstruction = false;          // line emits a word into instruction memory
+    bool isExit = false;
+    bool usesLocalLabels = false;        // defines or references a numeric local label
+    uint32_t alignment = 0;              // .align family: pads to a multiple of this, its size depends on its address
+};
 
 class Parser {
     DirectiveHandler directives;
@@ -18,8 +35,14 @@ public:
     Parser(Memory& mem) : directives(mem), memory(mem) {}  
 
     std::tuple<std::string, std::vector<std::string>> extractInstruction(const std::string& line);
+
+    // In the first pass `info` receives what the line defines and references,
+    // in the second pass the label references recorded there are used as is
     
     void parse(std::string line, uint32_t &address,
         SymbolTable &symbols, bool firstPass,
-        Memory& memory);
+        Memory& memory, LineInfo* info = nullptr);
+
+    bool inDataSegment() const { return directives.inDataSegment(); }
+    void setDataSegment(bool data) { directives.setDataSegment(data); }
 };
@@ -0,0 +1,69 @@
+/*
+Prefetchers that issue fills into the caches ahead of demand accesses.
+
+  next line  on every fetch, the `degree` lines after the fetched one
+  stride     a table of `entries` loads and stores indexed by PC. An entry remembers
+             the last address and stride of its instruction and a 2 bit confidence
+             that grows while the stride repeats. Once it reaches 2 the addresses
+             `distance` ... `distance + degree - 1` strides ahead are prefetched.
+
+They only suggest addresses, Cache::prefetch drops those already present and keeps
+the useful, late and useless counts.
+*/
+
+#pragma once
+
+#include "json_writer.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+struct PrefetcherConfig {
+    uint32_t degree = 1;
+    uint32_t distance = 1;   // stride only
+    uint32_t entries = 64;   // stride only, a power of two
+
+    // `key=value` options over the defaults, e.g. "degree=2 entries=128"
+    static PrefetcherConfig parse(const std::string& arguments);
+};
+
+class NextLinePrefetcher {
+public:
+    explicit NextLinePrefetcher(const PrefetcherConfig& config);
+
+    // The addresses to prefetch after a fetch from `pc` into lines of `lineSize` bytes
+    const std::vector<uint32_t>& observe(uint32_t pc, uint32_t lineSize);
+
+    const PrefetcherConfig& config() const { return settings; }
+    void clear() { lastLine = UINT32_MAX; }
+    void dump(JsonWriter& out) const;
+
+private:
+    PrefetcherConfig settings;
+    uint32_t lastLine = UINT32_MAX;
+    std::vector<uint32_t> addresses;
+};
+
+class StridePrefetcher {
+public:
+    explicit StridePrefetcher(const PrefetcherConfig& config);
+
+    // The addresses to prefetch after the load or store at `pc` accessed `address`
+    const std::vector<uint32_t>& observe(uint32_t pc, uint32_t address);
+
+    const PrefetcherConfig& config() const { return settings; }
+    void clear();
+    void dump(JsonWriter& out) const;
+
+private:
+    struct Entry {
+        uint32_t pc = UINT32_MAX;
+        uint32_t lastAddress = 0;
+        int32_t stride = 0;
+        uint8_t confidence = 0;
+    };
+
+    PrefetcherConfig settings;
+    std::vector<Entry> table;
+    std::vector<uint32_t> addresses;
+};
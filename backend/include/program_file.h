@@ -0,0 +1,37 @@
+/*
+Binary program files written by `save` and read back by `load`.
+  native (.rvi)  header, text runs, data runs, symbols and a line map, laid out
+                 so a loader can map the file and copy runs straight into memory
+  ELF32 (.elf)   RISC-V executable with .text/.data PT_LOAD segments and a .symtab
+  flat (.bin)    raw little-endian text words starting at address 0
+`load` also accepts ELF32 executables built by a RISC-V toolchain.
+*/
+
+#pragma once
+
+#include "program_image.h"
+#include <cstdint>
+#include <string>
+
+enum class ProgramFormat { Native, Elf, FlatBinary };
+
+// Picks the format from the file extension, anything unknown is a native image
+ProgramFormat formatFromPath(const std::string& path);
+const char* formatName(ProgramFormat format);
+
+// Writes the program and returns the file size in bytes
+size_t writeProgramFile(const std::string& path, ProgramFormat format, const ProgramImage& image, uint32_t entry);
+
+struct LoadedProgram {
+    ProgramFormat format;
+    uint32_t entry;          // initial PC
+    uint32_t globalPointer;  // initial gp
+    std::vector<std::pair<uint32_t, uint32_t>> mappedData;  // [start, end) of ELF data outside the data segment
+    std::vector<uint32_t> unsupported;  // addresses of the words the CPU cannot decode
+};
+
+// Reads a native image or an ELF32 RV32 executable, told apart by their magic.
+// Native images rebuild their lines from the line map and keep their data inside
+// 0x10000000-0x20000000. ELF files get one line per instruction and per data segment,
+// and their data segments are mapped wherever they were linked.
+LoadedProgram readProgramFile(const std::string& path, ProgramImage& image);
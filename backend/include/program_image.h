@@ -0,0 +1,40 @@
+/*
+An assembled program: the per-line result of both assembler passes together with
+the symbols and memory contents it produces. Used to cache and restore assemblies.
+*/
+
+#pragma once
+
+#include "parser.h"
+#include "paged_memory.h"
+#include <cstdint>
+#include <istream>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// One source line with the result of both assembler passes
+struct AssembledLine {
+    std::string text;
+    LineInfo info;
+    uint32_t address = 0;        // address of the first byte emitted by the line
+    uint32_t size = 0;           // bytes emitted by the line
+    bool inData = false;         // segment the line is emitted into
+    uint32_t word = 0;           // encoded instruction (text lines)
+    std::vector<uint8_t> bytes;  // encoded payload (data lines), empty when the line only reserves space
+};
+
+struct ProgramImage {
+    std::string source;  // normalized source the image was assembled from
+    std::vector<AssembledLine> lines;
+    SymbolTable symbols;  // line infos refer to its ids
+    std::map<uint32_t, uint32_t> instructionMemory;
+    PagedMemory dataMemory;
+    uint32_t exitAddress = 0;
+};
+
+// Binary serialization used by the on-disk assembly cache. Memory contents are not
+// written, they are rebuilt from the lines when the image is read back.
+void writeProgramImage(std::ostream& out, const ProgramImage& image);
+bool readProgramImage(std::istream& in, ProgramImage& image);
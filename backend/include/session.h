@@ -0,0 +1,141 @@
+/*
+One simulator instance: its own memory, CPU and assembler, plus the handlers for
+the text commands. The interactive mode drives a single session, the daemon mode
+hosts many of them side by side.
+*/
+
+#pragma once
+
+#include "assembler.h"
+#include "cpu.h"
+#include "memory.h"
+#include "json_request.h"
+#include "json_writer.h"
+#include "trace.h"
+#include "trace_file.h"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+
+struct SessionOptions {
+    std::string cacheDirectory;  // empty keeps the assembly cache in memory only
+    size_t cacheSize = 64;
+    uint64_t runMilliseconds = 0;  // wall-clock budget of a `run` that sets none, zero for no limit
+    uint64_t maxRunMilliseconds = 0;  // caps the `ms=` a run may ask for, zero for no cap
+    // Cycle budget of a `sweep`, `trace` or `locality` that sets no limit, zero for none. Unlike a run
+    // they cannot be paused or cancelled, so by default a program that never exits stops after this
+    static constexpr uint64_t DEFAULT_ANALYSIS_CYCLES = 10000000;
+    uint64_t analysisCycles = DEFAULT_ANALYSIS_CYCLES;
+    // Assembly cache of every session created with these options, nullptr gives each session its own
+    std::shared_ptr<AssemblyCache> cache;
+
+    // A cache with the size and directory above, for `cache`
+    std::shared_ptr<AssemblyCache> makeCache() const;
+};
+
+// Limits of one `run`, from `run [cycles=N] [instructions=N] [ms=N]`. Zero means no limit.
+struct RunBudget {
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t milliseconds = 0;
+
+    static RunBudget parse(const std::string& arguments);
+};
+
+// Lets another thread stop a run between two slices and follow its progress
+struct RunControl {
+    enum Request { NONE, PAUSE, CANCEL };
+
+    std::atomic<int> request{NONE};
+    std::atomic<uint64_t> cycles{0};
+    std::atomic<uint64_t> instructions{0};
+    std::atomic<uint32_t> pc{0};
+    std::chrono::steady_clock::time_point started;
+    std::function<void()> onSlice;  // called on the running thread after every slice
+
+    // Before the run starts, on the thread that later asks for its status
+    void begin(const Cpu& cpu);
+    // { "running": true, "cycles", "instructions", "pc", "elapsed_ms" }
+    void writeStatus(JsonWriter& json) const;
+};
+
+class Session {
+    void saveAndOutput(const std::string& path, JsonWriter& json);
+    void loadAndOutput(const std::string& path, JsonWriter& json);
+    void toggleAndOutput(bool& flag, JsonWriter& json);
+    void sweepAndOutput(const RunBudget& budget, JsonWriter& json);
+    void traceAndOutput(const RunBudget& budget, JsonWriter& json);
+    void replayAndOutput(JsonWriter& json);
+    void recordAndOutput(const std::string& arguments, JsonWriter& json);
+    void profileAndOutput(const std::string& arguments, JsonWriter& json);
+    void cacheAndOutput(const std::string& arguments, JsonWriter& json);
+    void dramAndOutput(const std::string& arguments, JsonWriter& json);
+    void prefetchAndOutput(const std::string& arguments, JsonWriter& json);
+    void latencyAndOutput(const std::string& arguments, JsonWriter& json);
+    void localityAndOutput(const std::string& arguments, JsonWriter& json);
+    void writeCaches(JsonWriter& json);
+    void rewind();
+    // Loads the program as assembled into `image` and points `copy` at its entry, for the side runs of
+    // `sweep`, `trace` and `locality`. Every copy shares `text` and, until it writes them, the pages of the
+    // assembled data; the session's own state is left alone.
+    void loadCopy(Memory& image, Cpu& copy, std::shared_ptr<const Memory::Text> text) const;
+    // The default time budget when `budget` sets none, capped at maxRunMilliseconds
+    void limitTime(RunBudget& budget) const;
+    // The default cycle budget of `sweep`, `trace` and `locality` when `budget` sets no cycle or instruction limit
+    void limitAnalysis(RunBudget& budget) const;
+
+    void writeMachineState(JsonWriter& json);
+    void writeComment(JsonWriter& json);
+    void writeModes(JsonWriter& json);
+
+    uint64_t defaultRunMilliseconds;
+    uint64_t maxRunMilliseconds;
+    uint64_t defaultAnalysisCycles;
+    Trace trace;  // recorded by `trace`, replayed by `replay`
+    std::unique_ptr<TraceWriter> recorder;  // attached to `cpu` between `record <path>` and `record off`
+
+public:
+    Memory memory;
+    Cpu cpu;
+    Assembler assembler;
+
+    explicit Session(const SessionOptions& options);
+
+    // `assemble` and `edit` are followed by a JSON payload
+    static bool needsPayload(const std::string& command);
+
+    // `run` and `run <limits>`
+    static bool isRun(const std::string& command);
+    // The limits following the command name, with the default time budget applied
+    RunBudget runBudget(const std::string& command) const;
+
+    // Runs `cpu` within the cycle, instruction and time limits of `budget`.
+    // Returns "cycles", "instructions" or "time" when a limit stopped it, nullptr once the program finished.
+    static const char* runWithin(Cpu& cpu, const RunBudget& budget);
+
+    // Runs one command and writes its JSON response into `json`.
+    // Returns false for an unknown command, errors are thrown.
+    bool execute(const std::string& command, const JsonRequest& request, JsonWriter& json);
+
+    // `assemble` and `edit` for callers that already hold the source
+    void assembleAndOutput(const std::string& source, JsonWriter& json);
+    void editAndOutput(size_t startLine, size_t endLine, const std::string& source, JsonWriter& json);
+
+    // Returns true once the program has exited
+    bool stepAndOutput(JsonWriter& json);
+
+    // `run` in slices of SLICE_CYCLES, stopping early at the budget or when `control` asks.
+    // A stopped run reports why in "stopped", a cancelled one also rewinds the program.
+    static constexpr uint64_t SLICE_CYCLES = 1 << 16;
+    void runAndOutput(const RunBudget& budget, RunControl* control, JsonWriter& json);
+
+    // ", \"totalInstructions\": n, ..." with every counter of the last run
+    void writeCounters(JsonWriter& json);
+
+    // The same run as a coroutine suspended after every slice, so a scheduler can interleave sessions.
+    // The response is written into `json` when it finishes, which must outlive the generator.
+    CycleGenerator runSlices(RunBudget budget, RunControl* control, JsonWriter& json);
+};
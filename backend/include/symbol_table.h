@@ -1,17 +1,65 @@
 /*
-Symbol Table created in the first pass which stores the address of the label
+Symbol Table created in the first pass which stores the address of the label.
+Label names are interned to dense ids when they are first seen, definitions and
+references are carried around as ids so resolving a label is an array index.
+Local numeric labels (`1:` referenced as `1b` / `1f`) are interned under a
+name that also carries their definition count, e.g. the third `1:` is "1@2".
 */
 
 #pragma once
 
 #include <string>
 #include <unordered_map>
+#include <vector>
 #include <cstdint>
+#include <limits>
 
 class SymbolTable {
-    std::unordered_map<std::string, uint32_t> labels;
 public:
+    static constexpr uint32_t NO_SYMBOL = std::numeric_limits<uint32_t>::max();
+
+private:
+    std::unordered_map<std::string, uint32_t> ids;
+    std::vector<std::string> names;         // indexed by id
+    std::vector<uint32_t> addresses;        // indexed by id
+    std::vector<bool> defined;              // indexed by id
+    std::unordered_map<std::string, uint32_t> localCounts;  // `N:` definitions seen so far
+
+    // Sorted (address, id) pairs of the defined symbols, rebuilt lazily after a change
+    mutable std::vector<std::pair<uint32_t, uint32_t>> addressIndex;
+    mutable bool indexValid = false;
+
+public:
+    static bool isLocalLabel(const std::string& label);
+    static bool isLocalReference(const std::string& operand);
+
+    // Returns the id of `label`, creating an undefined symbol for it if needed
+    uint32_t intern(const std::string& label);
+    // Returns the id of `label` or NO_SYMBOL
+    uint32_t find(const std::string& label) const;
+
+    // Interns a label definition, numeric labels get the next local instance
+    uint32_t internDefinition(const std::string& label);
+    // Interns a `Nb` / `Nf` reference to the matching local label instance
+    uint32_t internLocalReference(const std::string& operand);
+
+    void define(uint32_t id, uint32_t address);
+    bool isDefined(uint32_t id) const { return id < defined.size() && defined[id]; }
+    uint32_t getAddress(uint32_t id) const { return addresses[id]; }
+    const std::string& getName(uint32_t id) const { return names[id]; }
+    size_t size() const { return names.size(); }
+
     void addLabel(const std::string& label, uint32_t address);
     uint32_t getAddress(const std::string& label) const;
     bool labelExists(const std::string& label) const;
-};
\ No newline at end of file
+
+    // Forgets every address but keeps the ids, used when a program is laid out again
+    void undefineAll();
+    void resetLocalCounts() { localCounts.clear(); }
+    void clear();
+
+    // Defined symbols sorted by address
+    const std::vector<std::pair<uint32_t, uint32_t>>& getAddressIndex() const;
+    // Finds the closest symbol at or below `address`, local labels are reported without their count
+    bool lookupAddress(uint32_t address, std::string& name, uint32_t& offset) const;
+};
@@ -0,0 +1,51 @@
+/*
+Timing-only model of the 5 stage pipeline (IF ID EX MEM WB) driven by a recorded
+trace. It never touches registers or memory, it only tracks when every instruction
+reaches decode:
+
+  - registers are written in WB and read in ID of the same cycle
+  - without forwarding a consumer waits in ID until its producer reaches WB
+    (2 bubbles at distance 1, 1 at distance 2); with forwarding only a load
+    followed by a user costs 1 bubble, unless the user is a store taking the loaded
+    value as its data (forwarded M to M)
+  - a control transfer the front end did not follow costs `branchPenalty` bubbles
+    (1, like Cpu::step where fetch runs after execute in the same cycle)
+  - `jal` targets are known in decode once prediction is on, `jalr` targets never are
+
+Cycles are counted like the full model: instructions + 4 to drain + bubbles.
+*/
+
+#pragma once
+
+#include "trace.h"
+#include <cstdint>
+#include <string>
+
+namespace TimingModel {
+
+enum class Predictor { NONE, ONE_BIT, BIMODAL };
+
+struct Config {
+    bool dataForward = false;
+    Predictor predictor = Predictor::NONE;  // ONE_BIT is the single global bit of Cpu::step
+    unsigned branchPenalty = 1;
+    unsigned bimodalBits = 10;              // 2^bits two-bit counters indexed by PC
+};
+
+struct Result {
+    uint64_t cycles = 0;
+    uint64_t instructions = 0;
+    uint64_t bubbles = 0;
+    uint64_t dataHazards = 0;         // dependencies close enough to need a stall or a forward
+    uint64_t dataHazardBubbles = 0;
+    uint64_t forwards = 0;
+    uint64_t controlHazards = 0;      // control transfers the front end did not follow
+    uint64_t controlHazardBubbles = 0;
+    uint64_t branchMispredictions = 0;
+};
+
+Result replay(const Trace& trace, const Config& config);
+
+const char* predictorName(Predictor predictor);
+
+}
@@ -0,0 +1,34 @@
+/*
+Dynamic instruction trace: one record per retired instruction, taken from a
+functional (non pipelined) run. It holds what a timing model needs and nothing
+of the machine state, so the same trace can be replayed under many pipeline
+configurations without executing the program again.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class Instruction;
+
+enum class TraceKind : uint8_t { ALU, LOAD, STORE, BRANCH, JAL, JALR };
+
+struct TraceRecord {
+    uint32_t pc;
+    uint32_t address;  // effective address of loads and stores, next PC of control transfers
+    TraceKind kind;
+    uint8_t rd;        // 32 when the instruction has no such register
+    uint8_t rs1;
+    uint8_t rs2;
+    bool taken;        // the control transfer left the fall-through path
+};
+
+using Trace = std::vector<TraceRecord>;
+
+TraceKind traceKind(uint32_t opcode);
+
+// `effectiveAddress` is RZ after execute, `nextPC` the PC after the instruction retired
+TraceRecord makeTraceRecord(const Instruction& instruction, uint32_t effectiveAddress, uint32_t nextPC);
+
+const char* traceKindName(TraceKind kind);
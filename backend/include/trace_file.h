@@ -0,0 +1,115 @@
+/*
+Binary execution trace files, written while the Cpu runs and read back offline.
+
+  header   "RVTRACE\0", u32 version, u32 flags (1 = per cycle pipeline occupancy)
+  chunks   records, each chunk decodable on its own
+  index    one 32 byte entry per chunk (offset, first instruction, bytes, instructions, cycles, first PC)
+  footer   u64 index offset, u32 chunk count, "RVTI"
+
+Every record starts with a tag byte. A retired instruction (bit 7 clear) sets
+  bit 0  PC is the previous PC + 4, otherwise a zigzag varint delta from it follows
+  bit 1  register write: rd byte, varint value
+  bit 2  load, bit 3 store: zigzag varint address delta from the previous access, varint value
+  bits 4-5  log2 of the access size
+A pipelined cycle (bit 7 set) holds in bits 0-4 which of F D E M W carry an instruction.
+All fixed width fields are little endian.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+struct TraceChunk {
+    uint64_t offset = 0;
+    uint64_t firstInstruction = 0;
+    uint32_t bytes = 0;
+    uint32_t instructions = 0;
+    uint32_t cycles = 0;
+    uint32_t firstPC = 0;
+};
+
+struct TraceEvent {
+    enum Access : uint8_t { NONE, LOAD, STORE };
+
+    bool cycle = false;
+    uint8_t stages = 0;        // cycle records: bit 0 is F ... bit 4 is W
+    uint32_t pc = 0;
+    bool registerWrite = false;
+    uint8_t rd = 0;
+    uint32_t value = 0;
+    Access access = NONE;
+    uint8_t size = 0;          // bytes
+    uint32_t address = 0;
+    uint32_t data = 0;         // value loaded or stored
+};
+
+class TraceWriter {
+public:
+    static constexpr size_t CHUNK_BYTES = 1 << 16;
+
+    TraceWriter(const std::string& path, bool occupancy);
+    ~TraceWriter();
+
+    bool occupancy() const { return withOccupancy; }
+
+    // Remembered until the instruction retires. `sizeLog2` is funct3 & 3
+    void access(TraceEvent::Access kind, unsigned sizeLog2, uint32_t address, uint32_t data);
+    // `rd` 0 or 32 means no register was written
+    void retire(uint32_t pc, uint32_t rd, uint32_t value);
+    void cycle(uint8_t stages);
+
+    // Writes the last chunk, the index and the footer. Called by the destructor if needed
+    void finish();
+
+    uint64_t instructions() const { return totalInstructions; }
+    uint64_t cycles() const { return totalCycles; }
+    size_t chunks() const { return index.size(); }
+    uint64_t bytes() const { return written; }
+
+private:
+    std::ofstream out;
+    std::string path;
+    bool withOccupancy;
+    bool finished = false;
+
+    std::vector<uint8_t> buffer;
+    std::vector<TraceChunk> index;
+    TraceChunk current;
+    uint64_t written = 0;
+    uint64_t totalInstructions = 0;
+    uint64_t totalCycles = 0;
+
+    uint32_t previousPC = 0;
+    uint32_t previousAddress = 0;
+    TraceEvent::Access pendingAccess = TraceEvent::NONE;
+    unsigned pendingSize = 0;
+    uint32_t pendingAddress = 0;
+    uint32_t pendingData = 0;
+
+    void startChunk();
+    void flushChunk();
+    void varint(uint32_t value);
+    void zigzag(uint32_t delta);
+    void fixed(uint64_t value, int bytes);
+};
+
+class TraceReader {
+public:
+    explicit TraceReader(const std::string& path);
+
+    bool occupancy() const { return withOccupancy; }
+    const std::vector<TraceChunk>& chunks() const { return index; }
+
+    // Replaces `events` with the records of chunk `chunk`
+    void readChunk(size_t chunk, std::vector<TraceEvent>& events);
+
+private:
+    std::ifstream in;
+    std::string path;
+    bool withOccupancy = false;
+    std::vector<TraceChunk> index;
+    std::vector<uint8_t> buffer;
+};
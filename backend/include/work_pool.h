@@ -0,0 +1,54 @@
+/*
+A fixed set of worker threads that run numbered tasks. Each worker owns a
+deque: it takes from the front of its own and, when that runs dry, steals from
+the back of the others. One pool may serve every caller of a process, `run`
+is thread safe, but a task must not call `run` on the pool it runs on.
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkPool {
+    struct Job;
+
+    // Tasks queued on one worker, the owner takes from the front and thieves from the back
+    struct WorkQueue {
+        std::mutex mutex;
+        std::deque<std::pair<Job*, size_t>> tasks;
+    };
+
+    std::vector<WorkQueue> queues;
+    std::vector<std::thread> workers;
+
+    std::mutex wakeMutex;  // guards `queued`, `next` and `stopping`
+    std::condition_variable wake;
+    size_t queued = 0;  // tasks in the queues that no worker has taken yet
+    size_t next = 0;    // queue that receives the first task of the next job
+    bool stopping = false;
+
+    bool take(size_t worker, std::pair<Job*, size_t>& task);
+    void work(size_t worker);
+
+public:
+    // At least one worker
+    explicit WorkPool(unsigned threads);
+    ~WorkPool();
+    WorkPool(const WorkPool&) = delete;
+    WorkPool& operator=(const WorkPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(workers.size()); }
+
+    // Runs task(0) to task(count - 1) on the workers and returns once all of them have finished.
+    // Tasks must not throw
+    void run(size_t count, const std::function<void(size_t)>& task);
+
+    // The pool of the process, one worker per core, created on first use
+    static WorkPool& shared();
+};
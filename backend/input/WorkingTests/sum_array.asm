@@ -0,0 +1,17 @@
+# Sums a 5 element array through the global pointer and stores the result in .bss
+# Linked as: text at 0x100 (entry _start), .data at 0x10000000, .bss right after it,
+# gp = __global_pointer$ = 0x10000800 and `exit` as the exit symbol -> sum_array.elf
+_start:
+    addi x10, x0, 0         # sum = 0
+    addi x11, x3, -2048     # x11 = &array (gp - 2048)
+    addi x12, x0, 5         # n = 5
+loop:
+    lw x13, 0(x11)
+    add x10, x10, x13
+    addi x11, x11, 4
+    addi x12, x12, -1
+    bne x12, x0, loop
+    sw x10, 0(x11)          # result lives right after the array
+    jal x1, exit
+exit:
+    addi x0, x0, 0
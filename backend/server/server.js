@@ -1,251 +1,114 @@
 import express from 'express'
 import cors from 'cors'
 import path from 'path'
-import { spawn } from 'child_process'
 import { v4 as uuidv4 } from 'uuid';
 import { fileURLToPath } from 'url';
-import { pipeline } from 'stream';
+import { SimulatorPool } from './simulator_pool.js'
 
 const app = express();
 app.use(express.json());
 app.use(cors());
 
-let users = new Map()
+const __filename = fileURLToPath(import.meta.url);
+const __dirname = path.dirname(__filename);
+
+const pool = new SimulatorPool({
+    mainPath: path.resolve(__dirname, "../main"),
+    // A runaway program stops after SIM_RUN_MS instead of holding its process forever
+    args: ["--run-ms", String(process.env.SIM_RUN_MS ?? 10000), "--progress-ms", "0"],
+    warm: Number(process.env.SIM_POOL_SIZE ?? 4),
+    max: Number(process.env.SIM_MAX_PROCESSES ?? 64),
+    idleMs: Number(process.env.SIM_IDLE_MS ?? 10 * 60 * 1000),
+    checkpointDir: process.env.SIM_CHECKPOINT_DIR || null,
+});
 
-app.post("/assemble", (req, res) => {
+app.post("/assemble", async (req, res) => {
     let { id, code } = req.body;
-    let session;
-    let error = false;
+    let session = await pool.get(id);
 
-    if (!id || !users.has(id)) {
+    if (!session) {
         id = uuidv4();
-        const __filename = fileURLToPath(import.meta.url);
-        const __dirname = path.dirname(__filename);
-        const assemblerPath = path.resolve(__dirname, "../main");
-
-        const child = spawn(assemblerPath);
-        session = { child, output: "" };
-        users.set(id, session);
-
-        child.stdout.on("data", (data) => {
-            session.output += data.toString();
-        });
+        session = await pool.open(id);
+    }
 
-        child.stderr.on("data", (data) => {
-            error = true;
-            session.output += data.toString();
+    try {
+        const assembledJSON = JSON.parse(await session.simulator.send("assemble", { "input_code": code }));
+        session.assembled = true;
+        res.json({
+            machine_code: assembledJSON.machine_code,
+            data_segment: assembledJSON.data_segment,
+            id,
         });
-    } else {
-        session = users.get(id);
+    } catch (err) {
+        // Simulator reported an error
+        res.status(400).json({ error: err.message });
+    } finally {
+        pool.done(session);
     }
-
-    session.output = ""; 
-
-    session.child.stdin.write("assemble\n");
-    const input_code = { "input_code": code };
-    session.child.stdin.write(JSON.stringify(input_code) + "\n");
-
-    console.log([...users.keys()]);
-
-    setTimeout(() => {
-        console.log(session.output);
-        if (error) {
-            // Child process reported error
-            res.status(400).json({ error: session.output.trim() });
-        } else {
-            try {
-                const assembledJSON = JSON.parse(session.output);
-                console.log(assembledJSON);
-                res.json({
-                    machine_code: assembledJSON.machine_code,
-                    data_segment: assembledJSON.data_segment,
-                    id,
-                });
-            } catch (err) {
-                console.error("JSON parse error:", err);
-                res.status(400).json({ error: "Assembler output was not valid JSON." });
-            }
-        }
-    }, 1000);
 });
 
+// Sends `command` to the session named in the body and answers with `fields(output)`
+function simulate(command, missing, fields) {
+    return async (req, res) => {
+        const session = await pool.get(req.body.id);
+        if (!session) return res.status(400).json({ error: missing });
 
-app.post("/step", (req,res) => {
-    let { id } = req.body
-    if (!id || !users.has(id)) return res.status(400).json({ error: "Cannot step, you need to assemble first"})
-
-    const session = users.get(id)
-    session.output = ""
-    session.child.stdin.write("step\n");
-
-    console.log(session.output)
-    // const outputJSON = JSON.parse(session.output);
-    // console.log(outputJSON)
-
-    setTimeout(() => {
-        console.log(session.output)
         try {
-            const outputJSON = JSON.parse(session.output);
-            console.log(outputJSON)
-            res.json({
-                data_segment: outputJSON.data_segment,
-                instruction_memory: outputJSON.instruction_memory,
-                stack: outputJSON.stack,
-                registers: outputJSON.registers,
-                clock_cycles: outputJSON.clock_cycles,
-                comment: outputJSON.comment,
-                pipeline: outputJSON.pipeline,
-                data_forward: outputJSON.data_forward,
-                pipeline_status: outputJSON.pipeline_status,
-                data_forward_path: outputJSON.data_forward_path,
-                ra: outputJSON.RA,
-                rb: outputJSON.RB,
-                ry: outputJSON.RY,
-                rz: outputJSON.RZ,
-                rm: outputJSON.RM,
-            });
+            res.json(fields(JSON.parse(await session.simulator.send(command))));
         } catch (err) {
-            res.status(500).json({ error: session.output });
+            res.status(500).json({ error: err.message });
+        } finally {
+            pool.done(session);
         }
-    }, 500);
-    
-})
-
-app.post("/run", (req,res) => {
-    let { id } = req.body
-    if (!id || !users.has(id)) return res.status(400).json({ error: "Cannot run, you need to assemble first"})
-
-    const session = users.get(id)
-    session.output = ""
-    session.child.stdin.write("run\n");
-
-    setTimeout(() => {
-        console.log(session.output)
-        try {
-            const outputJSON = JSON.parse(session.output);
-            console.log(outputJSON)
-            res.json({
-                data_segment: outputJSON.data_segment,
-                instruction_memory: outputJSON.instruction_memory,
-                stack: outputJSON.stack,
-                registers: outputJSON.registers,
-                clock_cycles: outputJSON.clock_cycles,
-                comment: "Finished",
-                pipeline: outputJSON.pipeline,
-                data_forward: outputJSON.data_forward,
-                pipeline_status: outputJSON.pipeline_status,
-
-                totalInstructions: outputJSON.totalInstructions,
-                totalDataTransferInstructions: outputJSON.totalDataTransferInstructions,
-                totalControlInstructions: outputJSON.totalControlInstructions,
-                totalBubbles: outputJSON.totalBubbles,
-                totalControlHazardBubbles: outputJSON.totalControlHazardBubbles,
-                totalDataHazardBubbles: outputJSON.totalDataHazardBubbles,
-                totalDataHazards: outputJSON.totalDataHazards,
-                totalControlHazards: outputJSON.totalControlHazards,
-                totalBranchMissPredictions: outputJSON.totalBranchMissPredictions
-
-            });
-        } catch (err) {
-            res.status(500).json({ error: session.output });
-        }
-    }, 500);  
-})
-
-app.post("/pipeline", (req,res) => {
-    const isPipelineEnabled = req.query.pipelineEnabled === 'true'
-    console.log("Pipeline enabled:", isPipelineEnabled);
-    let { id } = req.body
-    if (!id || !users.has(id)) return res.status(400).json({ error: "Cannot run, you need to assemble first"})
-
-    const session = users.get(id)
-    session.output = ""
-    session.child.stdin.write("pipeline\n");
-
-    setTimeout(() => {
-        console.log(session.output)
-        try {
-            const outputJSON = JSON.parse(session.output);
-            console.log(outputJSON)
-            res.json({
-                data_segment: outputJSON.data_segment,
-                instruction_memory: outputJSON.instruction_memory,
-                stack: outputJSON.stack,
-                registers: outputJSON.registers,
-                clock_cycles: outputJSON.clock_cycles,
-                comment: outputJSON.comment,
-                pipeline: outputJSON.pipeline,
-                data_forward: outputJSON.data_forward,
-                branch_prediction: outputJSON.branch_prediction
-            });
-        } catch (err) {
-            res.status(500).json({ error: session.output });
-        }
-    }, 500);
-})
-
-app.post("/dataForward", (req,res) => {
-    const isDataForwardingEnabled = req.query.dataForwardingEnabled === 'true'
-    console.log("Pipeline enabled:", isDataForwardingEnabled);
-    let { id } = req.body
-    if (!id || !users.has(id)) return res.status(400).json({ error: "Cannot run, you need to assemble first"})
-
-    const session = users.get(id)
-    session.output = ""
-    session.child.stdin.write("data_forward\n");
-
-    setTimeout(() => {
-        console.log(session.output)
-        try {
-            const outputJSON = JSON.parse(session.output);
-            console.log(outputJSON)
-            res.json({
-                data_segment: outputJSON.data_segment,
-                instruction_memory: outputJSON.instruction_memory,
-                stack: outputJSON.stack,
-                registers: outputJSON.registers,
-                clock_cycles: outputJSON.clock_cycles,
-                comment: outputJSON.comment,
-                pipeline: outputJSON.pipeline,
-                data_forward: outputJSON.data_forward,
-                branch_prediction: outputJSON.branch_prediction
-            });
-        } catch (err) {
-            res.status(500).json({ error: session.output });
-        }
-    }, 500);
-})
-
-app.post("/branchPrediction", (req,res) => {
-    const isBranchPredictionEnabled = req.query.branchPredictionEnabled === 'true'
-    console.log("Pipeline enabled:", isBranchPredictionEnabled);
-    let { id } = req.body
-    if (!id || !users.has(id)) return res.status(400).json({ error: "Cannot run, you need to assemble first"})
+    };
+}
+
+const machineState = (outputJSON) => ({
+    data_segment: outputJSON.data_segment,
+    instruction_memory: outputJSON.instruction_memory,
+    stack: outputJSON.stack,
+    registers: outputJSON.registers,
+    clock_cycles: outputJSON.clock_cycles,
+    comment: outputJSON.comment,
+    pipeline: outputJSON.pipeline,
+    data_forward: outputJSON.data_forward,
+});
 
-    const session = users.get(id)
-    session.output = ""
-    session.child.stdin.write("branch_prediction\n");
+app.post("/step", simulate("step", "Cannot step, you need to assemble first", (outputJSON) => ({
+    ...machineState(outputJSON),
+    pipeline_status: outputJSON.pipeline_status,
+    data_forward_path: outputJSON.data_forward_path,
+    ra: outputJSON.RA,
+    rb: outputJSON.RB,
+    ry: outputJSON.RY,
+    rz: outputJSON.RZ,
+    rm: outputJSON.RM,
+})));
+
+app.post("/run", simulate("run", "Cannot run, you need to assemble first", (outputJSON) => ({
+    ...machineState(outputJSON),
+    comment: outputJSON.stopped ? "Stopped: " + outputJSON.stopped : "Finished",
+    stopped: outputJSON.stopped,
+    pipeline_status: outputJSON.pipeline_status,
+
+    totalInstructions: outputJSON.totalInstructions,
+    totalDataTransferInstructions: outputJSON.totalDataTransferInstructions,
+    totalControlInstructions: outputJSON.totalControlInstructions,
+    totalBubbles: outputJSON.totalBubbles,
+    totalControlHazardBubbles: outputJSON.totalControlHazardBubbles,
+    totalDataHazardBubbles: outputJSON.totalDataHazardBubbles,
+    totalDataHazards: outputJSON.totalDataHazards,
+    totalControlHazards: outputJSON.totalControlHazards,
+    totalBranchMissPredictions: outputJSON.totalBranchMissPredictions
+})));
+
+const toggled = (outputJSON) => ({
+    ...machineState(outputJSON),
+    branch_prediction: outputJSON.branch_prediction
+});
 
-    setTimeout(() => {
-        console.log(session.output)
-        try {
-            const outputJSON = JSON.parse(session.output);
-            console.log(outputJSON)
-            res.json({
-                data_segment: outputJSON.data_segment,
-                instruction_memory: outputJSON.instruction_memory,
-                stack: outputJSON.stack,
-                registers: outputJSON.registers,
-                clock_cycles: outputJSON.clock_cycles,
-                comment: outputJSON.comment,
-                pipeline: outputJSON.pipeline,
-                data_forward: outputJSON.data_forward,
-                branch_prediction: outputJSON.branch_prediction
-            });
-        } catch (err) {
-            res.status(500).json({ error: session.output });
-        }
-    }, 500);
-})
+app.post("/pipeline", simulate("pipeline", "Cannot run, you need to assemble first", toggled));
+app.post("/dataForward", simulate("data_forward", "Cannot run, you need to assemble first", toggled));
+app.post("/branchPrediction", simulate("branch_prediction", "Cannot run, you need to assemble first", toggled));
 
 app.listen(3000, () => console.log("Server running on port 3000"));
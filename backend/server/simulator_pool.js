@@ -0,0 +1,240 @@
+import { spawn } from 'child_process'
+import fs from 'fs'
+import path from 'path'
+
+// Lines `main` prints on stderr when a command failed, anything else there is a warning
+const FAILURE = /^(Error: |Standard exception: |Invalid command|An unknown error)/;
+
+// One `main` process. Every command is answered by one line, on stdout when it
+// succeeded or on stderr when it failed. Commands are sent one at a time so the
+// two pipes can never be matched to the wrong command.
+class Simulator {
+    constructor(mainPath, args) {
+        this.child = spawn(mainPath, args);
+        this.exited = new Promise((resolve) => this.child.on("exit", resolve));
+        this.alive = true;
+        this.pending = null;
+        this.tail = Promise.resolve();
+        this.stdout = "";
+        this.stderr = "";
+
+        this.child.stdout.on("data", (data) => {
+            this.stdout += data.toString();
+            let newline;
+            while ((newline = this.stdout.indexOf("\n")) !== -1) {
+                const line = this.stdout.slice(0, newline);
+                this.stdout = this.stdout.slice(newline + 1);
+                this.settle(null, line);
+            }
+        });
+        this.child.stderr.on("data", (data) => {
+            this.stderr += data.toString();
+            let newline;
+            while ((newline = this.stderr.indexOf("\n")) !== -1) {
+                const line = this.stderr.slice(0, newline);
+                this.stderr = this.stderr.slice(newline + 1);
+                if (FAILURE.test(line)) this.settle(new Error(line), null);
+            }
+        });
+        this.child.on("exit", () => {
+            this.alive = false;
+            this.settle(new Error("Simulator exited"), null);
+        });
+        this.child.stdin.on("error", () => {});
+    }
+
+    settle(error, line) {
+        const pending = this.pending;
+        this.pending = null;
+        if (!pending) return;
+        if (error) pending.reject(error);
+        else pending.resolve(line);
+    }
+
+    // Sends a command, plus its JSON payload for assemble/edit, and resolves with the response line
+    send(command, payload) {
+        const result = this.tail.then(() => new Promise((resolve, reject) => {
+            if (!this.alive) return reject(new Error("Simulator exited"));
+            this.pending = { resolve, reject };
+            this.child.stdin.write(command + "\n" + (payload ? JSON.stringify(payload) + "\n" : ""));
+        }));
+        this.tail = result.catch(() => {});
+        return result;
+    }
+
+    kill() {
+        this.alive = false;
+        this.child.kill();
+    }
+}
+
+// Keeps `warm` started simulators ready for new sessions and at most `max` processes in total.
+// A session gives its simulator back (after a `reset`) when it is evicted, either because it
+// was idle for `idleMs` or because a new session needed a process while at the cap. With a
+// `checkpointDir`, evicted programs are saved there and loaded again on the session's next request.
+// `get` and `open` hand out a session held for one request until `done`; held sessions are never
+// evicted, and a new session waits at the cap until one is let go.
+export class SimulatorPool {
+    constructor({ mainPath, args = [], warm = 4, max = 64, idleMs = 10 * 60 * 1000, checkpointDir = null }) {
+        this.mainPath = mainPath;
+        this.args = args;
+        this.warm = warm;
+        this.max = Math.max(max, 1);
+        this.idleMs = idleMs;
+        this.checkpointDir = checkpointDir;
+        this.sessions = new Map();  // id -> { id, simulator, lastUsed, assembled, holds, retiring }, oldest use first
+        this.idle = [];
+        this.total = 0;
+        this.waiting = [];  // acquire calls waiting for a process at the cap
+
+        if (checkpointDir) fs.mkdirSync(checkpointDir, { recursive: true });
+        this.fill();
+        setInterval(() => this.evictIdle(), Math.min(idleMs, 60 * 1000)).unref();
+    }
+
+    spawn() {
+        const simulator = new Simulator(this.mainPath, this.args);
+        this.total++;
+        simulator.child.on("exit", () => {
+            this.total--;
+            this.idle = this.idle.filter((s) => s !== simulator);
+            this.wake();
+        });
+        return simulator;
+    }
+
+    wake() {
+        const waiting = this.waiting;
+        this.waiting = [];
+        for (const resume of waiting) resume();
+    }
+
+    fill() {
+        while (this.idle.length < this.warm && this.total < this.max) {
+            this.idle.push(this.spawn());
+        }
+    }
+
+    // Every check and claim below happens before an await, so concurrent callers can neither
+    // exceed `max` nor take the same session's process
+    async acquire() {
+        while (true) {
+            if (this.idle.length > 0 || this.total < this.max) {
+                const simulator = this.idle.pop() ?? this.spawn();
+                setImmediate(() => this.fill());
+                return simulator;
+            }
+            const victim = [...this.sessions.values()].find((session) => session.holds === 0 && !session.retiring);
+            if (victim) {
+                // The process goes straight to this caller instead of through `idle`
+                if (await this.unregister(victim)) return victim.simulator;
+                victim.simulator.kill();
+                await victim.simulator.exited;
+                continue;
+            }
+            await new Promise((resume) => this.waiting.push(resume));
+        }
+    }
+
+    // Saves the session's checkpoint and resets its process, false when the process is unusable
+    async retire(session) {
+        if (this.checkpointDir && session.assembled) {
+            try {
+                await session.simulator.send(`save ${this.checkpointPath(session.id)}`);
+            } catch {
+                // Nothing worth keeping, e.g. the last assemble failed
+            }
+        }
+        try {
+            await session.simulator.send("reset");
+            return true;
+        } catch {
+            return false;
+        }
+    }
+
+    // Retires a session that stays registered until its checkpoint is saved, so that a `get`
+    // meanwhile waits for the save instead of finding nothing or loading an older checkpoint
+    unregister(session) {
+        session.retiring = this.retire(session).then((usable) => {
+            if (this.sessions.get(session.id) === session) this.sessions.delete(session.id);
+            return usable;
+        });
+        return session.retiring;
+    }
+
+    release(simulator, usable = true) {
+        if (usable && this.idle.length < this.warm) this.idle.push(simulator);
+        else simulator.kill();
+        this.wake();
+    }
+
+    checkpointPath(id) {
+        return path.join(this.checkpointDir, path.basename(String(id)) + ".rvi");
+    }
+
+    touch(session) {
+        session.lastUsed = Date.now();
+        // Map keeps insertion order, re-inserting keeps the least recently used session first
+        this.sessions.delete(session.id);
+        this.sessions.set(session.id, session);
+    }
+
+    // Starts a new session on a warm simulator, held for the caller
+    async open(id) {
+        const session = { id, simulator: await this.acquire(), lastUsed: Date.now(), assembled: false, holds: 1 };
+        this.sessions.set(id, session);
+        return session;
+    }
+
+    // The live session, one restored from its checkpoint, or undefined. A session is held for the caller
+    async get(id) {
+        if (!id) return undefined;
+        const session = this.sessions.get(id);
+        if (session?.retiring) {
+            await session.retiring;
+            return this.get(id);
+        }
+        if (session) {
+            if (session.simulator.alive) {
+                session.holds++;
+                this.touch(session);
+                return session;
+            }
+            this.sessions.delete(id);
+        }
+        if (!this.checkpointDir || !fs.existsSync(this.checkpointPath(id))) return undefined;
+
+        const restored = await this.open(id);
+        try {
+            await restored.simulator.send(`load ${this.checkpointPath(id)}`);
+            restored.assembled = true;
+            return restored;
+        } catch {
+            this.sessions.delete(id);
+            this.release(restored.simulator, await this.retire(restored));
+            return undefined;
+        }
+    }
+
+    // Lets go of a session from `get` or `open` once its request is answered
+    done(session) {
+        session.holds--;
+        if (this.sessions.get(session.id) === session) this.touch(session);
+        if (session.holds === 0) this.wake();
+    }
+
+    async evict(id) {
+        const session = this.sessions.get(id);
+        if (!session || session.holds > 0 || session.retiring) return;
+        this.release(session.simulator, await this.unregister(session));
+    }
+
+    evictIdle() {
+        const cutoff = Date.now() - this.idleMs;
+        for (const session of [...this.sessions.values()]) {
+            if (session.lastUsed >= cutoff) break;
+            this.evict(session.id);
+        }
+    }
+}
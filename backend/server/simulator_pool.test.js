@@ -0,0 +1,135 @@
+import test from 'node:test'
+import assert from 'node:assert/strict'
+import fs from 'fs'
+import os from 'os'
+import path from 'path'
+import { fileURLToPath } from 'url'
+import { SimulatorPool } from './simulator_pool.js'
+
+// Runs against the `main` that `npm run build` makes
+const mainPath = path.resolve(path.dirname(fileURLToPath(import.meta.url)), "../main");
+
+function makePool(options) {
+    const checkpointDir = fs.mkdtempSync(path.join(os.tmpdir(), "simulator-pool-"));
+    return new SimulatorPool({ mainPath, warm: 0, checkpointDir, ...options });
+}
+
+// Kills every process the pool still has so the test can end
+function close(pool) {
+    for (const session of pool.sessions.values()) session.simulator.kill();
+    for (const simulator of pool.idle) simulator.kill();
+    fs.rmSync(pool.checkpointDir, { recursive: true, force: true });
+}
+
+async function assemble(session, value) {
+    await session.simulator.send("assemble", { input_code: `addi x5, x0, ${value}\nexit` });
+    session.assembled = true;
+}
+
+async function x5(session) {
+    return JSON.parse(await session.simulator.send("run")).registers.x5;
+}
+
+test("a new session at the cap evicts the least recently used idle one", async () => {
+    const pool = makePool({ max: 2 });
+    try {
+        const a = await pool.open("a");
+        await assemble(a, 1);
+        const b = await pool.open("b");
+        pool.done(a);
+
+        // b is held, so c takes a's process
+        const c = await pool.open("c");
+        assert.equal(pool.total, 2);
+        assert.deepEqual([...pool.sessions.keys()], ["b", "c"]);
+        assert.ok(fs.existsSync(pool.checkpointPath("a")));
+        pool.done(b);
+        pool.done(c);
+    } finally {
+        close(pool);
+    }
+});
+
+test("a new session waits at the cap until a held one is done", async () => {
+    const pool = makePool({ max: 1 });
+    try {
+        const a = await pool.open("a");
+        let opened = false;
+        const opening = pool.open("b").then((b) => { opened = true; return b; });
+        await new Promise((resolve) => setTimeout(resolve, 50));
+        assert.equal(opened, false);
+
+        pool.done(a);
+        const b = await opening;
+        assert.equal(pool.total, 1);
+        assert.equal(pool.sessions.has("a"), false);
+        pool.done(b);
+    } finally {
+        close(pool);
+    }
+});
+
+test("an evicted session is restored from its checkpoint", async () => {
+    const pool = makePool({ max: 2 });
+    try {
+        const a = await pool.open("a");
+        await assemble(a, 7);
+        pool.done(a);
+        const empty = await pool.open("empty");
+        pool.done(empty);
+
+        await pool.evict("a");
+        await pool.evict("empty");
+        assert.equal(pool.sessions.size, 0);
+
+        const restored = await pool.get("a");
+        assert.equal(await x5(restored), "0x00000007");
+        pool.done(restored);
+        // Nothing was assembled, so nothing was saved
+        assert.equal(await pool.get("empty"), undefined);
+    } finally {
+        close(pool);
+    }
+});
+
+test("a get while the session is being evicted waits for its checkpoint", async () => {
+    const pool = makePool({ max: 1 });
+    try {
+        const a = await pool.open("a");
+        await assemble(a, 3);
+        pool.done(a);
+
+        // Neither is awaited, so the get lands while the save is in flight
+        const evicting = pool.evict("a");
+        const restoring = pool.get("a");
+        await evicting;
+        const restored = await restoring;
+        assert.ok(restored);
+        assert.equal(await x5(restored), "0x00000003");
+        pool.done(restored);
+    } finally {
+        close(pool);
+    }
+});
+
+test("a get while a new session evicts the old one restores it once the new one is done", async () => {
+    const pool = makePool({ max: 1 });
+    try {
+        const a = await pool.open("a");
+        await assemble(a, 5);
+        pool.done(a);
+
+        const opening = pool.open("b");
+        const restoring = pool.get("a");
+        const b = await opening;
+        pool.done(b);
+
+        const restored = await restoring;
+        assert.ok(restored);
+        assert.equal(await x5(restored), "0x00000005");
+        assert.equal(pool.total, 1);
+        pool.done(restored);
+    } finally {
+        close(pool);
+    }
+});
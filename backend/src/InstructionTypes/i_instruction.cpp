@@ -74,6 +74,28 @@ void IInstruction::execute(Cpu& cpu) const {
         cpu.RZ = addr;  // Store address in memory register
         cpu.memory.comment = "[Execute] I-format instruction " + instrName + " executed and effective address calculated: " + std::to_string(addr);
     }
+    else if (op == 0b1110011) {  // Zicsr: the old value goes to rd, rs1 sets, clears or replaces it
+        uint32_t csr = imm & 0xFFF;
+        // csrrw with rd = x0 does not read the CSR
+        uint32_t old = funct3 == 0b001 && rd == 0 ? 0 : cpu.readCsr(csr);
+        if (funct3 == 0b001) {
+            cpu.writeCsr(csr, cpu.RA);
+        } else if (funct3 == 0b010 && rs1 != 0) {
+            cpu.writeCsr(csr, old | cpu.RA);
+        } else if (funct3 == 0b011 && rs1 != 0) {
+            cpu.writeCsr(csr, old & ~cpu.RA);
+        }
+        result = old;
+
+        std::string comment = rd == 0 && funct3 == 0b001
+            ? "[Execute] I-format instruction " + instrName + " wrote " + std::to_string(cpu.RA) + " to CSR " + std::to_string(csr)
+            : "[Execute] I-format instruction " + instrName + " read " + std::to_string(old) + " from CSR " + std::to_string(csr);
+        if (cpu.pipeline) {
+            cpu.memory.pipelineComments.push_back(comment);
+        } else {
+            cpu.memory.comment = comment;
+        }
+    }
     else if (op == 0b1100111 && funct3 == 0b000) {  // JALR
         // Calculate return address
         result = cpu.PC + 4;
@@ -113,7 +135,7 @@ void IInstruction::memory_update(Cpu& cpu) const {
     // Range checking instead of map existence
     if (addr >= cpu.memory.STACK_START && addr < cpu.memory.STACK_END) {
         targetMemory = "STACK";
-    } else if (addr >= cpu.memory.DATA_START && addr < cpu.memory.DATA_END) {
+    } else if (cpu.memory.isDataAddress(addr)) {
         targetMemory = "DATA";
     } else {
         comment = "[Memory] Error: Address " + std::to_string(addr) + " not in stack/data segment.";
@@ -129,27 +151,27 @@ void IInstruction::memory_update(Cpu& cpu) const {
     if (funct3 == 0b000) {  // lb (load byte)
         // Sign-extend byte
         if (targetMemory == "STACK") {
-            int8_t byte = cpu.memory.stackMemory[addr] & 0xFF;
+            int8_t byte = cpu.memory.stackMemory.read(addr) & 0xFF;
             cpu.RY = static_cast<int32_t>(byte);
         } else if (targetMemory == "DATA") {
-            int8_t byte = cpu.memory.dataMemory[addr] & 0xFF;
+            int8_t byte = cpu.memory.dataMemory.read(addr) & 0xFF;
             cpu.RY = static_cast<int32_t>(byte);
         } else {
             comment = "[Memory] Error: Address " + std::to_string(addr) + " not in stack/data segment.";
             return;
         }
-        // int8_t byte = cpu.memory.dataMemory[addr] & 0xFF;
+        // int8_t byte = cpu.memory.dataMemory.read(addr) & 0xFF;
         // cpu.RY = static_cast<int32_t>(byte);
     }
     else if (funct3 == 0b001) {  // lh (load halfword)
         
         if (targetMemory == "STACK") {
-            int16_t halfword = (cpu.memory.stackMemory[addr] & 0xFF) | 
-                               ((cpu.memory.stackMemory[addr + 1] & 0xFF) << 8);
+            int16_t halfword = (cpu.memory.stackMemory.read(addr) & 0xFF) | 
+                               ((cpu.memory.stackMemory.read(addr + 1) & 0xFF) << 8);
             cpu.RY = static_cast<int32_t>(halfword);
         } else if (targetMemory == "DATA") {
-            int16_t halfword = (cpu.memory.dataMemory[addr] & 0xFF) | 
-                               ((cpu.memory.dataMemory[addr + 1] & 0xFF) << 8);
+            int16_t halfword = (cpu.memory.dataMemory.read(addr) & 0xFF) | 
+                               ((cpu.memory.dataMemory.read(addr + 1) & 0xFF) << 8);
             cpu.RY = static_cast<int32_t>(halfword);
         } else {
             comment = "[Memory] Error: Address " + std::to_string(addr) + " not in stack/data segment.";
@@ -159,17 +181,17 @@ void IInstruction::memory_update(Cpu& cpu) const {
     else if (funct3 == 0b010) {  // lw (load word)
         
         if (targetMemory == "STACK") {
-            int32_t word = (cpu.memory.stackMemory[addr] & 0xFF) | 
-                           ((cpu.memory.stackMemory[addr + 1] & 0xFF) << 8) |
-                           ((cpu.memory.stackMemory[addr + 2] & 0xFF) << 16) |
-                           ((cpu.memory.stackMemory[addr + 3] & 0xFF) << 24);
+            int32_t word = (cpu.memory.stackMemory.read(addr) & 0xFF) | 
+                           ((cpu.memory.stackMemory.read(addr + 1) & 0xFF) << 8) |
+                           ((cpu.memory.stackMemory.read(addr + 2) & 0xFF) << 16) |
+                           ((cpu.memory.stackMemory.read(addr + 3) & 0xFF) << 24);
             cpu.RY = word;
         } else if (targetMemory == "DATA") {
-            // int32_t word = cpu.memory.dataMemory[addr] & 0xFFFFFFFF; // Assuming dataMemory is uint8_t
-            int32_t word = (cpu.memory.dataMemory[addr] & 0xFF) | 
-                           ((cpu.memory.dataMemory[addr + 1] & 0xFF) << 8) |
-                           ((cpu.memory.dataMemory[addr + 2] & 0xFF) << 16) |
-                           ((cpu.memory.dataMemory[addr + 3] & 0xFF) << 24);
+            // int32_t word = cpu.memory.dataMemory.read(addr) & 0xFFFFFFFF; // Assuming dataMemory is uint8_t
+            int32_t word = (cpu.memory.dataMemory.read(addr) & 0xFF) | 
+                           ((cpu.memory.dataMemory.read(addr + 1) & 0xFF) << 8) |
+                           ((cpu.memory.dataMemory.read(addr + 2) & 0xFF) << 16) |
+                           ((cpu.memory.dataMemory.read(addr + 3) & 0xFF) << 24);
             cpu.RY = word;
         } else {
             comment = "[Memory] Error: Address " + std::to_string(addr) + " not in stack/data segment.";
@@ -180,17 +202,17 @@ void IInstruction::memory_update(Cpu& cpu) const {
         
         if (targetMemory == "STACK") {
             // Assuming stackMemory is uint8_t
-            int32_t doubleword = (static_cast<int64_t>(cpu.memory.stackMemory[addr]) & 0xFF) | 
-                                 ((static_cast<int64_t>(cpu.memory.stackMemory[addr + 1]) & 0xFF) << 8) |
-                                 ((static_cast<int64_t>(cpu.memory.stackMemory[addr + 2]) & 0xFF) << 16) |
-                                 ((static_cast<int64_t>(cpu.memory.stackMemory[addr + 3]) & 0xFF) << 24);
+            int32_t doubleword = (static_cast<int64_t>(cpu.memory.stackMemory.read(addr)) & 0xFF) | 
+                                 ((static_cast<int64_t>(cpu.memory.stackMemory.read(addr + 1)) & 0xFF) << 8) |
+                                 ((static_cast<int64_t>(cpu.memory.stackMemory.read(addr + 2)) & 0xFF) << 16) |
+                                 ((static_cast<int64_t>(cpu.memory.stackMemory.read(addr + 3)) & 0xFF) << 24);
             cpu.RY = doubleword;
         } else if (targetMemory == "DATA") {
             // Assuming dataMemory is uint8_t
-            int32_t doubleword = (static_cast<int64_t>(cpu.memory.dataMemory[addr]) & 0xFF) | 
-                                 ((static_cast<int64_t>(cpu.memory.dataMemory[addr + 1]) & 0xFF) << 8) |
-                                 ((static_cast<int64_t>(cpu.memory.dataMemory[addr + 2]) & 0xFF) << 16) |
-                                 ((static_cast<int64_t>(cpu.memory.dataMemory[addr + 3]) & 0xFF) << 24);
+            int32_t doubleword = (static_cast<int64_t>(cpu.memory.dataMemory.read(addr)) & 0xFF) | 
+                                 ((static_cast<int64_t>(cpu.memory.dataMemory.read(addr + 1)) & 0xFF) << 8) |
+                                 ((static_cast<int64_t>(cpu.memory.dataMemory.read(addr + 2)) & 0xFF) << 16) |
+                                 ((static_cast<int64_t>(cpu.memory.dataMemory.read(addr + 3)) & 0xFF) << 24);
             cpu.RY = doubleword;
         } else {
             comment = "[Memory] Error: Address " + std::to_string(addr) + " not in stack/data segment.";
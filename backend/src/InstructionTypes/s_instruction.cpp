@@ -73,7 +73,7 @@ void SInstruction::memory_update(Cpu& cpu) const {
     // Range checking instead of map existence
     if (addr >= cpu.memory.STACK_START && addr < cpu.memory.STACK_END) {
         targetMemory = "STACK";
-    } else if (addr >= cpu.memory.DATA_START && addr < cpu.memory.DATA_END) {
+    } else if (cpu.memory.isDataAddress(addr)) {
         targetMemory = "DATA";
     } else {
         comment = "[Memory] Error: Address " + std::to_string(addr) + " not in stack/data segment.";
@@ -88,9 +88,9 @@ void SInstruction::memory_update(Cpu& cpu) const {
     // Perform the store based on funct3
     if (funct3 == 0b000) {  // sb (store byte)
         if (targetMemory == "STACK") {
-            cpu.memory.stackMemory[addr] = value & 0xFF;
+            cpu.memory.stackMemory.write(addr, value & 0xFF);
         } else if (targetMemory == "DATA") {
-        cpu.memory.dataMemory[addr] = value & 0xFF;
+        cpu.memory.dataMemory.write(addr, value & 0xFF);
         } else {
             comment = "[Memory] Error: Address " + std::to_string(addr) + " not in stack/data segment.";
             return;
@@ -99,11 +99,11 @@ void SInstruction::memory_update(Cpu& cpu) const {
     }
     else if (funct3 == 0b001) {  // sh (store halfword)
         if (targetMemory == "STACK") {
-            cpu.memory.stackMemory[addr] = value & 0xFF;
-            cpu.memory.stackMemory[addr + 1] = (value >> 8) & 0xFF;
+            cpu.memory.stackMemory.write(addr, value & 0xFF);
+            cpu.memory.stackMemory.write(addr + 1, (value >> 8) & 0xFF);
         } else if (targetMemory == "DATA") {
-            cpu.memory.dataMemory[addr] = value & 0xFF;
-            cpu.memory.dataMemory[addr + 1] = (value >> 8) & 0xFF;
+            cpu.memory.dataMemory.write(addr, value & 0xFF);
+            cpu.memory.dataMemory.write(addr + 1, (value >> 8) & 0xFF);
         } else {
             comment = "[Memory] Error: Address " + std::to_string(addr) + " not in stack/data segment.";
             return;
@@ -113,15 +113,15 @@ void SInstruction::memory_update(Cpu& cpu) const {
     else if (funct3 == 0b010) {  // sw (store word)
         
         if (targetMemory == "STACK") {
-            cpu.memory.stackMemory[addr] = value & 0xFF;
-            cpu.memory.stackMemory[addr + 1] = (value >> 8) & 0xFF;
-            cpu.memory.stackMemory[addr + 2] = (value >> 16) & 0xFF;
-            cpu.memory.stackMemory[addr + 3] = (value >> 24) & 0xFF;
+            cpu.memory.stackMemory.write(addr, value & 0xFF);
+            cpu.memory.stackMemory.write(addr + 1, (value >> 8) & 0xFF);
+            cpu.memory.stackMemory.write(addr + 2, (value >> 16) & 0xFF);
+            cpu.memory.stackMemory.write(addr + 3, (value >> 24) & 0xFF);
         } else if (targetMemory == "DATA") {
-            cpu.memory.dataMemory[addr] = value & 0xFF;
-            cpu.memory.dataMemory[addr + 1] = (value >> 8) & 0xFF;
-            cpu.memory.dataMemory[addr + 2] = (value >> 16) & 0xFF;
-            cpu.memory.dataMemory[addr + 3] = (value >> 24) & 0xFF;
+            cpu.memory.dataMemory.write(addr, value & 0xFF);
+            cpu.memory.dataMemory.write(addr + 1, (value >> 8) & 0xFF);
+            cpu.memory.dataMemory.write(addr + 2, (value >> 16) & 0xFF);
+            cpu.memory.dataMemory.write(addr + 3, (value >> 24) & 0xFF);
         } else {
             comment = "[Memory] Error: Address " + std::to_string(addr) + " not in stack/data segment.";
             return;
@@ -130,25 +130,25 @@ void SInstruction::memory_update(Cpu& cpu) const {
     }
     else if (funct3 == 0b011) {  // sd (store doubleword)
         if (targetMemory == "STACK") {
-            cpu.memory.stackMemory[addr] = value & 0xFF;
-            cpu.memory.stackMemory[addr + 1] = (value >> 8) & 0xFF;
-            cpu.memory.stackMemory[addr + 2] = (value >> 16) & 0xFF;
-            cpu.memory.stackMemory[addr + 3] = (value >> 24) & 0xFF;
+            cpu.memory.stackMemory.write(addr, value & 0xFF);
+            cpu.memory.stackMemory.write(addr + 1, (value >> 8) & 0xFF);
+            cpu.memory.stackMemory.write(addr + 2, (value >> 16) & 0xFF);
+            cpu.memory.stackMemory.write(addr + 3, (value >> 24) & 0xFF);
             // Zero out the upper 32 bits
-            cpu.memory.stackMemory[addr + 4] = 0;
-            cpu.memory.stackMemory[addr + 5] = 0;
-            cpu.memory.stackMemory[addr + 6] = 0;
-            cpu.memory.stackMemory[addr + 7] = 0;
+            cpu.memory.stackMemory.write(addr + 4, 0);
+            cpu.memory.stackMemory.write(addr + 5, 0);
+            cpu.memory.stackMemory.write(addr + 6, 0);
+            cpu.memory.stackMemory.write(addr + 7, 0);
         } else if (targetMemory == "DATA") {
-            cpu.memory.dataMemory[addr] = value & 0xFF;
-            cpu.memory.dataMemory[addr + 1] = (value >> 8) & 0xFF;
-            cpu.memory.dataMemory[addr + 2] = (value >> 16) & 0xFF;
-            cpu.memory.dataMemory[addr + 3] = (value >> 24) & 0xFF;
+            cpu.memory.dataMemory.write(addr, value & 0xFF);
+            cpu.memory.dataMemory.write(addr + 1, (value >> 8) & 0xFF);
+            cpu.memory.dataMemory.write(addr + 2, (value >> 16) & 0xFF);
+            cpu.memory.dataMemory.write(addr + 3, (value >> 24) & 0xFF);
             // Zero out the upper 32 bits
-            cpu.memory.dataMemory[addr + 4] = 0;
-            cpu.memory.dataMemory[addr + 5] = 0;
-            cpu.memory.dataMemory[addr + 6] = 0;
-            cpu.memory.dataMemory[addr + 7] = 0;
+            cpu.memory.dataMemory.write(addr + 4, 0);
+            cpu.memory.dataMemory.write(addr + 5, 0);
+            cpu.memory.dataMemory.write(addr + 6, 0);
+            cpu.memory.dataMemory.write(addr + 7, 0);
         } else {
             comment = "[Memory] Error: Address " + std::to_string(addr) + " not in stack/data segment.";
             return;
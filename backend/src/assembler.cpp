@@ -3,55 +3,377 @@
 #include <map>
 #include <sstream>
 #include <iomanip>
+#include <limits>
+#include <unordered_map>
+
+std::vector<std::string> Assembler::splitLines(const std::string& input) {
+    std::vector<std::string> result;
+    std::istringstream stream(input);
+    std::string line;
+    while (std::getline(stream, line)) {
+        result.push_back(line);
+    }
+    return result;
+}
+
+// First pass over a single line: collects its labels and the number of bytes it emits
+AssembledLine Assembler::scanLine(const std::string& text, uint32_t& address, SymbolTable& table) {
+    AssembledLine line;
+    line.text = text;
+
+    uint32_t start = address;
+    parser.parse(text, address, table, true, memory, &line.info);
+    line.inData = parser.inDataSegment();
+    if (line.info.setsSegment) {
+        line.address = address;
+        line.size = 0;
+    } else {
+        line.address = start;
+        line.size = address - start;
+    }
+    return line;
+}
+
+// Second pass over a single line: encodes it at its current address and caches the result
+void Assembler::encodeLine(AssembledLine& line) {
+    parser.setDataSegment(line.inData);
+    uint32_t addr = line.address;
+    parser.parse(line.text, addr, symbols, false, memory, &line.info);
+
+    if (line.size == 0) return;
+    if (line.info.isInstruction) {
+        line.word = memory.fetchInstruction(line.address);
+    } else if (memory.getDataMemory().anyWritten(line.address, line.size)) {
+        line.bytes.resize(line.size);
+        memory.fetchDataBlock(line.address, line.bytes.data(), line.size);
+    } else {
+        // .space and friends only reserve zeroed memory, nothing to store
+        line.bytes.clear();
+    }
+}
+
+void Assembler::storeLine(const AssembledLine& line) {
+    if (line.size == 0) return;
+    if (line.info.isInstruction) {
+        memory.storeInstruction(line.address, line.word);
+    } else if (!line.bytes.empty()) {
+        memory.storeDataBytes(line.address, line.bytes);
+    }
+}
+
+void Assembler::eraseLine(const AssembledLine& line, uint32_t address) {
+    // Alignment padding is never written, and its size may already be the one at the new address
+    if (line.size == 0 || line.info.alignment) return;
+    if (line.info.isInstruction) {
+        memory.eraseInstruction(address);
+    } else {
+        memory.eraseData(address, line.size);
+    }
+}
+
+void Assembler::updateExitAddress() {
+    memory.exitAddress = std::numeric_limits<uint32_t>::max();
+    for (const AssembledLine& line : lines) {
+        if (line.info.isExit) {
+            memory.exitAddress = line.address;
+        }
+    }
+}
+
+void Assembler::restore(const ProgramImage& image) {
+    memory.mappedData.clear();
+    lines = image.lines;
+    symbols = image.symbols;
+    memory.instructionMemory = image.instructionMemory;
+    memory.dataMemory = image.dataMemory;
+    memory.exitAddress = image.exitAddress;
+}
+
+std::shared_ptr<ProgramImage> Assembler::snapshot(const std::string& normalized) const {
+    auto image = std::make_shared<ProgramImage>();
+    image->source = normalized;
+    image->lines = lines;
+    image->symbols = symbols;
+    image->instructionMemory = memory.instructionMemory;
+    image->dataMemory = memory.dataMemory;
+    image->exitAddress = memory.exitAddress;
+    return image;
+}
 
 void Assembler::assemble(const std::string& input) {
 
+    std::string normalized = AssemblyCache::normalize(input);
+    uint64_t key = AssemblyCache::hash(normalized);
+    // Included files can change behind the source's back
+    bool cacheable = normalized.find(".incbin") == std::string::npos;
+    if (auto image = cacheable ? cache->find(key, normalized) : nullptr) {
+        restore(*image);
+        loadedFromFile = false;
+        entryPoint = RISCV_CONSTANTS::TEXT_SEGMENT_START;
+        globalPointer = RISCV_CONSTANTS::DATA_SEGMENT_START;
+        lastWasCacheHit = true;
+        dataImage = memory.dataMemory;
+        return;
+    }
+    lastWasCacheHit = false;
+
+    assembleLines(splitLines(normalized));
+    dataImage = memory.dataMemory;
+    if (cacheable) {
+        cache->insert(key, snapshot(normalized));
+    }
+}
+
+void Assembler::assembleLines(const std::vector<std::string>& source) {
+    loadedFromFile = false;
+    entryPoint = RISCV_CONSTANTS::TEXT_SEGMENT_START;
+    globalPointer = RISCV_CONSTANTS::DATA_SEGMENT_START;
+    lines.clear();
+    symbols.clear();
+    memory.mappedData.clear();
     uint32_t addr = RISCV_CONSTANTS::TEXT_SEGMENT_START;
-    bool inDataSegment = false;
-    
-    std::istringstream stream(input);
-    std::string line;
 
-    // First pass: Parse labels
-    while (std::getline(stream, line)) {
-        parser.parse(line, addr, symbols, true, memory);
+    // First pass: Parse labels and lay out every line
+    parser.setDataSegment(false);
+    for (const std::string& text : source) {
+        lines.push_back(scanLine(text, addr, symbols));
     }
-    // Reset stream for second pass
-    stream.clear();
-    stream.seekg(0, std::ios::beg);
-    addr = RISCV_CONSTANTS::TEXT_SEGMENT_START;
 
     // Second pass: Generate machine code
-    while (std::getline(stream, line)) {
-        if (line.find(".data") != std::string::npos) {
-            inDataSegment = true;
-            addr = RISCV_CONSTANTS::DATA_SEGMENT_START;
-        } else if (line.find(".text") != std::string::npos) {
-            inDataSegment = false;
-            addr = RISCV_CONSTANTS::TEXT_SEGMENT_START;
+    for (AssembledLine& line : lines) {
+        encodeLine(line);
+    }
+    updateExitAddress();
+}
+
+size_t Assembler::edit(size_t firstLine, size_t lastLine, const std::string& replacement) {
+    if (lines.empty()) {
+        throw std::runtime_error("Nothing to edit, assemble a program first");
+    }
+    if (loadedFromFile) {
+        throw std::runtime_error("The program was loaded from a binary image, assemble its source to edit it");
+    }
+    lastWasCacheHit = false;
+    lastLine = std::min(lastLine, lines.size());
+    firstLine = std::min(firstLine, lastLine);
+
+    // Both passes below write memory as they go, a line that fails to assemble puts everything back
+    std::shared_ptr<ProgramImage> before = snapshot("");
+    try {
+        size_t reencoded = editLines(firstLine, lastLine, splitLines(replacement));
+        dataImage = memory.dataMemory;
+        return reencoded;
+    } catch (const std::exception&) {
+        restore(*before);
+        throw;
+    }
+}
+
+size_t Assembler::editLines(size_t firstLine, size_t lastLine, const std::vector<std::string>& replaced) {
+    // Local labels are numbered by position, edits that define or use them are assembled in full
+    bool local = false;
+    for (size_t i = firstLine; i < lastLine; i++) {
+        local |= lines[i].info.usesLocalLabels;
+    }
+    if (!local) {
+        SymbolTable scratch;
+        uint32_t scanAddr = RISCV_CONSTANTS::TEXT_SEGMENT_START;
+        parser.setDataSegment(firstLine > 0 && lines[firstLine - 1].inData);
+        try {
+            for (const std::string& text : replaced) {
+                local |= scanLine(text, scanAddr, scratch).info.usesLocalLabels;
+            }
+        } catch (const std::exception&) {
+            local = true;  // let the full assembly report it
+        }
+    }
+    if (local) {
+        std::vector<std::string> source;
+        for (size_t i = 0; i < lines.size(); i++) {
+            if (i == firstLine) source.insert(source.end(), replaced.begin(), replaced.end());
+            if (i < firstLine || i >= lastLine) source.push_back(lines[i].text);
+            eraseLine(lines[i], lines[i].address);
         }
-        parser.parse(line, addr, symbols, false, memory);
+        if (firstLine == lines.size()) source.insert(source.end(), replaced.begin(), replaced.end());
+        assembleLines(source);
+        return lines.size();
     }
 
-    // Print JSON output
-    std::cout << "{ \"machine_code\": [";
-    bool first = true;
-    for (const auto& [pc, instr] : memory.instructionMemory) {
-        if (!first) std::cout << ",";
-        std::cout << "{ \"pc\": \"0x" << std::hex << std::setw(8) << std::setfill('0') << pc << "\", "
-                  << "\"machineCode\": \"0x" << std::setw(8) << std::setfill('0') << instr << "\" }";
-        first = false;
+    for (size_t i = firstLine; i < lastLine; i++) {
+        eraseLine(lines[i], lines[i].address);
     }
-    std::cout << "], \"data_segment\": {";
 
-    // Use memory instead of `dataSegment`
-    first = true;
-    for (const auto& [addr, val] : memory.getDataMemory()) {
-        if (!first) std::cout << ",";
-        std::cout << "\"0x" << std::hex << std::setw(8) << std::setfill('0') << addr << "\": " << std::dec << (int)val;
-        first = false;
+    // Addresses by symbol id before the edit, ids interned by the new lines have no old address
+    size_t oldSymbolCount = symbols.size();
+    std::vector<uint32_t> oldLabels(oldSymbolCount);
+    std::vector<bool> oldDefined(oldSymbolCount);
+    for (uint32_t id = 0; id < oldSymbolCount; id++) {
+        oldDefined[id] = symbols.isDefined(id);
+        oldLabels[id] = oldDefined[id] ? symbols.getAddress(id) : 0;
+    }
+
+    // First pass over the new lines only, their labels are placed by the relayout below
+    uint32_t scanAddr = RISCV_CONSTANTS::TEXT_SEGMENT_START;
+    parser.setDataSegment(firstLine > 0 && lines[firstLine - 1].inData);
+    std::vector<AssembledLine> added;
+    for (const std::string& text : replaced) {
+        added.push_back(scanLine(text, scanAddr, symbols));
+    }
+    size_t addedEnd = firstLine + added.size();
+
+    lines.erase(lines.begin() + firstLine, lines.begin() + lastLine);
+    lines.insert(lines.begin() + firstLine,
+                 std::make_move_iterator(added.begin()), std::make_move_iterator(added.end()));
+
+    // Re-layout from the cached line sizes, nothing is reparsed here.
+    // Only alignment padding is sized again, it depends on where the line lands
+    std::vector<uint32_t> oldAddress(lines.size());
+    std::vector<bool> oldInData(lines.size());
+    symbols.undefineAll();
+
+    uint32_t address = RISCV_CONSTANTS::TEXT_SEGMENT_START;
+    bool inData = false;
+    for (size_t i = 0; i < lines.size(); i++) {
+        AssembledLine& line = lines[i];
+        oldAddress[i] = line.address;
+        oldInData[i] = line.inData;
+
+        for (uint32_t label : line.info.labels) {
+            symbols.define(label, address);
+        }
+        if (line.info.setsSegment) {
+            inData = line.inData;
+            address = inData ? RISCV_CONSTANTS::DATA_SEGMENT_START : RISCV_CONSTANTS::TEXT_SEGMENT_START;
+        }
+        line.address = address;
+        line.inData = inData;
+        if (line.info.alignment) {
+            uint64_t boundary = line.info.alignment;
+            line.size = static_cast<uint32_t>(((address + boundary - 1) & ~(boundary - 1)) - address);
+        }
+        address += line.size;
+    }
+
+    // Lines that only moved are copied to their new address, lines whose
+    // PC-relative targets changed (or that are new) are encoded again
+    std::vector<size_t> moved, reencode;
+    for (size_t i = 0; i < lines.size(); i++) {
+        AssembledLine& line = lines[i];
+        if (i >= firstLine && i < addedEnd) {
+            reencode.push_back(i);
+            continue;
+        }
+
+        int64_t shift = static_cast<int64_t>(line.address) - oldAddress[i];
+        bool retarget = oldInData[i] != line.inData;
+        for (const LineInfo::LabelUse& use : line.info.labelUses) {
+            uint32_t label = use.symbol;
+            if (label >= oldSymbolCount || !oldDefined[label] || !symbols.isDefined(label) ||
+                static_cast<int64_t>(symbols.getAddress(label)) - oldLabels[label] != shift) {
+                retarget = true;
+            }
+        }
+
+        if (retarget) {
+            eraseLine(line, oldAddress[i]);
+            reencode.push_back(i);
+        } else if (shift != 0) {
+            eraseLine(line, oldAddress[i]);
+            moved.push_back(i);
+        }
+    }
+
+    for (size_t i : moved) {
+        storeLine(lines[i]);
     }
+    for (size_t i : reencode) {
+        encodeLine(lines[i]);
+    }
+    updateExitAddress();
+
+    return reencode.size();
+}
+
+void Assembler::reload() {
+    for (const AssembledLine& line : lines) {
+        storeLine(line);
+    }
+    updateExitAddress();
+}
+
+void Assembler::storeData(Memory& target) const {
+    target.dataMemory = dataImage;
+    target.exitAddress = memory.exitAddress;
+    target.mappedData = memory.mappedData;
+}
+
+size_t Assembler::save(const std::string& path) {
+    if (lines.empty()) {
+        throw std::runtime_error("Nothing to save, assemble a program first");
+    }
+    return writeProgramFile(path, formatFromPath(path), *snapshot(""), entryPoint);
+}
+
+void Assembler::load(const std::string& path) {
+    ProgramImage image;
+    LoadedProgram loaded = readProgramFile(path, image);
+    entryPoint = loaded.entry;
+    globalPointer = loaded.globalPointer;
+    lines = std::move(image.lines);
+    symbols = std::move(image.symbols);
+    memory.instructionMemory = std::move(image.instructionMemory);
+    memory.dataMemory = std::move(image.dataMemory);
+    memory.exitAddress = image.exitAddress;
+    memory.mappedData = std::move(loaded.mappedData);
+    dataImage = memory.dataMemory;
+    unsupported = std::move(loaded.unsupported);
+    loadedFromFile = true;
+    lastWasCacheHit = false;
+}
+
+void Assembler::clear() {
+    lines.clear();
+    symbols.clear();
+    memory.mappedData.clear();
+    dataImage.clear();
+    loadedFromFile = false;
+    lastWasCacheHit = false;
+    entryPoint = RISCV_CONSTANTS::TEXT_SEGMENT_START;
+    globalPointer = RISCV_CONSTANTS::DATA_SEGMENT_START;
+}
 
-    std::cout << "} }" << std::endl;
+bool Assembler::findSourceLine(uint32_t address, size_t& line) const {
+    for (size_t i = 0; i < lines.size(); i++) {
+        const AssembledLine& candidate = lines[i];
+        // Pseudo instructions emit several words from one line
+        if (candidate.info.isInstruction && address >= candidate.address && address - candidate.address < candidate.size) {
+            line = i;
+            return true;
+        }
+    }
+    return false;
 }
 
+void Assembler::dumpMachineCode(JsonWriter& out) const {
+    out.raw("{ \"machine_code\": [");
+    bool first = true;
+    for (const auto& [pc, instr] : memory.instructionMemory) {
+        if (!first) out.raw(',');
+        out.raw("{ \"pc\": ").hexString(pc).raw(", \"machineCode\": ").hexString(instr).raw(" }");
+        first = false;
+    }
+    out.raw(']');
+    if (loadedFromFile) {
+        out.raw(", \"unsupported\": [");
+        for (size_t i = 0; i < unsupported.size(); i++) {
+            if (i > 0) out.raw(',');
+            out.hexString(unsupported[i]);
+        }
+        out.raw(']');
+    }
+    out.raw(", \"data_segment\": {");
+    memory.dumpMemory(out);
+    out.raw("}, \"cache\": { \"hit\": ").boolean(lastWasCacheHit)
+       .raw(", \"hits\": ").number(cache->hits.load()).raw(", \"misses\": ").number(cache->misses.load())
+       .raw(", \"disk_hits\": ").number(cache->diskHits.load()).raw(" } }");
+}
@@ -0,0 +1,133 @@
+#include "assembly_cache.h"
+#include <cstdio>
+#include <fstream>
+#include <atomic>
+#include <iomanip>
+#include <sstream>
+#include <sys/stat.h>
+#include <unistd.h>
+
+std::string AssemblyCache::normalize(const std::string& source) {
+    std::string result;
+    result.reserve(source.size());
+
+    size_t pos = 0;
+    while (pos <= source.size()) {
+        size_t end = source.find('\n', pos);
+        if (end == std::string::npos) end = source.size();
+
+        // Comments end the line for the parser too, so dropping them keeps the meaning
+        size_t stop = source.find('#', pos);
+        if (stop == std::string::npos || stop > end) stop = end;
+
+        size_t first = source.find_first_not_of(" \t\r", pos);
+        if (first != std::string::npos && first < stop) {
+            size_t last = source.find_last_not_of(" \t\r", stop - 1);
+            result.append(source, first, last - first + 1);
+        }
+        if (end == source.size()) break;
+        result += '\n';
+        pos = end + 1;
+    }
+    return result;
+}
+
+uint64_t AssemblyCache::hash(const std::string& normalized) {
+    // 64-bit FNV-1a, collisions are caught by comparing the stored source on lookup
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned char c : normalized) {
+        h ^= c;
+        h *= 0x100000001b3ULL;
+    }
+    return h;
+}
+
+void AssemblyCache::setCapacity(size_t count) {
+    std::lock_guard<std::mutex> lock(mutex);
+    capacity = count;
+    trim();
+}
+
+void AssemblyCache::trim() {
+    while (entries.size() > capacity) {
+        index.erase(entries.back().first);
+        entries.pop_back();
+    }
+}
+
+void AssemblyCache::setDirectory(const std::string& path) {
+    std::lock_guard<std::mutex> lock(mutex);
+    directory = path;
+    if (!directory.empty()) {
+        mkdir(directory.c_str(), 0755);
+    }
+}
+
+std::string AssemblyCache::imagePath(uint64_t key) const {
+    std::stringstream ss;
+    ss << directory << "/" << std::hex << std::setw(16) << std::setfill('0') << key << ".rvc";
+    return ss.str();
+}
+
+void AssemblyCache::insertEntry(uint64_t key, std::shared_ptr<const ProgramImage> image) {
+    if (capacity == 0) return;
+    auto it = index.find(key);
+    if (it != index.end()) {
+        entries.erase(it->second);
+    }
+    entries.emplace_front(key, std::move(image));
+    index[key] = entries.begin();
+    trim();
+}
+
+std::shared_ptr<const ProgramImage> AssemblyCache::find(uint64_t key, const std::string& normalized) {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = index.find(key);
+        if (it != index.end() && it->second->second->source == normalized) {
+            entries.splice(entries.begin(), entries, it->second);
+            hits++;
+            return entries.front().second;
+        }
+        if (!directory.empty()) path = imagePath(key);
+    }
+
+    if (!path.empty()) {
+        std::ifstream file(path, std::ios::binary);
+        auto image = std::make_shared<ProgramImage>();
+        if (file && readProgramImage(file, *image) && image->source == normalized) {
+            std::lock_guard<std::mutex> lock(mutex);
+            insertEntry(key, image);
+            hits++;
+            diskHits++;
+            return image;
+        }
+    }
+
+    misses++;
+    return nullptr;
+}
+
+void AssemblyCache::insert(uint64_t key, std::shared_ptr<const ProgramImage> image) {
+    std::string path;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        if (!directory.empty()) path = imagePath(key);
+    }
+    if (!path.empty()) {
+        // Write to a temporary name first so concurrent readers never see half an image
+        static std::atomic<uint64_t> tmpCounter{0};
+        std::string tmp = path + "." + std::to_string(getpid()) + "." + std::to_string(tmpCounter++) + ".tmp";
+        std::ofstream file(tmp, std::ios::binary | std::ios::trunc);
+        writeProgramImage(file, *image);
+        file.close();
+        if (file) {
+            std::rename(tmp.c_str(), path.c_str());
+        } else {
+            std::remove(tmp.c_str());
+        }
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    insertEntry(key, std::move(image));
+}
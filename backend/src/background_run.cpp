@@ -0,0 +1,75 @@
+#include "background_run.h"
+
+BackgroundRun::BackgroundRun(Session& session, std::ostream& out, std::ostream& err, std::mutex& outputMutex,
+                             std::chrono::milliseconds progressInterval)
+    : session(session), out(out), err(err), outputMutex(outputMutex), progressInterval(progressInterval) {
+    control.onSlice = [this] { reportProgress(); };
+}
+
+BackgroundRun::~BackgroundRun() {
+    stop(RunControl::CANCEL);
+    wait();
+}
+
+void BackgroundRun::start(const RunBudget& budget) {
+    wait();
+
+    control.begin(session.cpu);
+    lastProgress = control.started;
+    active = true;
+
+    worker = std::thread([this, budget] {
+        JsonWriter json;
+        try {
+            session.runAndOutput(budget, &control, json);
+            // Idle before the response is out, so a `status` sent right after it reports so
+            std::lock_guard<std::mutex> lock(outputMutex);
+            active = false;
+            json.flush(out);
+        } catch (const std::exception& e) {
+            std::lock_guard<std::mutex> lock(outputMutex);
+            active = false;
+            err << "Error: " << e.what() << std::endl;
+        }
+    });
+}
+
+void BackgroundRun::wait() {
+    if (worker.joinable()) {
+        worker.join();
+    }
+}
+
+bool BackgroundRun::stop(RunControl::Request request) {
+    if (!active) {
+        return false;
+    }
+    control.request = request;
+    return true;
+}
+
+void BackgroundRun::reportProgress() {
+    if (progressInterval.count() == 0) {
+        return;
+    }
+    auto now = std::chrono::steady_clock::now();
+    if (now - lastProgress < progressInterval) {
+        return;
+    }
+    lastProgress = now;
+
+    JsonWriter json;
+    json.raw("{ \"progress\": { \"cycles\": ").number(control.cycles.load())
+        .raw(", \"instructions\": ").number(control.instructions.load())
+        .raw(", \"pc\": ").hexString(control.pc.load()).raw(" } }");
+    std::lock_guard<std::mutex> lock(outputMutex);
+    json.flush(out);
+}
+
+void BackgroundRun::writeStatus(JsonWriter& json) const {
+    if (!active) {
+        json.raw("{ \"running\": false }");
+        return;
+    }
+    control.writeStatus(json);
+}
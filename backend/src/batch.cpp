@@ -0,0 +1,195 @@
+#include "batch.h"
+#include "work_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+namespace Batch {
+
+void Options::parseConfig(const std::string& config) {
+    std::istringstream in(config);
+    std::string mode;
+    while (std::getline(in, mode, ',')) {
+        if (mode == "pipeline") {
+            pipeline = true;
+        } else if (mode == "forward" || mode == "data_forward") {
+            dataForward = true;
+        } else if (mode == "prediction" || mode == "branch_prediction") {
+            branchPrediction = true;
+        } else if (!mode.empty()) {
+            throw std::runtime_error("Unknown batch config: " + mode);
+        }
+    }
+}
+
+namespace {
+
+class Runner {
+    const std::vector<std::filesystem::path>& files;
+    const std::filesystem::path& root;
+    const Options& options;
+    const SessionOptions& sessionOptions;
+    std::ostream& out;
+
+    WorkPool pool;
+
+    std::mutex outputMutex;  // guards everything below
+    std::vector<std::string> records;
+    std::vector<bool> finished;
+    size_t printed = 0;
+    size_t exited = 0;
+    size_t stopped = 0;
+    size_t errors = 0;
+
+    // FNV-1a over the address and value of every written data byte
+    static uint64_t hashData(const PagedMemory& data, size_t& bytes) {
+        uint64_t hash = 0xcbf29ce484222325ull;
+        auto mix = [&](uint8_t byte) {
+            hash ^= byte;
+            hash *= 0x100000001b3ull;
+        };
+        bytes = 0;
+        data.forEachWritten([&](uint32_t address, uint8_t value) {
+            for (int shift = 0; shift < 32; shift += 8) mix(static_cast<uint8_t>(address >> shift));
+            mix(value);
+            bytes++;
+        });
+        return hash;
+    }
+
+    // Plain assembly, or the {"input_code": "..."} payload of `assemble` that many test inputs are saved as
+    static std::string readSource(std::istream& in) {
+        std::stringstream source;
+        source << in.rdbuf();
+        const std::string& text = source.str();
+        size_t first = text.find_first_not_of(" \t\r\n");
+        if (first == std::string::npos || text[first] != '{') {
+            return text;
+        }
+        JsonRequest request;
+        source.seekg(0);
+        request.read(source);
+        return request.getString("input_code");
+    }
+
+    enum Status { EXITED, STOPPED, FAILED };
+
+    Status simulate(const std::filesystem::path& file, JsonWriter& json) {
+        json.raw("{ \"file\": ").string(file.lexically_relative(root).generic_string());
+
+        Session session(sessionOptions);
+        const char* stoppedBy = nullptr;
+        try {
+            std::ifstream in(file, std::ios::binary);
+            if (!in) {
+                throw std::runtime_error("Cannot read " + file.string());
+            }
+            std::string source = readSource(in);
+
+            session.cpu.reset();
+            session.assembler.assemble(source);
+            session.cpu.pipeline = options.pipeline;
+            session.cpu.data_forward = options.dataForward;
+            session.cpu.predictionBool = options.branchPrediction;
+            if (options.caches) {
+                session.cpu.instructionCache = std::make_unique<Cache>(*options.caches);
+                session.cpu.dataCache = std::make_unique<Cache>(*options.caches);
+            }
+            if (options.dram) {
+                session.cpu.dram = std::make_unique<Dram>(*options.dram);
+            }
+            if (options.prefetch) {
+                session.cpu.instructionPrefetcher = std::make_unique<NextLinePrefetcher>(*options.prefetch);
+                session.cpu.dataPrefetcher = std::make_unique<StridePrefetcher>(*options.prefetch);
+            }
+            if (options.latency) {
+                session.cpu.functionalUnits = std::make_unique<FunctionalUnits>(*options.latency);
+            }
+
+            stoppedBy = Session::runWithin(session.cpu, options.budget);
+        } catch (const std::exception& e) {
+            json.raw(", \"status\": \"error\", \"error\": ").string(e.what()).raw(" }");
+            return FAILED;
+        }
+
+        if (stoppedBy) {
+            json.raw(", \"status\": \"stopped\", \"stopped\": \"").raw(stoppedBy).raw('"');
+        } else {
+            json.raw(", \"status\": \"exited\"");
+        }
+        json.raw(", \"clock_cycles\": ").number(session.cpu.clock);
+        session.writeCounters(json);
+        json.raw(", \"registers\": {");
+        session.cpu.dumpRegisters(json);
+        size_t bytes;
+        uint64_t hash = hashData(session.memory.dataMemory, bytes);
+        char hex[19];
+        snprintf(hex, sizeof(hex), "0x%016llx", static_cast<unsigned long long>(hash));
+        json.raw("}, \"data_hash\": \"").raw(hex).raw("\", \"data_bytes\": ").number(bytes).raw(" }");
+        return stoppedBy ? STOPPED : EXITED;
+    }
+
+    void simulateAndRecord(size_t program) {
+        JsonWriter json;
+        Status status = simulate(files[program], json);
+
+        std::lock_guard<std::mutex> lock(outputMutex);
+        (status == EXITED ? exited : status == STOPPED ? stopped : errors)++;
+        records[program] = json.str();
+        finished[program] = true;
+
+        // Records come out in path order, whichever worker finishes first
+        while (printed < files.size() && finished[printed]) {
+            out << records[printed] << '\n';
+            std::string().swap(records[printed]);
+            printed++;
+        }
+    }
+
+public:
+    Runner(const std::vector<std::filesystem::path>& files, const std::filesystem::path& root, const Options& options,
+           const SessionOptions& sessionOptions, std::ostream& out)
+        : files(files), root(root), options(options), sessionOptions(sessionOptions), out(out),
+          pool(options.jobs), records(files.size()), finished(files.size(), false) {
+    }
+
+    size_t run() {
+        auto started = std::chrono::steady_clock::now();
+        pool.run(files.size(), [this](size_t program) { simulateAndRecord(program); });
+
+        auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+        out << "{ \"batch\": { \"programs\": " << files.size() << ", \"exited\": " << exited
+            << ", \"stopped\": " << stopped << ", \"errors\": " << errors << ", \"jobs\": " << pool.size()
+            << ", \"ms\": " << elapsed.count() << " } }" << std::endl;
+        return errors;
+    }
+};
+
+}
+
+size_t run(const std::string& directory, const Options& options, const SessionOptions& sessionOptions,
+           std::ostream& out) {
+    std::filesystem::path root(directory);
+    if (!std::filesystem::is_directory(root)) {
+        throw std::runtime_error("Not a directory: " + directory);
+    }
+
+    std::vector<std::filesystem::path> files;
+    for (const auto& entry : std::filesystem::recursive_directory_iterator(root)) {
+        if (entry.is_regular_file() && entry.path().extension() == ".asm") {
+            files.push_back(entry.path());
+        }
+    }
+    std::sort(files.begin(), files.end());
+
+    Runner runner(files, root, options, sessionOptions, out);
+    return runner.run();
+}
+
+}
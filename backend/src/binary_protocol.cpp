@@ -0,0 +1,243 @@
+#include "binary_protocol.h"
+#include <stdexcept>
+
+namespace BinaryProtocol {
+
+namespace {
+
+constexpr uint32_t MAX_READ = 16 * 1024 * 1024;
+
+class Frame {
+public:
+    std::string bytes;
+
+    void clear() { bytes.clear(); }
+    void u8(uint8_t value) { bytes.push_back(static_cast<char>(value)); }
+    void u32(uint32_t value) {
+        bytes.append(4, '\0');
+        patchU32(bytes.size() - 4, value);
+    }
+    // Overwrites the u32 written at `offset`
+    void patchU32(size_t offset, uint32_t value) {
+        for (int i = 0; i < 4; i++) {
+            bytes[offset + i] = static_cast<char>(value >> (8 * i));
+        }
+    }
+    void u64(uint64_t value) {
+        u32(static_cast<uint32_t>(value));
+        u32(static_cast<uint32_t>(value >> 32));
+    }
+    void raw(const void* data, size_t size) { bytes.append(static_cast<const char*>(data), size); }
+};
+
+uint32_t readU32(const std::string& payload, size_t offset) {
+    if (offset + 4 > payload.size()) {
+        throw std::runtime_error("Request is too short");
+    }
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(payload.data()) + offset;
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// u32 entry | u32 count | { u32 pc, u32 word }* | u32 runs | { u32 address, u32 size, bytes }*
+void writeProgram(Frame& frame, Memory& memory, Assembler& assembler) {
+    frame.u32(assembler.getEntryPoint());
+    frame.u32(static_cast<uint32_t>(memory.instructionMemory.size()));
+    for (const auto& [pc, word] : memory.instructionMemory) {
+        frame.u32(pc);
+        frame.u32(word);
+    }
+
+    // Runs of consecutive written bytes, each size is patched when its run ends
+    size_t countAt = frame.bytes.size();
+    frame.u32(0);
+    uint32_t runs = 0, next = 0;
+    size_t sizeAt = 0;
+    auto closeRun = [&]() {
+        if (runs > 0) {
+            frame.patchU32(sizeAt, static_cast<uint32_t>(frame.bytes.size() - sizeAt - 4));
+        }
+    };
+    memory.getDataMemory().forEachWritten([&](uint32_t address, uint8_t value) {
+        if (runs == 0 || address != next) {
+            closeRun();
+            frame.u32(address);
+            sizeAt = frame.bytes.size();
+            frame.u32(0);
+            runs++;
+        }
+        frame.u8(value);
+        next = address + 1;
+    });
+    closeRun();
+    frame.patchU32(countAt, runs);
+}
+
+uint32_t stage(const Cpu& cpu, const char* name) {
+    auto it = cpu.instructionMap.find(name);
+    return it != cpu.instructionMap.end() ? it->second : 0;
+}
+
+// Fixed 224 byte block:
+// u32 pc | u32 ir | u64 clock | u32 x0..x31 | i32 RA, RB | u32 RM | i32 RY, RZ |
+// u32 stage F, D, E, M, W | u8 pipeline, data_forward, branch_prediction, exited |
+// u32 instructions, data transfers, control, bubbles, data hazard bubbles,
+//     control hazard bubbles, data hazards, control hazards, mispredictions
+void writeState(Frame& frame, const Cpu& cpu, const Memory& memory) {
+    frame.u32(cpu.PC);
+    frame.u32(cpu.IR);
+    frame.u64(cpu.clock);
+    for (uint32_t value : cpu.registers) {
+        frame.u32(value);
+    }
+    frame.u32(static_cast<uint32_t>(cpu.RA));
+    frame.u32(static_cast<uint32_t>(cpu.RB));
+    frame.u32(cpu.RM);
+    frame.u32(static_cast<uint32_t>(cpu.RY));
+    frame.u32(static_cast<uint32_t>(cpu.RZ));
+    for (const char* name : {"F", "D", "E", "M", "W"}) {
+        frame.u32(stage(cpu, name));
+    }
+    frame.u8(cpu.pipeline);
+    frame.u8(cpu.data_forward);
+    frame.u8(cpu.predictionBool);
+    frame.u8(memory.comment == "Successfully Exited");
+    for (uint32_t counter : {cpu.totalInstructions, cpu.totalDataTransferInstructions, cpu.totalControlInstructions,
+                             cpu.totalBubbles, cpu.totalDataHazardBubbles, cpu.totalControlHazardBubbles,
+                             cpu.totalDataHazards, cpu.totalControlHazards, cpu.totalBranchMissPredictions}) {
+        frame.u32(counter);
+    }
+}
+
+// Raw bytes of [address, address + length) from the stack, data or text segment
+void writeMemory(Frame& frame, const Memory& memory, uint32_t address, uint32_t length) {
+    if (length > MAX_READ) {
+        throw std::runtime_error("Memory reads are limited to 16 MiB");
+    }
+    size_t start = frame.bytes.size();
+    frame.bytes.resize(start + length);
+    uint8_t* out = reinterpret_cast<uint8_t*>(&frame.bytes[start]);
+
+    uint64_t end = static_cast<uint64_t>(address) + length;
+    if (address >= memory.DATA_START && end <= memory.DATA_END) {
+        memory.dataMemory.readBlock(address, out, length);
+        return;
+    }
+    for (uint64_t at = address; at < end; at++) {
+        uint32_t addr = static_cast<uint32_t>(at);
+        if (addr >= memory.STACK_START && addr < memory.STACK_END) {
+            *out++ = memory.stackMemory.read(addr);
+        } else if (memory.isDataAddress(addr)) {
+            *out++ = memory.dataMemory.read(addr);
+        } else {
+            *out++ = (memory.fetchInstruction(addr & ~3u) >> ((addr & 3) * 8)) & 0xFF;
+        }
+    }
+}
+
+}
+
+void serve(std::istream& in, std::ostream& out, Session& session) {
+    Cpu& cpu = session.cpu;
+    Memory& memory = session.memory;
+    Assembler& assembler = session.assembler;
+    std::string payload;
+    Frame frame;
+    char header[4];
+
+    while (in.read(header, 4)) {
+        uint32_t length = readU32(std::string(header, 4), 0);
+        bool oversized = length > MAX_FRAME;
+        if (oversized) {
+            // Skipped rather than buffered, the next frame starts right after it
+            payload.clear();
+            if (!in.ignore(length) || static_cast<uint64_t>(in.gcount()) != length) {
+                break;
+            }
+        } else {
+            payload.resize(length);
+            if (!in.read(&payload[0], length)) {
+                break;
+            }
+        }
+
+        uint8_t opcode = length > 0 && !oversized ? static_cast<uint8_t>(payload[0]) : 0;
+        frame.clear();
+        frame.u32(0);  // length, patched below
+        frame.u8(0);
+        frame.u8(opcode);
+
+        try {
+            if (oversized) {
+                throw std::runtime_error("Frame of " + std::to_string(length) + " bytes exceeds the limit of " +
+                                         std::to_string(MAX_FRAME));
+            }
+            switch (opcode) {
+            case ASSEMBLE:
+                cpu.reset();
+                assembler.assemble(payload.substr(1));
+                writeProgram(frame, memory, assembler);
+                break;
+            case EDIT:
+                // Once the program has executed, memory no longer holds the assembled image
+                if (cpu.clock != 0) {
+                    cpu.reset();
+                    assembler.reload();
+                }
+                assembler.edit(readU32(payload, 1), readU32(payload, 5), payload.substr(9));
+                writeProgram(frame, memory, assembler);
+                break;
+            case STEP:
+                cpu.step();
+                writeState(frame, cpu, memory);
+                break;
+            case RUN: {
+                // Missing limits are no limit, a missing time limit is the session's default as for `run`
+                RunBudget budget = session.runBudget("run");
+                if (payload.size() >= 5) budget.cycles = readU32(payload, 1);
+                if (payload.size() >= 9) budget.instructions = readU32(payload, 5);
+                if (payload.size() >= 13 && readU32(payload, 9)) budget.milliseconds = readU32(payload, 9);
+                Session::runWithin(cpu, budget);
+                writeState(frame, cpu, memory);
+                break;
+            }
+            case TOGGLE: {
+                uint8_t which = payload.size() > 1 ? static_cast<uint8_t>(payload[1]) : 0xFF;
+                if (which == 0) cpu.pipeline = !cpu.pipeline;
+                else if (which == 1) cpu.data_forward = !cpu.data_forward;
+                else if (which == 2) cpu.predictionBool = !cpu.predictionBool;
+                else throw std::runtime_error("Unknown toggle");
+                writeState(frame, cpu, memory);
+                break;
+            }
+            case READ_MEMORY:
+                writeMemory(frame, memory, readU32(payload, 1), readU32(payload, 5));
+                break;
+            case STATE:
+                writeState(frame, cpu, memory);
+                break;
+            case LOAD:
+                cpu.reset();
+                assembler.load(payload.substr(1));
+                cpu.PC = assembler.getEntryPoint();
+                cpu.registers[3] = assembler.getGlobalPointer();
+                writeProgram(frame, memory, assembler);
+                break;
+            default:
+                throw std::runtime_error("Unknown opcode " + std::to_string(opcode));
+            }
+        } catch (const std::exception& e) {
+            frame.bytes.resize(6);
+            frame.bytes[4] = 1;
+            frame.raw(e.what(), std::char_traits<char>::length(e.what()));
+        }
+
+        uint32_t size = static_cast<uint32_t>(frame.bytes.size() - 4);
+        char prefix[4] = {static_cast<char>(size), static_cast<char>(size >> 8),
+                          static_cast<char>(size >> 16), static_cast<char>(size >> 24)};
+        frame.bytes.replace(0, 4, prefix, 4);
+        out.write(frame.bytes.data(), frame.bytes.size());
+        out.flush();
+    }
+}
+
+}
@@ -0,0 +1,269 @@
+#include "cache.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+namespace {
+
+bool powerOfTwo(uint32_t value) {
+    return value && !(value & (value - 1));
+}
+
+uint32_t log2(uint32_t value) {
+    uint32_t bits = 0;
+    while (value >>= 1) bits++;
+    return bits;
+}
+
+}
+
+CacheConfig CacheConfig::parse(const std::string& arguments) {
+    CacheConfig config;
+    std::istringstream in(arguments);
+    std::string option;
+    while (in >> option) {
+        size_t equals = option.find('=');
+        if (equals == std::string::npos) {
+            throw std::runtime_error("Unknown cache option: " + option);
+        }
+        std::string name = option.substr(0, equals);
+        std::string value = option.substr(equals + 1);
+        uint32_t* field = name == "size" ? &config.size
+                        : name == "line" ? &config.lineSize
+                        : name == "ways" ? &config.ways
+                        : name == "hit" ? &config.hitLatency
+                        : name == "miss" ? &config.missLatency : nullptr;
+        if (field) {
+            try {
+                *field = std::stoul(value);
+            } catch (const std::exception&) {
+                throw std::runtime_error("Invalid cache option: " + option);
+            }
+        } else if (name == "replacement" && (value == "lru" || value == "plru" || value == "random")) {
+            config.replacement = value == "lru" ? Replacement::LRU : value == "plru" ? Replacement::PLRU : Replacement::RANDOM;
+        } else if (name == "write" && (value == "back" || value == "through")) {
+            config.write = value == "back" ? WritePolicy::BACK : WritePolicy::THROUGH;
+        } else if (name == "allocate" && (value == "on" || value == "off")) {
+            config.writeAllocate = value == "on";
+        } else {
+            throw std::runtime_error("Unknown cache option: " + option);
+        }
+    }
+    return config;
+}
+
+Cache::Cache(const CacheConfig& config) : settings(config) {
+    if (!powerOfTwo(config.size) || !powerOfTwo(config.lineSize) || !powerOfTwo(config.ways)) {
+        throw std::runtime_error("Cache size, line and ways must be powers of two");
+    }
+    if (config.lineSize < 4 || config.size < config.lineSize * config.ways) {
+        throw std::runtime_error("A cache needs lines of at least 4 bytes and room for one set");
+    }
+    if (config.replacement == CacheConfig::Replacement::PLRU && config.ways > 32) {
+        throw std::runtime_error("Pseudo LRU supports at most 32 ways");
+    }
+    if (config.hitLatency == 0 || config.missLatency < config.hitLatency) {
+        throw std::runtime_error("Cache latencies need 1 <= hit <= miss");
+    }
+    sets = config.size / config.lineSize / config.ways;
+    offsetBits = log2(config.lineSize);
+    setBits = log2(sets);
+    lines.resize(static_cast<size_t>(sets) * config.ways);
+    plruBits.resize(sets);
+}
+
+void Cache::clear() {
+    lines.assign(lines.size(), Line());
+    plruBits.assign(plruBits.size(), 0);
+    counters = CacheStats();
+    useClock = 0;
+    randomState = 0x2545F491;
+}
+
+uint32_t Cache::access(uint32_t address, uint32_t size, bool write, Dram* memory, uint64_t now) {
+    if (write) {
+        counters.writes++;
+    } else {
+        counters.reads++;
+    }
+    uint32_t first = address >> offsetBits;
+    uint32_t last = (address + (size ? size - 1 : 0)) >> offsetBits;
+    uint32_t cycles = accessLine(first, write, memory, now);
+    if (last != first) {
+        cycles = std::max(cycles, accessLine(last, write, memory, now));
+    }
+    return cycles;
+}
+
+uint32_t Cache::find(uint32_t set, uint32_t tag) const {
+    const Line* ways = &lines[static_cast<size_t>(set) * settings.ways];
+    for (uint32_t way = 0; way < settings.ways; way++) {
+        if (ways[way].valid && ways[way].tag == tag) return way;
+    }
+    return settings.ways;
+}
+
+Cache::Line& Cache::replace(uint32_t set, uint32_t tag, Dram* memory, uint64_t now, uint32_t& cycles) {
+    uint32_t way = victim(set);
+    Line& line = lines[static_cast<size_t>(set) * settings.ways + way];
+    if (line.valid) {
+        counters.evictions++;
+        if (line.prefetched) counters.prefetchUseless++;
+        if (line.dirty) {
+            counters.writebacks++;
+            if (memory) cycles += memory->write((line.tag << setBits | set) << offsetBits, now);
+        }
+    }
+    line = Line();
+    line.tag = tag;
+    line.valid = true;
+    touch(set, way);
+    return line;
+}
+
+uint32_t Cache::accessLine(uint32_t lineAddress, bool write, Dram* memory, uint64_t now) {
+    uint32_t set = lineAddress & (sets - 1);
+    uint32_t tag = lineAddress >> setBits;
+    bool writeThrough = write && settings.write == CacheConfig::WritePolicy::THROUGH;
+
+    uint32_t way = find(set, tag);
+    if (way < settings.ways) {
+        Line& line = lines[static_cast<size_t>(set) * settings.ways + way];
+        counters.hits++;
+        line.dirty |= write && !writeThrough;
+        touch(set, way);
+        uint32_t cycles = settings.hitLatency;
+        if (line.prefetched) {
+            // The first demand access decides whether the prefetch was in time
+            line.prefetched = false;
+            if (line.readyAt > now) {
+                counters.prefetchLate++;
+                cycles = std::max<uint64_t>(cycles, line.readyAt - now);
+            } else {
+                counters.prefetchUseful++;
+            }
+        }
+        if (writeThrough && memory) {
+            cycles += memory->write(lineAddress << offsetBits, now);
+        }
+        return cycles;
+    }
+
+    counters.misses++;
+    // A store that does not allocate goes around the cache into the write buffer
+    if (write && !settings.writeAllocate) {
+        return settings.hitLatency + (memory ? memory->write(lineAddress << offsetBits, now) : 0);
+    }
+    uint32_t cycles = settings.hitLatency;
+    Line& line = replace(set, tag, memory, now, cycles);
+    line.dirty = write && !writeThrough;
+    if (!memory) {
+        return settings.missLatency;
+    }
+    cycles += memory->read(lineAddress << offsetBits, now + cycles);
+    if (writeThrough) {
+        cycles += memory->write(lineAddress << offsetBits, now + cycles);
+    }
+    return cycles;
+}
+
+void Cache::prefetch(uint32_t address, Dram* memory, uint64_t now) {
+    uint32_t lineAddress = address >> offsetBits;
+    uint32_t set = lineAddress & (sets - 1);
+    uint32_t tag = lineAddress >> setBits;
+    if (find(set, tag) < settings.ways) {
+        return;
+    }
+    counters.prefetches++;
+    uint32_t cycles = settings.hitLatency;
+    Line& line = replace(set, tag, memory, now, cycles);
+    line.prefetched = true;
+    line.readyAt = now + (memory ? cycles + memory->read(lineAddress << offsetBits, now + cycles) : settings.missLatency);
+}
+
+uint32_t Cache::victim(uint32_t set) {
+    const Line* ways = &lines[static_cast<size_t>(set) * settings.ways];
+    for (uint32_t way = 0; way < settings.ways; way++) {
+        if (!ways[way].valid) return way;
+    }
+
+    switch (settings.replacement) {
+    case CacheConfig::Replacement::LRU: {
+        uint32_t oldest = 0;
+        for (uint32_t way = 1; way < settings.ways; way++) {
+            if (ways[way].lastUse < ways[oldest].lastUse) oldest = way;
+        }
+        return oldest;
+    }
+    case CacheConfig::Replacement::PLRU: {
+        // Follow the bits from the root, each one points at the less recently used half
+        uint32_t node = 0, base = 0;
+        for (uint32_t span = settings.ways; span > 1; span /= 2) {
+            if (plruBits[set] >> node & 1) {
+                base += span / 2;
+                node = 2 * node + 2;
+            } else {
+                node = 2 * node + 1;
+            }
+        }
+        return base;
+    }
+    case CacheConfig::Replacement::RANDOM:
+        // xorshift32, seeded by clear() so runs repeat
+        randomState ^= randomState << 13;
+        randomState ^= randomState >> 17;
+        randomState ^= randomState << 5;
+        return randomState & (settings.ways - 1);
+    }
+    return 0;
+}
+
+void Cache::touch(uint32_t set, uint32_t way) {
+    lines[static_cast<size_t>(set) * settings.ways + way].lastUse = ++useClock;
+    if (settings.replacement != CacheConfig::Replacement::PLRU) {
+        return;
+    }
+    // Point every node on the path away from `way`
+    uint32_t node = 0, base = 0;
+    for (uint32_t span = settings.ways; span > 1; span /= 2) {
+        if (way < base + span / 2) {
+            plruBits[set] |= 1u << node;
+            node = 2 * node + 1;
+        } else {
+            plruBits[set] &= ~(1u << node);
+            base += span / 2;
+            node = 2 * node + 2;
+        }
+    }
+}
+
+void Cache::dump(JsonWriter& out) const {
+    out.raw("{ \"size\": ").number(settings.size)
+        .raw(", \"line\": ").number(settings.lineSize)
+        .raw(", \"ways\": ").number(settings.ways)
+        .raw(", \"sets\": ").number(sets)
+        .raw(", \"replacement\": \"").raw(replacementName(settings.replacement))
+        .raw("\", \"write\": \"").raw(settings.write == CacheConfig::WritePolicy::BACK ? "back" : "through")
+        .raw("\", \"allocate\": ").boolean(settings.writeAllocate)
+        .raw(", \"hit\": ").number(settings.hitLatency)
+        .raw(", \"miss\": ").number(settings.missLatency)
+        .raw(", \"reads\": ").number(counters.reads)
+        .raw(", \"writes\": ").number(counters.writes)
+        .raw(", \"hits\": ").number(counters.hits)
+        .raw(", \"misses\": ").number(counters.misses)
+        .raw(", \"evictions\": ").number(counters.evictions)
+        .raw(", \"writebacks\": ").number(counters.writebacks)
+        .raw(", \"prefetches\": ").number(counters.prefetches)
+        .raw(", \"prefetchUseful\": ").number(counters.prefetchUseful)
+        .raw(", \"prefetchLate\": ").number(counters.prefetchLate)
+        .raw(", \"prefetchUseless\": ").number(counters.prefetchUseless).raw(" }");
+}
+
+const char* replacementName(CacheConfig::Replacement replacement) {
+    switch (replacement) {
+    case CacheConfig::Replacement::LRU: return "lru";
+    case CacheConfig::Replacement::PLRU: return "plru";
+    case CacheConfig::Replacement::RANDOM: return "random";
+    }
+    return "unknown";
+}
@@ -5,12 +5,16 @@
 #include "InstructionTypes/sb_instruction.h"
 #include "InstructionTypes/u_instruction.h"
 #include "InstructionTypes/uj_instruction.h"
+#include "trace.h"
+#include "trace_file.h"
+#include "constants.h"
 #include <iostream>
 #include "memory"
 #include <sstream>
 #include <iomanip>
+#include <algorithm>
+#include <iterator>
 
-Step Cpu::currentStep = FETCH;
 
 Cpu::Cpu(Memory &memory) : PC(0), IR(0), RA(0), RB(0), RM(0), RY(0), RZ(0), clock(0), memory(memory), 
                             data_forward(false), pipeline(false), numberOfBubbles(0),
@@ -36,7 +40,8 @@ Cpu::Cpu(Memory &memory) : PC(0), IR(0), RA(0), RB(0), RM(0), RY(0), RZ(0), cloc
 
 void Cpu::fetch()
 {
-    if (memory.instructionMemory.find(PC) == memory.instructionMemory.end())
+    auto fetched = memory.text().find(PC);
+    if (fetched == memory.text().end())
     {
         if (pipeline) {
             std::stringstream ss;
@@ -59,7 +64,15 @@ void Cpu::fetch()
         return;
     }
 
-    IR = memory.instructionMemory[PC];
+    if (instructionCache) {
+        waitForMemory(instructionCache->access(PC, 4, false, dram.get(), clock));
+        if (instructionPrefetcher) {
+            for (uint32_t address : instructionPrefetcher->observe(PC, instructionCache->config().lineSize)) {
+                instructionCache->prefetch(address, dram.get(), clock);
+            }
+        }
+    }
+    IR = fetched->second;
 
     std::stringstream ss;
     ss << "[Fetch] Fetched instruction 0x" << std::setw(8) << std::setfill('0') << std::hex << std::uppercase << IR
@@ -91,6 +104,8 @@ void Cpu::decode()
     currentInstruction->instructionPC = PC - 4; // Store the instruction PC for later use
 
     if (pipeline) {
+        uint32_t dataBubblesBefore = totalDataHazardBubbles;
+        uint32_t consumerPC = currentInstruction->instructionPC;
         decodedInstruction = std::move(currentInstruction);
         if (rdVec.size() == 5) {
             rdVec.erase(rdVec.begin());
@@ -111,7 +126,8 @@ void Cpu::decode()
             if (rs1 != 32 && rs1 == rdVec[i]) {
                 // std::cout << "rs1: " << rs1 << " rdVec[i]: " << rdVec[i] << std::endl;
                 if (data_forward) {
-                    checkDataForwarding(decodedInstruction, i, 0);
+                    // A load-use stall may already have moved the instruction to stalledInstruction
+                    if (decodedInstruction) checkDataForwarding(decodedInstruction, i, 0);
                     continue;
                 }
                 switch (i)
@@ -132,7 +148,7 @@ void Cpu::decode()
             }
             if (rs2 != 32 && rs2 == rdVec[i]) {
                 if (data_forward) {
-                    checkDataForwarding(decodedInstruction, i, 1);
+                    if (decodedInstruction) checkDataForwarding(decodedInstruction, i, 1);
                     continue;
                 }
                 switch (i)
@@ -152,7 +168,8 @@ void Cpu::decode()
                 }
             }
         }
-        if (data_forward) {
+        if (functionalUnits) waitForFunctionalUnits();
+        if (data_forward && decodedInstruction) {
             std::string instrName = decodedInstruction->getName();
             if (predictionBool && (instrName == "JAL" || instrName == "JALR" || instrName == "BEQ" || 
                 instrName == "BNE" || instrName == "BLT" || instrName == "BGE")) {
@@ -162,6 +179,17 @@ void Cpu::decode()
         totalBubbles += std::max(rs1Bubbles, rs2Bubbles);
         totalDataHazardBubbles += std::max(rs1Bubbles, rs2Bubbles);
         IR = 0;
+
+        if (uint32_t bubbles = totalDataHazardBubbles - dataBubblesBefore) {
+            if (PcCounters* counters = countersAt(consumerPC)) counters->dataBubblesSuffered += bubbles;
+            // The closest producer of a source operand is the one the stall waits for
+            for (const Instruction* producer : {executedInstruction.get(), memoryAccessedInstruction.get()}) {
+                if (producer && producer->getRD() != 32 && (producer->getRD() == rs1 || producer->getRD() == rs2)) {
+                    if (PcCounters* counters = countersAt(producer->instructionPC)) counters->dataBubblesCaused += bubbles;
+                    break;
+                }
+            }
+        }
     }
 }
 
@@ -172,6 +200,8 @@ void Cpu::checkDataForwarding(std::unique_ptr<Instruction>& decodedInstruction,
     case 2: // from instr is memoryAccessedInstruction, i.e., forward from prev to prev ins
             // M to E
         // std::cout << "M to E" << std::endl;
+        // rdVec still holds the destination of an instruction that was flushed as a bubble
+        if (!memoryAccessedInstruction) break;
         if (rsNo == 0) {
             dataForwardMap[{memoryAccessedInstruction->instructionPC, decodedInstruction->instructionPC}] = { Buffers::RY, Buffers::RA };
         } else {
@@ -182,6 +212,7 @@ void Cpu::checkDataForwarding(std::unique_ptr<Instruction>& decodedInstruction,
         
         // std::cout << "E to E" << std::endl;
         // M to E, if executedInstruction is load, with 1 bubble
+        if (!executedInstruction) break;
         if (executedInstruction->getName() == "LD" || executedInstruction->getName() == "LW"
             || executedInstruction->getName() == "LH" || executedInstruction->getName() == "LB") {
             if (decodedInstruction->getName() == "SD" || decodedInstruction->getName() == "SW"
@@ -262,6 +293,11 @@ void Cpu::doDataForwarding() {
                 RB = RZ;
             }
         }
+        // A M to M forward waits a cycle before it is applied
+        if (!(pendingLoadToStore && key == pendingKey)) {
+            if (PcCounters* counters = countersAt(fromPC)) counters->forwardsOut++;
+            if (PcCounters* counters = countersAt(toPC)) counters->forwardsIn++;
+        }
     }
 
     if (!pendingLoadToStore){
@@ -304,6 +340,21 @@ int32_t Cpu::signExtend(uint32_t value, uint32_t bits)
     return (value ^ mask) - mask;
 }
 
+bool Cpu::canDecode(uint32_t instr)
+{
+    uint32_t funct3 = (instr >> 12) & 0x7;
+    switch (instr & 0x7F)
+    {
+    case 0b0110011: case 0b0010011: case 0b0000011: case 0b1100111: case 0b0100011:
+    case 0b1100011: case 0b0110111: case 0b0010111: case 0b1101111:
+        return true;
+    case 0b1110011:
+        return funct3 >= 0b001 && funct3 <= 0b011;
+    default:
+        return false;
+    }
+}
+
 std::unique_ptr<Instruction> Cpu::decodeInstructionFun(uint32_t instr)
 {
     // Extract fields
@@ -478,6 +529,23 @@ std::unique_ptr<Instruction> Cpu::decodeInstructionFun(uint32_t instr)
         return std::make_unique<UJInstruction>(imm, rd, opcode, instrName);
     }
 
+    case 0b1110011: // I-format Zicsr (csrrw, csrrs, csrrc), the immediate is the CSR number
+    {
+        int32_t csr = (instr >> 20) & 0xFFF;
+        if      (funct3 == 0b001) instrName = "CSRRW";
+        else if (funct3 == 0b010) instrName = "CSRRS";
+        else if (funct3 == 0b011) instrName = "CSRRC";
+        else    throw std::runtime_error("Unsupported system instruction " + std::to_string(instr));
+        comment = "[Decode] I-format instruction " + instrName + " with rs1: x" + std::to_string(rs1) + ", rd: x" + std::to_string(rd) + ", csr: " + std::to_string(csr);
+        if(pipeline) {
+            memory.pipelineComments.push_back(comment);
+        } else {
+            memory.comment = comment;
+        }
+
+        return std::make_unique<IInstruction>(csr, rs1, funct3, rd, opcode, instrName);
+    }
+
     default:
         throw std::runtime_error("Unknown instruction opcode: " + std::to_string(opcode));
     }
@@ -489,6 +557,9 @@ void Cpu::execute()
     if (pipeline) {
         decodedInstruction->execute(*this);
         executedInstruction = std::move(decodedInstruction);
+        if (functionalUnits) {
+            functionalUnits->issue(executedInstruction->getName(), executedInstruction->getRD(), clock);
+        }
  
     } else {
         currentInstruction->execute(*this);
@@ -500,6 +571,8 @@ void Cpu::memory_update()
 {
     if (pipeline) {
         executedInstruction->memory_update(*this);
+        if (dataCache) accessDataCache(*executedInstruction);
+        if (traceWriter) traceAccess(*executedInstruction);
         memoryAccessedInstruction = std::move(executedInstruction);
     } else {
         if (!currentInstruction)
@@ -508,6 +581,8 @@ void Cpu::memory_update()
             return;
         }
         currentInstruction->memory_update(*this);
+        if (dataCache) accessDataCache(*currentInstruction);
+        if (traceWriter) traceAccess(*currentInstruction);
     }
     
 }
@@ -518,6 +593,8 @@ void Cpu::write_back()
         memoryAccessedInstruction->writeback(*this);
         writebackedInstruction = std::move(memoryAccessedInstruction);
         totalInstructions++;
+        if (PcCounters* counters = countersAt(writebackedInstruction->instructionPC)) counters->executions++;
+        if (traceWriter) traceRetire(*writebackedInstruction);
         if (writebackedInstruction->getName() == "LB" && writebackedInstruction->getName() == "LH" && writebackedInstruction->getName() == "LW" && writebackedInstruction->getName() == "LD"
             && writebackedInstruction->getName() == "SB" && writebackedInstruction->getName() == "SH" && writebackedInstruction->getName() == "SW" && writebackedInstruction->getName() == "SD") {
                 totalDataTransferInstructions++;
@@ -535,6 +612,9 @@ void Cpu::write_back()
         // std::cout << "[Write Back] Writing results to registers." << std::endl;
         currentInstruction->writeback(*this);
         totalInstructions++;
+        if (PcCounters* counters = countersAt(currentInstruction->instructionPC)) counters->executions++;
+        if (onRetire) onRetire(*currentInstruction);
+        if (traceWriter) traceRetire(*currentInstruction);
         if (currentInstruction->getName() == "LB" && currentInstruction->getName() == "LH" && currentInstruction->getName() == "LW" && currentInstruction->getName() == "LD"
         && currentInstruction->getName() == "SB" && currentInstruction->getName() == "SH" && currentInstruction->getName() == "SW" && currentInstruction->getName() == "SD") {
             totalDataTransferInstructions++;
@@ -547,10 +627,160 @@ void Cpu::write_back()
 
 }
 
+uint64_t Cpu::counter(uint32_t index) const
+{
+    switch (index) {
+    case 0: return clock;  // cycle
+    case 1: return clock;  // time, simulated time is counted in cycles
+    case 2: return totalInstructions;
+    case 3: return totalBubbles;
+    case 4: return totalDataHazards;
+    case 5: return totalDataHazardBubbles;
+    case 6: return totalControlHazards;
+    case 7: return totalControlHazardBubbles;
+    case 8: return totalBranchMissPredictions;
+    case 9: return instructionCache ? instructionCache->stats().misses : 0;
+    case 10: return dataCache ? dataCache->stats().misses : 0;
+    case 11: return totalMemoryStallCycles;
+    case 12: return totalFunctionalUnitBubbles;
+    default: throw std::logic_error("No counter " + std::to_string(index));
+    }
+}
+
+uint32_t Cpu::readCsr(uint32_t csr) const
+{
+    uint32_t bank = csr & ~0x9Fu;
+    // hpmcounter13 and up are not wired to anything, reading them as zero would look like a real count
+    if ((bank != 0xC00 && bank != 0xB00) || csr == 0xB01 || csr == 0xB81 ||
+        (csr & 0x1F) >= RISCV_CONSTANTS::CSR_COUNTERS) {
+        std::stringstream ss;
+        ss << "Unsupported CSR 0x" << std::hex << csr;
+        throw std::runtime_error(ss.str());
+    }
+    uint32_t index = csr & 0x1F;
+    uint64_t value = counter(index) + counterOffsets[index];
+    return csr & 0x80 ? static_cast<uint32_t>(value >> 32) : static_cast<uint32_t>(value);
+}
+
+void Cpu::writeCsr(uint32_t csr, uint32_t value)
+{
+    if ((csr & ~0x9Fu) == 0xC00) {
+        std::stringstream ss;
+        ss << "CSR 0x" << std::hex << csr << " is read only";
+        throw std::runtime_error(ss.str());
+    }
+    uint64_t current = static_cast<uint64_t>(readCsr(csr | 0x80)) << 32 | readCsr(csr & ~0x80u);
+    uint64_t written = csr & 0x80 ? (current & 0xFFFFFFFFull) | static_cast<uint64_t>(value) << 32
+                                  : (current & ~0xFFFFFFFFull) | value;
+    // The counter keeps counting from the written value
+    counterOffsets[csr & 0x1F] += written - current;
+}
+
+PcCounters* Cpu::countersAt(uint32_t pc)
+{
+    if (profile.size() == 0 && !memory.text().empty()) {
+        profile.cover(memory.text().begin()->first, memory.text().rbegin()->first);
+    }
+    return profile.find(pc);
+}
+
+void Cpu::traceAccess(const Instruction& instruction)
+{
+    TraceKind kind = traceKind(instruction.getOpcode());
+    if (kind == TraceKind::LOAD) {
+        traceWriter->access(TraceEvent::LOAD, instruction.getFunct3() & 3, RZ, RY);
+    } else if (kind == TraceKind::STORE) {
+        traceWriter->access(TraceEvent::STORE, instruction.getFunct3() & 3, RZ, RM);
+    }
+}
+
+void Cpu::traceRetire(const Instruction& instruction)
+{
+    uint32_t rd = instruction.getRD();
+    traceWriter->retire(instruction.instructionPC, rd, rd < 32 ? registers[rd] : 0);
+}
+
+void Cpu::traceOccupancy()
+{
+    uint8_t stages = 0;
+    if (IR != 0) stages |= 1;
+    if (decodedInstruction || stalledInstruction) stages |= 2;
+    if (executedInstruction) stages |= 4;
+    if (memoryAccessedInstruction) stages |= 8;
+    if (writebackedInstruction) stages |= 16;
+    traceWriter->cycle(stages);
+}
+
+void Cpu::accessDataCache(const Instruction& instruction)
+{
+    // RZ holds the effective address once the instruction has executed
+    TraceKind kind = traceKind(instruction.getOpcode());
+    if (kind == TraceKind::LOAD || kind == TraceKind::STORE) {
+        waitForMemory(dataCache->access(RZ, 1u << (instruction.getFunct3() & 3), kind == TraceKind::STORE,
+                                       dram.get(), clock));
+        if (dataPrefetcher) {
+            for (uint32_t address : dataPrefetcher->observe(instruction.instructionPC, RZ)) {
+                dataCache->prefetch(address, dram.get(), clock);
+            }
+        }
+    }
+}
+
+void Cpu::waitForMemory(uint32_t cycles)
+{
+    // Misses of both caches in one cycle overlap
+    memoryStall = std::max(memoryStall, cycles - 1);
+}
+
+void Cpu::waitForFunctionalUnits()
+{
+    Instruction* consumer = decodedInstruction ? decodedInstruction.get() : stalledInstruction.get();
+    // A stall on both operands can lose the instruction altogether
+    if (!consumer) {
+        return;
+    }
+    uint32_t rs1 = consumer->getRS1();
+    uint32_t rs2 = consumer->getRS2();
+    // Unstalled it would execute next cycle
+    uint64_t start = clock + 1;
+    uint64_t ready = functionalUnits->readyAt(consumer->getName(), rs1, rs2);
+    if (ready <= start + numberOfBubbles) {
+        return;
+    }
+    int bubbles = static_cast<int>(ready - start);
+    // Its operands are read again from the registers when the stall ends, so the producers
+    // still in execute and memory have to write back first,
+    for (auto [producer, cycles] : {std::pair{executedInstruction.get(), 2}, {memoryAccessedInstruction.get(), 1}}) {
+        uint32_t rd = producer ? producer->getRD() : 32;
+        if (rd != 32 && (rd == rs1 || rd == rs2)) bubbles = std::max(bubbles, cycles);
+    }
+
+    uint32_t extra = bubbles - numberOfBubbles;
+    if (decodedInstruction) stalledInstruction = std::move(decodedInstruction);
+    numberOfBubbles = bubbles;
+    totalBubbles += extra;
+    totalFunctionalUnitBubbles += extra;
+    if (PcCounters* counters = countersAt(consumer->instructionPC)) counters->unitBubbles += extra;
+    // and nothing is forwarded into it
+    for (auto it = dataForwardMap.begin(); it != dataForwardMap.end();) {
+        it = it->first.second == consumer->instructionPC ? dataForwardMap.erase(it) : std::next(it);
+    }
+}
+
 void Cpu::step()
 {
+    if (memoryStall) {
+        memoryStall--;
+        totalMemoryStallCycles++;
+        clock++;
+        if (pipeline && traceWriter && traceWriter->occupancy()) traceOccupancy();
+        return;
+    }
+
     if (pipeline) {
         uint32_t oldPC = PC;
+        uint32_t controlBubblesBefore = totalControlHazardBubbles;
+        uint32_t mispredictionsBefore = totalBranchMissPredictions;
         if (memoryAccessedInstruction != nullptr) {
             write_back();
             if (executedInstruction == nullptr && decodedInstruction == nullptr && stalledInstruction == nullptr) {
@@ -596,6 +826,14 @@ void Cpu::step()
 
         clock++;
 
+        // Redirects and mispredictions of this cycle belong to the control instruction that just executed
+        if (executedInstruction && (totalControlHazardBubbles != controlBubblesBefore || totalBranchMissPredictions != mispredictionsBefore)) {
+            if (PcCounters* counters = countersAt(executedInstruction->instructionPC)) {
+                counters->controlBubbles += totalControlHazardBubbles - controlBubblesBefore;
+                counters->mispredictions += totalBranchMissPredictions - mispredictionsBefore;
+            }
+        }
+
         if (numberOfBubbles == 0 && stalledInstruction != nullptr) {
             decodedInstruction = std::move(stalledInstruction);
             uint32_t rs1 = decodedInstruction->getRS1();
@@ -624,6 +862,8 @@ void Cpu::step()
             doDataForwarding();
         }
 
+        if (traceWriter && traceWriter->occupancy()) traceOccupancy();
+
     } else {
         // No pipelining
         switch (currentStep)
@@ -647,6 +887,11 @@ void Cpu::step()
         case EXECUTE:
             execute();
             clock++;
+            if (functionalUnits) {
+                uint32_t extra = functionalUnits->latency(currentInstruction->getName()) - 1;
+                clock += extra;
+                totalFunctionalUnitBubbles += extra;
+            }
             currentStep = MEMORY;
             break;
         case MEMORY:
@@ -666,28 +911,39 @@ void Cpu::step()
 
 void Cpu::run()
 {
-    if (pipeline) {
-        while (memory.comment != "Successfully Exited") {
-            step();
-        }
-    } else {
-        while (memory.instructionMemory.find(PC) != memory.instructionMemory.end())
-        {
-                for (int i = 0; i < 5; ++i) {
-                    if (memory.comment == "Successfully Exited") return;
-                    step();
-                }
-                currentStep = FETCH;
-            
-          
-        }
+    runUntil(UINT64_MAX, UINT64_MAX);
+}
+
+bool Cpu::runUntil(uint64_t clockLimit, uint64_t instructionLimit)
+{
+    while (!finished()) {
+        if (clock >= clockLimit || totalInstructions >= instructionLimit) return false;
+        // Nothing dumps the state between two cycles of a run, keep only the comments of the last one
+        memory.pipelineComments.clear();
+        step();
     }
 
     // std::cout << "[Program Finished] Total clock cycles: " << clock << "\n";
+    return true;
 }
 
+bool Cpu::finished() const
+{
+    if (memory.comment == "Successfully Exited") return true;
+    // Without pipelining a program also ends by falling off the instruction memory
+    return !pipeline && currentStep == FETCH && memory.text().find(PC) == memory.text().end();
+}
 
-void Cpu::dumpRegisters()
+CycleGenerator Cpu::execution(uint64_t cyclesPerYield, uint64_t clockLimit, uint64_t instructionLimit)
+{
+    while (!runUntil(std::min(clockLimit, clock + cyclesPerYield), instructionLimit)) {
+        if (clock >= clockLimit || totalInstructions >= instructionLimit) co_return;
+        co_yield clock;
+    }
+}
+
+
+void Cpu::dumpRegisters(JsonWriter& out) const
 {
     bool first = true;
     for (int i = 0; i < 32; i++)
@@ -695,18 +951,18 @@ void Cpu::dumpRegisters()
         if (registers[i] != 0)
         {
             if (!first)
-                std::cout << ",";
-            std::cout << "\"x" << std::dec << i << "\": \"0x" << std::hex << std::setw(8) << std::setfill('0') << registers[i] << "\"";
+                out.raw(',');
+            out.raw("\"x").number(i).raw("\": ").hexString(registers[i]);
             first = false;
         }
     }
 }
 
-void Cpu::dumpDataForwardPath() {
+void Cpu::dumpDataForwardPath(JsonWriter& out) {
+
+    out.raw("{ \"fromBuffer\": \"").raw(dataForwardPair.first).raw("\", ")
+       .raw("\"toBuffer\": \"").raw(dataForwardPair.second).raw("\"}");
 
-        std::cout << "{ \"fromBuffer\": "<< "\"" << dataForwardPair.first << "\"" << ", "
-           << "\"toBuffer\": " << "\"" << dataForwardPair.second << "\"" << "}";
-    
     dataForwardPair.first = "";
     dataForwardPair.second = "";
 }
@@ -737,19 +993,58 @@ void Cpu::reset()
     totalDataHazards = 0;
     totalControlHazards = 0;
     totalBranchMissPredictions = 0;
+    profile.clear();
+    std::fill(std::begin(counterOffsets), std::end(counterOffsets), 0);
+    memoryStall = 0;
+    totalMemoryStallCycles = 0;
+    totalFunctionalUnitBubbles = 0;
+    if (functionalUnits) functionalUnits->clear();
+    if (instructionCache) instructionCache->clear();
+    if (dataCache) dataCache->clear();
+    if (dram) dram->clear();
+    if (instructionPrefetcher) instructionPrefetcher->clear();
+    if (dataPrefetcher) dataPrefetcher->clear();
 
     memory.reset();
     predictionBool  = false;
     predictionBit = false;
 }
 
-std::string Cpu::dumpPipelineStages()
+void Cpu::resetPipeline()
 {
-    std::stringstream ss;
-    ss << "{ \"F\": "<< "\"" << "0x" << std::hex << std::setw(8) << std::setfill('0') << instructionMap["F"] << "\"" << ", "
-       << "\"D\": " << "\"" << "0x" << std::hex << std::setw(8) << std::setfill('0') << instructionMap["D"] << "\"" << ", "
-       << "\"E\": " << "\"" << "0x" << std::hex << std::setw(8) << std::setfill('0') << instructionMap["E"]  <<  "\"" << ", "
-       << "\"M\": " << "\"" << "0x" << std::hex << std::setw(8) << std::setfill('0') << instructionMap["M"] << "\"" << ", "
-       << "\"W\": " << "\"" << "0x" << std::hex << std::setw(8) << std::setfill('0') << instructionMap["W"] << "\"" << " }";
-    return ss.str();
+    flushPipeline();
+    pipeline = false;
+    data_forward = false;
+}
+
+void Cpu::flushPipeline()
+{
+    currentInstruction.reset();
+    decodedInstruction.reset();
+    executedInstruction.reset();
+    memoryAccessedInstruction.reset();
+    writebackedInstruction.reset();
+    stalledInstruction.reset();
+    instructionMap.clear();
+    dataForwardMap.clear();
+    dataForwardPair = std::make_pair("", "");
+    rdVec.assign(5, 32);
+    numberOfBubbles = 0;
+    memoryStall = 0;
+    if (functionalUnits) functionalUnits->clear();
+    currentStep = FETCH;
+    loadToStoreForwarding = false;
+    memory.pipelineComments.clear();
+}
+
+void Cpu::dumpPipelineStages(JsonWriter& out) const
+{
+    const char* stages[] = {"F", "D", "E", "M", "W"};
+    out.raw("{ ");
+    for (int i = 0; i < 5; i++)
+    {
+        auto it = instructionMap.find(stages[i]);
+        out.raw(i ? ", \"" : "\"").raw(stages[i]).raw("\": ").hexString(it != instructionMap.end() ? it->second : 0);
+    }
+    out.raw(" }");
 }
\ No newline at end of file
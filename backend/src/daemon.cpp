@@ -0,0 +1,258 @@
+#include "daemon.h"
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <stdexcept>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace Daemon {
+
+namespace {
+
+struct Command {
+    std::string text;
+    JsonRequest request;
+};
+
+struct HostedSession {
+    std::string id;
+    Session session;
+    std::deque<Command> pending;  // guarded by Host::mutex
+    bool scheduled = false;       // queued in Host::ready or being run by a worker
+
+    // A `run` in progress, resumed one slice per turn so that long runs share the workers
+    std::optional<CycleGenerator> running;  // only touched by the worker holding the session
+    JsonWriter runOutput;
+    RunControl control;
+    bool runActive = false;  // guarded by Host::mutex
+
+    HostedSession(const std::string& id, const SessionOptions& options) : id(id), session(options) {}
+};
+
+class Host {
+    const SessionOptions& options;
+    std::ostream& out;
+    std::ostream& err;
+
+    std::mutex mutex;  // guards sessions, ready, finished and every pending queue
+    std::condition_variable wake;
+    std::unordered_map<std::string, std::shared_ptr<HostedSession>> sessions;
+    // Sessions with pending commands, each appears at most once so a session only ever runs on one worker
+    std::deque<std::shared_ptr<HostedSession>> ready;
+    bool finished = false;
+
+    std::mutex outputMutex;
+    std::vector<std::thread> workers;
+
+    void enqueue(const std::shared_ptr<HostedSession>& hosted, Command command) {
+        hosted->pending.push_back(std::move(command));
+        if (!hosted->scheduled) {
+            hosted->scheduled = true;
+            ready.push_back(hosted);
+            wake.notify_one();
+        }
+    }
+
+    void run(HostedSession& hosted, const Command& command, JsonWriter& json) {
+        try {
+            if (command.text == "close") {
+                json.raw("{ \"closed\": true }");
+            } else if (!hosted.session.execute(command.text, command.request, json)) {
+                error(hosted.id, "Invalid command");
+                return;
+            }
+            std::lock_guard<std::mutex> lock(outputMutex);
+            out << hosted.id << ' ';
+            json.flush(out);
+        } catch (const std::exception& e) {
+            json.clear();
+            error(hosted.id, std::string("Error: ") + e.what());
+        }
+    }
+
+    // Starts (`start` set) or resumes a run for one slice, returns true once it has finished
+    bool resume(HostedSession& hosted, const std::string* start) {
+        try {
+            if (start) {
+                hosted.running.emplace(hosted.session.runSlices(hosted.session.runBudget(*start), &hosted.control, hosted.runOutput));
+            }
+            if (hosted.running->next()) {
+                return false;
+            }
+            hosted.running.reset();
+            std::lock_guard<std::mutex> lock(outputMutex);
+            out << hosted.id << ' ';
+            hosted.runOutput.flush(out);
+        } catch (const std::exception& e) {
+            hosted.running.reset();
+            hosted.runOutput.clear();
+            error(hosted.id, std::string("Error: ") + e.what());
+        }
+        return true;
+    }
+
+    void work() {
+        JsonWriter json;
+        std::unique_lock<std::mutex> lock(mutex);
+        while (true) {
+            wake.wait(lock, [&] { return finished || !ready.empty(); });
+            if (ready.empty()) {
+                return;
+            }
+            std::shared_ptr<HostedSession> hosted = std::move(ready.front());
+            ready.pop_front();
+
+            if (hosted->runActive) {
+                lock.unlock();
+                bool done = resume(*hosted, nullptr);
+                lock.lock();
+                hosted->runActive = !done;
+            } else {
+                Command command = std::move(hosted->pending.front());
+                hosted->pending.pop_front();
+                bool isRun = Session::isRun(command.text);
+                if (isRun) {
+                    hosted->control.begin(hosted->session.cpu);
+                    hosted->runActive = true;
+                }
+
+                lock.unlock();
+                bool done = true;
+                if (isRun) {
+                    done = resume(*hosted, &command.text);
+                } else {
+                    run(*hosted, command, json);
+                }
+                lock.lock();
+                hosted->runActive = !done;
+            }
+
+            // One command or one run slice per turn, busy sessions go to the back so others are not starved
+            if (hosted->pending.empty() && !hosted->runActive) {
+                hosted->scheduled = false;
+            } else {
+                ready.push_back(std::move(hosted));
+            }
+        }
+    }
+
+public:
+    Host(const SessionOptions& options, std::ostream& out, std::ostream& err, unsigned threads)
+        : options(options), out(out), err(err) {
+        for (unsigned i = 0; i < threads; i++) {
+            workers.emplace_back(&Host::work, this);
+        }
+    }
+
+    void error(const std::string& id, const std::string& message) {
+        std::lock_guard<std::mutex> lock(outputMutex);
+        err << id << ' ' << message << std::endl;
+    }
+
+    void submit(const std::string& id, Command command) {
+        std::lock_guard<std::mutex> lock(mutex);
+        std::shared_ptr<HostedSession>& hosted = sessions[id];
+        if (!hosted) {
+            hosted = std::make_shared<HostedSession>(id, options);
+        }
+        enqueue(hosted, std::move(command));
+    }
+
+    // `status`, `pause` and `cancel` are answered at once, even while the session's run is in progress
+    void control(const std::string& id, const std::string& text) {
+        JsonWriter json;
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            auto it = sessions.find(id);
+            bool active = it != sessions.end() && it->second->runActive;
+            if (text == "status") {
+                if (active) {
+                    it->second->control.writeStatus(json);
+                } else {
+                    json.raw("{ \"running\": false }");
+                }
+            } else {
+                if (active) {
+                    it->second->control.request = text == "pause" ? RunControl::PAUSE : RunControl::CANCEL;
+                }
+                json.raw("{ \"").raw(text).raw("\": ").boolean(active).raw(" }");
+            }
+        }
+        std::lock_guard<std::mutex> lock(outputMutex);
+        out << id << ' ';
+        json.flush(out);
+    }
+
+    // Forgets the session at once so a later command with the same id starts afresh,
+    // its queued commands still run before the close is acknowledged
+    void close(const std::string& id) {
+        std::lock_guard<std::mutex> lock(mutex);
+        auto it = sessions.find(id);
+        if (it == sessions.end()) {
+            error(id, "Error: No session " + id);
+            return;
+        }
+        if (it->second->runActive) {
+            it->second->control.request = RunControl::CANCEL;
+        }
+        enqueue(it->second, Command{"close", {}});
+        sessions.erase(it);
+    }
+
+    // Lets the workers drain the remaining commands and waits for them
+    void finish() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            finished = true;
+        }
+        wake.notify_all();
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+    }
+};
+
+}
+
+void serve(std::istream& in, std::ostream& out, std::ostream& err, const SessionOptions& options, unsigned threads) {
+    Host host(options, out, err, threads > 0 ? threads : 1);
+
+    std::string line;
+    while (std::getline(in, line)) {
+        if (line.empty()) {
+            continue;
+        }
+        size_t space = line.find(' ');
+        if (space == std::string::npos || space == 0) {
+            host.error("-", "Error: Expected \"<session> <command>\"");
+            continue;
+        }
+        std::string id = line.substr(0, space);
+        Command command{line.substr(space + 1), {}};
+
+        if (command.text == "close") {
+            host.close(id);
+            continue;
+        }
+        if (command.text == "status" || command.text == "pause" || command.text == "cancel") {
+            host.control(id, command.text);
+            continue;
+        }
+        if (Session::needsPayload(command.text)) {
+            try {
+                command.request.read(in);
+            } catch (const std::exception& e) {
+                host.error(id, std::string("Error: ") + e.what());
+                continue;
+            }
+        }
+        host.submit(id, std::move(command));
+    }
+    host.finish();
+}
+
+}
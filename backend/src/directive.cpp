@@ -1,9 +1,12 @@
 #include "directive.h"
+#include "constants.h"
 #include <unordered_map>
 #include <sstream>
 #include <iostream>
 #include <vector>
 #include <stdexcept>
+#include <fstream>
+#include <algorithm>
 
 bool isNumber(const std::string& s) {
     for (char c : s) {
@@ -16,6 +19,13 @@ bool DirectiveHandler::isDirective(const std::string &line) {
     return line[0] == '.';
 }
 
+bool DirectiveHandler::isSegmentDirective(const std::string &line) {
+    std::istringstream iss(line);
+    std::string directive;
+    iss >> directive;
+    return directive == ".text" || directive == ".data";
+}
+
 bool DirectiveHandler::isInByteRange(int value) {
     return (value >= 0 && value <= 255);
 }
@@ -28,10 +38,55 @@ bool DirectiveHandler::isInWordRange(int value) {
     return (value >= -2147483648LL && value <= 4294967295LL);
 }
 
+std::string DirectiveHandler::includeDirectory;
+
+// Parses the comma separated numeric operands of .space, .fill and the alignment directives
+static std::vector<long long> parseArguments(std::istringstream &iss, const std::string &directive) {
+    std::vector<long long> values;
+    std::string rest, arg;
+    std::getline(iss, rest);
+    std::istringstream args(rest);
+    while (std::getline(args, arg, ',')) {
+        arg.erase(0, arg.find_first_not_of(" \t"));
+        arg.erase(arg.find_last_not_of(" \t") + 1);
+        if (arg.empty()) continue;
+        try {
+            values.push_back(std::stoll(arg, nullptr, 0));
+        } catch (const std::exception &) {
+            throw std::runtime_error("Invalid argument '" + arg + "' for " + directive + " directive");
+        }
+    }
+    return values;
+}
+
+// Bytes still free in the data segment from `address`
+static uint64_t remainingDataSpace(uint32_t address) {
+    return address < RISCV_CONSTANTS::DATA_SEGMENT_END ? uint64_t(RISCV_CONSTANTS::DATA_SEGMENT_END) - address : 0;
+}
+
+void DirectiveHandler::reserve(uint32_t &address, uint64_t size, const std::string &directive) {
+    if (size > remainingDataSpace(address)) {
+        throw std::runtime_error(directive + " of " + std::to_string(size) + " bytes does not fit in the data segment");
+    }
+    // Reserved memory is zero, its pages stay unallocated until the program writes them
+    address += static_cast<uint32_t>(size);
+}
+
+std::string DirectiveHandler::resolveInclude(const std::string &file) {
+    if (includeDirectory.empty()) {
+        throw std::runtime_error(".incbin is disabled, start the assembler with --include-dir <dir>");
+    }
+    if (file.empty() || file[0] == '/' || file.find("..") != std::string::npos) {
+        throw std::runtime_error(".incbin path must be relative to the include directory: " + file);
+    }
+    return includeDirectory + "/" + file;
+}
+
 void DirectiveHandler::process(const std::string &line, uint32_t &address, bool firstPass) {
     std::istringstream iss(line);
     std::string directive;
     iss >> directive;
+    alignment = 0;
 
     if (directive == ".text") {
         currentSegment = Segment::TEXT;
@@ -40,6 +95,10 @@ void DirectiveHandler::process(const std::string &line, uint32_t &address, bool
         currentSegment = Segment::DATA;
         address = 0x10000000;
     } else if (currentSegment == Segment::DATA) {
+        // Every directive collects its payload and writes it with a single bulk store
+        std::vector<uint8_t> bytes;
+        uint32_t start = address;
+
         if (directive == ".byte") {
             std::string value_str;
             while (iss >> value_str) {
@@ -59,12 +118,9 @@ void DirectiveHandler::process(const std::string &line, uint32_t &address, bool
                 }
 
                 if (!firstPass) {
-                    memory.storeData(address, static_cast<uint8_t>(value));
+                    bytes.push_back(static_cast<uint8_t>(value));
                 }
                 address += 1;
-
-                // char comma;
-                // iss >> comma;
             }
         } 
         else if (directive == ".half") {
@@ -86,16 +142,10 @@ void DirectiveHandler::process(const std::string &line, uint32_t &address, bool
                 }
 
                 if (!firstPass) {
-                    std::vector<uint8_t> bytes = {
-                        static_cast<uint8_t>(value & 0xFF),
-                        static_cast<uint8_t>((value >> 8) & 0xFF)
-                    };
-                    memory.storeDataBytes(address, bytes);
+                    bytes.push_back(static_cast<uint8_t>(value & 0xFF));
+                    bytes.push_back(static_cast<uint8_t>((value >> 8) & 0xFF));
                 }
                 address += 2;
-
-                // char comma;
-                // iss >> comma;
             }
         } 
         else if (directive == ".word") {
@@ -117,37 +167,25 @@ void DirectiveHandler::process(const std::string &line, uint32_t &address, bool
                 }
 
                 if (!firstPass) {
-                    std::vector<uint8_t> bytes = {
-                        static_cast<uint8_t>(value & 0xFF),
-                        static_cast<uint8_t>((value >> 8) & 0xFF),
-                        static_cast<uint8_t>((value >> 16) & 0xFF),
-                        static_cast<uint8_t>((value >> 24) & 0xFF)
-                    };
-                    memory.storeDataBytes(address, bytes);
+                    for (int i = 0; i < 4; i++) {
+                        bytes.push_back(static_cast<uint8_t>((value >> (i * 8)) & 0xFF));
+                    }
                 }
                 address += 4;
-
-                // char comma;
-                // iss >> comma;
             }
         } 
         else if (directive == ".dword") {
             long long value;
             while (iss >> value) {
                 if (!firstPass) {
-                    std::vector<uint8_t> bytes(8);
                     for (int i = 0; i < 8; i++) {
-                        bytes[i] = static_cast<uint8_t>((value >> (i * 8)) & 0xFF);
+                        bytes.push_back(static_cast<uint8_t>((value >> (i * 8)) & 0xFF));
                     }
-                    memory.storeDataBytes(address, bytes);
                 }
                 address += 8;
-
-                // char comma;
-                // iss >> comma;
             }
         } 
-        else if (directive == ".asciiz") {
+        else if (directive == ".asciiz" || directive == ".asciz") {
             std::string str;
             std::getline(iss, str);
 
@@ -158,15 +196,109 @@ void DirectiveHandler::process(const std::string &line, uint32_t &address, bool
                 str = str.substr(first + 1, last - first - 1);
 
                 if (!firstPass) {
-                    std::vector<uint8_t> bytes(str.begin(), str.end());
+                    bytes.assign(str.begin(), str.end());
                     bytes.push_back(0);  // Null terminator
-                    memory.storeDataBytes(address, bytes);
                 }
                 address += str.length() + 1;
             }
         } 
+        else if (directive == ".space" || directive == ".zero") {
+            // .space size
+            std::vector<long long> args = parseArguments(iss, directive);
+            if (args.size() != 1 || args[0] < 0) {
+                throw std::runtime_error(directive + " expects a single non-negative size");
+            }
+            reserve(address, args[0], directive);
+        }
+        else if (directive == ".fill") {
+            // .fill repeat[, size[, value]] with size between 1 and 8 bytes
+            std::vector<long long> args = parseArguments(iss, directive);
+            if (args.empty() || args.size() > 3 || args[0] < 0) {
+                throw std::runtime_error(".fill expects repeat[, size[, value]]");
+            }
+            long long size = args.size() > 1 ? args[1] : 1;
+            long long value = args.size() > 2 ? args[2] : 0;
+            if (size < 1 || size > 8) {
+                throw std::runtime_error(".fill size must be between 1 and 8");
+            }
+            // Checked before multiplying, a huge repeat count would wrap the total around
+            if (static_cast<uint64_t>(args[0]) > remainingDataSpace(address) / size) {
+                throw std::runtime_error(".fill of " + std::to_string(args[0]) + " x " + std::to_string(size) +
+                                         " bytes does not fit in the data segment");
+            }
+            uint64_t total = static_cast<uint64_t>(args[0]) * size;
+            if (value == 0) {
+                reserve(address, total, directive);
+            } else {
+                if (!firstPass) {
+                    bytes.resize(total);
+                    for (long long i = 0; i < size; i++) {
+                        bytes[i] = static_cast<uint8_t>((value >> (i * 8)) & 0xFF);
+                    }
+                    // Double the filled prefix until the whole buffer is covered
+                    for (uint64_t filled = size; filled < total; filled *= 2) {
+                        std::copy_n(bytes.begin(), std::min(filled, total - filled), bytes.begin() + filled);
+                    }
+                }
+                address += static_cast<uint32_t>(total);
+            }
+        }
+        else if (directive == ".align" || directive == ".p2align" || directive == ".balign") {
+            // .align / .p2align take a power of two, .balign a byte count
+            std::vector<long long> args = parseArguments(iss, directive);
+            if (args.empty() || args[0] < 0 || (directive != ".balign" && args[0] > 31)) {
+                throw std::runtime_error(directive + " expects an alignment");
+            }
+            uint64_t boundary = directive == ".balign" ? args[0] : (1ULL << args[0]);
+            if (boundary == 0 || (boundary & (boundary - 1)) != 0) {
+                throw std::runtime_error(directive + " alignment must be a power of two");
+            }
+            uint64_t aligned = (static_cast<uint64_t>(address) + boundary - 1) & ~(boundary - 1);
+            reserve(address, aligned - address, directive);
+            alignment = static_cast<uint32_t>(boundary);
+        }
+        else if (directive == ".incbin") {
+            // .incbin "file"[, skip[, count]]
+            std::string rest;
+            std::getline(iss, rest);
+            size_t first = rest.find('"');
+            size_t last = rest.find('"', first + 1);
+            if (first == std::string::npos || last == std::string::npos) {
+                throw std::runtime_error(".incbin expects a quoted file name");
+            }
+            std::string path = resolveInclude(rest.substr(first + 1, last - first - 1));
+            std::istringstream argStream(rest.substr(last + 1));
+            std::vector<long long> args = parseArguments(argStream, directive);
+            long long skip = args.size() > 0 ? args[0] : 0;
+
+            std::ifstream file(path, std::ios::binary | std::ios::ate);
+            if (!file) {
+                throw std::runtime_error("Cannot open .incbin file " + path);
+            }
+            long long fileSize = file.tellg();
+            if (skip < 0 || skip > fileSize) {
+                throw std::runtime_error(".incbin skip is outside of " + path);
+            }
+            long long count = args.size() > 1 ? args[1] : fileSize - skip;
+            if (count < 0 || skip + count > fileSize) {
+                throw std::runtime_error(".incbin count is outside of " + path);
+            }
+            if (static_cast<uint64_t>(count) > remainingDataSpace(address)) {
+                throw std::runtime_error(".incbin of " + std::to_string(count) + " bytes does not fit in the data segment");
+            }
+            if (!firstPass) {
+                bytes.resize(count);
+                file.seekg(skip);
+                file.read(reinterpret_cast<char *>(bytes.data()), count);
+            }
+            address += static_cast<uint32_t>(count);
+        }
         else {
             throw std::runtime_error("Invalid directive: " + directive);
         }
+
+        if (!firstPass && !bytes.empty()) {
+            memory.storeDataBytes(start, bytes);
+        }
     }
 }
@@ -0,0 +1,108 @@
+#include "dram.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+DramConfig DramConfig::parse(const std::string& arguments) {
+    DramConfig config;
+    std::istringstream in(arguments);
+    std::string option;
+    while (in >> option) {
+        size_t equals = option.find('=');
+        std::string name = option.substr(0, equals);
+        uint32_t* field = name == "banks" ? &config.banks
+                        : name == "row" ? &config.rowSize
+                        : name == "hit" ? &config.rowHitLatency
+                        : name == "closed" ? &config.rowClosedLatency
+                        : name == "conflict" ? &config.rowConflictLatency
+                        : name == "queue" ? &config.queue : nullptr;
+        if (!field || equals == std::string::npos) {
+            throw std::runtime_error("Unknown dram option: " + option);
+        }
+        try {
+            *field = std::stoul(option.substr(equals + 1));
+        } catch (const std::exception&) {
+            throw std::runtime_error("Invalid dram option: " + option);
+        }
+    }
+    return config;
+}
+
+Dram::Dram(const DramConfig& config) : settings(config), banks(config.banks) {
+    if (config.banks == 0 || config.rowSize == 0 || config.queue == 0) {
+        throw std::runtime_error("DRAM banks, row and queue must be positive");
+    }
+    if (config.rowHitLatency == 0) {
+        throw std::runtime_error("DRAM latencies must be positive");
+    }
+    pending.reserve(config.queue);
+}
+
+void Dram::clear() {
+    banks.assign(banks.size(), Bank());
+    pending.clear();
+    counters = DramStats();
+}
+
+uint64_t Dram::issue(uint32_t address, uint64_t now, uint64_t& done) {
+    std::erase_if(pending, [now](uint64_t completion) { return completion <= now; });
+    uint64_t accepted = now;
+    if (pending.size() >= settings.queue) {
+        auto oldest = std::min_element(pending.begin(), pending.end());
+        accepted = *oldest;
+        counters.queueCycles += accepted - now;
+        pending.erase(oldest);
+    }
+
+    uint32_t block = address / settings.rowSize;
+    Bank& bank = banks[block % settings.banks];
+    uint32_t row = block / settings.banks;
+    uint32_t latency;
+    if (bank.open && bank.row == row) {
+        counters.rowHits++;
+        latency = settings.rowHitLatency;
+    } else if (!bank.open) {
+        counters.rowClosed++;
+        latency = settings.rowClosedLatency;
+    } else {
+        counters.rowConflicts++;
+        latency = settings.rowConflictLatency;
+    }
+    bank.open = true;
+    bank.row = row;
+
+    done = std::max(accepted, bank.readyAt) + latency;
+    bank.readyAt = done;
+    pending.push_back(done);
+    return accepted;
+}
+
+uint32_t Dram::read(uint32_t address, uint64_t now) {
+    counters.reads++;
+    uint64_t done;
+    issue(address, now, done);
+    counters.readCycles += done - now;
+    return static_cast<uint32_t>(done - now);
+}
+
+uint32_t Dram::write(uint32_t address, uint64_t now) {
+    counters.writes++;
+    uint64_t done;
+    return static_cast<uint32_t>(issue(address, now, done) - now);
+}
+
+void Dram::dump(JsonWriter& out) const {
+    out.raw("{ \"banks\": ").number(settings.banks)
+        .raw(", \"row\": ").number(settings.rowSize)
+        .raw(", \"hit\": ").number(settings.rowHitLatency)
+        .raw(", \"closed\": ").number(settings.rowClosedLatency)
+        .raw(", \"conflict\": ").number(settings.rowConflictLatency)
+        .raw(", \"queue\": ").number(settings.queue)
+        .raw(", \"reads\": ").number(counters.reads)
+        .raw(", \"writes\": ").number(counters.writes)
+        .raw(", \"rowHits\": ").number(counters.rowHits)
+        .raw(", \"rowClosed\": ").number(counters.rowClosed)
+        .raw(", \"rowConflicts\": ").number(counters.rowConflicts)
+        .raw(", \"readCycles\": ").number(counters.readCycles)
+        .raw(", \"queueCycles\": ").number(counters.queueCycles).raw(" }");
+}
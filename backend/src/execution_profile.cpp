@@ -0,0 +1,6 @@
+#include "execution_profile.h"
+
+void ExecutionProfile::cover(uint32_t first, uint32_t last) {
+    base = first;
+    counters.assign(last >= first ? (last - first) / 4 + 1 : 0, PcCounters());
+}
@@ -0,0 +1,78 @@
+#include "functional_units.h"
+#include <algorithm>
+#include <sstream>
+#include <stdexcept>
+
+FunctionalUnitConfig FunctionalUnitConfig::parse(const std::string& arguments) {
+    FunctionalUnitConfig config;
+    std::istringstream in(arguments);
+    std::string option;
+    while (in >> option) {
+        size_t equals = option.find('=');
+        std::string name = option.substr(0, equals);
+        std::string value = equals == std::string::npos ? "" : option.substr(equals + 1);
+        if (name == "multiplier" || name == "divider") {
+            if (value != "pipelined" && value != "blocking") {
+                throw std::runtime_error("Invalid latency option: " + option);
+            }
+            (name == "multiplier" ? config.pipelinedMultiplier : config.pipelinedDivider) = value == "pipelined";
+            continue;
+        }
+        uint32_t* field = name == "mul" ? &config.mulLatency
+                        : name == "div" ? &config.divLatency
+                        : name == "rem" ? &config.remLatency : nullptr;
+        if (!field || equals == std::string::npos) {
+            throw std::runtime_error("Unknown latency option: " + option);
+        }
+        try {
+            *field = std::stoul(value);
+        } catch (const std::exception&) {
+            throw std::runtime_error("Invalid latency option: " + option);
+        }
+    }
+    if (config.mulLatency == 0 || config.divLatency == 0 || config.remLatency == 0) {
+        throw std::runtime_error("Latencies must be at least one cycle");
+    }
+    return config;
+}
+
+FunctionalUnits::FunctionalUnits(const FunctionalUnitConfig& config) : settings(config) {
+}
+
+uint32_t FunctionalUnits::latency(const std::string& name) const {
+    return name == "MUL" ? settings.mulLatency
+         : name == "DIV" ? settings.divLatency
+         : name == "REM" ? settings.remLatency : 1;
+}
+
+uint64_t FunctionalUnits::readyAt(const std::string& name, uint32_t rs1, uint32_t rs2) const {
+    uint64_t ready = 0;
+    for (uint32_t rs : {rs1, rs2}) {
+        if (rs < 32) ready = std::max(ready, registerReadyAt[rs]);
+    }
+    if (name == "MUL" && !settings.pipelinedMultiplier) ready = std::max(ready, multiplierFreeAt);
+    if ((name == "DIV" || name == "REM") && !settings.pipelinedDivider) ready = std::max(ready, dividerFreeAt);
+    return ready;
+}
+
+void FunctionalUnits::issue(const std::string& name, uint32_t rd, uint64_t now) {
+    uint32_t cycles = latency(name);
+    // A later write of the register replaces any result still on its way
+    if (rd < 32 && rd != 0) registerReadyAt[rd] = cycles > 1 ? now + cycles : 0;
+    if (name == "MUL") multiplierFreeAt = now + cycles;
+    if (name == "DIV" || name == "REM") dividerFreeAt = now + cycles;
+}
+
+void FunctionalUnits::clear() {
+    std::fill(std::begin(registerReadyAt), std::end(registerReadyAt), 0);
+    multiplierFreeAt = 0;
+    dividerFreeAt = 0;
+}
+
+void FunctionalUnits::dump(JsonWriter& out) const {
+    out.raw("{ \"mul\": ").number(settings.mulLatency)
+        .raw(", \"div\": ").number(settings.divLatency)
+        .raw(", \"rem\": ").number(settings.remLatency)
+        .raw(", \"multiplier\": \"").raw(settings.pipelinedMultiplier ? "pipelined" : "blocking")
+        .raw("\", \"divider\": \"").raw(settings.pipelinedDivider ? "pipelined" : "blocking").raw("\" }");
+}
@@ -0,0 +1,680 @@
+#include "http_server.h"
+#include <algorithm>
+#include <arpa/inet.h>
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace HttpServer {
+
+namespace {
+
+constexpr size_t MAX_HEADER = 64 * 1024;
+constexpr size_t MAX_BODY = 64 * 1024 * 1024;
+constexpr unsigned long MAX_STEPS = 1000;  // states one `step n` message may stream
+
+using Clock = std::chrono::steady_clock;
+
+uint32_t rotl(uint32_t value, int bits) {
+    return (value << bits) | (value >> (32 - bits));
+}
+
+// SHA-1 digest (20 raw bytes), only needed for the WebSocket handshake
+std::string sha1(const std::string& message) {
+    uint32_t h[5] = {0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::string data = message;
+    uint64_t bitLength = static_cast<uint64_t>(message.size()) * 8;
+    data.push_back('\x80');
+    while (data.size() % 64 != 56) {
+        data.push_back('\0');
+    }
+    for (int i = 7; i >= 0; i--) {
+        data.push_back(static_cast<char>(bitLength >> (i * 8)));
+    }
+
+    for (size_t chunk = 0; chunk < data.size(); chunk += 64) {
+        uint32_t w[80];
+        for (int i = 0; i < 16; i++) {
+            const unsigned char* p = reinterpret_cast<const unsigned char*>(data.data()) + chunk + 4 * i;
+            w[i] = (static_cast<uint32_t>(p[0]) << 24) | (p[1] << 16) | (p[2] << 8) | p[3];
+        }
+        for (int i = 16; i < 80; i++) {
+            w[i] = rotl(w[i - 3] ^ w[i - 8] ^ w[i - 14] ^ w[i - 16], 1);
+        }
+        uint32_t a = h[0], b = h[1], c = h[2], d = h[3], e = h[4];
+        for (int i = 0; i < 80; i++) {
+            uint32_t f, k;
+            if (i < 20) { f = (b & c) | (~b & d); k = 0x5A827999; }
+            else if (i < 40) { f = b ^ c ^ d; k = 0x6ED9EBA1; }
+            else if (i < 60) { f = (b & c) | (b & d) | (c & d); k = 0x8F1BBCDC; }
+            else { f = b ^ c ^ d; k = 0xCA62C1D6; }
+            uint32_t t = rotl(a, 5) + f + e + k + w[i];
+            e = d;
+            d = c;
+            c = rotl(b, 30);
+            b = a;
+            a = t;
+        }
+        h[0] += a;
+        h[1] += b;
+        h[2] += c;
+        h[3] += d;
+        h[4] += e;
+    }
+
+    std::string digest;
+    for (uint32_t word : h) {
+        for (int i = 3; i >= 0; i--) {
+            digest.push_back(static_cast<char>(word >> (i * 8)));
+        }
+    }
+    return digest;
+}
+
+std::string base64(const std::string& data) {
+    static const char* alphabet = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+    std::string out;
+    for (size_t i = 0; i < data.size(); i += 3) {
+        uint32_t chunk = static_cast<unsigned char>(data[i]) << 16;
+        if (i + 1 < data.size()) chunk |= static_cast<unsigned char>(data[i + 1]) << 8;
+        if (i + 2 < data.size()) chunk |= static_cast<unsigned char>(data[i + 2]);
+        out.push_back(alphabet[(chunk >> 18) & 63]);
+        out.push_back(alphabet[(chunk >> 12) & 63]);
+        out.push_back(i + 1 < data.size() ? alphabet[(chunk >> 6) & 63] : '=');
+        out.push_back(i + 2 < data.size() ? alphabet[chunk & 63] : '=');
+    }
+    return out;
+}
+
+const char* statusText(int status) {
+    switch (status) {
+    case 200: return "OK";
+    case 204: return "No Content";
+    case 400: return "Bad Request";
+    case 404: return "Not Found";
+    case 413: return "Payload Too Large";
+    case 431: return "Request Header Fields Too Large";
+    case 503: return "Service Unavailable";
+    default: return "Error";
+    }
+}
+
+struct Connection {
+    int fd;
+    std::string in;
+    std::string out;
+    bool websocket = false;
+    bool closing = false;   // close once `out` is written
+    bool writing = false;   // registered for EPOLLOUT
+    std::string sessionId;  // WebSocket connections are bound to one session
+    std::string message;    // fragmented WebSocket message being reassembled
+};
+
+// Commands a network client may send: everything but those reading or writing server files
+bool allowedOverNetwork(const std::string& command) {
+    static const std::unordered_set<std::string> allowed = {
+        "assemble", "edit", "reset", "run", "step", "pipeline", "data_forward", "branch_prediction",
+        "sweep", "trace", "replay", "locality", "profile", "cache", "dram", "prefetch", "latency"};
+    return allowed.count(command.substr(0, command.find(' '))) != 0;
+}
+
+struct HostedSession {
+    std::unique_ptr<Session> session;
+    Clock::time_point lastUsed;
+    unsigned sockets = 0;  // WebSocket connections bound to it, which keep it from eviction
+};
+
+struct HttpRequest {
+    std::string method;
+    std::string path;
+    std::string query;
+    std::unordered_map<std::string, std::string> headers;  // lower-case names
+    std::string body;
+};
+
+class Server {
+    const ServerOptions& server;
+    SessionOptions options;
+    int epollFd = -1;
+    int listenFd = -1;
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    std::unordered_map<std::string, HostedSession> sessions;
+    Clock::time_point lastSweep = Clock::now();
+    JsonWriter json;
+    JsonRequest request;
+    std::mt19937_64 random{std::random_device{}()};
+
+    std::string newSessionId() {
+        std::string id;
+        do {
+            char text[33];
+            snprintf(text, sizeof(text), "%016llx%016llx", static_cast<unsigned long long>(random()),
+                     static_cast<unsigned long long>(random()));
+            id = text;
+        } while (sessions.count(id));
+        return id;
+    }
+
+    Session* findSession(const std::string& id) {
+        auto it = sessions.find(id);
+        if (it == sessions.end()) return nullptr;
+        it->second.lastUsed = Clock::now();
+        return it->second.session.get();
+    }
+
+    // Drops the sessions idle for longer than idleSeconds that no WebSocket holds
+    void evictIdle() {
+        auto now = Clock::now();
+        for (auto it = sessions.begin(); it != sessions.end();) {
+            if (!it->second.sockets && now - it->second.lastUsed >= std::chrono::seconds(server.idleSeconds)) {
+                it = sessions.erase(it);
+            } else {
+                ++it;
+            }
+        }
+        lastSweep = now;
+    }
+
+    // A new session under a fresh id, nullptr when maxSessions are all held by WebSockets
+    Session* createSession(std::string& id) {
+        if (sessions.size() >= server.maxSessions) {
+            evictIdle();
+        }
+        if (sessions.size() >= server.maxSessions) {
+            auto oldest = sessions.end();
+            for (auto it = sessions.begin(); it != sessions.end(); ++it) {
+                if (!it->second.sockets && (oldest == sessions.end() || it->second.lastUsed < oldest->second.lastUsed)) {
+                    oldest = it;
+                }
+            }
+            if (oldest == sessions.end()) return nullptr;
+            sessions.erase(oldest);
+        }
+        id = newSessionId();
+        HostedSession& hosted = sessions[id];
+        hosted.session = std::make_unique<Session>(options);
+        hosted.lastUsed = Clock::now();
+        return hosted.session.get();
+    }
+
+    void respond(Connection& connection, int status, const std::string& body, const std::string& extraHeaders = "") {
+        std::string& out = connection.out;
+        out.append("HTTP/1.1 ").append(std::to_string(status)).append(" ").append(statusText(status)).append("\r\n");
+        out.append("Content-Type: application/json\r\nAccess-Control-Allow-Origin: *\r\n");
+        out.append(extraHeaders);
+        if (connection.closing) {
+            out.append("Connection: close\r\n");
+        }
+        out.append("Content-Length: ").append(std::to_string(body.size())).append("\r\n\r\n").append(body);
+    }
+
+    void respondError(Connection& connection, int status, const std::string& message) {
+        json.clear();
+        json.raw("{ \"error\": ").string(message).raw(" }");
+        respond(connection, status, json.str());
+        json.clear();
+    }
+
+    void sendFrame(Connection& connection, uint8_t opcode, const char* data, size_t size) {
+        std::string& out = connection.out;
+        out.push_back(static_cast<char>(0x80 | opcode));
+        if (size < 126) {
+            out.push_back(static_cast<char>(size));
+        } else if (size < 65536) {
+            out.push_back(126);
+            out.push_back(static_cast<char>(size >> 8));
+            out.push_back(static_cast<char>(size));
+        } else {
+            out.push_back(127);
+            for (int i = 7; i >= 0; i--) {
+                out.push_back(static_cast<char>(static_cast<uint64_t>(size) >> (i * 8)));
+            }
+        }
+        out.append(data, size);
+    }
+
+    void sendJson(Connection& connection) {
+        sendFrame(connection, 1, json.str().data(), json.str().size());
+        json.clear();
+    }
+
+    void sendError(Connection& connection, const std::string& message) {
+        json.clear();
+        json.raw("{ \"error\": ").string(message).raw(" }");
+        sendJson(connection);
+    }
+
+    // Splits the header block, returns false while the request is incomplete
+    bool parseRequest(Connection& connection, HttpRequest& http) {
+        size_t headerEnd = connection.in.find("\r\n\r\n");
+        if (headerEnd == std::string::npos) {
+            if (connection.in.size() > MAX_HEADER) {
+                connection.closing = true;
+                respondError(connection, 431, "Request header too large");
+            }
+            return false;
+        }
+
+        std::istringstream lines(connection.in.substr(0, headerEnd));
+        std::string line, target, version;
+        std::getline(lines, line);
+        std::istringstream requestLine(line);
+        requestLine >> http.method >> target >> version;
+        size_t question = target.find('?');
+        http.path = target.substr(0, question);
+        http.query = question != std::string::npos ? target.substr(question + 1) : "";
+        while (std::getline(lines, line)) {
+            size_t colon = line.find(':');
+            if (colon == std::string::npos) continue;
+            std::string name = line.substr(0, colon);
+            for (char& c : name) c = static_cast<char>(tolower(static_cast<unsigned char>(c)));
+            size_t start = line.find_first_not_of(" \t", colon + 1);
+            size_t end = line.find_last_not_of(" \t\r");
+            http.headers[name] = start == std::string::npos ? "" : line.substr(start, end - start + 1);
+        }
+
+        size_t length = 0;
+        auto contentLength = http.headers.find("content-length");
+        if (contentLength != http.headers.end()) {
+            length = std::strtoull(contentLength->second.c_str(), nullptr, 10);
+        }
+        if (length > MAX_BODY) {
+            connection.closing = true;
+            respondError(connection, 413, "Request body too large");
+            return false;
+        }
+        if (connection.in.size() < headerEnd + 4 + length) {
+            return false;
+        }
+        http.body = connection.in.substr(headerEnd + 4, length);
+        connection.in.erase(0, headerEnd + 4 + length);
+
+        auto connectionHeader = http.headers.find("connection");
+        if (version == "HTTP/1.0" ||
+            (connectionHeader != http.headers.end() && connectionHeader->second.find("close") != std::string::npos)) {
+            connection.closing = true;
+        }
+        return true;
+    }
+
+    std::string queryValue(const std::string& query, const std::string& key) {
+        std::istringstream pairs(query);
+        std::string pair;
+        while (std::getline(pairs, pair, '&')) {
+            if (pair.rfind(key + "=", 0) == 0) {
+                return pair.substr(key.size() + 1);
+            }
+        }
+        return "";
+    }
+
+    void upgrade(Connection& connection, const HttpRequest& http) {
+        auto key = http.headers.find("sec-websocket-key");
+        if (key == http.headers.end()) {
+            respondError(connection, 400, "Expected a WebSocket upgrade");
+            return;
+        }
+        std::string id = queryValue(http.query, "id");
+        if (!findSession(id) && !createSession(id)) {
+            respondError(connection, 503, "Too many sessions");
+            return;
+        }
+        sessions[id].sockets++;
+        connection.websocket = true;
+        connection.sessionId = id;
+        connection.out.append("HTTP/1.1 101 Switching Protocols\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+                              "Sec-WebSocket-Accept: ")
+            .append(base64(sha1(key->second + "258EAFA5-E914-47DA-95CA-C5AB0DC11B65")))
+            .append("\r\n\r\n");
+        json.raw("{ \"id\": ").string(id).raw(" }");
+        sendJson(connection);
+    }
+
+    void route(Connection& connection, HttpRequest& http) {
+        if (http.method == "OPTIONS") {
+            respond(connection, 204, "",
+                    "Access-Control-Allow-Methods: GET, POST, OPTIONS\r\nAccess-Control-Allow-Headers: Content-Type\r\n");
+            return;
+        }
+        if (http.method == "GET" && http.path == "/ws") {
+            upgrade(connection, http);
+            return;
+        }
+
+        std::string command;
+        if (http.path == "/assemble") command = "assemble";
+        else if (http.path == "/step") command = "step";
+        else if (http.path == "/run") command = "run";
+        else if (http.path == "/pipeline") command = "pipeline";
+        else if (http.path == "/data_forward" || http.path == "/dataForward") command = "data_forward";
+        else if (http.path == "/branch_prediction" || http.path == "/branchPrediction") command = "branch_prediction";
+        if (command.empty() || http.method != "POST") {
+            respondError(connection, 404, "Not found");
+            return;
+        }
+
+        try {
+            std::istringstream body(http.body.empty() ? "{}" : http.body);
+            request.read(body);
+            std::string id = request.hasString("id") ? request.getString("id") : "";
+            Session* session = findSession(id);
+            json.clear();
+
+            if (command == "assemble") {
+                if (!session && !(session = createSession(id))) {
+                    respondError(connection, 503, "Too many sessions");
+                    return;
+                }
+                session->assembleAndOutput(request.getString("code"), json);
+                json.reopen().raw(", \"id\": ").string(id).raw(" }");
+            } else if (!session) {
+                respondError(connection, 400, "Cannot " + command + ", you need to assemble first");
+                return;
+            } else if (command == "step") {
+                // server.js also reported the latches in lower case
+                session->stepAndOutput(json);
+                json.reopen().raw(", \"ra\": ").number(session->cpu.RA).raw(", \"rb\": ").number(session->cpu.RB)
+                    .raw(", \"ry\": ").number(session->cpu.RY).raw(", \"rz\": ").number(session->cpu.RZ)
+                    .raw(", \"rm\": ").number(session->cpu.RM).raw(" }");
+            } else if (command == "run") {
+                session->execute(command, request, json);
+                if (session->cpu.finished()) {
+                    json.reopen().raw(", \"comment\": \"Finished\" }");
+                }
+            } else {
+                session->execute(command, request, json);
+            }
+            respond(connection, 200, json.str());
+            json.clear();
+        } catch (const std::exception& e) {
+            respondError(connection, 400, e.what());
+        }
+    }
+
+    // Runs one WebSocket message against the connection's session
+    void handleMessage(Connection& connection, const std::string& message) {
+        Session* session = findSession(connection.sessionId);
+        size_t newline = message.find('\n');
+        std::string command = message.substr(0, newline);
+        while (!command.empty() && (command.back() == '\r' || command.back() == ' ')) {
+            command.pop_back();
+        }
+
+        try {
+            json.clear();
+            if (!allowedOverNetwork(command)) {
+                sendError(connection, "Not available over the network: " + command.substr(0, command.find(' ')));
+                return;
+            }
+            if (command == "step" || command.rfind("step ", 0) == 0) {
+                // Bounded like a run, since the loop serves nobody else meanwhile
+                unsigned long count = command.size() > 5 ? std::min(std::stoul(command.substr(5)), MAX_STEPS) : 1;
+                auto deadline = Clock::now() + std::chrono::milliseconds(options.runMilliseconds);
+                for (unsigned long i = 0; i < count; i++) {
+                    bool exited = session->stepAndOutput(json);
+                    sendJson(connection);
+                    flush(connection);
+                    if (exited || Clock::now() >= deadline) {
+                        break;
+                    }
+                }
+                return;
+            }
+            if (Session::needsPayload(command)) {
+                std::istringstream payload(newline != std::string::npos ? message.substr(newline + 1) : "");
+                request.read(payload);
+            }
+            if (!session->execute(command, request, json)) {
+                sendError(connection, "Invalid command");
+                return;
+            }
+            sendJson(connection);
+        } catch (const std::exception& e) {
+            sendError(connection, e.what());
+        }
+    }
+
+    // Decodes client frames (always masked), returns false while a frame is incomplete
+    bool parseFrame(Connection& connection) {
+        const std::string& in = connection.in;
+        if (in.size() < 2) return false;
+        uint8_t first = in[0], second = in[1];
+        bool fin = first & 0x80;
+        uint8_t opcode = first & 0x0F;
+        uint64_t length = second & 0x7F;
+        size_t offset = 2;
+        if (length == 126) {
+            if (in.size() < 4) return false;
+            length = (static_cast<uint8_t>(in[2]) << 8) | static_cast<uint8_t>(in[3]);
+            offset = 4;
+        } else if (length == 127) {
+            if (in.size() < 10) return false;
+            length = 0;
+            for (int i = 0; i < 8; i++) {
+                length = (length << 8) | static_cast<uint8_t>(in[2 + i]);
+            }
+            offset = 10;
+        }
+        if (!(second & 0x80) || length > MAX_BODY) {
+            // Unmasked or oversized frames are protocol errors
+            closeWithError(connection, 1002);
+            return false;
+        }
+        if (in.size() < offset + 4 + length) return false;
+
+        const char* mask = in.data() + offset;
+        std::string payload = in.substr(offset + 4, length);
+        for (size_t i = 0; i < payload.size(); i++) {
+            payload[i] ^= mask[i % 4];
+        }
+        connection.in.erase(0, offset + 4 + length);
+
+        switch (opcode) {
+        case 0:  // continuation
+        case 1:  // text
+        case 2:  // binary, treated as text
+            if (opcode != 0) connection.message.clear();
+            if (connection.message.size() + payload.size() > MAX_BODY) {
+                // Continuations must not grow a message past the limit of a single frame
+                closeWithError(connection, 1009);
+                return false;
+            }
+            connection.message += payload;
+            if (fin) {
+                std::string message = std::move(connection.message);
+                connection.message.clear();
+                handleMessage(connection, message);
+            }
+            break;
+        case 8:
+            sendFrame(connection, 8, payload.data(), std::min<size_t>(payload.size(), 2));
+            connection.closing = true;
+            break;
+        case 9:
+            sendFrame(connection, 10, payload.data(), payload.size());
+            break;
+        default:
+            break;
+        }
+        return true;
+    }
+
+    // Sends a close frame with `code` and drops whatever the client sends after it
+    void closeWithError(Connection& connection, uint16_t code) {
+        const char payload[2] = {static_cast<char>(code >> 8), static_cast<char>(code & 0xFF)};
+        sendFrame(connection, 8, payload, 2);
+        connection.closing = true;
+        connection.in.clear();
+        connection.message.clear();
+    }
+
+    void setWriting(Connection& connection, bool writing) {
+        if (connection.writing == writing) return;
+        epoll_event event{};
+        event.events = EPOLLIN | (writing ? EPOLLOUT : 0u);
+        event.data.fd = connection.fd;
+        epoll_ctl(epollFd, EPOLL_CTL_MOD, connection.fd, &event);
+        connection.writing = writing;
+    }
+
+    // Writes as much as the socket takes, the rest waits for EPOLLOUT
+    void flush(Connection& connection) {
+        size_t written = 0;
+        while (written < connection.out.size()) {
+            ssize_t n = send(connection.fd, connection.out.data() + written, connection.out.size() - written, MSG_NOSIGNAL);
+            if (n > 0) {
+                written += n;
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                if (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK) {
+                    connection.out.clear();
+                    connection.closing = true;
+                    written = 0;
+                }
+                break;
+            }
+        }
+        connection.out.erase(0, written);
+        setWriting(connection, !connection.out.empty());
+    }
+
+    void close(int fd) {
+        auto it = connections.find(fd);
+        if (it != connections.end() && it->second->websocket) {
+            HostedSession& hosted = sessions[it->second->sessionId];
+            hosted.sockets--;
+            hosted.lastUsed = Clock::now();
+        }
+        epoll_ctl(epollFd, EPOLL_CTL_DEL, fd, nullptr);
+        ::close(fd);
+        connections.erase(fd);
+    }
+
+    void accept() {
+        while (true) {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0) {
+                return;
+            }
+            int one = 1;
+            setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+            epoll_event event{};
+            event.events = EPOLLIN;
+            event.data.fd = fd;
+            epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event);
+            auto connection = std::make_unique<Connection>();
+            connection->fd = fd;
+            connections[fd] = std::move(connection);
+        }
+    }
+
+    void readable(Connection& connection) {
+        char buffer[64 * 1024];
+        bool peerClosed = false;
+        while (true) {
+            ssize_t n = recv(connection.fd, buffer, sizeof(buffer), 0);
+            if (n > 0) {
+                connection.in.append(buffer, n);
+            } else if (n < 0 && errno == EINTR) {
+                continue;
+            } else {
+                peerClosed = n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK);
+                break;
+            }
+        }
+
+        while (!connection.closing) {
+            if (connection.websocket) {
+                if (!parseFrame(connection)) break;
+            } else {
+                HttpRequest http;
+                if (!parseRequest(connection, http)) break;
+                route(connection, http);
+            }
+        }
+        if (peerClosed) {
+            connection.closing = true;
+        }
+    }
+
+public:
+    Server(const ServerOptions& server, const SessionOptions& sessionOptions) : server(server), options(sessionOptions) {
+        // Runs block the loop, so none may go unbounded or outlast the default
+        if (!options.runMilliseconds) options.runMilliseconds = RUN_MILLISECONDS;
+        options.maxRunMilliseconds = options.runMilliseconds;
+    }
+
+    void run() {
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(server.port);
+        if (inet_pton(AF_INET, server.host.c_str(), &address.sin_addr) != 1) {
+            throw std::runtime_error("Invalid listen address: " + server.host);
+        }
+        listenFd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        int one = 1;
+        setsockopt(listenFd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+        if (bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0 || listen(listenFd, 128) < 0) {
+            throw std::runtime_error("Cannot listen on " + server.host + ":" + std::to_string(server.port) + ": " + strerror(errno));
+        }
+        socklen_t size = sizeof(address);
+        getsockname(listenFd, reinterpret_cast<sockaddr*>(&address), &size);
+        json.raw("{ \"http\": ").number(ntohs(address.sin_port)).raw(" }");
+        json.flush(std::cout);
+
+        epollFd = epoll_create1(EPOLL_CLOEXEC);
+        epoll_event event{};
+        event.events = EPOLLIN;
+        event.data.fd = listenFd;
+        epoll_ctl(epollFd, EPOLL_CTL_ADD, listenFd, &event);
+
+        // Wakes often enough to drop idle sessions within half their timeout
+        auto sweepInterval = std::chrono::milliseconds(std::max<uint64_t>(server.idleSeconds * 500, 100));
+        epoll_event events[256];
+        while (true) {
+            int count = epoll_wait(epollFd, events, 256, static_cast<int>(std::min<int64_t>(sweepInterval.count(), 60000)));
+            if (Clock::now() - lastSweep >= sweepInterval) {
+                evictIdle();
+            }
+            for (int i = 0; i < count; i++) {
+                int fd = events[i].data.fd;
+                if (fd == listenFd) {
+                    accept();
+                    continue;
+                }
+                auto it = connections.find(fd);
+                if (it == connections.end()) continue;
+                Connection& connection = *it->second;
+                if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+                    readable(connection);
+                }
+                flush(connection);
+                if (connection.closing && connection.out.empty()) {
+                    close(fd);
+                }
+            }
+        }
+    }
+};
+
+}
+
+void serve(const ServerOptions& server, const SessionOptions& options) {
+    Server(server, options).run();
+}
+
+}
@@ -117,13 +117,15 @@ void validateJumpOffset(int32_t offset, const std::string &inst)
 
 std::unique_ptr<Instruction> InstructionFactory::create(const std::string &inst,
                                                         const std::vector<std::string> &operands, // rd rs1 rs2 (left to right)
+                                                        const std::vector<uint32_t> &operandSymbols,
                                                         const SymbolTable &symbols,
                                                         uint32_t address)
 {
 
     // Tp check if a string is likely a register name
-    auto isLikelyRegister = [&symbols](const std::string &op) -> bool
+    auto isLikelyRegister = [&](size_t index) -> bool
     {
+        const std::string &op = operands[index];
         // checking multiple conditions to determine if it's a register
         if (op.empty())
             return false;
@@ -133,7 +135,9 @@ std::unique_ptr<Instruction> InstructionFactory::create(const std::string &inst,
             return false;
         if (op.size() >= 2 && op.substr(0, 2) == "0x")
             return false;
-        if (symbols.labelExists(op))
+        if (symbols.isDefined(operandSymbols[index]))
+            return false;
+        if (RISCV_CONSTANTS::CSRS.count(op))
             return false;
         if (op[0] == 'x' || op[0] == 'a' || op[0] == 't' || op[0] == 's' ||
             op == "ra" || op == "sp" || op == "gp" || op == "tp" || op == "fp" || op == "zero")
@@ -144,9 +148,10 @@ std::unique_ptr<Instruction> InstructionFactory::create(const std::string &inst,
     };
 
     // Validate registers before processing any instruction
-    for (const auto &operand : operands)
+    for (size_t i = 0; i < operands.size(); i++)
     {
-        if (isLikelyRegister(operand))
+        const std::string &operand = operands[i];
+        if (isLikelyRegister(i))
         {
             // Check if it's in the register map
             if (RISCV_CONSTANTS::REGISTERS.find(operand) == RISCV_CONSTANTS::REGISTERS.end())
@@ -157,18 +162,63 @@ std::unique_ptr<Instruction> InstructionFactory::create(const std::string &inst,
         }
     }
 
+    // PC-relative offset of a branch or jump target, either a label or an immediate
+    auto targetOffset = [&](size_t index) -> int32_t
+    {
+        uint32_t symbol = operandSymbols[index];
+        if (symbol == SymbolTable::NO_SYMBOL && operands[index][0] >= '0' && operands[index][0] <= '9')
+        {
+            // if immediate value given directly
+            return std::stoi(operands[index], nullptr, 0);
+        }
+        // if label given
+        if (!symbols.isDefined(symbol))
+        {
+            throw std::runtime_error("Label " + operands[index] + " not found");
+        }
+        return symbols.getAddress(symbol) - address;
+    };
+
+    // CSR operand, by name or number
+    auto csrOperand = [&](size_t index) -> int32_t
+    {
+        auto named = RISCV_CONSTANTS::CSRS.find(operands[index]);
+        if (named != RISCV_CONSTANTS::CSRS.end())
+        {
+            return named->second;
+        }
+        int32_t csr;
+        try
+        {
+            csr = std::stoi(operands[index], nullptr, 0);
+        }
+        catch (const std::exception &)
+        {
+            throw std::runtime_error("Unknown CSR '" + operands[index] + "' in instruction: '" + inst + "'");
+        }
+        if (csr < 0 || csr > 0xFFF)
+        {
+            throw std::out_of_range("CSR number " + operands[index] + " for instruction '" + inst + "' exceeds 12 bits");
+        }
+        return csr;
+    };
+    auto csrInstruction = [&](uint32_t funct3, int32_t csr, const std::string &rs1, const std::string &rd)
+    {
+        return std::make_unique<IInstruction>(csr,
+                                              RISCV_CONSTANTS::REGISTERS.at(rs1),
+                                              funct3,
+                                              RISCV_CONSTANTS::REGISTERS.at(rd),
+                                              RISCV_CONSTANTS::OPCODE_I_TYPE_CSR, "");
+    };
+
     // Get instruction info with attributes
     InstructionInfo info = instruction_map(inst);
 
-    // Validate operand count
-    try {
-        if (operands.size() != info.operandCount) {
-            throw std::runtime_error("Incorrect number of operands for '" + inst +
-                                     "'. Expected " + std::to_string(info.operandCount) +
-                                     ", got " + std::to_string(operands.size()));
-        }
-    } catch (const std::runtime_error& e) {
-        std::cerr << "Error: " << e.what() << std::endl;
+    // Validate operand count, the encoders below index the operands directly
+    if (operands.size() != info.operandCount) {
+        throw std::runtime_error("Incorrect number of operands for '" + inst +
+                                 "'. Expected " + std::to_string(info.operandCount) +
+                                 ", got " + std::to_string(operands.size()));
     }
     
     switch (info.opcode)
@@ -401,24 +451,7 @@ std::unique_ptr<Instruction> InstructionFactory::create(const std::string &inst,
     case RISCV_CONSTANTS::INSTRUCTIONS::BEQ:
     {
         // Calculate branch offset relative to current address
-        int32_t offset;
-        if (operands[2][0] >= '0' && operands[2][0] <= '9')
-        {
-            // if immediate value given directly
-            offset = std::stoi(operands[2], nullptr, 0);
-        }
-        else
-        {
-            // if label given
-            try
-            {
-                offset = symbols.getAddress(operands[2]) - address;
-            }
-            catch (const std::exception &e)
-            {
-                throw std::runtime_error("Label " + operands[2] + " not found");
-            }
-        }
+        int32_t offset = targetOffset(2);
 
         // Validate branch offset
         validateBranchOffset(offset, "beq");
@@ -432,22 +465,7 @@ std::unique_ptr<Instruction> InstructionFactory::create(const std::string &inst,
 
     case RISCV_CONSTANTS::INSTRUCTIONS::BNE:
     {
-        int32_t offset;
-        if (operands[2][0] >= '0' && operands[2][0] <= '9')
-        {
-            offset = std::stoi(operands[2], nullptr, 0);
-        }
-        else
-        {
-            try
-            {
-                offset = symbols.getAddress(operands[2]) - address;
-            }
-            catch (const std::exception &e)
-            {
-                throw std::runtime_error("Label " + operands[2] + " not found");
-            }
-        }
+        int32_t offset = targetOffset(2);
 
         // Validate branch offset
         validateBranchOffset(offset, "bne");
@@ -461,22 +479,7 @@ std::unique_ptr<Instruction> InstructionFactory::create(const std::string &inst,
 
     case RISCV_CONSTANTS::INSTRUCTIONS::BLT:
     {
-        int32_t offset;
-        if (operands[2][0] >= '0' && operands[2][0] <= '9')
-        {
-            offset = std::stoi(operands[2], nullptr, 0);
-        }
-        else
-        {
-            try
-            {
-                offset = symbols.getAddress(operands[2]) - address;
-            }
-            catch (const std::exception &e)
-            {
-                throw std::runtime_error("Label " + operands[2] + " not found");
-            }
-        }
+        int32_t offset = targetOffset(2);
 
         // Validate branch offset
         validateBranchOffset(offset, "blt");
@@ -491,22 +494,7 @@ std::unique_ptr<Instruction> InstructionFactory::create(const std::string &inst,
 
     case RISCV_CONSTANTS::INSTRUCTIONS::BGE:
     {
-        int32_t offset;
-        if (operands[2][0] >= '0' && operands[2][0] <= '9')
-        {
-            offset = std::stoi(operands[2], nullptr, 0);
-        }
-        else
-        {
-            try
-            {
-                offset = symbols.getAddress(operands[2]) - address;
-            }
-            catch (const std::exception &e)
-            {
-                throw std::runtime_error("Label " + operands[2] + " not found");
-            }
-        }
+        int32_t offset = targetOffset(2);
 
         // Validate branch offset
         validateBranchOffset(offset, "bge");
@@ -548,24 +536,7 @@ std::unique_ptr<Instruction> InstructionFactory::create(const std::string &inst,
         // UJ-Type instruction (JAL) with range checking
     case RISCV_CONSTANTS::INSTRUCTIONS::JAL:
     {
-        int32_t offset;
-        if (operands[1][0] >= '0' && operands[1][0] <= '9')
-        {
-            // if immediate value given directly
-            offset = std::stoi(operands[1], nullptr, 0);
-        }
-        else
-        {
-            // if label given
-            try
-            {
-                offset = symbols.getAddress(operands[1]) - address;
-            }
-            catch (const std::exception &e)
-            {
-                throw std::runtime_error("Label " + operands[1] + " not found");
-            }
-        }
+        int32_t offset = targetOffset(1);
 
         // Validate jump offset
         validateJumpOffset(offset, "jal");
@@ -575,6 +546,31 @@ std::unique_ptr<Instruction> InstructionFactory::create(const std::string &inst,
                                                RISCV_CONSTANTS::OPCODE_UJ_TYPE_JAL, "");
     }
 
+    // Zicsr instructions: csrrw/csrrs/csrrc rd, csr, rs1 and their pseudo instructions
+    case RISCV_CONSTANTS::INSTRUCTIONS::CSRRW:
+        return csrInstruction(RISCV_CONSTANTS::FUNCT3_CSRRW, csrOperand(1), operands[2], operands[0]);
+
+    case RISCV_CONSTANTS::INSTRUCTIONS::CSRRS:
+        return csrInstruction(RISCV_CONSTANTS::FUNCT3_CSRRS, csrOperand(1), operands[2], operands[0]);
+
+    case RISCV_CONSTANTS::INSTRUCTIONS::CSRRC:
+        return csrInstruction(RISCV_CONSTANTS::FUNCT3_CSRRC, csrOperand(1), operands[2], operands[0]);
+
+    case RISCV_CONSTANTS::INSTRUCTIONS::CSRR:
+        return csrInstruction(RISCV_CONSTANTS::FUNCT3_CSRRS, csrOperand(1), "x0", operands[0]);
+
+    case RISCV_CONSTANTS::INSTRUCTIONS::CSRW:
+        return csrInstruction(RISCV_CONSTANTS::FUNCT3_CSRRW, csrOperand(0), operands[1], "x0");
+
+    case RISCV_CONSTANTS::INSTRUCTIONS::RDCYCLE:
+        return csrInstruction(RISCV_CONSTANTS::FUNCT3_CSRRS, RISCV_CONSTANTS::CSR_CYCLE, "x0", operands[0]);
+
+    case RISCV_CONSTANTS::INSTRUCTIONS::RDTIME:
+        return csrInstruction(RISCV_CONSTANTS::FUNCT3_CSRRS, RISCV_CONSTANTS::CSR_TIME, "x0", operands[0]);
+
+    case RISCV_CONSTANTS::INSTRUCTIONS::RDINSTRET:
+        return csrInstruction(RISCV_CONSTANTS::FUNCT3_CSRRS, RISCV_CONSTANTS::CSR_INSTRET, "x0", operands[0]);
+
     default:
         throw std::invalid_argument("Unsupported instruction: " + inst);
     }
@@ -614,7 +610,15 @@ static InstructionInfo instruction_map(const std::string &inst)
         {"jalr", {RISCV_CONSTANTS::INSTRUCTIONS::JALR, 2}},
         {"lui", {RISCV_CONSTANTS::INSTRUCTIONS::LUI, 2}},
         {"auipc", {RISCV_CONSTANTS::INSTRUCTIONS::AUIPC, 2}},
-        {"jal", {RISCV_CONSTANTS::INSTRUCTIONS::JAL, 2}}};
+        {"jal", {RISCV_CONSTANTS::INSTRUCTIONS::JAL, 2}},
+        {"csrrw", {RISCV_CONSTANTS::INSTRUCTIONS::CSRRW, 3}},
+        {"csrrs", {RISCV_CONSTANTS::INSTRUCTIONS::CSRRS, 3}},
+        {"csrrc", {RISCV_CONSTANTS::INSTRUCTIONS::CSRRC, 3}},
+        {"csrr", {RISCV_CONSTANTS::INSTRUCTIONS::CSRR, 2}},
+        {"csrw", {RISCV_CONSTANTS::INSTRUCTIONS::CSRW, 2}},
+        {"rdcycle", {RISCV_CONSTANTS::INSTRUCTIONS::RDCYCLE, 1}},
+        {"rdtime", {RISCV_CONSTANTS::INSTRUCTIONS::RDTIME, 1}},
+        {"rdinstret", {RISCV_CONSTANTS::INSTRUCTIONS::RDINSTRET, 1}}};
     auto it = instruction_lookup.find(inst);
     if (it != instruction_lookup.end())
     {
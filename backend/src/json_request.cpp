@@ -0,0 +1,243 @@
+#include "json_request.h"
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+
+namespace {
+
+bool isBlank(int c) {
+    return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+}
+
+}
+
+int JsonRequest::next() {
+    int c = source->sbumpc();
+    if (c == std::char_traits<char>::eof()) {
+        throw std::runtime_error("Unexpected end of JSON input");
+    }
+    last = c;
+    return c;
+}
+
+int JsonRequest::peek() {
+    int c = source->sgetc();
+    if (c == std::char_traits<char>::eof()) {
+        throw std::runtime_error("Unexpected end of JSON input");
+    }
+    return c;
+}
+
+int JsonRequest::skipWhitespace() {
+    int c = peek();
+    while (isBlank(c)) {
+        next();
+        c = peek();
+    }
+    return c;
+}
+
+void JsonRequest::expect(char c) {
+    if (skipWhitespace() != c) {
+        throw std::runtime_error(std::string("Invalid JSON: expected '") + c + "'");
+    }
+    next();
+}
+
+uint32_t JsonRequest::parseHex4() {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) {
+        int c = next();
+        value <<= 4;
+        if (c >= '0' && c <= '9') value |= c - '0';
+        else if (c >= 'a' && c <= 'f') value |= c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value |= c - 'A' + 10;
+        else throw std::runtime_error("Invalid JSON: bad \\u escape");
+    }
+    return value;
+}
+
+void JsonRequest::appendUtf8(std::string& out, uint32_t codePoint) {
+    if (codePoint < 0x80) {
+        out.push_back(static_cast<char>(codePoint));
+    } else if (codePoint < 0x800) {
+        out.push_back(static_cast<char>(0xC0 | (codePoint >> 6)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else if (codePoint < 0x10000) {
+        out.push_back(static_cast<char>(0xE0 | (codePoint >> 12)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    } else {
+        out.push_back(static_cast<char>(0xF0 | (codePoint >> 18)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 12) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | ((codePoint >> 6) & 0x3F)));
+        out.push_back(static_cast<char>(0x80 | (codePoint & 0x3F)));
+    }
+}
+
+// Decodes a string whose opening quote has already been consumed
+void JsonRequest::parseString(std::string& out) {
+    out.clear();
+    while (true) {
+        int c = next();
+        if (c == '"') {
+            return;
+        }
+        if (c == '\n') {
+            throw std::runtime_error("Invalid JSON: unescaped line break in string");
+        }
+        if (c != '\\') {
+            out.push_back(static_cast<char>(c));
+            continue;
+        }
+        switch (next()) {
+        case '"': out.push_back('"'); break;
+        case '\\': out.push_back('\\'); break;
+        case '/': out.push_back('/'); break;
+        case 'b': out.push_back('\b'); break;
+        case 'f': out.push_back('\f'); break;
+        case 'n': out.push_back('\n'); break;
+        case 'r': out.push_back('\r'); break;
+        case 't': out.push_back('\t'); break;
+        case 'u': {
+            uint32_t codePoint = parseHex4();
+            if (codePoint >= 0xD800 && codePoint < 0xDC00) {
+                if (next() != '\\' || next() != 'u') {
+                    throw std::runtime_error("Invalid JSON: unpaired surrogate");
+                }
+                uint32_t low = parseHex4();
+                if (low < 0xDC00 || low >= 0xE000) {
+                    throw std::runtime_error("Invalid JSON: unpaired surrogate");
+                }
+                codePoint = 0x10000 + ((codePoint - 0xD800) << 10) + (low - 0xDC00);
+            } else if (codePoint >= 0xDC00 && codePoint < 0xE000) {
+                throw std::runtime_error("Invalid JSON: unpaired surrogate");
+            }
+            appendUtf8(out, codePoint);
+            break;
+        }
+        default:
+            throw std::runtime_error("Invalid JSON: bad escape sequence");
+        }
+    }
+}
+
+// Numbers, true, false and null are kept as their literal text
+void JsonRequest::parseLiteral(std::string& out) {
+    out.clear();
+    int c = peek();
+    while (!isBlank(c) && c != ',' && c != '}' && c != ']') {
+        out.push_back(static_cast<char>(next()));
+        c = peek();
+    }
+    if (out.empty()) {
+        throw std::runtime_error("Invalid JSON: missing value");
+    }
+}
+
+// Skips an object or array whose opening bracket has already been consumed
+void JsonRequest::skipNested() {
+    std::string ignored;
+    int depth = 1;
+    while (depth > 0) {
+        int c = next();
+        if (c == '"') parseString(ignored);
+        else if (c == '{' || c == '[') depth++;
+        else if (c == '}' || c == ']') depth--;
+    }
+}
+
+void JsonRequest::parseObject() {
+    expect('{');
+    if (skipWhitespace() == '}') {
+        next();
+        return;
+    }
+    while (true) {
+        expect('"');
+        if (fieldCount == fields.size()) {
+            fields.emplace_back();
+        }
+        Field& field = fields[fieldCount++];
+        parseString(field.key);
+        expect(':');
+
+        int c = skipWhitespace();
+        field.isString = c == '"';
+        if (c == '"') {
+            next();
+            parseString(field.value);
+        } else if (c == '{' || c == '[') {
+            next();
+            skipNested();
+            field.value.clear();
+        } else {
+            parseLiteral(field.value);
+        }
+
+        c = skipWhitespace();
+        next();
+        if (c == '}') {
+            return;
+        }
+        if (c != ',') {
+            throw std::runtime_error("Invalid JSON: expected ',' or '}'");
+        }
+    }
+}
+
+void JsonRequest::read(std::istream& in) {
+    source = in.rdbuf();
+    fieldCount = 0;
+    last = 0;
+    try {
+        parseObject();
+    } catch (const std::runtime_error&) {
+        if (last != '\n') {
+            in.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+        }
+        throw;
+    }
+
+    // Consume the rest of the line so the next command starts cleanly
+    int c = source->sgetc();
+    while (c == ' ' || c == '\t' || c == '\r') {
+        source->sbumpc();
+        c = source->sgetc();
+    }
+    if (c == '\n') {
+        source->sbumpc();
+    }
+}
+
+const JsonRequest::Field* JsonRequest::find(const std::string& key) const {
+    // Later duplicates win
+    for (size_t i = fieldCount; i-- > 0;) {
+        if (fields[i].key == key) {
+            return &fields[i];
+        }
+    }
+    return nullptr;
+}
+
+bool JsonRequest::hasString(const std::string& key) const {
+    const Field* field = find(key);
+    return field && field->isString;
+}
+
+const std::string& JsonRequest::getString(const std::string& key) const {
+    const Field* field = find(key);
+    if (!field || !field->isString) {
+        throw std::runtime_error("Missing string \"" + key + "\" in request");
+    }
+    return field->value;
+}
+
+size_t JsonRequest::getNumber(const std::string& key) const {
+    const Field* field = find(key);
+    if (!field || field->isString || field->value.empty() ||
+        field->value.find_first_not_of("0123456789") != std::string::npos) {
+        throw std::runtime_error("Missing non-negative integer \"" + key + "\" in request");
+    }
+    return std::stoul(field->value);
+}
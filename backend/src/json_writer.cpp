@@ -0,0 +1,65 @@
+#include "json_writer.h"
+
+namespace {
+
+// Two lowercase hex digits for every byte value
+struct HexTable {
+    char digits[256][2];
+
+    constexpr HexTable() : digits() {
+        const char* hex = "0123456789abcdef";
+        for (int i = 0; i < 256; i++) {
+            digits[i][0] = hex[i >> 4];
+            digits[i][1] = hex[i & 0xF];
+        }
+    }
+};
+
+constexpr HexTable HEX_TABLE;
+
+}
+
+JsonWriter& JsonWriter::hex(uint32_t value) {
+    char text[10] = {'0', 'x'};
+    for (int i = 0; i < 4; i++) {
+        const char* pair = HEX_TABLE.digits[(value >> (24 - 8 * i)) & 0xFF];
+        text[2 + 2 * i] = pair[0];
+        text[3 + 2 * i] = pair[1];
+    }
+    buffer.append(text, sizeof(text));
+    return *this;
+}
+
+JsonWriter& JsonWriter::string(const std::string& text) {
+    buffer.push_back('"');
+    for (char c : text) {
+        unsigned char u = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            buffer.push_back('\\');
+            buffer.push_back(c);
+        } else if (c == '\n') {
+            buffer.append("\\n");
+        } else if (u < 0x20) {
+            buffer.append("\\u00").append(HEX_TABLE.digits[u], 2);
+        } else {
+            buffer.push_back(c);
+        }
+    }
+    buffer.push_back('"');
+    return *this;
+}
+
+JsonWriter& JsonWriter::reopen() {
+    size_t end = buffer.find_last_not_of(' ');
+    if (end != std::string::npos && buffer[end] == '}') {
+        buffer.resize(buffer.find_last_not_of(' ', end - 1) + 1);
+    }
+    return *this;
+}
+
+void JsonWriter::flush(std::ostream& out) {
+    buffer.push_back('\n');
+    out.write(buffer.data(), buffer.size());
+    out.flush();
+    buffer.clear();
+}
@@ -0,0 +1,213 @@
+#include "locality.h"
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+namespace {
+
+constexpr uint32_t MIN_SLOTS = 1 << 16;
+
+uint32_t log2(uint32_t value) {
+    uint32_t bits = 0;
+    while (value >>= 1) bits++;
+    return bits;
+}
+
+}
+
+bool LocalityConfig::apply(const std::string& option) {
+    size_t equals = option.find('=');
+    if (equals == std::string::npos) {
+        return false;
+    }
+    std::string name = option.substr(0, equals);
+    if (name != "line" && name != "page" && name != "window" && name != "pages") {
+        return false;
+    }
+    uint64_t value;
+    try {
+        value = std::stoull(option.substr(equals + 1));
+    } catch (const std::exception&) {
+        throw std::runtime_error("Invalid locality option: " + option);
+    }
+    if (name == "window" || name == "pages") {
+        if (value == 0) {
+            throw std::runtime_error("Invalid locality option: " + option);
+        }
+        if (name == "window") {
+            window = value;
+        } else {
+            pages = value;
+        }
+        return true;
+    }
+    if (value == 0 || value > (1u << 30) || (value & (value - 1))) {
+        throw std::runtime_error("Locality line and page sizes must be powers of two");
+    }
+    if (name == "line") {
+        lineSize = static_cast<uint32_t>(value);
+    } else {
+        pageSize = static_cast<uint32_t>(value);
+    }
+    return true;
+}
+
+LocalityAnalysis::LocalityAnalysis(const LocalityConfig& config)
+    : settings(config), lineShift(log2(config.lineSize)), pageShift(log2(config.pageSize)),
+      lines(1024), tree(MIN_SLOTS + 1, 0) {
+}
+
+LocalityAnalysis::LineState& LocalityAnalysis::find(uint32_t line) {
+    // Grow at half full so probes stay short
+    if (2 * (lineCount + 1) > lines.size()) {
+        std::vector<LineState> old(lines.size() * 2);
+        old.swap(lines);
+        for (const LineState& state : old) {
+            if (state.used) find(state.line) = state;
+        }
+    }
+    size_t mask = lines.size() - 1;
+    for (size_t slot = (line * 0x9E3779B1u) & mask;; slot = (slot + 1) & mask) {
+        if (!lines[slot].used || lines[slot].line == line) return lines[slot];
+    }
+}
+
+void LocalityAnalysis::add(uint32_t time, int32_t delta) {
+    for (uint32_t i = time + 1; i < tree.size(); i += i & -i) {
+        tree[i] += delta;
+    }
+}
+
+uint32_t LocalityAnalysis::prefix(uint32_t time) const {
+    uint32_t sum = 0;
+    for (uint32_t i = time; i > 0; i -= i & -i) {
+        sum += tree[i];
+    }
+    return sum;
+}
+
+// Gives the live marks the times 0 ... lines - 1 in their order and rebuilds the tree in linear time
+void LocalityAnalysis::compact() {
+    std::vector<std::pair<uint32_t, LineState*>> live;
+    live.reserve(lineCount);
+    for (LineState& state : lines) {
+        if (state.used) live.emplace_back(state.time, &state);
+    }
+    std::sort(live.begin(), live.end(), [](const auto& a, const auto& b) { return a.first < b.first; });
+    for (uint32_t i = 0; i < live.size(); i++) {
+        live[i].second->time = i;
+    }
+
+    size_t slots = std::max<size_t>(MIN_SLOTS, 2 * live.size());
+    tree.assign(slots + 1, 0);
+    for (size_t i = 1; i <= live.size(); i++) {
+        tree[i] = 1;
+    }
+    for (size_t i = 1; i < tree.size(); i++) {
+        size_t parent = i + (i & -i);
+        if (parent < tree.size()) tree[parent] += tree[i];
+    }
+    now = static_cast<uint32_t>(live.size());
+}
+
+void LocalityAnalysis::access(uint32_t address, bool write) {
+    if (now + 1 >= tree.size()) {
+        compact();
+    }
+    total++;
+
+    if (!lastHeat || address >> pageShift != lastPage) {
+        lastPage = address >> pageShift;
+        lastHeat = &pages[lastPage];
+    }
+    (write ? lastHeat->writes : lastHeat->reads)++;
+
+    LineState& state = find(address >> lineShift);
+    if (!state.used) {
+        state.used = true;
+        state.line = address >> lineShift;
+        state.time = now;
+        state.window = windowIndex;
+        lineCount++;
+        cold++;
+        windowLines++;
+    } else {
+        // Every line holds one mark and all of them are before `now`
+        uint32_t distance = static_cast<uint32_t>(lineCount) - prefix(state.time + 1);
+        size_t bucket = distance ? log2(distance) + 1 : 0;
+        if (bucket >= histogram.size()) histogram.resize(bucket + 1, 0);
+        histogram[bucket]++;
+        add(state.time, -1);
+        if (state.window != windowIndex) {
+            state.window = windowIndex;
+            windowLines++;
+        }
+        state.time = now;
+    }
+    add(now, 1);
+    now++;
+
+    if (++windowAccesses == settings.window) {
+        workingSet.push_back(windowLines);
+        windowIndex++;
+        windowAccesses = 0;
+        windowLines = 0;
+    }
+}
+
+void LocalityAnalysis::dump(JsonWriter& out) const {
+    out.raw("{ \"accesses\": ").number(total).raw(", \"lines\": ").number(lineCount);
+
+    out.raw(", \"reuse\": { \"cold\": ").number(cold).raw(", \"histogram\": [");
+    for (size_t bucket = 0; bucket < histogram.size(); bucket++) {
+        uint64_t low = bucket ? uint64_t(1) << (bucket - 1) : 0;
+        uint64_t high = bucket ? (uint64_t(1) << bucket) - 1 : 0;
+        out.raw(bucket ? ", " : "").raw("{ \"min\": ").number(low).raw(", \"max\": ").number(high)
+            .raw(", \"count\": ").number(histogram[bucket]).raw(" }");
+    }
+    // A fully associative LRU cache of 2^k lines hits the distances of buckets 0 ... k
+    out.raw("], \"missRatio\": [");
+    uint64_t hits = 0;
+    for (size_t bucket = 0; bucket < histogram.size(); bucket++) {
+        hits += histogram[bucket];
+        uint64_t capacity = uint64_t(1) << bucket;
+        double ratio = total ? std::round(1000.0 * (total - hits) / total) / 1000 : 0;
+        out.raw(bucket ? ", " : "").raw("{ \"lines\": ").number(capacity)
+            .raw(", \"bytes\": ").number(capacity * settings.lineSize)
+            .raw(", \"ratio\": ").number(ratio).raw(" }");
+    }
+    out.raw("] }");
+
+    std::vector<std::pair<uint32_t, PageHeat>> hottest(pages.begin(), pages.end());
+    auto heat = [](const std::pair<uint32_t, PageHeat>& page) { return page.second.reads + page.second.writes; };
+    size_t count = std::min(settings.pages, hottest.size());
+    std::partial_sort(hottest.begin(), hottest.begin() + count, hottest.end(), [&](const auto& a, const auto& b) {
+        return heat(a) != heat(b) ? heat(a) > heat(b) : a.first < b.first;
+    });
+    std::sort(hottest.begin(), hottest.begin() + count, [](const auto& a, const auto& b) { return a.first < b.first; });
+    out.raw(", \"pages\": [");
+    for (size_t i = 0; i < count; i++) {
+        out.raw(i ? ", " : "").raw("{ \"page\": ").hexString(hottest[i].first << pageShift)
+            .raw(", \"reads\": ").number(hottest[i].second.reads)
+            .raw(", \"writes\": ").number(hottest[i].second.writes).raw(" }");
+    }
+
+    // The last window counts even when it is partial
+    std::vector<uint32_t> windows = workingSet;
+    if (windowAccesses) windows.push_back(windowLines);
+    uint64_t sum = 0;
+    uint32_t largest = 0;
+    for (uint32_t size : windows) {
+        sum += size;
+        largest = std::max(largest, size);
+    }
+    double average = windows.empty() ? 0 : std::round(1000.0 * sum / windows.size()) / 1000;
+    out.raw("], \"workingSet\": { \"window\": ").number(settings.window)
+        .raw(", \"max\": ").number(largest)
+        .raw(", \"average\": ").number(average)
+        .raw(", \"lines\": [");
+    for (size_t i = 0; i < windows.size(); i++) {
+        out.raw(i ? ", " : "").number(windows[i]);
+    }
+    out.raw("] } }");
+}
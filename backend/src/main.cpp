@@ -3,189 +3,197 @@
 #include "assembler.h"
 #include "cpu.h"
 #include "memory.h"
+#include "binary_protocol.h"
+#include "json_request.h"
+#include "session.h"
+#include "daemon.h"
+#include "http_server.h"
+#include "background_run.h"
+#include "batch.h"
+#include <mutex>
+#include <thread>
 
-Memory memory;
-Cpu cpu(memory);
-Assembler assembler(memory);
-
-void assembleAndOutput()
+int main(int argc, char *argv[])
 {
-    std::string jsonInput, line;
-
-    std::getline(std::cin, jsonInput);
-
-    // Find the JSON key manually
-    size_t start = jsonInput.find("\"input_code\":");
-    if (start == std::string::npos)
+    SessionOptions options;
+    bool daemon = false;
+    int httpPort = -1;
+    HttpServer::ServerOptions http;
+    unsigned threads = std::thread::hardware_concurrency();
+    unsigned long progressMilliseconds = 1000;
+    std::string batchDirectory;
+    Batch::Options batch;
+    batch.jobs = threads;
+    for (int i = 1; i < argc; i++)
     {
-        std::cerr << "{ \"error\": \"Invalid JSON format\" }" << std::endl;
-        return;
+        std::string arg = argv[i];
+        if (arg == "--cache-dir" && i + 1 < argc)
+        {
+            options.cacheDirectory = argv[++i];
+        }
+        else if (arg == "--include-dir" && i + 1 < argc)
+        {
+            DirectiveHandler::includeDirectory = argv[++i];
+        }
+        else if (arg == "--cache-size" && i + 1 < argc)
+        {
+            options.cacheSize = std::stoul(argv[++i]);
+        }
+        else if (arg == "--daemon")
+        {
+            daemon = true;
+        }
+        else if (arg == "--threads" && i + 1 < argc)
+        {
+            threads = std::stoul(argv[++i]);
+        }
+        else if (arg == "--run-ms" && i + 1 < argc)
+        {
+            options.runMilliseconds = std::stoull(argv[++i]);
+        }
+        else if (arg == "--analysis-cycles" && i + 1 < argc)
+        {
+            options.analysisCycles = std::stoull(argv[++i]);
+        }
+        else if (arg == "--progress-ms" && i + 1 < argc)
+        {
+            progressMilliseconds = std::stoul(argv[++i]);
+        }
+        else if (arg == "--batch" && i + 1 < argc)
+        {
+            batchDirectory = argv[++i];
+        }
+        else if (arg == "--jobs" && i + 1 < argc)
+        {
+            batch.jobs = std::stoul(argv[++i]);
+        }
+        else if (arg == "--config" && i + 1 < argc)
+        {
+            try
+            {
+                batch.parseConfig(argv[++i]);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--l1" && i + 1 < argc)
+        {
+            try
+            {
+                batch.caches = CacheConfig::parse(argv[++i]);
+                Cache check(*batch.caches);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--dram" && i + 1 < argc)
+        {
+            try
+            {
+                batch.dram = DramConfig::parse(argv[++i]);
+                Dram check(*batch.dram);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--prefetch" && i + 1 < argc)
+        {
+            try
+            {
+                batch.prefetch = PrefetcherConfig::parse(argv[++i]);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--latency" && i + 1 < argc)
+        {
+            try
+            {
+                batch.latency = FunctionalUnitConfig::parse(argv[++i]);
+            }
+            catch (const std::exception &e)
+            {
+                std::cerr << "Error: " << e.what() << std::endl;
+                return 1;
+            }
+        }
+        else if (arg == "--max-cycles" && i + 1 < argc)
+        {
+            batch.budget.cycles = std::stoull(argv[++i]);
+        }
+        else if (arg == "--http" && i + 1 < argc)
+        {
+            httpPort = std::stoi(argv[++i]);
+        }
+        else if (arg == "--http-host" && i + 1 < argc)
+        {
+            http.host = argv[++i];
+        }
+        else if (arg == "--http-sessions" && i + 1 < argc)
+        {
+            http.maxSessions = std::stoul(argv[++i]);
+        }
+        else if (arg == "--http-idle-s" && i + 1 < argc)
+        {
+            http.idleSeconds = std::stoull(argv[++i]);
+        }
     }
+    // Every session of the process assembles through one cache
+    options.cache = options.makeCache();
 
-    // Extract assembly code inside quotes
-    start = jsonInput.find("\"", start + 13);
-    size_t end = jsonInput.rfind("\"");
-    if (start == std::string::npos || end == std::string::npos || start >= end)
+    if (!batchDirectory.empty())
     {
-        std::cerr << "{ \"error\": \"Invalid input format\" }" << std::endl;
-        return;
+        batch.budget.milliseconds = options.runMilliseconds;
+        try
+        {
+            return Batch::run(batchDirectory, batch, options, std::cout) == 0 ? 0 : 1;
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
     }
 
-    std::string program = jsonInput.substr(start + 1, end - start - 1);
-
-    size_t pos;
-    while ((pos = program.find("\\n")) != std::string::npos)
+    if (httpPort >= 0)
     {
-        program.replace(pos, 2, "\n");
+        http.port = static_cast<uint16_t>(httpPort);
+        try
+        {
+            HttpServer::serve(http, options);
+        }
+        catch (const std::exception &e)
+        {
+            std::cerr << "Error: " << e.what() << std::endl;
+            return 1;
+        }
+        return 0;
     }
-    assembler.assemble(program);
-}
-
-void runAndOutput()
-{
-    cpu.run();
-
-    std::cout << "{ \"data_segment\": {";
-    memory.dumpMemory();
-    std::cout << "}, \"instruction_memory\": {";
-    memory.dumpInstructions();
-    std::cout << "}, \"stack\": {";
-    memory.dumpStack();
-    std::cout << "}, \"registers\": {";
-    cpu.dumpRegisters();
-    std::cout << "}, \"clock_cycles\": " << std::dec << cpu.clock << " ";
-    std::cout << ", \"pipeline\":";
-    std::cout << (cpu.pipeline ? "\"On\"" : "\"Off\"");
-    std::cout << ", \"data_forward\":";
-    std::cout << (cpu.data_forward ? "\"On\"" : "\"Off\"");
-    std::cout << ", \"totalInstructions\":";
-    std::cout << cpu.totalInstructions;
-    std::cout << ", \"totalDataTransferInstructions\":";
-    std::cout << cpu.totalDataTransferInstructions;
-    std::cout << ", \"totalControlInstructions\":";
-    std::cout << cpu.totalControlInstructions;
-    std::cout << ", \"totalBubbles\":";
-    std::cout << cpu.totalBubbles;
-    std::cout << ", \"totalControlHazardBubbles\":";
-    std::cout << cpu.totalControlHazardBubbles;
-    std::cout << ", \"totalDataHazardBubbles\":";
-    std::cout << cpu.totalDataHazardBubbles;
-    std::cout << ", \"totalDataHazards\":";
-    std::cout << cpu.totalDataHazards;
-    std::cout << ", \"totalControlHazards\":";
-    std::cout << cpu.totalControlHazards;
-    std::cout << ", \"totalBranchMissPredictions\":";
-    std::cout << cpu.totalBranchMissPredictions;
-    std::cout << " }" << std::endl;
-}
-
-void stepAndOutput()
-{
-    cpu.step();
-
-    std::cout << "{ \"data_segment\": {";
-    memory.dumpMemory();
-    std::cout << "}, \"instruction_memory\": {";
-    memory.dumpInstructions();
-    std::cout << "}, \"stack\": {";
-    memory.dumpStack();
-    std::cout << "}, \"registers\": {";
-    cpu.dumpRegisters();
-    std::cout << "}, \"clock_cycles\": " << std::dec << cpu.clock << " ";
-    std::cout << ", \"comment\": \"";
-    memory.dumpComments();
-    std::cout << "\", \"pipeline\":";
-    std::cout << (cpu.pipeline ? "\"On\"" : "\"Off\"");
-    std::cout << ", \"data_forward\":";
-    std::cout << (cpu.data_forward ? "\"On\"" : "\"Off\"");
-    std::cout << ", \"pipeline_status\": ";
-    std::cout << cpu.dumpPipelineStages();
-    std::cout << ", \"data_forward_path\": ";
-    cpu.dumpDataForwardPath();
-    std::cout << ", \"RA\": ";
-    std::cout << cpu.RA;
-    std::cout << ", \"RB\": ";
-    std::cout << cpu.RB;
-    std::cout << ", \"RY\": ";
-    std::cout << cpu.RY;
-    std::cout << ", \"RZ\": ";
-    std::cout << cpu.RZ;
-    std::cout << ", \"RM\": ";
-    std::cout << cpu.RM;
-    std::cout << " }" << std::endl;
-}
 
-void pipeline()
-{
-    cpu.pipeline = !cpu.pipeline;
-
-    std::cout << "{ \"data_segment\": {";
-    memory.dumpMemory();
-    std::cout << "}, \"instruction_memory\": {";
-    memory.dumpInstructions();
-    std::cout << "}, \"stack\": {";
-    memory.dumpStack();
-    std::cout << "}, \"registers\": {";
-    cpu.dumpRegisters();
-    std::cout << "}, \"clock_cycles\": " << std::dec << cpu.clock << " ";
-    std::cout << ", \"comment\": \"";
-    memory.dumpComments();
-    std::cout << "\", \"pipeline\":";
-    std::cout << (cpu.pipeline ? "\"On\"" : "\"Off\"");
-    std::cout << ", \"data_forward\":";
-    std::cout << (cpu.data_forward ? "\"On\"" : "\"Off\"");
-    std::cout << ", \"branch_prediction\":";
-    std::cout << (cpu.predictionBool ? "\"On\"" : "\"Off\"");
-    std::cout << " }" << std::endl;
-}
-
-void dataForward()
-{
-    cpu.data_forward = !cpu.data_forward;
-    std::cout << "{ \"data_segment\": {";
-    memory.dumpMemory();
-    std::cout << "}, \"instruction_memory\": {";
-    memory.dumpInstructions();
-    std::cout << "}, \"stack\": {";
-    memory.dumpStack();
-    std::cout << "}, \"registers\": {";
-    cpu.dumpRegisters();
-    std::cout << "}, \"clock_cycles\": " << std::dec << cpu.clock << " ";
-    std::cout << ", \"comment\": \"";
-    memory.dumpComments();
-    std::cout << "\", \"pipeline\":";
-    std::cout << (cpu.pipeline ? "\"On\"" : "\"Off\"");
-    std::cout << ", \"data_forward\":";
-    std::cout << (cpu.data_forward ? "\"On\"" : "\"Off\"");
-    std::cout << ", \"branch_prediction\":";
-    std::cout << (cpu.predictionBool ? "\"On\"" : "\"Off\"");
-    std::cout << " }" << std::endl;
-}
-
-void branchPrediction() {
-    cpu.predictionBool = !cpu.predictionBool;
-    std::cout << "{ \"data_segment\": {";
-    memory.dumpMemory();
-    std::cout << "}, \"instruction_memory\": {";
-    memory.dumpInstructions();
-    std::cout << "}, \"stack\": {";
-    memory.dumpStack();
-    std::cout << "}, \"registers\": {";
-    cpu.dumpRegisters();
-    std::cout << "}, \"clock_cycles\": " << std::dec << cpu.clock << " ";
-    std::cout << ", \"comment\": \"";
-    memory.dumpComments();
-    std::cout << "\", \"pipeline\":";
-    std::cout << (cpu.pipeline ? "\"On\"" : "\"Off\"");
-    std::cout << ", \"data_forward\":";
-    std::cout << (cpu.data_forward ? "\"On\"" : "\"Off\"");
-    std::cout << ", \"branch_prediction\":";
-    std::cout << (cpu.predictionBool ? "\"On\"" : "\"Off\"");
-    std::cout << " }" << std::endl;
-}
+    if (daemon)
+    {
+        Daemon::serve(std::cin, std::cout, std::cerr, options, threads);
+        return 0;
+    }
 
-int main(int argc, char *argv[])
-{
+    Session session(options);
+    JsonWriter json;
+    JsonRequest request;
+    // `run` executes in the background, its output shares stdout and stderr with this loop
+    std::mutex outputMutex;
+    BackgroundRun background(session, std::cout, std::cerr, outputMutex, std::chrono::milliseconds(progressMilliseconds));
 
     while (true)
     {
@@ -193,46 +201,66 @@ int main(int argc, char *argv[])
         std::getline(std::cin, command);
         try
         {
-            if (command == "assemble")
+            if (command == "status")
             {
-                cpu.reset();
-                assembleAndOutput();
+                background.writeStatus(json);
+                std::lock_guard<std::mutex> lock(outputMutex);
+                json.flush(std::cout);
+                continue;
             }
-            else if (command == "run")
+            if (command == "pause" || command == "cancel")
             {
-                runAndOutput();
+                bool stopping = background.stop(command == "pause" ? RunControl::PAUSE : RunControl::CANCEL);
+                json.raw("{ \"").raw(command).raw("\": ").boolean(stopping).raw(" }");
+                std::lock_guard<std::mutex> lock(outputMutex);
+                json.flush(std::cout);
+                continue;
             }
-            else if (command == "step")
+            // Any other command runs after the program stops, as if `run` had blocked
+            background.wait();
+            if (Session::isRun(command))
             {
-                stepAndOutput();
+                background.start(session.runBudget(command));
+                continue;
             }
-            else if (command == "pipeline")
+            if (command == "protocol binary")
             {
-                pipeline();
+                json.raw("{ \"protocol\": \"binary\", \"version\": ").number(BinaryProtocol::VERSION).raw(" }");
+                json.flush(std::cout);
+                BinaryProtocol::serve(std::cin, std::cout, session);
+                return 0;
             }
-            else if (command == "data_forward")
+            if (Session::needsPayload(command))
             {
-                dataForward();
+                request.read(std::cin);
             }
-            else if (command == "branch_prediction")
+            if (session.execute(command, request, json))
             {
-                branchPrediction();
+                std::lock_guard<std::mutex> lock(outputMutex);
+                json.flush(std::cout);
             }
             else
             {
+                std::lock_guard<std::mutex> lock(outputMutex);
                 std::cerr << "Invalid command\n";
             }
         }
         catch (const std::runtime_error &e)
         {
+            json.clear();
+            std::lock_guard<std::mutex> lock(outputMutex);
             std::cerr << "Error: " << e.what() << std::endl;
         }
         catch (const std::exception &e)
         {
+            json.clear();
+            std::lock_guard<std::mutex> lock(outputMutex);
             std::cerr << "Standard exception: " << e.what() << std::endl;
         }
         catch (...)
         {
+            json.clear();
+            std::lock_guard<std::mutex> lock(outputMutex);
             std::cerr << "An unknown error occurred.\n";
         }
     }
@@ -1,6 +1,5 @@
 #include "memory.h"
 #include <fstream>
-#include <iomanip>
 #include <cstring>
 #include <iostream>
 
@@ -11,36 +10,56 @@ void Memory::storeInstruction(uint32_t address, uint32_t machineCode) {
 
 
 void Memory::storeData(uint32_t address, uint8_t value) {
-    dataMemory[address] = value;
+    dataMemory.write(address, value);
 }
 
 
 void Memory::storeDataBytes(uint32_t address, const std::vector<uint8_t>& values) {
-    for (size_t i = 0; i < values.size(); i++) {
-        storeData(address + i, values[i]);
-    }
+    dataMemory.writeBlock(address, values.data(), values.size());
 }
 
 
 
 void Memory::storeString(uint32_t address, const std::string& str) {
-    for (size_t i = 0; i < str.size(); i++) {
-        storeData(address + i, static_cast<uint8_t>(str[i]));
-    }
+    dataMemory.writeBlock(address, reinterpret_cast<const uint8_t*>(str.data()), str.size());
     storeData(address + str.size(), 0); 
 }
 
 
 
+void Memory::eraseInstruction(uint32_t address) {
+    instructionMemory.erase(address);
+}
+
+
+void Memory::eraseData(uint32_t address, uint32_t size) {
+    dataMemory.erase(address, size);
+}
+
+
+
 uint32_t Memory::fetchInstruction(uint32_t address) const {
-    auto it = instructionMemory.find(address);
-    return (it != instructionMemory.end()) ? it->second : 0;
+    auto it = text().find(address);
+    return (it != text().end()) ? it->second : 0;
 }
 
 
 uint8_t Memory::fetchData(uint32_t address) const {
-    auto it = dataMemory.find(address);
-    return (it != dataMemory.end()) ? it->second : 0;
+    return dataMemory.read(address);
+}
+
+
+void Memory::fetchDataBlock(uint32_t address, uint8_t* out, size_t size) const {
+    dataMemory.readBlock(address, out, size);
+}
+
+
+bool Memory::isDataAddress(uint32_t address) const {
+    if (address >= DATA_START && address < DATA_END) return true;
+    for (const auto& [start, end] : mappedData) {
+        if (address >= start && address < end) return true;
+    }
+    return false;
 }
 
 
@@ -49,62 +68,54 @@ const std::map<uint32_t, uint32_t>& Memory::getInstructionMemory() const {
 }
 
 
-const std::map<uint32_t, int>& Memory::getDataMemory() const {
+const PagedMemory& Memory::getDataMemory() const {
     return dataMemory;
 }
 
-void Memory::dumpMemory() {
+void Memory::dumpMemory(JsonWriter& out) const {
     bool first = true;
-    for (const auto& [addr, val] : dataMemory) {
-        if (!first) std::cout << ",";
-        std::cout << "\"0x" << std::hex << std::setw(8) << std::setfill('0') << addr << "\": " << std::dec << (int)val;
+    dataMemory.forEachWritten([&](uint32_t addr, uint8_t val) {
+        if (!first) out.raw(',');
+        out.hexKey(addr).number(val);
         first = false;
-    }
+    });
 }
 
-// first = true;
-// for (const auto& [addr, val] : memory.getDataMemory()) {
-//     if (!first) std::cout << ",";
-//     std::cout << "\"0x" << std::hex << std::setw(8) << std::setfill('0') << addr << "\": " << std::dec << (int)val;
-//     first = false;
-// }
-
-void Memory::dumpInstructions() {
+void Memory::dumpInstructions(JsonWriter& out) const {
     bool first = true;
     for (const auto& [pc, instr] : instructionMemory) {
-        if (!first) std::cout << ",";
-        std::cout << "\"0x" << std::hex << std::setw(8) << std::setfill('0') << pc << "\": "
-        << "\"0x" << std::setw(8) << std::setfill('0') << instr << "\"";
+        if (!first) out.raw(',');
+        out.hexKey(pc).hexString(instr);
         first = false;
     }
 }
 
-void Memory::dumpStack() {
+void Memory::dumpStack(JsonWriter& out) const {
     bool first = true;
-    for (const auto& [addr, val] : stackMemory) {
-        if (!first) std::cout << ",";
-        std::cout << "\"0x" << std::hex << std::setw(8) << std::setfill('0') << addr << "\": " << std::dec << (int)val;
+    stackMemory.forEachWritten([&](uint32_t addr, uint8_t val) {
+        if (!first) out.raw(',');
+        out.hexKey(addr).number(val);
         first = false;
-    }
+    });
 }
 
-void Memory::dumpComments() {
+void Memory::dumpComments(JsonWriter& out) {
     if (comment.empty()){
         if (pipelineComments.empty()){
-            std::cout << "No comments available";
+            out.raw("No comments available");
             return;
         }
-        std::cout << "Pipeline comments: ";
+        out.raw("Pipeline comments: ");
         for (int i = 0; i < pipelineComments.size(); i++){
-            std::cout << pipelineComments[i];
+            out.raw(pipelineComments[i]);
             if (i != pipelineComments.size() - 1) {
-                std::cout << ", ";
+                out.raw(", ");
             }
         }
         pipelineComments.clear();
     }
     else {
-        std::cout << comment;
+        out.raw(comment);
         comment.clear();
     }
 }
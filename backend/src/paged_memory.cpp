@@ -0,0 +1,131 @@
+#include "paged_memory.h"
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+// Marks (or clears) the written bits of [offset, offset + size) inside one page
+void markWritten(uint64_t* written, uint32_t offset, uint32_t size, bool value) {
+    while (size > 0) {
+        uint32_t word = offset / 64;
+        uint32_t bit = offset % 64;
+        uint32_t count = std::min<uint32_t>(64 - bit, size);
+        uint64_t mask = (count == 64) ? ~0ULL : (((1ULL << count) - 1) << bit);
+        if (value) {
+            written[word] |= mask;
+        } else {
+            written[word] &= ~mask;
+        }
+        offset += count;
+        size -= count;
+    }
+}
+
+}
+
+const PagedMemory::Page* PagedMemory::findPage(uint32_t pageNumber) const {
+    auto it = pages.find(pageNumber);
+    return it != pages.end() ? it->second.get() : nullptr;
+}
+
+PagedMemory::Page& PagedMemory::writablePage(uint32_t pageNumber) {
+    std::shared_ptr<Page>& page = pages[pageNumber];
+    if (!page) {
+        page = std::make_shared<Page>();
+    } else if (page.use_count() > 1) {
+        // Shared with another copy of this memory, clone before writing
+        page = std::make_shared<Page>(*page);
+    }
+    return *page;
+}
+
+uint8_t PagedMemory::read(uint32_t address) const {
+    const Page* page = findPage(address >> PAGE_BITS);
+    return page ? page->bytes[address & (PAGE_SIZE - 1)] : 0;
+}
+
+void PagedMemory::write(uint32_t address, uint8_t value) {
+    Page& page = writablePage(address >> PAGE_BITS);
+    uint32_t offset = address & (PAGE_SIZE - 1);
+    page.bytes[offset] = value;
+    page.written[offset / 64] |= 1ULL << (offset % 64);
+}
+
+void PagedMemory::readBlock(uint32_t address, uint8_t* out, size_t size) const {
+    while (size > 0) {
+        uint32_t offset = address & (PAGE_SIZE - 1);
+        uint32_t chunk = static_cast<uint32_t>(std::min<size_t>(PAGE_SIZE - offset, size));
+        const Page* page = findPage(address >> PAGE_BITS);
+        if (page) {
+            std::memcpy(out, page->bytes + offset, chunk);
+        } else {
+            std::memset(out, 0, chunk);
+        }
+        address += chunk;
+        out += chunk;
+        size -= chunk;
+    }
+}
+
+void PagedMemory::writeBlock(uint32_t address, const uint8_t* data, size_t size) {
+    while (size > 0) {
+        uint32_t offset = address & (PAGE_SIZE - 1);
+        uint32_t chunk = static_cast<uint32_t>(std::min<size_t>(PAGE_SIZE - offset, size));
+        Page& page = writablePage(address >> PAGE_BITS);
+        std::memcpy(page.bytes + offset, data, chunk);
+        markWritten(page.written, offset, chunk, true);
+        address += chunk;
+        data += chunk;
+        size -= chunk;
+    }
+}
+
+void PagedMemory::fill(uint32_t address, uint8_t value, size_t size) {
+    while (size > 0) {
+        uint32_t offset = address & (PAGE_SIZE - 1);
+        uint32_t chunk = static_cast<uint32_t>(std::min<size_t>(PAGE_SIZE - offset, size));
+        Page& page = writablePage(address >> PAGE_BITS);
+        std::memset(page.bytes + offset, value, chunk);
+        markWritten(page.written, offset, chunk, true);
+        address += chunk;
+        size -= chunk;
+    }
+}
+
+void PagedMemory::erase(uint32_t address, size_t size) {
+    while (size > 0) {
+        uint32_t offset = address & (PAGE_SIZE - 1);
+        uint32_t chunk = static_cast<uint32_t>(std::min<size_t>(PAGE_SIZE - offset, size));
+        uint32_t pageNumber = address >> PAGE_BITS;
+        if (findPage(pageNumber)) {
+            Page& page = writablePage(pageNumber);
+            std::memset(page.bytes + offset, 0, chunk);
+            markWritten(page.written, offset, chunk, false);
+            if (std::all_of(std::begin(page.written), std::end(page.written), [](uint64_t w) { return w == 0; })) {
+                pages.erase(pageNumber);
+            }
+        }
+        address += chunk;
+        size -= chunk;
+    }
+}
+
+bool PagedMemory::isWritten(uint32_t address) const {
+    const Page* page = findPage(address >> PAGE_BITS);
+    uint32_t offset = address & (PAGE_SIZE - 1);
+    return page && (page->written[offset / 64] >> (offset % 64) & 1);
+}
+
+bool PagedMemory::anyWritten(uint32_t address, size_t size) const {
+    auto it = pages.lower_bound(address >> PAGE_BITS);
+    uint64_t end = static_cast<uint64_t>(address) + size;
+    for (; it != pages.end() && (static_cast<uint64_t>(it->first) << PAGE_BITS) < end; ++it) {
+        uint64_t base = static_cast<uint64_t>(it->first) << PAGE_BITS;
+        uint32_t from = static_cast<uint32_t>(std::max<uint64_t>(base, address) - base);
+        uint32_t to = static_cast<uint32_t>(std::min<uint64_t>(base + PAGE_SIZE, end) - base);
+        for (uint32_t offset = from; offset < to; offset++) {
+            if (it->second->written[offset / 64] >> (offset % 64) & 1) return true;
+        }
+    }
+    return false;
+}
@@ -43,7 +43,7 @@ std::tuple<std::string, std::vector<std::string>> Parser::extractInstruction(con
 
 void Parser::parse(std::string line, uint32_t &address,
                    SymbolTable &symbols, bool firstPass,
-                   Memory &memory)
+                   Memory &memory, LineInfo *info)
 {
 
     size_t commentPos = line.find('#');
@@ -69,7 +69,13 @@ void Parser::parse(std::string line, uint32_t &address,
         std::string label = line.substr(0, colonPos);
         if (firstPass)
         {
-            symbols.addLabel(label, address);
+            uint32_t id = symbols.internDefinition(label);
+            symbols.define(id, address);
+            if (info)
+            {
+                info->labels.push_back(id);
+                info->usesLocalLabels |= SymbolTable::isLocalLabel(label);
+            }
         }
 
         if (colonPos + 1 < line.length())
@@ -88,7 +94,15 @@ void Parser::parse(std::string line, uint32_t &address,
 
     if (directives.isDirective(line))
     {
+        if (info)
+        {
+            info->setsSegment = directives.isSegmentDirective(line);
+        }
         directives.process(line, address, firstPass);
+        if (info)
+        {
+            info->alignment = directives.lastAlignment();
+        }
         return;
     }
 
@@ -96,6 +110,28 @@ void Parser::parse(std::string line, uint32_t &address,
     if (op.empty())
         return;
 
+    if (firstPass && info)
+    {
+        info->isInstruction = true;
+        info->isExit = (op == "exit");
+        // Branches take the label as the last operand, jal as the second
+        bool isBranch = (op == "beq" || op == "bne" || op == "blt" || op == "bge");
+        if ((isBranch && operands.size() == 3) || (op == "jal" && operands.size() == 2))
+        {
+            uint32_t index = operands.size() - 1;
+            const std::string &target = operands[index];
+            if (SymbolTable::isLocalReference(target))
+            {
+                info->labelUses.push_back({index, symbols.internLocalReference(target)});
+                info->usesLocalLabels = true;
+            }
+            else if (!target.empty() && !(target[0] >= '0' && target[0] <= '9'))
+            {
+                info->labelUses.push_back({index, symbols.intern(target)});
+            }
+        }
+    }
+
     if (!firstPass)
     {
         if (op == "exit") {
@@ -103,7 +139,23 @@ void Parser::parse(std::string line, uint32_t &address,
             memory.exitAddress = address;
         }
         else{
-            auto inst = InstructionFactory::create(op, operands, symbols, address);
+            // Label operands resolved in the first pass, looked up by name without one
+            std::vector<uint32_t> operandSymbols(operands.size(), SymbolTable::NO_SYMBOL);
+            if (info)
+            {
+                for (const LineInfo::LabelUse &use : info->labelUses)
+                {
+                    operandSymbols[use.operand] = use.symbol;
+                }
+            }
+            else
+            {
+                for (size_t i = 0; i < operands.size(); i++)
+                {
+                    operandSymbols[i] = symbols.find(operands[i]);
+                }
+            }
+            auto inst = InstructionFactory::create(op, operands, operandSymbols, symbols, address);
             if (inst)
             {
                 memory.storeInstruction(address, inst->generate_machine_code());
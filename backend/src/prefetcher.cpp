@@ -0,0 +1,91 @@
+#include "prefetcher.h"
+#include <sstream>
+#include <stdexcept>
+
+PrefetcherConfig PrefetcherConfig::parse(const std::string& arguments) {
+    PrefetcherConfig config;
+    std::istringstream in(arguments);
+    std::string option;
+    while (in >> option) {
+        size_t equals = option.find('=');
+        std::string name = option.substr(0, equals);
+        uint32_t* field = name == "degree" ? &config.degree
+                        : name == "distance" ? &config.distance
+                        : name == "entries" ? &config.entries : nullptr;
+        if (!field || equals == std::string::npos) {
+            throw std::runtime_error("Unknown prefetch option: " + option);
+        }
+        try {
+            *field = std::stoul(option.substr(equals + 1));
+        } catch (const std::exception&) {
+            throw std::runtime_error("Invalid prefetch option: " + option);
+        }
+    }
+    if (config.degree == 0 || config.distance == 0 || config.entries == 0 || (config.entries & (config.entries - 1))) {
+        throw std::runtime_error("Prefetch degree and distance must be positive and entries a power of two");
+    }
+    return config;
+}
+
+NextLinePrefetcher::NextLinePrefetcher(const PrefetcherConfig& config) : settings(config) {
+    addresses.reserve(config.degree);
+}
+
+const std::vector<uint32_t>& NextLinePrefetcher::observe(uint32_t pc, uint32_t lineSize) {
+    addresses.clear();
+    // Only a fetch that enters another line can ask for anything new
+    uint32_t line = pc / lineSize;
+    if (line != lastLine) {
+        lastLine = line;
+        for (uint32_t i = 1; i <= settings.degree; i++) {
+            addresses.push_back((line + i) * lineSize);
+        }
+    }
+    return addresses;
+}
+
+void NextLinePrefetcher::dump(JsonWriter& out) const {
+    out.raw("{ \"type\": \"next_line\", \"degree\": ").number(settings.degree).raw(" }");
+}
+
+StridePrefetcher::StridePrefetcher(const PrefetcherConfig& config) : settings(config), table(config.entries) {
+    addresses.reserve(config.degree);
+}
+
+void StridePrefetcher::clear() {
+    table.assign(table.size(), Entry());
+}
+
+const std::vector<uint32_t>& StridePrefetcher::observe(uint32_t pc, uint32_t address) {
+    addresses.clear();
+    Entry& entry = table[(pc >> 2) & (table.size() - 1)];
+    if (entry.pc != pc) {
+        entry = Entry();
+        entry.pc = pc;
+        entry.lastAddress = address;
+        return addresses;
+    }
+
+    int32_t stride = static_cast<int32_t>(address - entry.lastAddress);
+    if (stride == entry.stride && stride != 0) {
+        if (entry.confidence < 3) entry.confidence++;
+    } else if (entry.confidence > 0) {
+        entry.confidence--;
+    } else {
+        entry.stride = stride;
+    }
+    entry.lastAddress = address;
+
+    if (entry.confidence >= 2) {
+        for (uint32_t i = 0; i < settings.degree; i++) {
+            addresses.push_back(address + static_cast<uint32_t>(entry.stride) * (settings.distance + i));
+        }
+    }
+    return addresses;
+}
+
+void StridePrefetcher::dump(JsonWriter& out) const {
+    out.raw("{ \"type\": \"stride\", \"entries\": ").number(settings.entries)
+        .raw(", \"degree\": ").number(settings.degree)
+        .raw(", \"distance\": ").number(settings.distance).raw(" }");
+}
@@ -0,0 +1,584 @@
+#include "program_file.h"
+#include "constants.h"
+#include "cpu.h"
+#include <algorithm>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace {
+
+constexpr uint32_t NATIVE_MAGIC = 0x4D495652; // "RVIM"
+constexpr uint32_t NATIVE_VERSION = 2;
+constexpr uint32_t NATIVE_HEADER_SIZE = 64;
+// Source lines a native image may claim, the lines missing from its line map are kept as blanks
+constexpr uint32_t MAX_SOURCE_LINES = 1 << 20;
+
+// Line map flags
+constexpr uint32_t LINE_INSTRUCTION = 1;
+constexpr uint32_t LINE_DATA = 2;
+constexpr uint32_t LINE_EXIT = 4;
+constexpr uint32_t LINE_SEGMENT = 8;
+
+constexpr uint16_t EM_RISCV = 243;
+constexpr uint32_t ELF_PAGE = 0x1000;
+constexpr uint32_t EF_RISCV_RVC = 0x1;
+constexpr uint32_t PT_LOAD = 1;
+constexpr uint32_t PF_X = 1;
+constexpr uint32_t SHT_PROGBITS = 1;
+constexpr uint32_t SHT_SYMTAB = 2;
+constexpr uint32_t SHF_EXECINSTR = 0x4;
+constexpr uint32_t EXIT_WORD = 0x77777777;  // stored by the assembler for `exit`
+
+// Read-only mapping of a whole file
+class MappedFile {
+    int fd = -1;
+    void* base = MAP_FAILED;
+
+public:
+    const uint8_t* data = nullptr;
+    size_t size = 0;
+
+    explicit MappedFile(const std::string& path) {
+        fd = open(path.c_str(), O_RDONLY);
+        struct stat st;
+        if (fd < 0 || fstat(fd, &st) != 0) {
+            throw std::runtime_error("Cannot open " + path);
+        }
+        size = st.st_size;
+        if (size > 0) {
+            base = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (base == MAP_FAILED) {
+                throw std::runtime_error("Cannot map " + path);
+            }
+            data = static_cast<const uint8_t*>(base);
+        }
+    }
+
+    ~MappedFile() {
+        if (base != MAP_FAILED) munmap(base, size);
+        if (fd >= 0) close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    uint16_t u16(size_t offset) const {
+        if (offset + 2 > size) throw std::runtime_error("Truncated program file");
+        return data[offset] | (data[offset + 1] << 8);
+    }
+
+    uint32_t u32(size_t offset) const {
+        if (offset + 4 > size) throw std::runtime_error("Truncated program file");
+        return data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16) |
+               (static_cast<uint32_t>(data[offset + 3]) << 24);
+    }
+
+    const uint8_t* bytes(size_t offset, size_t count) const {
+        if (offset > size || count > size - offset) throw std::runtime_error("Truncated program file");
+        return data + offset;
+    }
+};
+
+// Little-endian output buffer
+class Writer {
+public:
+    std::vector<uint8_t> buffer;
+
+    size_t offset() const { return buffer.size(); }
+    void u8(uint8_t value) { buffer.push_back(value); }
+    void u16(uint16_t value) {
+        u8(value & 0xFF);
+        u8(value >> 8);
+    }
+    void u32(uint32_t value) {
+        for (int i = 0; i < 4; i++) u8((value >> (i * 8)) & 0xFF);
+    }
+    void bytes(const uint8_t* data, size_t size) { buffer.insert(buffer.end(), data, data + size); }
+    void align(size_t alignment) { buffer.resize((buffer.size() + alignment - 1) / alignment * alignment, 0); }
+    void patch32(size_t at, uint32_t value) {
+        for (int i = 0; i < 4; i++) buffer[at + i] = (value >> (i * 8)) & 0xFF;
+    }
+};
+
+// Consecutive addresses of a program segment
+struct Run {
+    uint32_t address;
+    std::vector<uint8_t> bytes;
+};
+
+std::vector<Run> textRuns(const ProgramImage& image) {
+    std::vector<Run> runs;
+    for (const auto& [address, word] : image.instructionMemory) {
+        if (runs.empty() || runs.back().address + runs.back().bytes.size() != address) {
+            runs.push_back({address, {}});
+        }
+        for (int i = 0; i < 4; i++) runs.back().bytes.push_back((word >> (i * 8)) & 0xFF);
+    }
+    return runs;
+}
+
+std::vector<Run> dataRuns(const ProgramImage& image) {
+    std::vector<Run> runs;
+    image.dataMemory.forEachWritten([&](uint32_t address, uint8_t value) {
+        if (runs.empty() || runs.back().address + runs.back().bytes.size() != address) {
+            runs.push_back({address, {}});
+        }
+        runs.back().bytes.push_back(value);
+    });
+    return runs;
+}
+
+void writeFile(const std::string& path, const std::vector<uint8_t>& buffer) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    if (!out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size())) {
+        throw std::runtime_error("Cannot write " + path);
+    }
+}
+
+void buildNative(Writer& w, const ProgramImage& image, uint32_t entry) {
+    std::vector<Run> text = textRuns(image);
+    std::vector<Run> data = dataRuns(image);
+    std::string strings;
+
+    w.buffer.resize(NATIVE_HEADER_SIZE, 0);
+
+    // Runs are { address, size } followed by the payload padded to a word
+    auto writeRuns = [&w](const std::vector<Run>& runs) {
+        size_t start = w.offset();
+        for (const Run& run : runs) {
+            w.u32(run.address);
+            w.u32(static_cast<uint32_t>(run.bytes.size()));
+            w.bytes(run.bytes.data(), run.bytes.size());
+            w.align(4);
+        }
+        return static_cast<uint32_t>(start);
+    };
+    uint32_t textOffset = writeRuns(text);
+    uint32_t dataOffset = writeRuns(data);
+
+    uint32_t symbolOffset = static_cast<uint32_t>(w.offset());
+    uint32_t symbolCount = 0;
+    for (const auto& [address, id] : image.symbols.getAddressIndex()) {
+        const std::string& name = image.symbols.getName(id);
+        w.u32(address);
+        w.u32(static_cast<uint32_t>(strings.size()));
+        w.u32(static_cast<uint32_t>(name.size()));
+        strings += name;
+        symbolCount++;
+    }
+
+    uint32_t lineOffset = static_cast<uint32_t>(w.offset());
+    uint32_t lineCount = 0;
+    for (size_t i = 0; i < image.lines.size(); i++) {
+        const AssembledLine& line = image.lines[i];
+        if (line.size == 0 && !line.info.setsSegment) continue;
+        uint32_t flags = (line.info.isInstruction ? LINE_INSTRUCTION : 0) | (line.inData ? LINE_DATA : 0) |
+                         (line.info.isExit ? LINE_EXIT : 0) | (line.info.setsSegment ? LINE_SEGMENT : 0);
+        w.u32(line.address);
+        w.u32(line.size);
+        w.u32(static_cast<uint32_t>(i));
+        w.u32(flags);
+        w.u32(static_cast<uint32_t>(strings.size()));
+        w.u32(static_cast<uint32_t>(line.text.size()));
+        strings += line.text;
+        lineCount++;
+    }
+
+    uint32_t stringOffset = static_cast<uint32_t>(w.offset());
+    w.bytes(reinterpret_cast<const uint8_t*>(strings.data()), strings.size());
+
+    uint32_t header[16] = {
+        NATIVE_MAGIC, NATIVE_VERSION, entry, image.exitAddress,
+        static_cast<uint32_t>(text.size()), textOffset, static_cast<uint32_t>(data.size()), dataOffset,
+        symbolCount, symbolOffset, lineCount, lineOffset,
+        stringOffset, static_cast<uint32_t>(strings.size()), static_cast<uint32_t>(w.offset()),
+        static_cast<uint32_t>(image.lines.size())
+    };
+    for (int i = 0; i < 16; i++) w.patch32(i * 4, header[i]);
+}
+
+void buildFlatBinary(Writer& w, const ProgramImage& image) {
+    for (const auto& [address, word] : image.instructionMemory) {
+        if (address < w.offset()) continue;
+        w.buffer.resize(address, 0);
+        w.u32(word);
+    }
+}
+
+void buildElf(Writer& w, const ProgramImage& image, uint32_t entry) {
+    // Both segments are written as one contiguous range, gaps are zero filled
+    uint32_t textStart = 0, textEnd = 0, dataStart = 0, dataEnd = 0;
+    if (!image.instructionMemory.empty()) {
+        textStart = image.instructionMemory.begin()->first;
+        textEnd = image.instructionMemory.rbegin()->first + 4;
+    }
+    std::vector<Run> data = dataRuns(image);
+    if (!data.empty()) {
+        dataStart = data.front().address;
+        dataEnd = data.back().address + static_cast<uint32_t>(data.back().bytes.size());
+    }
+    uint16_t phnum = (textEnd > textStart ? 1 : 0) + (dataEnd > dataStart ? 1 : 0);
+
+    // ELF header, patched once the section headers are placed
+    const uint8_t ident[16] = {0x7F, 'E', 'L', 'F', 1 /* 32-bit */, 1 /* little endian */, 1 /* version */};
+    w.bytes(ident, 16);
+    w.u16(2);          // ET_EXEC
+    w.u16(EM_RISCV);
+    w.u32(1);          // EV_CURRENT
+    w.u32(entry);
+    w.u32(phnum ? 52 : 0);  // program headers follow the ELF header
+    size_t shoffAt = w.offset();
+    w.u32(0);
+    w.u32(0);          // e_flags: RV32I, soft float
+    w.u16(52);
+    w.u16(32);
+    w.u16(phnum);
+    w.u16(40);
+    w.u16(6);          // null, .text, .data, .symtab, .strtab, .shstrtab
+    w.u16(5);
+
+    // Segment payloads start on their own page so they can be mapped directly
+    size_t phdrAt = w.offset();
+    w.buffer.resize(phdrAt + phnum * 32, 0);
+    w.align(ELF_PAGE);
+    uint32_t textOffset = static_cast<uint32_t>(w.offset());
+    w.buffer.resize(textOffset + (textEnd - textStart), 0);
+    for (const auto& [address, word] : image.instructionMemory) {
+        w.patch32(textOffset + address - textStart, word);
+    }
+    w.align(ELF_PAGE);
+    uint32_t dataOffset = static_cast<uint32_t>(w.offset());
+    w.buffer.resize(dataOffset + (dataEnd - dataStart), 0);
+    for (const Run& run : data) {
+        std::copy(run.bytes.begin(), run.bytes.end(), w.buffer.begin() + dataOffset + (run.address - dataStart));
+    }
+
+    size_t ph = phdrAt;
+    auto programHeader = [&](uint32_t offset, uint32_t vaddr, uint32_t size, uint32_t flags) {
+        uint32_t fields[8] = {1 /* PT_LOAD */, offset, vaddr, vaddr, size, size, flags, ELF_PAGE};
+        for (int i = 0; i < 8; i++) w.patch32(ph + i * 4, fields[i]);
+        ph += 32;
+    };
+    if (textEnd > textStart) programHeader(textOffset, textStart, textEnd - textStart, 5 /* R+X */);
+    if (dataEnd > dataStart) programHeader(dataOffset, dataStart, dataEnd - dataStart, 6 /* R+W */);
+
+    // Symbols, local numeric labels first as the ELF spec requires
+    std::string strtab(1, '\0');
+    std::vector<std::pair<uint32_t, uint32_t>> symbols = image.symbols.getAddressIndex();
+    std::stable_partition(symbols.begin(), symbols.end(), [&](const std::pair<uint32_t, uint32_t>& symbol) {
+        return image.symbols.getName(symbol.second).find('@') != std::string::npos;
+    });
+    w.align(4);
+    uint32_t symtabOffset = static_cast<uint32_t>(w.offset());
+    w.buffer.resize(w.offset() + 16, 0);  // null symbol
+    uint32_t firstGlobal = 1;
+    for (const auto& [address, id] : symbols) {
+        const std::string& fullName = image.symbols.getName(id);
+        bool local = fullName.find('@') != std::string::npos;
+        std::string name = fullName.substr(0, fullName.find('@'));
+        bool inText = address < RISCV_CONSTANTS::DATA_SEGMENT_START;
+        w.u32(static_cast<uint32_t>(strtab.size()));
+        w.u32(address);
+        w.u32(0);
+        w.u8(local ? 0x00 : 0x10);  // STB_LOCAL / STB_GLOBAL, STT_NOTYPE
+        w.u8(0);
+        w.u16(inText ? 1 : 2);
+        strtab += name;
+        strtab += '\0';
+        if (local) firstGlobal++;
+    }
+    uint32_t symtabSize = static_cast<uint32_t>(w.offset()) - symtabOffset;
+
+    uint32_t strtabOffset = static_cast<uint32_t>(w.offset());
+    w.bytes(reinterpret_cast<const uint8_t*>(strtab.data()), strtab.size());
+    const char shstrtab[] = "\0.text\0.data\0.symtab\0.strtab\0.shstrtab";
+    uint32_t shstrtabOffset = static_cast<uint32_t>(w.offset());
+    w.bytes(reinterpret_cast<const uint8_t*>(shstrtab), sizeof(shstrtab));
+
+    w.align(4);
+    w.patch32(shoffAt, static_cast<uint32_t>(w.offset()));
+    auto sectionHeader = [&w](uint32_t name, uint32_t type, uint32_t flags, uint32_t addr, uint32_t offset,
+                              uint32_t size, uint32_t link, uint32_t info, uint32_t align, uint32_t entsize) {
+        uint32_t fields[10] = {name, type, flags, addr, offset, size, link, info, align, entsize};
+        for (uint32_t field : fields) w.u32(field);
+    };
+    sectionHeader(0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    sectionHeader(1, 1 /* PROGBITS */, 6 /* ALLOC+EXEC */, textStart, textOffset, textEnd - textStart, 0, 0, 4, 0);
+    sectionHeader(7, 1 /* PROGBITS */, 3 /* WRITE+ALLOC */, dataStart, dataOffset, dataEnd - dataStart, 0, 0, 1, 0);
+    sectionHeader(13, 2 /* SYMTAB */, 0, 0, symtabOffset, symtabSize, 4, firstGlobal, 4, 16);
+    sectionHeader(21, 3 /* STRTAB */, 0, 0, strtabOffset, static_cast<uint32_t>(strtab.size()), 0, 0, 1, 0);
+    sectionHeader(29, 3 /* STRTAB */, 0, 0, shstrtabOffset, sizeof(shstrtab), 0, 0, 1, 0);
+}
+
+}
+
+ProgramFormat formatFromPath(const std::string& path) {
+    size_t dot = path.rfind('.');
+    std::string extension = dot == std::string::npos ? "" : path.substr(dot);
+    if (extension == ".elf") return ProgramFormat::Elf;
+    if (extension == ".bin") return ProgramFormat::FlatBinary;
+    return ProgramFormat::Native;
+}
+
+const char* formatName(ProgramFormat format) {
+    switch (format) {
+    case ProgramFormat::Elf: return "elf";
+    case ProgramFormat::FlatBinary: return "bin";
+    default: return "native";
+    }
+}
+
+size_t writeProgramFile(const std::string& path, ProgramFormat format, const ProgramImage& image, uint32_t entry) {
+    Writer w;
+    switch (format) {
+    case ProgramFormat::Native: buildNative(w, image, entry); break;
+    case ProgramFormat::Elf: buildElf(w, image, entry); break;
+    case ProgramFormat::FlatBinary: buildFlatBinary(w, image); break;
+    }
+    writeFile(path, w.buffer);
+    return w.buffer.size();
+}
+
+static uint32_t readNativeImage(const MappedFile& file, const std::string& path, ProgramImage& image) {
+    if (file.size < NATIVE_HEADER_SIZE || file.u32(0) != NATIVE_MAGIC) {
+        throw std::runtime_error(path + " is not a program image");
+    }
+    if (file.u32(4) != NATIVE_VERSION) {
+        throw std::runtime_error(path + " has an unsupported image version");
+    }
+    uint32_t entry = file.u32(8);
+    image.exitAddress = file.u32(12);
+
+    // Everything below is checked against the header and the segments before it is used,
+    // a corrupt image must not make the loader allocate or write outside them
+    auto checkRange = [&](uint64_t address, uint64_t size, bool data) {
+        uint64_t start = data ? RISCV_CONSTANTS::DATA_SEGMENT_START : RISCV_CONSTANTS::TEXT_SEGMENT_START;
+        uint64_t end = data ? RISCV_CONSTANTS::DATA_SEGMENT_END : RISCV_CONSTANTS::DATA_SEGMENT_START;
+        if (address < start || address + size > end) {
+            std::ostringstream message;
+            message << path << ": " << (data ? "data" : "text") << " at 0x" << std::hex << address
+                    << " (" << std::dec << size << " bytes) is outside its segment";
+            throw std::runtime_error(message.str());
+        }
+    };
+
+    // Runs are copied straight out of the mapping
+    size_t offset = file.u32(20);
+    for (uint32_t i = 0, count = file.u32(16); i < count; i++) {
+        uint32_t address = file.u32(offset), size = file.u32(offset + 4);
+        checkRange(address, size, false);
+        const uint8_t* words = file.bytes(offset + 8, size);
+        auto hint = image.instructionMemory.end();
+        for (uint32_t at = 0; at + 4 <= size; at += 4) {
+            uint32_t word = words[at] | (words[at + 1] << 8) | (words[at + 2] << 16) |
+                            (static_cast<uint32_t>(words[at + 3]) << 24);
+            hint = image.instructionMemory.emplace_hint(hint, address + at, word);
+            ++hint;
+        }
+        offset += 8 + (size + 3) / 4 * 4;
+    }
+    offset = file.u32(28);
+    for (uint32_t i = 0, count = file.u32(24); i < count; i++) {
+        uint32_t address = file.u32(offset), size = file.u32(offset + 4);
+        checkRange(address, size, true);
+        image.dataMemory.writeBlock(address, file.bytes(offset + 8, size), size);
+        offset += 8 + (size + 3) / 4 * 4;
+    }
+
+    uint32_t stringOffset = file.u32(48), stringSize = file.u32(52);
+    const char* strings = reinterpret_cast<const char*>(file.bytes(stringOffset, stringSize));
+    auto string = [&](uint32_t at, uint32_t length) {
+        if (at > stringSize || length > stringSize - at) throw std::runtime_error("Truncated program file");
+        return std::string(strings + at, length);
+    };
+
+    offset = file.u32(36);
+    for (uint32_t i = 0, count = file.u32(32); i < count; i++, offset += 12) {
+        image.symbols.define(image.symbols.intern(string(file.u32(offset + 4), file.u32(offset + 8))),
+                             file.u32(offset));
+    }
+
+    // Lines keep their source line number, the lines in between stay blank
+    uint32_t lineCount = file.u32(40), sourceLines = file.u32(60);
+    if (sourceLines > MAX_SOURCE_LINES || lineCount > sourceLines) {
+        throw std::runtime_error(path + " has an invalid line count");
+    }
+    image.lines.resize(sourceLines);
+    offset = file.u32(44);
+    for (uint32_t i = 0, previous = 0; i < lineCount; i++, offset += 24) {
+        uint32_t number = file.u32(offset + 8), flags = file.u32(offset + 12);
+        if (number >= sourceLines || (i > 0 && number <= previous)) {
+            throw std::runtime_error(path + " has an invalid line map");
+        }
+        previous = number;
+        AssembledLine& line = image.lines[number];
+        line.address = file.u32(offset);
+        line.size = file.u32(offset + 4);
+        if (!(flags & LINE_SEGMENT)) checkRange(line.address, line.size, flags & LINE_DATA);
+        line.text = string(file.u32(offset + 16), file.u32(offset + 20));
+        line.info.isInstruction = flags & LINE_INSTRUCTION;
+        line.info.isExit = flags & LINE_EXIT;
+        line.info.setsSegment = flags & LINE_SEGMENT;
+        line.inData = flags & LINE_DATA;
+        if (line.info.isInstruction) {
+            auto it = image.instructionMemory.find(line.address);
+            line.word = it != image.instructionMemory.end() ? it->second : 0;
+        } else if (line.size > 0 && image.dataMemory.anyWritten(line.address, line.size)) {
+            line.bytes.resize(line.size);
+            image.dataMemory.readBlock(line.address, line.bytes.data(), line.size);
+        }
+    }
+    return entry;
+}
+
+static uint32_t readElf(const MappedFile& file, const std::string& path, ProgramImage& image, LoadedProgram& loaded) {
+    const uint8_t* ident = file.bytes(0, 52);
+    if (ident[4] != 1 || ident[5] != 1) {
+        throw std::runtime_error(path + " is not a 32-bit little-endian ELF file");
+    }
+    if (file.u16(18) != EM_RISCV) {
+        throw std::runtime_error(path + " is not a RISC-V executable");
+    }
+    if (file.u16(16) != 2) {
+        throw std::runtime_error(path + " is not an executable (ET_EXEC) ELF file");
+    }
+    if (file.u32(36) & EF_RISCV_RVC) {
+        throw std::runtime_error(path + " uses compressed instructions, which the simulator does not support");
+    }
+    uint32_t entry = file.u32(24);
+    uint32_t phoff = file.u32(28), shoff = file.u32(32);
+    uint16_t phentsize = file.u16(42), phnum = file.u16(44);
+    uint16_t shentsize = file.u16(46), shnum = file.u16(48);
+
+    // [start, end) of the code sections. The linker puts .rodata in the executable segment as well,
+    // so when the section headers are there only these words are instructions
+    std::vector<std::pair<uint32_t, uint32_t>> code;
+    for (uint16_t i = 0; i < shnum; i++) {
+        size_t sh = shoff + static_cast<size_t>(i) * shentsize;
+        if (file.u32(sh + 4) == SHT_PROGBITS && (file.u32(sh + 8) & SHF_EXECINSTR)) {
+            code.push_back({file.u32(sh + 12), file.u32(sh + 12) + file.u32(sh + 20)});
+        }
+    }
+    auto isCode = [&](uint32_t address) {
+        if (code.empty()) return true;
+        for (const auto& [start, end] : code) {
+            if (address >= start && address < end) return true;
+        }
+        return false;
+    };
+
+    image.exitAddress = std::numeric_limits<uint32_t>::max();
+    for (uint16_t i = 0; i < phnum; i++) {
+        size_t ph = phoff + static_cast<size_t>(i) * phentsize;
+        if (file.u32(ph) != PT_LOAD) continue;
+        uint32_t offset = file.u32(ph + 4), vaddr = file.u32(ph + 8);
+        uint32_t filesz = file.u32(ph + 16), memsz = file.u32(ph + 20), flags = file.u32(ph + 24);
+        const uint8_t* payload = file.bytes(offset, filesz);
+
+        // Every segment is data mapped at its own address, so that code can read the constants
+        // linked next to it. .bss stays unallocated
+        uint64_t end = static_cast<uint64_t>(vaddr) + std::max(memsz, filesz);
+        if (end > RISCV_CONSTANTS::STACK_START && vaddr < RISCV_CONSTANTS::STACK_END) {
+            std::ostringstream message;
+            message << "Segment at 0x" << std::hex << vaddr << " (" << std::dec << memsz
+                    << " bytes) overlaps the stack at 0x" << std::hex << RISCV_CONSTANTS::STACK_START;
+            throw std::runtime_error(message.str());
+        }
+        if (vaddr < RISCV_CONSTANTS::DATA_SEGMENT_START || end > RISCV_CONSTANTS::DATA_SEGMENT_END) {
+            loaded.mappedData.push_back({vaddr, static_cast<uint32_t>(end)});
+        }
+        image.dataMemory.writeBlock(vaddr, payload, filesz);
+
+        AssembledLine data;
+        data.inData = true;
+        data.address = vaddr;
+        data.size = filesz;
+        data.bytes.assign(payload, payload + filesz);
+        image.lines.push_back(std::move(data));
+
+        if (flags & PF_X) {
+            // Executable segments are instruction memory as well, one word per instruction
+            if (vaddr % 4 != 0) {
+                std::ostringstream message;
+                message << "Executable segment at 0x" << std::hex << vaddr << " is not word aligned";
+                throw std::runtime_error(message.str());
+            }
+            for (uint32_t at = 0; at + 4 <= filesz; at += 4) {
+                if (!isCode(vaddr + at)) continue;
+                uint32_t word = payload[at] | (payload[at + 1] << 8) | (payload[at + 2] << 16) |
+                                (static_cast<uint32_t>(payload[at + 3]) << 24);
+                image.instructionMemory[vaddr + at] = word;
+                if (word == EXIT_WORD) image.exitAddress = vaddr + at;
+
+                AssembledLine line;
+                line.info.isInstruction = true;
+                line.info.isExit = word == EXIT_WORD;
+                line.address = vaddr + at;
+                line.size = 4;
+                line.word = word;
+                image.lines.push_back(std::move(line));
+            }
+        }
+    }
+
+    // Symbols of every .symtab, the global pointer comes from __global_pointer$ when present
+    for (uint16_t i = 0; i < shnum; i++) {
+        size_t sh = shoff + static_cast<size_t>(i) * shentsize;
+        if (file.u32(sh + 4) != SHT_SYMTAB) continue;
+        uint32_t offset = file.u32(sh + 16), size = file.u32(sh + 20), link = file.u32(sh + 24);
+        uint32_t entsize = file.u32(sh + 36);
+        if (entsize < 16 || link >= shnum) continue;
+        size_t strtab = shoff + static_cast<size_t>(link) * shentsize;
+        uint32_t strOffset = file.u32(strtab + 16), strSize = file.u32(strtab + 20);
+        const char* strings = reinterpret_cast<const char*>(file.bytes(strOffset, strSize));
+
+        for (uint32_t at = entsize; at + 16 <= size; at += entsize) {
+            size_t symbol = offset + at;
+            uint32_t nameOffset = file.u32(symbol), value = file.u32(symbol + 4);
+            uint8_t type = file.bytes(symbol + 12, 1)[0] & 0xF;
+            uint16_t section = file.u16(symbol + 14);
+            // Skip undefined symbols and the STT_SECTION / STT_FILE entries
+            if (section == 0 || type == 3 || type == 4 || nameOffset >= strSize) continue;
+            std::string name(strings + nameOffset, strnlen(strings + nameOffset, strSize - nameOffset));
+            if (name.empty()) continue;
+            image.symbols.define(image.symbols.intern(name), value);
+            if (name == "__global_pointer$") loaded.globalPointer = value;
+        }
+    }
+
+    // Toolchain programs have no exit marker, finishing in exit() counts as exiting
+    if (image.exitAddress == std::numeric_limits<uint32_t>::max()) {
+        for (const char* name : {"_exit", "exit"}) {
+            if (image.symbols.labelExists(name)) {
+                image.exitAddress = image.symbols.getAddress(name);
+                break;
+            }
+        }
+    }
+    return entry;
+}
+
+LoadedProgram readProgramFile(const std::string& path, ProgramImage& image) {
+    MappedFile file(path);
+    LoadedProgram loaded;
+    loaded.globalPointer = RISCV_CONSTANTS::DATA_SEGMENT_START;
+    if (file.size >= 4 && file.data[0] == 0x7F && file.data[1] == 'E' && file.data[2] == 'L' && file.data[3] == 'F') {
+        loaded.format = ProgramFormat::Elf;
+        loaded.entry = readElf(file, path, image, loaded);
+    } else {
+        loaded.format = ProgramFormat::Native;
+        loaded.entry = readNativeImage(file, path, image);
+    }
+    // Reported now rather than when the CPU first fetches one
+    for (const auto& [address, word] : image.instructionMemory) {
+        if (word != EXIT_WORD && !Cpu::canDecode(word)) loaded.unsupported.push_back(address);
+    }
+    return loaded;
+}
@@ -0,0 +1,141 @@
+#include "program_image.h"
+#include <limits>
+
+namespace {
+
+constexpr uint32_t IMAGE_MAGIC = 0x43565352; // "RSVC"
+constexpr uint32_t IMAGE_VERSION = 3;
+
+void writeU32(std::ostream& out, uint32_t value) {
+    char bytes[4] = {
+        static_cast<char>(value & 0xFF),
+        static_cast<char>((value >> 8) & 0xFF),
+        static_cast<char>((value >> 16) & 0xFF),
+        static_cast<char>((value >> 24) & 0xFF)
+    };
+    out.write(bytes, 4);
+}
+
+void writeString(std::ostream& out, const std::string& str) {
+    writeU32(out, static_cast<uint32_t>(str.size()));
+    out.write(str.data(), str.size());
+}
+
+bool readU32(std::istream& in, uint32_t& value) {
+    unsigned char bytes[4];
+    if (!in.read(reinterpret_cast<char*>(bytes), 4)) return false;
+    value = bytes[0] | (bytes[1] << 8) | (bytes[2] << 16) | (static_cast<uint32_t>(bytes[3]) << 24);
+    return true;
+}
+
+bool readString(std::istream& in, std::string& str) {
+    uint32_t size;
+    if (!readU32(in, size)) return false;
+    str.resize(size);
+    return static_cast<bool>(in.read(&str[0], size));
+}
+
+}
+
+void writeProgramImage(std::ostream& out, const ProgramImage& image) {
+    writeU32(out, IMAGE_MAGIC);
+    writeU32(out, IMAGE_VERSION);
+    writeString(out, image.source);
+
+    writeU32(out, static_cast<uint32_t>(image.lines.size()));
+    for (const AssembledLine& line : image.lines) {
+        writeString(out, line.text);
+        writeU32(out, static_cast<uint32_t>(line.info.labels.size()));
+        for (uint32_t label : line.info.labels) writeU32(out, label);
+        writeU32(out, static_cast<uint32_t>(line.info.labelUses.size()));
+        for (const LineInfo::LabelUse& use : line.info.labelUses) {
+            writeU32(out, use.operand);
+            writeU32(out, use.symbol);
+        }
+        uint32_t flags = (line.info.setsSegment ? 1 : 0) | (line.info.isInstruction ? 2 : 0) |
+                         (line.info.isExit ? 4 : 0) | (line.inData ? 8 : 0) |
+                         (line.info.usesLocalLabels ? 16 : 0);
+        writeU32(out, flags);
+        writeU32(out, line.info.alignment);
+        writeU32(out, line.address);
+        writeU32(out, line.size);
+        writeU32(out, line.word);
+        writeU32(out, static_cast<uint32_t>(line.bytes.size()));
+        out.write(reinterpret_cast<const char*>(line.bytes.data()), line.bytes.size());
+    }
+
+    // Symbols in id order so the ids stored in the lines stay valid
+    writeU32(out, static_cast<uint32_t>(image.symbols.size()));
+    for (uint32_t id = 0; id < image.symbols.size(); id++) {
+        writeString(out, image.symbols.getName(id));
+        writeU32(out, image.symbols.isDefined(id) ? 1 : 0);
+        writeU32(out, image.symbols.getAddress(id));
+    }
+    writeU32(out, image.exitAddress);
+}
+
+bool readProgramImage(std::istream& in, ProgramImage& image) {
+    uint32_t magic, version, count;
+    if (!readU32(in, magic) || magic != IMAGE_MAGIC) return false;
+    if (!readU32(in, version) || version != IMAGE_VERSION) return false;
+    if (!readString(in, image.source)) return false;
+
+    if (!readU32(in, count)) return false;
+    image.lines.resize(count);
+    for (AssembledLine& line : image.lines) {
+        uint32_t labels, flags, bytes;
+        if (!readString(in, line.text) || !readU32(in, labels)) return false;
+        line.info.labels.resize(labels);
+        for (uint32_t& label : line.info.labels) {
+            if (!readU32(in, label)) return false;
+        }
+        if (!readU32(in, labels)) return false;
+        line.info.labelUses.resize(labels);
+        for (LineInfo::LabelUse& use : line.info.labelUses) {
+            if (!readU32(in, use.operand) || !readU32(in, use.symbol)) return false;
+        }
+        if (!readU32(in, flags) || !readU32(in, line.info.alignment) || !readU32(in, line.address) || !readU32(in, line.size) ||
+            !readU32(in, line.word) || !readU32(in, bytes)) return false;
+        line.info.setsSegment = flags & 1;
+        line.info.isInstruction = flags & 2;
+        line.info.isExit = flags & 4;
+        line.inData = flags & 8;
+        line.info.usesLocalLabels = flags & 16;
+        line.bytes.resize(bytes);
+        if (!in.read(reinterpret_cast<char*>(line.bytes.data()), bytes)) return false;
+    }
+
+    if (!readU32(in, count)) return false;
+    image.symbols.clear();
+    for (uint32_t i = 0; i < count; i++) {
+        std::string label;
+        uint32_t defined, address;
+        if (!readString(in, label) || !readU32(in, defined) || !readU32(in, address)) return false;
+        uint32_t id = image.symbols.intern(label);
+        if (id != i) return false;
+        if (defined) image.symbols.define(id, address);
+    }
+    // Line infos must only refer to symbols of this image
+    for (const AssembledLine& line : image.lines) {
+        for (uint32_t label : line.info.labels) {
+            if (label >= count) return false;
+        }
+        for (const LineInfo::LabelUse& use : line.info.labelUses) {
+            if (use.symbol >= count) return false;
+        }
+    }
+    if (!readU32(in, image.exitAddress)) return false;
+
+    // Rebuild the memory contents from the encoded lines
+    image.instructionMemory.clear();
+    image.dataMemory.clear();
+    for (const AssembledLine& line : image.lines) {
+        if (line.size == 0) continue;
+        if (line.info.isInstruction) {
+            image.instructionMemory[line.address] = line.word;
+        } else if (!line.bytes.empty()) {
+            image.dataMemory.writeBlock(line.address, line.bytes.data(), line.bytes.size());
+        }
+    }
+    return true;
+}
@@ -0,0 +1,788 @@
+#include "session.h"
+#include "locality.h"
+#include "timing_model.h"
+#include "work_pool.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <sstream>
+#include <stdexcept>
+#include <vector>
+
+std::shared_ptr<AssemblyCache> SessionOptions::makeCache() const {
+    auto made = std::make_shared<AssemblyCache>();
+    made->setCapacity(cacheSize);
+    if (!cacheDirectory.empty()) {
+        made->setDirectory(cacheDirectory);
+    }
+    return made;
+}
+
+Session::Session(const SessionOptions& options)
+    : defaultRunMilliseconds(options.runMilliseconds), maxRunMilliseconds(options.maxRunMilliseconds),
+      defaultAnalysisCycles(options.analysisCycles), cpu(memory),
+      assembler(memory, options.cache ? options.cache : options.makeCache()) {
+}
+
+RunBudget RunBudget::parse(const std::string& arguments) {
+    RunBudget budget;
+    std::istringstream in(arguments);
+    std::string limit;
+    while (in >> limit) {
+        size_t equals = limit.find('=');
+        std::string name = limit.substr(0, equals);
+        uint64_t* field = name == "cycles" ? &budget.cycles
+                        : name == "instructions" ? &budget.instructions
+                        : name == "ms" ? &budget.milliseconds : nullptr;
+        if (!field || equals == std::string::npos) {
+            throw std::runtime_error("Unknown run limit: " + limit);
+        }
+        *field = std::stoull(limit.substr(equals + 1));
+    }
+    return budget;
+}
+
+bool Session::needsPayload(const std::string& command) {
+    return command == "assemble" || command == "edit";
+}
+
+bool Session::isRun(const std::string& command) {
+    return command == "run" || command.rfind("run ", 0) == 0;
+}
+
+RunBudget Session::runBudget(const std::string& command) const {
+    size_t space = command.find(' ');
+    RunBudget budget = RunBudget::parse(space == std::string::npos ? "" : command.substr(space + 1));
+    limitTime(budget);
+    return budget;
+}
+
+void Session::limitTime(RunBudget& budget) const {
+    if (!budget.milliseconds) budget.milliseconds = defaultRunMilliseconds;
+    if (maxRunMilliseconds && (!budget.milliseconds || budget.milliseconds > maxRunMilliseconds)) {
+        budget.milliseconds = maxRunMilliseconds;
+    }
+}
+
+void Session::limitAnalysis(RunBudget& budget) const {
+    if (!budget.cycles && !budget.instructions) budget.cycles = defaultAnalysisCycles;
+}
+
+bool Session::execute(const std::string& command, const JsonRequest& request, JsonWriter& json) {
+    if (command == "assemble") {
+        assembleAndOutput(request.getString("input_code"), json);
+    } else if (command == "edit") {
+        // Expects { "start_line": a, "end_line": b, "input_code": "..." } replacing lines [a, b)
+        editAndOutput(request.getNumber("start_line"), request.getNumber("end_line"), request.getString("input_code"), json);
+    } else if (command.rfind("save ", 0) == 0) {
+        saveAndOutput(command.substr(5), json);
+    } else if (command.rfind("load ", 0) == 0) {
+        cpu.reset();
+        loadAndOutput(command.substr(5), json);
+    } else if (command == "reset") {
+        // Back to the state of a fresh process, so a pooled process can serve another user
+        cpu.resetPipeline();
+        cpu.reset();
+        assembler.clear();
+        cpu.traceWriter = nullptr;
+        recorder.reset();
+        cpu.instructionCache.reset();
+        cpu.dataCache.reset();
+        cpu.dram.reset();
+        cpu.instructionPrefetcher.reset();
+        cpu.dataPrefetcher.reset();
+        cpu.functionalUnits.reset();
+        json.raw("{ \"reset\": true }");
+    } else if (isRun(command)) {
+        runAndOutput(runBudget(command), nullptr, json);
+    } else if (command == "sweep" || command.rfind("sweep ", 0) == 0) {
+        RunBudget budget = runBudget(command);
+        limitAnalysis(budget);
+        sweepAndOutput(budget, json);
+    } else if (command == "trace" || command.rfind("trace ", 0) == 0) {
+        RunBudget budget = runBudget(command);
+        limitAnalysis(budget);
+        traceAndOutput(budget, json);
+    } else if (command == "locality" || command.rfind("locality ", 0) == 0) {
+        localityAndOutput(command.size() > 9 ? command.substr(9) : "", json);
+    } else if (command == "replay") {
+        replayAndOutput(json);
+    } else if (command.rfind("record ", 0) == 0) {
+        recordAndOutput(command.substr(7), json);
+    } else if (command == "profile" || command.rfind("profile ", 0) == 0) {
+        profileAndOutput(command.size() > 8 ? command.substr(8) : "", json);
+    } else if (command == "cache" || command.rfind("cache ", 0) == 0) {
+        cacheAndOutput(command.size() > 6 ? command.substr(6) : "", json);
+    } else if (command == "dram" || command.rfind("dram ", 0) == 0) {
+        dramAndOutput(command.size() > 5 ? command.substr(5) : "", json);
+    } else if (command == "prefetch" || command.rfind("prefetch ", 0) == 0) {
+        prefetchAndOutput(command.size() > 9 ? command.substr(9) : "", json);
+    } else if (command == "latency" || command.rfind("latency ", 0) == 0) {
+        latencyAndOutput(command.size() > 8 ? command.substr(8) : "", json);
+    } else if (command == "step") {
+        stepAndOutput(json);
+    } else if (command == "pipeline") {
+        toggleAndOutput(cpu.pipeline, json);
+    } else if (command == "data_forward") {
+        toggleAndOutput(cpu.data_forward, json);
+    } else if (command == "branch_prediction") {
+        toggleAndOutput(cpu.predictionBool, json);
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void Session::assembleAndOutput(const std::string& source, JsonWriter& json) {
+    cpu.reset();
+    assembler.assemble(source);
+    assembler.dumpMachineCode(json);
+}
+
+void Session::editAndOutput(size_t startLine, size_t endLine, const std::string& source, JsonWriter& json) {
+    // Once the program has executed, memory no longer holds the assembled image
+    if (cpu.clock != 0) {
+        cpu.reset();
+        assembler.reload();
+    }
+
+    assembler.edit(startLine, endLine, source);
+    assembler.dumpMachineCode(json);
+}
+
+// `save <file>`: .elf, .bin or a native image for any other extension
+void Session::saveAndOutput(const std::string& path, JsonWriter& json) {
+    // Once the program has executed, memory no longer holds the assembled image
+    if (cpu.clock != 0) {
+        cpu.reset();
+        assembler.reload();
+    }
+
+    size_t bytes = assembler.save(path);
+    json.raw("{ \"saved\": ").string(path).raw(", \"format\": \"").raw(formatName(formatFromPath(path)))
+        .raw("\", \"bytes\": ").number(bytes).raw(" }");
+}
+
+// `load <file>`: replaces the program with a saved image or an ELF executable without reparsing any source
+void Session::loadAndOutput(const std::string& path, JsonWriter& json) {
+    assembler.load(path);
+    cpu.PC = assembler.getEntryPoint();
+    cpu.registers[3] = assembler.getGlobalPointer();
+    assembler.dumpMachineCode(json);
+}
+
+// Opens the response object with the memory, registers and clock shared by every CPU command
+void Session::writeMachineState(JsonWriter& json) {
+    json.raw("{ \"data_segment\": {");
+    memory.dumpMemory(json);
+    json.raw("}, \"instruction_memory\": {");
+    memory.dumpInstructions(json);
+    json.raw("}, \"stack\": {");
+    memory.dumpStack(json);
+    json.raw("}, \"registers\": {");
+    cpu.dumpRegisters(json);
+    json.raw("}, \"clock_cycles\": ").number(cpu.clock).raw(' ');
+}
+
+void Session::writeComment(JsonWriter& json) {
+    json.raw(", \"comment\": \"");
+    memory.dumpComments(json);
+    json.raw('"');
+}
+
+void Session::writeModes(JsonWriter& json) {
+    json.raw(", \"pipeline\":").onOff(cpu.pipeline);
+    json.raw(", \"data_forward\":").onOff(cpu.data_forward);
+}
+
+void RunControl::begin(const Cpu& cpu) {
+    request = NONE;
+    cycles = cpu.clock;
+    instructions = cpu.totalInstructions;
+    pc = cpu.PC;
+    started = std::chrono::steady_clock::now();
+}
+
+void RunControl::writeStatus(JsonWriter& json) const {
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+    json.raw("{ \"running\": true, \"cycles\": ").number(cycles.load())
+        .raw(", \"instructions\": ").number(instructions.load())
+        .raw(", \"pc\": ").hexString(pc.load())
+        .raw(", \"elapsed_ms\": ").number(static_cast<uint64_t>(elapsed.count())).raw(" }");
+}
+
+void Session::runAndOutput(const RunBudget& budget, RunControl* control, JsonWriter& json) {
+    CycleGenerator run = runSlices(budget, control, json);
+    while (run.next()) {
+    }
+}
+
+CycleGenerator Session::runSlices(RunBudget budget, RunControl* control, JsonWriter& json) {
+    auto started = std::chrono::steady_clock::now();
+    uint64_t clockLimit = budget.cycles ? cpu.clock + budget.cycles : UINT64_MAX;
+    uint64_t instructionLimit = budget.instructions ? cpu.totalInstructions + budget.instructions : UINT64_MAX;
+    const char* stopped = nullptr;
+
+    CycleGenerator execution = cpu.execution(SLICE_CYCLES, clockLimit, instructionLimit);
+    while (execution.next()) {
+        if (control) {
+            control->cycles = cpu.clock;
+            control->instructions = cpu.totalInstructions;
+            control->pc = cpu.PC;
+            if (control->onSlice) control->onSlice();
+            int request = control->request.exchange(RunControl::NONE);
+            if (request != RunControl::NONE) {
+                stopped = request == RunControl::PAUSE ? "paused" : "cancelled";
+                break;
+            }
+        }
+        if (budget.milliseconds && std::chrono::steady_clock::now() - started >= std::chrono::milliseconds(budget.milliseconds)) {
+            stopped = "time";
+            break;
+        }
+        co_yield cpu.clock;
+    }
+    if (!stopped && !cpu.finished()) {
+        stopped = cpu.clock >= clockLimit ? "cycles" : "instructions";
+    }
+
+    writeMachineState(json);
+    writeModes(json);
+    writeCounters(json);
+    if (stopped) {
+        json.raw(", \"stopped\": \"").raw(stopped).raw('"');
+    }
+    json.raw(" }");
+
+    if (stopped && std::string(stopped) == "cancelled") {
+        cpu.flushPipeline();
+        rewind();
+    }
+}
+
+// Back to the start of the program once it has executed, memory no longer holds the assembled image then
+void Session::rewind() {
+    if (cpu.clock == 0) {
+        return;
+    }
+    cpu.reset();
+    assembler.reload();
+    cpu.PC = assembler.getEntryPoint();
+    cpu.registers[3] = assembler.getGlobalPointer();
+}
+
+void Session::loadCopy(Memory& image, Cpu& copy, std::shared_ptr<const Memory::Text> text) const {
+    image.sharedText = std::move(text);
+    assembler.storeData(image);
+    copy.PC = assembler.getEntryPoint();
+    copy.registers[3] = assembler.getGlobalPointer();
+}
+
+const char* Session::runWithin(Cpu& cpu, const RunBudget& budget) {
+    auto started = std::chrono::steady_clock::now();
+    uint64_t clockLimit = budget.cycles ? cpu.clock + budget.cycles : UINT64_MAX;
+    uint64_t instructionLimit = budget.instructions ? cpu.totalInstructions + budget.instructions : UINT64_MAX;
+
+    CycleGenerator execution = cpu.execution(SLICE_CYCLES, clockLimit, instructionLimit);
+    while (execution.next()) {
+        if (budget.milliseconds && std::chrono::steady_clock::now() - started >= std::chrono::milliseconds(budget.milliseconds)) {
+            return "time";
+        }
+    }
+    if (cpu.finished()) {
+        return nullptr;
+    }
+    return cpu.clock >= clockLimit ? "cycles" : "instructions";
+}
+
+// `sweep [limits]`: runs the program from its start under every mode combination at once and
+// compares them. Each run gets its own stack and copy-on-write data, the text is shared.
+void Session::sweepAndOutput(const RunBudget& budget, JsonWriter& json) {
+    if (memory.instructionMemory.empty()) {
+        throw std::runtime_error("Nothing to sweep, assemble a program first");
+    }
+    auto text = std::make_shared<const Memory::Text>(memory.instructionMemory);
+
+    struct Configuration {
+        const char* name;
+        bool pipeline;
+        bool dataForward;
+        bool branchPrediction;
+    };
+    // Forwarding and prediction only act on the pipeline
+    static const Configuration configurations[] = {
+        {"single_cycle", false, false, false},
+        {"pipeline", true, false, false},
+        {"pipeline+forward", true, true, false},
+        {"pipeline+prediction", true, false, true},
+        {"pipeline+forward+prediction", true, true, true},
+    };
+    constexpr size_t count = sizeof(configurations) / sizeof(configurations[0]);
+
+    std::vector<JsonWriter> results(count);
+    WorkPool::shared().run(count, [&](size_t i) {
+        const Configuration& configuration = configurations[i];
+        JsonWriter& out = results[i];
+        out.raw("{ \"config\": \"").raw(configuration.name)
+            .raw("\", \"pipeline\": ").boolean(configuration.pipeline)
+            .raw(", \"data_forward\": ").boolean(configuration.dataForward)
+            .raw(", \"branch_prediction\": ").boolean(configuration.branchPrediction);
+        try {
+            Memory image;
+            Cpu sweepCpu(image);
+            loadCopy(image, sweepCpu, text);
+            sweepCpu.pipeline = configuration.pipeline;
+            sweepCpu.data_forward = configuration.dataForward;
+            sweepCpu.predictionBool = configuration.branchPrediction;
+            if (cpu.instructionCache) sweepCpu.instructionCache = std::make_unique<Cache>(cpu.instructionCache->config());
+            if (cpu.dataCache) sweepCpu.dataCache = std::make_unique<Cache>(cpu.dataCache->config());
+            if (cpu.dram) sweepCpu.dram = std::make_unique<Dram>(cpu.dram->config());
+            if (cpu.instructionPrefetcher) {
+                sweepCpu.instructionPrefetcher = std::make_unique<NextLinePrefetcher>(cpu.instructionPrefetcher->config());
+            }
+            if (cpu.dataPrefetcher) sweepCpu.dataPrefetcher = std::make_unique<StridePrefetcher>(cpu.dataPrefetcher->config());
+            if (cpu.functionalUnits) {
+                sweepCpu.functionalUnits = std::make_unique<FunctionalUnits>(cpu.functionalUnits->config());
+            }
+
+            const char* stopped = runWithin(sweepCpu, budget);
+            double cpi = sweepCpu.totalInstructions ? std::round(1000.0 * sweepCpu.clock / sweepCpu.totalInstructions) / 1000 : 0;
+            out.raw(", \"status\": \"").raw(stopped ? stopped : "exited")
+                .raw("\", \"clock\": ").number(sweepCpu.clock)
+                .raw(", \"instructions\": ").number(sweepCpu.totalInstructions)
+                .raw(", \"cpi\": ").number(cpi)
+                .raw(", \"totalBubbles\": ").number(sweepCpu.totalBubbles)
+                .raw(", \"totalDataHazards\": ").number(sweepCpu.totalDataHazards)
+                .raw(", \"totalControlHazards\": ").number(sweepCpu.totalControlHazards)
+                .raw(", \"totalBranchMissPredictions\": ").number(sweepCpu.totalBranchMissPredictions);
+            if (sweepCpu.instructionCache || sweepCpu.dataCache) {
+                out.raw(", \"totalMemoryStallCycles\": ").number(sweepCpu.totalMemoryStallCycles);
+            }
+            if (sweepCpu.functionalUnits) {
+                out.raw(", \"totalFunctionalUnitBubbles\": ").number(sweepCpu.totalFunctionalUnitBubbles);
+            }
+            out.raw(" }");
+        } catch (const std::exception& e) {
+            out.raw(", \"status\": \"error\", \"error\": ").string(e.what()).raw(" }");
+        }
+    });
+
+    json.raw("{ \"sweep\": [");
+    for (size_t i = 0; i < count; i++) {
+        json.raw(i ? ", " : "").raw(results[i].str());
+    }
+    json.raw("] }");
+}
+
+// `trace [limits]`: records the dynamic trace of a functional run from the start of the program.
+// Like `sweep` it runs on a copy of the program and leaves the session's own state alone.
+void Session::traceAndOutput(const RunBudget& budget, JsonWriter& json) {
+    if (memory.instructionMemory.empty()) {
+        throw std::runtime_error("Nothing to trace, assemble a program first");
+    }
+
+    auto started = std::chrono::steady_clock::now();
+    Memory image;
+    Cpu tracer(image);
+    loadCopy(image, tracer, std::make_shared<const Memory::Text>(memory.instructionMemory));
+    trace.clear();
+    tracer.onRetire = [&](const Instruction& instruction) {
+        trace.push_back(makeTraceRecord(instruction, tracer.RZ, tracer.PC));
+    };
+    const char* stopped = runWithin(tracer, budget);
+    auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+
+    json.raw("{ \"trace\": { \"status\": \"").raw(stopped ? stopped : "exited")
+        .raw("\", \"instructions\": ").number(trace.size())
+        .raw(", \"bytes\": ").number(trace.size() * sizeof(TraceRecord))
+        .raw(", \"us\": ").number(static_cast<uint64_t>(elapsed.count())).raw(" } }");
+}
+
+// `locality [line=N] [page=N] [window=N] [pages=N] [limits]`: the reuse distances, page heat map and working
+// set of the fetch and of the load/store address streams of a functional run from the start of the program.
+// Like `trace` it runs on a copy of the program and leaves the session's own state alone.
+void Session::localityAndOutput(const std::string& arguments, JsonWriter& json) {
+    if (memory.instructionMemory.empty()) {
+        throw std::runtime_error("Nothing to analyse, assemble a program first");
+    }
+    LocalityConfig config;
+    std::istringstream in(arguments);
+    std::string option, limits;
+    while (in >> option) {
+        if (!config.apply(option)) limits += option + " ";
+    }
+    RunBudget budget = RunBudget::parse(limits);
+    limitTime(budget);
+    limitAnalysis(budget);
+
+    auto started = std::chrono::steady_clock::now();
+    Memory image;
+    Cpu analysed(image);
+    loadCopy(image, analysed, std::make_shared<const Memory::Text>(memory.instructionMemory));
+    LocalityAnalysis fetches(config), data(config);
+    analysed.onRetire = [&](const Instruction& instruction) {
+        fetches.access(instruction.instructionPC, false);
+        TraceKind kind = traceKind(instruction.getOpcode());
+        if (kind == TraceKind::LOAD || kind == TraceKind::STORE) {
+            data.access(analysed.RZ, kind == TraceKind::STORE);
+        }
+    };
+    const char* stopped = runWithin(analysed, budget);
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - started);
+
+    json.raw("{ \"locality\": { \"status\": \"").raw(stopped ? stopped : "exited")
+        .raw("\", \"instructions\": ").number(analysed.totalInstructions)
+        .raw(", \"line\": ").number(config.lineSize)
+        .raw(", \"page\": ").number(config.pageSize)
+        .raw(", \"ms\": ").number(static_cast<uint64_t>(elapsed.count()))
+        .raw(", \"fetch\": ");
+    fetches.dump(json);
+    json.raw(", \"data\": ");
+    data.dump(json);
+    json.raw(" } }");
+}
+
+// `replay`: the recorded trace through the timing model under every forwarding and predictor setting
+void Session::replayAndOutput(JsonWriter& json) {
+    if (trace.empty()) {
+        throw std::runtime_error("Nothing to replay, record a trace first");
+    }
+
+    json.raw("{ \"replay\": [");
+    bool first = true;
+    for (bool dataForward : {false, true}) {
+        for (TimingModel::Predictor predictor :
+             {TimingModel::Predictor::NONE, TimingModel::Predictor::ONE_BIT, TimingModel::Predictor::BIMODAL}) {
+            TimingModel::Config config;
+            config.dataForward = dataForward;
+            config.predictor = predictor;
+
+            auto started = std::chrono::steady_clock::now();
+            TimingModel::Result result = TimingModel::replay(trace, config);
+            auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - started);
+
+            std::string name = "pipeline";
+            if (dataForward) name += "+forward";
+            if (predictor != TimingModel::Predictor::NONE) name += std::string("+") + TimingModel::predictorName(predictor);
+            double cpi = result.instructions ? std::round(1000.0 * result.cycles / result.instructions) / 1000 : 0;
+
+            json.raw(first ? "" : ", ").raw("{ \"config\": \"").raw(name)
+                .raw("\", \"data_forward\": ").boolean(dataForward)
+                .raw(", \"predictor\": \"").raw(TimingModel::predictorName(predictor))
+                .raw("\", \"clock\": ").number(result.cycles)
+                .raw(", \"instructions\": ").number(result.instructions)
+                .raw(", \"cpi\": ").number(cpi)
+                .raw(", \"totalBubbles\": ").number(result.bubbles)
+                .raw(", \"totalDataHazards\": ").number(result.dataHazards)
+                .raw(", \"totalDataHazardBubbles\": ").number(result.dataHazardBubbles)
+                .raw(", \"forwards\": ").number(result.forwards)
+                .raw(", \"totalControlHazards\": ").number(result.controlHazards)
+                .raw(", \"totalControlHazardBubbles\": ").number(result.controlHazardBubbles)
+                .raw(", \"totalBranchMissPredictions\": ").number(result.branchMispredictions)
+                .raw(", \"us\": ").number(static_cast<uint64_t>(elapsed.count())).raw(" }");
+            first = false;
+        }
+    }
+    json.raw("] }");
+}
+
+// `record <path> [occupancy]` streams everything the CPU executes from then on into a binary trace file,
+// `record off` completes the file and reports its size
+void Session::recordAndOutput(const std::string& arguments, JsonWriter& json) {
+    std::istringstream in(arguments);
+    std::string path, option;
+    in >> path;
+    bool occupancy = false;
+    while (in >> option) {
+        if (option != "occupancy") {
+            throw std::runtime_error("Unknown record option: " + option);
+        }
+        occupancy = true;
+    }
+    if (path.empty()) {
+        throw std::runtime_error("record needs a file path or off");
+    }
+
+    if (path == "off") {
+        if (!recorder) {
+            throw std::runtime_error("Not recording");
+        }
+        cpu.traceWriter = nullptr;
+        std::unique_ptr<TraceWriter> finished = std::move(recorder);
+        finished->finish();
+        json.raw("{ \"record\": { \"recording\": false, \"instructions\": ").number(finished->instructions())
+            .raw(", \"cycles\": ").number(finished->cycles())
+            .raw(", \"chunks\": ").number(finished->chunks())
+            .raw(", \"bytes\": ").number(finished->bytes()).raw(" } }");
+        return;
+    }
+
+    // A new file completes the one being recorded
+    cpu.traceWriter = nullptr;
+    recorder.reset();
+    recorder = std::make_unique<TraceWriter>(path, occupancy);
+    cpu.traceWriter = recorder.get();
+    json.raw("{ \"record\": { \"recording\": true, \"path\": ").string(path)
+        .raw(", \"occupancy\": ").boolean(occupancy).raw(" } }");
+}
+
+// `profile [N]`: the N (default 10) instructions the run spent most cycles on, counting one issue slot
+// per execution plus the bubbles they waited in decode and the fetch slots lost after them
+void Session::profileAndOutput(const std::string& arguments, JsonWriter& json) {
+    size_t count = 10;
+    if (!arguments.empty()) {
+        try {
+            count = std::stoul(arguments);
+        } catch (const std::exception&) {
+            throw std::runtime_error("Invalid profile size: " + arguments);
+        }
+    }
+
+    const ExecutionProfile& profile = cpu.profile;
+    std::vector<size_t> slots;
+    for (size_t slot = 0; slot < profile.size(); slot++) {
+        if (profile[slot].executions || profile[slot].stalls() || profile[slot].dataBubblesCaused) {
+            slots.push_back(slot);
+        }
+    }
+    auto cost = [&](size_t slot) { return profile[slot].executions + profile[slot].stalls(); };
+    count = std::min(count, slots.size());
+    std::partial_sort(slots.begin(), slots.begin() + count, slots.end(), [&](size_t a, size_t b) {
+        return cost(a) != cost(b) ? cost(a) > cost(b) : a < b;
+    });
+
+    json.raw("{ \"profile\": { \"cycles\": ").number(cpu.clock)
+        .raw(", \"instructions\": ").number(cpu.totalInstructions)
+        .raw(", \"pipeline\": ").boolean(cpu.pipeline)
+        .raw(", \"hotspots\": [");
+    for (size_t i = 0; i < count; i++) {
+        size_t slot = slots[i];
+        const PcCounters& counters = profile[slot];
+        uint32_t pc = profile.pcOf(slot);
+        json.raw(i ? ", " : "").raw("{ \"pc\": ").hexString(pc);
+
+        size_t line;
+        if (assembler.findSourceLine(pc, line)) {
+            const std::string& text = assembler.getSourceLine(line);
+            size_t start = text.find_first_not_of(" \t");
+            size_t end = text.find_last_not_of(" \t\r");
+            json.raw(", \"line\": ").number(line + 1)
+                .raw(", \"source\": ").string(start == std::string::npos ? "" : text.substr(start, end - start + 1));
+        }
+        std::string label;
+        uint32_t offset;
+        if (assembler.getSymbols().lookupAddress(pc, label, offset)) {
+            json.raw(", \"label\": ").string(offset ? label + "+" + std::to_string(offset) : label);
+        }
+
+        json.raw(", \"cycles\": ").number(cost(slot))
+            .raw(", \"executions\": ").number(counters.executions)
+            .raw(", \"dataBubblesSuffered\": ").number(counters.dataBubblesSuffered)
+            .raw(", \"dataBubblesCaused\": ").number(counters.dataBubblesCaused)
+            .raw(", \"unitBubbles\": ").number(counters.unitBubbles)
+            .raw(", \"controlBubbles\": ").number(counters.controlBubbles)
+            .raw(", \"mispredictions\": ").number(counters.mispredictions)
+            .raw(", \"forwardsIn\": ").number(counters.forwardsIn)
+            .raw(", \"forwardsOut\": ").number(counters.forwardsOut).raw(" }");
+    }
+    json.raw("] } }");
+}
+
+// `cache [icache|dcache] on|<options>` puts new, empty L1 caches in front of memory, both without a name.
+// `cache [icache|dcache] off` takes them away again and `cache` alone reports them.
+void Session::cacheAndOutput(const std::string& arguments, JsonWriter& json) {
+    if (!arguments.empty()) {
+        std::string which = arguments.substr(0, arguments.find(' '));
+        bool instruction = which != "dcache";
+        bool data = which != "icache";
+        std::string options = arguments;
+        if (which == "icache" || which == "dcache") {
+            options = arguments.size() > which.size() ? arguments.substr(which.size() + 1) : "";
+        }
+
+        if (options == "off") {
+            if (instruction) cpu.instructionCache.reset();
+            if (data) cpu.dataCache.reset();
+        } else {
+            CacheConfig config = CacheConfig::parse(options == "on" ? "" : options);
+            if (instruction) cpu.instructionCache = std::make_unique<Cache>(config);
+            if (data) cpu.dataCache = std::make_unique<Cache>(config);
+        }
+    }
+
+    json.raw("{ \"cache\": { \"icache\": ");
+    if (cpu.instructionCache) {
+        cpu.instructionCache->dump(json);
+    } else {
+        json.raw("null");
+    }
+    json.raw(", \"dcache\": ");
+    if (cpu.dataCache) {
+        cpu.dataCache->dump(json);
+    } else {
+        json.raw("null");
+    }
+    json.raw(", \"stallCycles\": ").number(cpu.totalMemoryStallCycles).raw(" } }");
+}
+
+// `dram on|<options>` puts new DRAM banks behind the caches, `dram off` goes back to their fixed
+// miss latency and `dram` alone reports them
+void Session::dramAndOutput(const std::string& arguments, JsonWriter& json) {
+    if (arguments == "off") {
+        cpu.dram.reset();
+    } else if (!arguments.empty()) {
+        cpu.dram = std::make_unique<Dram>(DramConfig::parse(arguments == "on" ? "" : arguments));
+    }
+
+    json.raw("{ \"dram\": ");
+    if (cpu.dram) {
+        cpu.dram->dump(json);
+    } else {
+        json.raw("null");
+    }
+    json.raw(" }");
+}
+
+// `prefetch [icache|dcache] on|<options>` attaches the next line prefetcher to the instruction cache and
+// the stride prefetcher to the data cache, both without a name. `prefetch [icache|dcache] off` detaches
+// them and `prefetch` alone reports them with the outcome of their prefetches so far:
+// accuracy is the share of prefetches a demand access used, coverage the share of would-be misses they caught
+void Session::prefetchAndOutput(const std::string& arguments, JsonWriter& json) {
+    if (!arguments.empty()) {
+        std::string which = arguments.substr(0, arguments.find(' '));
+        bool instruction = which != "dcache";
+        bool data = which != "icache";
+        std::string options = arguments;
+        if (which == "icache" || which == "dcache") {
+            options = arguments.size() > which.size() ? arguments.substr(which.size() + 1) : "";
+        }
+
+        if (options == "off") {
+            if (instruction) cpu.instructionPrefetcher.reset();
+            if (data) cpu.dataPrefetcher.reset();
+        } else {
+            PrefetcherConfig config = PrefetcherConfig::parse(options == "on" ? "" : options);
+            if (instruction) cpu.instructionPrefetcher = std::make_unique<NextLinePrefetcher>(config);
+            if (data) cpu.dataPrefetcher = std::make_unique<StridePrefetcher>(config);
+        }
+    }
+
+    auto outcome = [&](const Cache* cache) {
+        if (!cache) {
+            return;
+        }
+        const CacheStats& stats = cache->stats();
+        uint64_t used = stats.prefetchUseful + stats.prefetchLate;
+        double accuracy = stats.prefetches ? std::round(1000.0 * used / stats.prefetches) / 1000 : 0;
+        double coverage = used + stats.misses ? std::round(1000.0 * used / (used + stats.misses)) / 1000 : 0;
+        json.reopen().raw(", \"issued\": ").number(stats.prefetches)
+            .raw(", \"useful\": ").number(stats.prefetchUseful)
+            .raw(", \"late\": ").number(stats.prefetchLate)
+            .raw(", \"useless\": ").number(stats.prefetchUseless)
+            .raw(", \"accuracy\": ").number(accuracy)
+            .raw(", \"coverage\": ").number(coverage).raw(" }");
+    };
+
+    json.raw("{ \"prefetch\": { \"icache\": ");
+    if (cpu.instructionPrefetcher) {
+        cpu.instructionPrefetcher->dump(json);
+        outcome(cpu.instructionCache.get());
+    } else {
+        json.raw("null");
+    }
+    json.raw(", \"dcache\": ");
+    if (cpu.dataPrefetcher) {
+        cpu.dataPrefetcher->dump(json);
+        outcome(cpu.dataCache.get());
+    } else {
+        json.raw("null");
+    }
+    json.raw(" } }");
+}
+
+// `latency on|<options>` makes MUL, DIV and REM take several execute cycles, `latency off` goes back
+// to single cycle ones and `latency` alone reports them with the cycles waited on them so far
+void Session::latencyAndOutput(const std::string& arguments, JsonWriter& json) {
+    if (arguments == "off") {
+        cpu.functionalUnits.reset();
+    } else if (!arguments.empty()) {
+        cpu.functionalUnits = std::make_unique<FunctionalUnits>(FunctionalUnitConfig::parse(arguments == "on" ? "" : arguments));
+    }
+
+    json.raw("{ \"latency\": ");
+    if (cpu.functionalUnits) {
+        cpu.functionalUnits->dump(json);
+        json.reopen().raw(", \"bubbles\": ").number(cpu.totalFunctionalUnitBubbles).raw(" }");
+    } else {
+        json.raw("null");
+    }
+    json.raw(" }");
+}
+
+// The caches and their stall cycles, only when there are caches
+void Session::writeCaches(JsonWriter& json) {
+    if (!cpu.instructionCache && !cpu.dataCache) {
+        return;
+    }
+    json.raw(", \"totalMemoryStallCycles\":").number(cpu.totalMemoryStallCycles);
+    if (cpu.instructionCache) {
+        json.raw(", \"icache\": ");
+        cpu.instructionCache->dump(json);
+    }
+    if (cpu.dataCache) {
+        json.raw(", \"dcache\": ");
+        cpu.dataCache->dump(json);
+    }
+    if (cpu.dram) {
+        json.raw(", \"dram\": ");
+        cpu.dram->dump(json);
+    }
+}
+
+void Session::writeCounters(JsonWriter& json) {
+    json.raw(", \"totalInstructions\":").number(cpu.totalInstructions);
+    json.raw(", \"totalDataTransferInstructions\":").number(cpu.totalDataTransferInstructions);
+    json.raw(", \"totalControlInstructions\":").number(cpu.totalControlInstructions);
+    json.raw(", \"totalBubbles\":").number(cpu.totalBubbles);
+    json.raw(", \"totalControlHazardBubbles\":").number(cpu.totalControlHazardBubbles);
+    json.raw(", \"totalDataHazardBubbles\":").number(cpu.totalDataHazardBubbles);
+    json.raw(", \"totalDataHazards\":").number(cpu.totalDataHazards);
+    json.raw(", \"totalControlHazards\":").number(cpu.totalControlHazards);
+    json.raw(", \"totalBranchMissPredictions\":").number(cpu.totalBranchMissPredictions);
+    if (cpu.functionalUnits) {
+        json.raw(", \"totalFunctionalUnitBubbles\":").number(cpu.totalFunctionalUnitBubbles);
+    }
+    writeCaches(json);
+}
+
+bool Session::stepAndOutput(JsonWriter& json) {
+    cpu.step();
+    // Read before the comment is dumped, dumping clears it
+    bool exited = memory.comment == "Successfully Exited";
+
+    writeMachineState(json);
+    writeComment(json);
+    writeModes(json);
+    json.raw(", \"pipeline_status\": ");
+    cpu.dumpPipelineStages(json);
+    json.raw(", \"data_forward_path\": ");
+    cpu.dumpDataForwardPath(json);
+    json.raw(", \"RA\": ").number(cpu.RA);
+    json.raw(", \"RB\": ").number(cpu.RB);
+    json.raw(", \"RY\": ").number(cpu.RY);
+    json.raw(", \"RZ\": ").number(cpu.RZ);
+    json.raw(", \"RM\": ").number(cpu.RM);
+    json.raw(" }");
+    return exited;
+}
+
+// `pipeline`, `data_forward` and `branch_prediction` flip their flag and report the new modes
+void Session::toggleAndOutput(bool& flag, JsonWriter& json) {
+    flag = !flag;
+
+    writeMachineState(json);
+    writeComment(json);
+    writeModes(json);
+    json.raw(", \"branch_prediction\":").onOff(cpu.predictionBool);
+    json.raw(" }");
+}
@@ -1,13 +1,111 @@
 #include "symbol_table.h"
+#include <algorithm>
+#include <stdexcept>
+
+bool SymbolTable::isLocalLabel(const std::string& label) {
+    return !label.empty() && std::all_of(label.begin(), label.end(), ::isdigit);
+}
+
+bool SymbolTable::isLocalReference(const std::string& operand) {
+    return operand.size() >= 2 && (operand.back() == 'b' || operand.back() == 'f') &&
+           isLocalLabel(operand.substr(0, operand.size() - 1));
+}
+
+uint32_t SymbolTable::intern(const std::string& label) {
+    auto [it, inserted] = ids.emplace(label, static_cast<uint32_t>(names.size()));
+    if (inserted) {
+        names.push_back(label);
+        addresses.push_back(0);
+        defined.push_back(false);
+    }
+    return it->second;
+}
+
+uint32_t SymbolTable::find(const std::string& label) const {
+    auto it = ids.find(label);
+    return it != ids.end() ? it->second : NO_SYMBOL;
+}
+
+uint32_t SymbolTable::internDefinition(const std::string& label) {
+    if (!isLocalLabel(label)) {
+        return intern(label);
+    }
+    uint32_t count = localCounts[label]++;
+    return intern(label + "@" + std::to_string(count));
+}
+
+uint32_t SymbolTable::internLocalReference(const std::string& operand) {
+    std::string label = operand.substr(0, operand.size() - 1);
+    auto it = localCounts.find(label);
+    uint32_t count = it != localCounts.end() ? it->second : 0;
+    if (operand.back() == 'b') {
+        if (count == 0) {
+            throw std::runtime_error("Local label " + operand + " has no preceding " + label + ":");
+        }
+        count--;
+    }
+    return intern(label + "@" + std::to_string(count));
+}
+
+void SymbolTable::define(uint32_t id, uint32_t address) {
+    addresses[id] = address;
+    defined[id] = true;
+    indexValid = false;
+}
 
 void SymbolTable::addLabel(const std::string& label, uint32_t address) {
-    labels[label] = address;
+    define(intern(label), address);
 }
 
 uint32_t SymbolTable::getAddress(const std::string& label) const {
-    return labels.at(label);
+    uint32_t id = find(label);
+    if (!isDefined(id)) {
+        throw std::out_of_range("Label " + label + " not found");
+    }
+    return addresses[id];
 }
 
 bool SymbolTable::labelExists(const std::string& label) const {
-    return labels.find(label) != labels.end();
+    return isDefined(find(label));
+}
+
+void SymbolTable::undefineAll() {
+    std::fill(defined.begin(), defined.end(), false);
+    indexValid = false;
+}
+
+void SymbolTable::clear() {
+    ids.clear();
+    names.clear();
+    addresses.clear();
+    defined.clear();
+    localCounts.clear();
+    indexValid = false;
+}
+
+const std::vector<std::pair<uint32_t, uint32_t>>& SymbolTable::getAddressIndex() const {
+    if (!indexValid) {
+        addressIndex.clear();
+        for (uint32_t id = 0; id < names.size(); id++) {
+            if (defined[id]) {
+                addressIndex.emplace_back(addresses[id], id);
+            }
+        }
+        std::sort(addressIndex.begin(), addressIndex.end());
+        indexValid = true;
+    }
+    return addressIndex;
+}
+
+bool SymbolTable::lookupAddress(uint32_t address, std::string& name, uint32_t& offset) const {
+    const auto& index = getAddressIndex();
+    // First entry above the address, the one before it is the closest symbol
+    auto it = std::upper_bound(index.begin(), index.end(), std::make_pair(address, NO_SYMBOL));
+    if (it == index.begin()) {
+        return false;
+    }
+    --it;
+    name = names[it->second].substr(0, names[it->second].find('@'));
+    offset = address - it->first;
+    return true;
 }
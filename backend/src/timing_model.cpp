@@ -0,0 +1,85 @@
+#include "timing_model.h"
+#include <algorithm>
+#include <vector>
+
+namespace TimingModel {
+
+Result replay(const Trace& trace, const Config& config) {
+    Result result;
+
+    // Decode cycle of the last producer of every register, and whether it was a load
+    uint64_t producedAt[32] = {};
+    bool producedByLoad[32] = {};
+    bool produced[32] = {};
+
+    bool globalBit = false;
+    std::vector<uint8_t> counters(size_t(1) << config.bimodalBits, 1);  // weakly not taken
+    uint64_t earliest = 1;  // first cycle the next instruction could be in decode
+
+    for (const TraceRecord& record : trace) {
+        uint64_t decode = earliest;
+
+        const uint8_t sources[2] = {record.rs1, record.rs2};
+        for (int i = 0; i < 2; i++) {
+            uint8_t source = sources[i];
+            if (source == 0 || source >= 32 || !produced[source] || earliest - producedAt[source] >= 3) {
+                continue;
+            }
+            result.dataHazards++;
+            uint64_t ready;
+            if (!config.dataForward) {
+                ready = producedAt[source] + 3;
+            } else {
+                result.forwards++;
+                bool storeData = record.kind == TraceKind::STORE && i == 1;
+                ready = producedByLoad[source] && !storeData ? producedAt[source] + 2 : producedAt[source] + 1;
+            }
+            decode = std::max(decode, ready);
+        }
+        result.dataHazardBubbles += decode - earliest;
+
+        if (record.rd != 0 && record.rd < 32) {
+            producedAt[record.rd] = decode;
+            producedByLoad[record.rd] = record.kind == TraceKind::LOAD;
+            produced[record.rd] = true;
+        }
+
+        bool followed = !record.taken;
+        if (record.kind == TraceKind::JAL) {
+            followed = config.predictor != Predictor::NONE;
+        } else if (record.kind == TraceKind::BRANCH && config.predictor != Predictor::NONE) {
+            uint8_t& counter = counters[(record.pc >> 2) & (counters.size() - 1)];
+            bool predicted = config.predictor == Predictor::ONE_BIT ? globalBit : counter >= 2;
+            followed = predicted == record.taken;
+            if (!followed) {
+                result.branchMispredictions++;
+            }
+            globalBit = record.taken;
+            if (record.taken && counter < 3) counter++;
+            if (!record.taken && counter > 0) counter--;
+        }
+
+        earliest = decode + 1;
+        if (!followed) {
+            result.controlHazards++;
+            result.controlHazardBubbles += config.branchPenalty;
+            earliest += config.branchPenalty;
+        }
+    }
+
+    result.instructions = trace.size();
+    result.bubbles = result.dataHazardBubbles + result.controlHazardBubbles;
+    result.cycles = result.instructions ? result.instructions + 4 + result.bubbles : 0;
+    return result;
+}
+
+const char* predictorName(Predictor predictor) {
+    switch (predictor) {
+    case Predictor::NONE: return "none";
+    case Predictor::ONE_BIT: return "one_bit";
+    case Predictor::BIMODAL: return "bimodal";
+    }
+    return "unknown";
+}
+
+}
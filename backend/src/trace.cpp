@@ -0,0 +1,40 @@
+#include "trace.h"
+#include "instruction.h"
+
+TraceKind traceKind(uint32_t opcode) {
+    switch (opcode) {
+    case 0b0000011: return TraceKind::LOAD;
+    case 0b0100011: return TraceKind::STORE;
+    case 0b1100011: return TraceKind::BRANCH;
+    case 0b1101111: return TraceKind::JAL;
+    case 0b1100111: return TraceKind::JALR;
+    default: return TraceKind::ALU;
+    }
+}
+
+TraceRecord makeTraceRecord(const Instruction& instruction, uint32_t effectiveAddress, uint32_t nextPC) {
+    TraceRecord record;
+    record.pc = instruction.instructionPC;
+    record.kind = traceKind(instruction.getOpcode());
+    record.rd = static_cast<uint8_t>(instruction.getRD());
+    record.rs1 = static_cast<uint8_t>(instruction.getRS1());
+    record.rs2 = static_cast<uint8_t>(instruction.getRS2());
+
+    bool memoryAccess = record.kind == TraceKind::LOAD || record.kind == TraceKind::STORE;
+    bool control = record.kind == TraceKind::BRANCH || record.kind == TraceKind::JAL || record.kind == TraceKind::JALR;
+    record.address = memoryAccess ? effectiveAddress : control ? nextPC : 0;
+    record.taken = control && nextPC != record.pc + 4;
+    return record;
+}
+
+const char* traceKindName(TraceKind kind) {
+    switch (kind) {
+    case TraceKind::ALU: return "alu";
+    case TraceKind::LOAD: return "load";
+    case TraceKind::STORE: return "store";
+    case TraceKind::BRANCH: return "branch";
+    case TraceKind::JAL: return "jal";
+    case TraceKind::JALR: return "jalr";
+    }
+    return "unknown";
+}
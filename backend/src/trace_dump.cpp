@@ -0,0 +1,123 @@
+// trace_dump: prints the chunk index of a binary trace written by `record`, chunks of it as text,
+// or the locality of its fetch and load/store address streams as the `locality` command reports it.
+//   trace_dump <file> --index
+//   trace_dump <file> [chunk | first-last]
+//   trace_dump <file> --locality [line=N] [page=N] [window=N] [pages=N]
+#include "locality.h"
+#include "trace_file.h"
+#include <cstdio>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+static void printEvent(const TraceEvent& event, uint64_t instruction) {
+    if (event.cycle) {
+        char stages[6] = ".....";
+        const char names[] = "FDEMW";
+        for (int i = 0; i < 5; i++) {
+            if (event.stages & (1 << i)) stages[i] = names[i];
+        }
+        std::printf("  cycle %s\n", stages);
+        return;
+    }
+    std::printf("%llu 0x%08x", static_cast<unsigned long long>(instruction), event.pc);
+    if (event.registerWrite) {
+        std::printf(" x%u=0x%08x", event.rd, event.value);
+    }
+    if (event.access != TraceEvent::NONE) {
+        std::printf(" %s%u [0x%08x]=0x%0*x", event.access == TraceEvent::LOAD ? "load" : "store", event.size,
+                    event.address, event.size * 2, event.data);
+    }
+    std::printf("\n");
+}
+
+// Streams the trace chunk by chunk, so its size is bounded by the disk rather than memory
+static void printLocality(TraceReader& reader, const LocalityConfig& config) {
+    LocalityAnalysis fetches(config), data(config);
+    std::vector<TraceEvent> events;
+    uint64_t instructions = 0;
+    for (size_t i = 0; i < reader.chunks().size(); i++) {
+        reader.readChunk(i, events);
+        for (const TraceEvent& event : events) {
+            if (event.cycle) {
+                continue;
+            }
+            instructions++;
+            fetches.access(event.pc, false);
+            if (event.access != TraceEvent::NONE) {
+                data.access(event.address, event.access == TraceEvent::STORE);
+            }
+        }
+    }
+
+    JsonWriter json;
+    json.raw("{ \"locality\": { \"instructions\": ").number(instructions)
+        .raw(", \"line\": ").number(config.lineSize)
+        .raw(", \"page\": ").number(config.pageSize)
+        .raw(", \"fetch\": ");
+    fetches.dump(json);
+    json.raw(", \"data\": ");
+    data.dump(json);
+    json.raw(" } }");
+    json.flush(std::cout);
+}
+
+int main(int argc, char* argv[]) {
+    bool locality = argc >= 3 && std::string(argv[2]) == "--locality";
+    if (argc < 2 || (argc > 3 && !locality)) {
+        std::cerr << "Usage: " << argv[0] << " <trace> [--index | chunk | first-last | --locality [options]]" << std::endl;
+        return 2;
+    }
+    try {
+        TraceReader reader(argv[1]);
+        const std::vector<TraceChunk>& chunks = reader.chunks();
+        std::string selection = argc == 3 ? argv[2] : "";
+
+        if (locality) {
+            LocalityConfig config;
+            for (int i = 3; i < argc; i++) {
+                if (!config.apply(argv[i])) {
+                    throw std::runtime_error(std::string("Unknown locality option: ") + argv[i]);
+                }
+            }
+            printLocality(reader, config);
+            return 0;
+        }
+
+        if (selection == "--index") {
+            std::printf("chunks %zu occupancy %s\n", chunks.size(), reader.occupancy() ? "on" : "off");
+            for (size_t i = 0; i < chunks.size(); i++) {
+                const TraceChunk& chunk = chunks[i];
+                std::printf("%zu offset=%llu bytes=%u first=%llu instructions=%u cycles=%u pc=0x%08x\n", i,
+                            static_cast<unsigned long long>(chunk.offset), chunk.bytes,
+                            static_cast<unsigned long long>(chunk.firstInstruction), chunk.instructions, chunk.cycles,
+                            chunk.firstPC);
+            }
+            return 0;
+        }
+
+        size_t first = 0;
+        size_t last = chunks.empty() ? 0 : chunks.size() - 1;
+        if (!selection.empty()) {
+            size_t dash = selection.find('-');
+            first = std::stoul(selection.substr(0, dash));
+            last = dash == std::string::npos ? first : std::stoul(selection.substr(dash + 1));
+        }
+
+        std::vector<TraceEvent> events;
+        for (size_t i = first; i <= last && !chunks.empty(); i++) {
+            reader.readChunk(i, events);
+            uint64_t instruction = chunks[i].firstInstruction;
+            std::printf("# chunk %zu\n", i);
+            for (const TraceEvent& event : events) {
+                printEvent(event, instruction);
+                if (!event.cycle) instruction++;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,275 @@
+#include "trace_file.h"
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+const char HEADER_MAGIC[8] = {'R', 'V', 'T', 'R', 'A', 'C', 'E', '\0'};
+const char FOOTER_MAGIC[4] = {'R', 'V', 'T', 'I'};
+constexpr uint32_t VERSION = 1;
+constexpr uint32_t FLAG_OCCUPANCY = 1;
+constexpr size_t HEADER_BYTES = 16;
+constexpr size_t INDEX_ENTRY_BYTES = 32;
+constexpr size_t FOOTER_BYTES = 16;
+
+constexpr uint8_t TAG_SEQUENTIAL = 0x01;
+constexpr uint8_t TAG_REGISTER = 0x02;
+constexpr uint8_t TAG_LOAD = 0x04;
+constexpr uint8_t TAG_STORE = 0x08;
+constexpr int TAG_SIZE_SHIFT = 4;
+constexpr uint8_t TAG_CYCLE = 0x80;
+
+uint64_t readFixed(const uint8_t* bytes, int count) {
+    uint64_t value = 0;
+    for (int i = count - 1; i >= 0; i--) {
+        value = value << 8 | bytes[i];
+    }
+    return value;
+}
+
+}
+
+TraceWriter::TraceWriter(const std::string& path, bool occupancy)
+    : out(path, std::ios::binary | std::ios::trunc), path(path), withOccupancy(occupancy) {
+    if (!out) {
+        throw std::runtime_error("Cannot write trace " + path);
+    }
+    buffer.reserve(CHUNK_BYTES + 64);
+    buffer.insert(buffer.end(), HEADER_MAGIC, HEADER_MAGIC + sizeof(HEADER_MAGIC));
+    fixed(VERSION, 4);
+    fixed(withOccupancy ? FLAG_OCCUPANCY : 0, 4);
+    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    written = buffer.size();
+    buffer.clear();
+    startChunk();
+}
+
+TraceWriter::~TraceWriter() {
+    try {
+        finish();
+    } catch (...) {
+    }
+}
+
+void TraceWriter::startChunk() {
+    current = TraceChunk();
+    current.offset = written;
+    current.firstInstruction = totalInstructions;
+    // Deltas restart with every chunk so each one decodes without its predecessors
+    previousPC = static_cast<uint32_t>(-4);
+    previousAddress = 0;
+}
+
+void TraceWriter::flushChunk() {
+    if (buffer.empty()) {
+        return;
+    }
+    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    current.bytes = static_cast<uint32_t>(buffer.size());
+    written += buffer.size();
+    index.push_back(current);
+    buffer.clear();
+    startChunk();
+}
+
+void TraceWriter::varint(uint32_t value) {
+    while (value >= 0x80) {
+        buffer.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    buffer.push_back(static_cast<uint8_t>(value));
+}
+
+void TraceWriter::zigzag(uint32_t delta) {
+    int32_t signedDelta = static_cast<int32_t>(delta);
+    varint(static_cast<uint32_t>(signedDelta << 1) ^ static_cast<uint32_t>(signedDelta >> 31));
+}
+
+void TraceWriter::fixed(uint64_t value, int bytes) {
+    for (int i = 0; i < bytes; i++) {
+        buffer.push_back(static_cast<uint8_t>(value >> (8 * i)));
+    }
+}
+
+void TraceWriter::access(TraceEvent::Access kind, unsigned sizeLog2, uint32_t address, uint32_t data) {
+    pendingAccess = kind;
+    pendingSize = sizeLog2 & 3;
+    pendingAddress = address;
+    pendingData = sizeLog2 >= 2 ? data : data & ((1u << (8 << sizeLog2)) - 1);
+}
+
+void TraceWriter::retire(uint32_t pc, uint32_t rd, uint32_t value) {
+    if (current.instructions == 0) {
+        current.firstPC = pc;
+    }
+    bool registerWrite = rd != 0 && rd < 32;
+    uint8_t tag = 0;
+    if (pc == previousPC + 4) tag |= TAG_SEQUENTIAL;
+    if (registerWrite) tag |= TAG_REGISTER;
+    if (pendingAccess == TraceEvent::LOAD) tag |= TAG_LOAD;
+    if (pendingAccess == TraceEvent::STORE) tag |= TAG_STORE;
+    tag |= pendingSize << TAG_SIZE_SHIFT;
+    buffer.push_back(tag);
+
+    if (!(tag & TAG_SEQUENTIAL)) {
+        zigzag(pc - (previousPC + 4));
+    }
+    if (registerWrite) {
+        buffer.push_back(static_cast<uint8_t>(rd));
+        varint(value);
+    }
+    if (pendingAccess != TraceEvent::NONE) {
+        zigzag(pendingAddress - previousAddress);
+        varint(pendingData);
+        previousAddress = pendingAddress;
+    }
+
+    previousPC = pc;
+    pendingAccess = TraceEvent::NONE;
+    pendingSize = 0;
+    current.instructions++;
+    totalInstructions++;
+    if (buffer.size() >= CHUNK_BYTES) {
+        flushChunk();
+    }
+}
+
+void TraceWriter::cycle(uint8_t stages) {
+    if (!withOccupancy) {
+        return;
+    }
+    buffer.push_back(TAG_CYCLE | (stages & 0x1f));
+    current.cycles++;
+    totalCycles++;
+}
+
+void TraceWriter::finish() {
+    if (finished) {
+        return;
+    }
+    finished = true;
+    flushChunk();
+
+    uint64_t indexOffset = written;
+    for (const TraceChunk& chunk : index) {
+        fixed(chunk.offset, 8);
+        fixed(chunk.firstInstruction, 8);
+        fixed(chunk.bytes, 4);
+        fixed(chunk.instructions, 4);
+        fixed(chunk.cycles, 4);
+        fixed(chunk.firstPC, 4);
+    }
+    fixed(indexOffset, 8);
+    fixed(index.size(), 4);
+    buffer.insert(buffer.end(), FOOTER_MAGIC, FOOTER_MAGIC + sizeof(FOOTER_MAGIC));
+    out.write(reinterpret_cast<const char*>(buffer.data()), buffer.size());
+    written += buffer.size();
+    buffer.clear();
+    out.close();
+    if (!out) {
+        throw std::runtime_error("Cannot write trace " + path);
+    }
+}
+
+TraceReader::TraceReader(const std::string& path) : in(path, std::ios::binary), path(path) {
+    if (!in) {
+        throw std::runtime_error("Cannot read trace " + path);
+    }
+    uint8_t header[HEADER_BYTES];
+    uint8_t footer[FOOTER_BYTES];
+    in.read(reinterpret_cast<char*>(header), sizeof(header));
+    in.seekg(-static_cast<std::streamoff>(sizeof(footer)), std::ios::end);
+    in.read(reinterpret_cast<char*>(footer), sizeof(footer));
+    if (!in || std::memcmp(header, HEADER_MAGIC, sizeof(HEADER_MAGIC)) != 0 ||
+        std::memcmp(footer + 12, FOOTER_MAGIC, sizeof(FOOTER_MAGIC)) != 0) {
+        throw std::runtime_error("Not a complete trace file: " + path);
+    }
+    if (readFixed(header + 8, 4) != VERSION) {
+        throw std::runtime_error("Unsupported trace version in " + path);
+    }
+    withOccupancy = readFixed(header + 12, 4) & FLAG_OCCUPANCY;
+
+    uint64_t indexOffset = readFixed(footer, 8);
+    size_t count = readFixed(footer + 8, 4);
+    std::vector<uint8_t> entries(count * INDEX_ENTRY_BYTES);
+    in.seekg(indexOffset);
+    in.read(reinterpret_cast<char*>(entries.data()), entries.size());
+    if (!in) {
+        throw std::runtime_error("Truncated trace index in " + path);
+    }
+    index.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        const uint8_t* entry = entries.data() + i * INDEX_ENTRY_BYTES;
+        index[i].offset = readFixed(entry, 8);
+        index[i].firstInstruction = readFixed(entry + 8, 8);
+        index[i].bytes = readFixed(entry + 16, 4);
+        index[i].instructions = readFixed(entry + 20, 4);
+        index[i].cycles = readFixed(entry + 24, 4);
+        index[i].firstPC = readFixed(entry + 28, 4);
+    }
+}
+
+void TraceReader::readChunk(size_t chunk, std::vector<TraceEvent>& events) {
+    if (chunk >= index.size()) {
+        throw std::runtime_error("No chunk " + std::to_string(chunk) + " in " + path);
+    }
+    const TraceChunk& info = index[chunk];
+    buffer.resize(info.bytes);
+    in.seekg(info.offset);
+    in.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+    if (!in) {
+        throw std::runtime_error("Truncated trace chunk in " + path);
+    }
+
+    const uint8_t* position = buffer.data();
+    const uint8_t* end = position + buffer.size();
+    auto varint = [&]() {
+        uint32_t value = 0;
+        for (int shift = 0; position < end && shift < 35; shift += 7) {
+            uint8_t byte = *position++;
+            value |= static_cast<uint32_t>(byte & 0x7f) << shift;
+            if (!(byte & 0x80)) {
+                return value;
+            }
+        }
+        throw std::runtime_error("Corrupt trace chunk in " + path);
+    };
+    auto zigzag = [&]() {
+        uint32_t value = varint();
+        return (value >> 1) ^ (0u - (value & 1));
+    };
+
+    events.clear();
+    events.reserve(info.instructions + info.cycles);
+    uint32_t previousPC = static_cast<uint32_t>(-4);
+    uint32_t previousAddress = 0;
+    while (position < end) {
+        TraceEvent event;
+        uint8_t tag = *position++;
+        if (tag & TAG_CYCLE) {
+            event.cycle = true;
+            event.stages = tag & 0x1f;
+            events.push_back(event);
+            continue;
+        }
+
+        event.pc = tag & TAG_SEQUENTIAL ? previousPC + 4 : previousPC + 4 + zigzag();
+        if (tag & TAG_REGISTER) {
+            if (position == end) {
+                throw std::runtime_error("Corrupt trace chunk in " + path);
+            }
+            event.registerWrite = true;
+            event.rd = *position++;
+            event.value = varint();
+        }
+        if (tag & (TAG_LOAD | TAG_STORE)) {
+            event.access = tag & TAG_LOAD ? TraceEvent::LOAD : TraceEvent::STORE;
+            event.size = 1 << ((tag >> TAG_SIZE_SHIFT) & 3);
+            event.address = previousAddress + zigzag();
+            event.data = varint();
+            previousAddress = event.address;
+        }
+        previousPC = event.pc;
+        events.push_back(event);
+    }
+}
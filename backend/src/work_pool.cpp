@@ -0,0 +1,100 @@
+#include "work_pool.h"
+#include <algorithm>
+
+// The tasks of one `run` call
+struct WorkPool::Job {
+    const std::function<void(size_t)>& task;
+    size_t remaining;
+    std::mutex mutex;  // guards `remaining`
+    std::condition_variable done;
+};
+
+WorkPool::WorkPool(unsigned threads) : queues(std::max(1u, threads)) {
+    for (size_t i = 0; i < queues.size(); i++) {
+        workers.emplace_back(&WorkPool::work, this, i);
+    }
+}
+
+WorkPool::~WorkPool() {
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+WorkPool& WorkPool::shared() {
+    static WorkPool pool(std::max(1u, std::thread::hardware_concurrency()));
+    return pool;
+}
+
+bool WorkPool::take(size_t worker, std::pair<Job*, size_t>& task) {
+    bool taken = false;
+    {
+        WorkQueue& own = queues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = own.tasks.front();
+            own.tasks.pop_front();
+            taken = true;
+        }
+    }
+    for (size_t i = 1; i < queues.size() && !taken; i++) {
+        WorkQueue& victim = queues[(worker + i) % queues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = victim.tasks.back();
+            victim.tasks.pop_back();
+            taken = true;
+        }
+    }
+    if (taken) {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        queued--;
+    }
+    return taken;
+}
+
+void WorkPool::work(size_t worker) {
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(wakeMutex);
+            wake.wait(lock, [&] { return stopping || queued > 0; });
+            if (queued == 0) return;
+        }
+        std::pair<Job*, size_t> task;
+        // Another worker may have taken the last task since the wake up
+        if (!take(worker, task)) continue;
+
+        Job& job = *task.first;
+        job.task(task.second);
+        // The caller destroys the job as soon as it sees the last task finish, so notify under the lock
+        std::lock_guard<std::mutex> lock(job.mutex);
+        if (--job.remaining == 0) job.done.notify_all();
+    }
+}
+
+void WorkPool::run(size_t count, const std::function<void(size_t)>& task) {
+    if (count == 0) return;
+    Job job{task, count};
+
+    {
+        // Queued and counted at once, so a worker never takes a task that is not counted yet
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        // Later jobs start where this one ended, so that single tasks do not pile onto one worker
+        for (size_t i = 0; i < count; i++) {
+            WorkQueue& queue = queues[(next + i) % queues.size()];
+            std::lock_guard<std::mutex> queueLock(queue.mutex);
+            queue.tasks.push_back({&job, i});
+        }
+        next = (next + count) % queues.size();
+        queued += count;
+    }
+    wake.notify_all();
+
+    std::unique_lock<std::mutex> lock(job.mutex);
+    job.done.wait(lock, [&] { return job.remaining == 0; });
+}
@@ -0,0 +1,211 @@
+#include "check.h"
+#include "assembler.h"
+#include "session.h"
+#include <utility>
+
+namespace {
+
+const std::string PROGRAM =
+    ".data\n"
+    "arr: .word 5, 3, 9, 1\n"
+    "val: .byte 7, 8\n"
+    "h: .half 300\n"
+    ".text\n"
+    "main:\n"
+    "    lui x16, 0x10000\n"
+    "    lw x10, 0(x16)\n"
+    "    lw x11, 4(x16)\n"
+    "    add x12, x10, x11\n"
+    "    sw x12, 8(x16)\n"
+    "    addi x5, x0, 4\n"
+    "loop:\n"
+    "    addi x5, x5, -1\n"
+    "    bne x5, x0, loop\n"
+    "    jal x1, func\n"
+    "    beq x0, x0, end\n"
+    "func:\n"
+    "    addi x20, x0, 99\n"
+    "    jalr x0, 0(x1)\n"
+    "end:\n"
+    "    exit\n";
+
+struct Program {
+    Memory memory;
+    Assembler assembler{memory};
+};
+
+std::vector<std::string> splitLines(const std::string& source) {
+    std::vector<std::string> lines;
+    size_t start = 0;
+    while (start < source.size()) {
+        size_t end = source.find('\n', start);
+        if (end == std::string::npos) end = source.size();
+        lines.push_back(source.substr(start, end - start));
+        start = end + 1;
+    }
+    return lines;
+}
+
+// `source` with lines [first, last) replaced, the way Assembler::edit splices it
+std::string splice(const std::string& source, size_t first, size_t last, const std::string& replacement) {
+    std::vector<std::string> lines = splitLines(source);
+    std::vector<std::string> added = splitLines(replacement);
+    lines.erase(lines.begin() + first, lines.begin() + last);
+    lines.insert(lines.begin() + first, added.begin(), added.end());
+    std::string result;
+    for (const std::string& line : lines) result += line + "\n";
+    return result;
+}
+
+std::vector<std::pair<uint32_t, uint8_t>> dataBytes(const Memory& memory) {
+    std::vector<std::pair<uint32_t, uint8_t>> bytes;
+    memory.getDataMemory().forEachWritten([&](uint32_t address, uint8_t value) { bytes.push_back({address, value}); });
+    return bytes;
+}
+
+// Edits `source` in place and checks the result against assembling the edited source from scratch
+void checkEditMatchesAssemble(const std::string& source, size_t first, size_t last, const std::string& replacement,
+                              const std::vector<std::string>& labels) {
+    Program edited, full;
+    edited.assembler.assemble(source);
+    edited.assembler.edit(first, last, replacement);
+    full.assembler.assemble(splice(source, first, last, replacement));
+
+    CHECK(edited.memory.instructionMemory == full.memory.instructionMemory);
+    CHECK(dataBytes(edited.memory) == dataBytes(full.memory));
+    CHECK_EQUAL(edited.memory.exitAddress, full.memory.exitAddress);
+    for (const std::string& label : labels) {
+        CHECK_EQUAL(edited.assembler.getSymbols().getAddress(label), full.assembler.getSymbols().getAddress(label));
+    }
+}
+
+const std::vector<std::string> LABELS = {"arr", "val", "h", "main", "loop", "func", "end"};
+
+}  // namespace
+
+TEST(editInsertingInstructionsMovesBranchTargets) {
+    checkEditMatchesAssemble(PROGRAM, 8, 9, "    lw x11, 4(x16)\n    lw x13, 0(x16)", LABELS);
+}
+
+TEST(editDeletingLinesMovesLabelsBack) {
+    checkEditMatchesAssemble(PROGRAM, 13, 14, "", LABELS);
+}
+
+TEST(editGrowingDataShiftsLaterData) {
+    checkEditMatchesAssemble(PROGRAM, 1, 2, "arr: .word 5, 3, 9, 1, 77", LABELS);
+}
+
+TEST(editMovingALabelRetargetsItsUsers) {
+    checkEditMatchesAssemble(PROGRAM, 17, 19, "    addi x21, x0, 1\nfunc:\n    addi x20, x0, 99", LABELS);
+}
+
+TEST(editAppendingAfterTheLastLine) {
+    checkEditMatchesAssemble(PROGRAM, 22, 22, "    addi x0, x0, 0", LABELS);
+}
+
+TEST(editReportsTheReencodedLines) {
+    Program program;
+    program.assembler.assemble(PROGRAM);
+    // Only the new line itself, nothing after it refers across it
+    CHECK_EQUAL(program.assembler.edit(21, 22, "    exit"), size_t(1));
+}
+
+TEST(editWithoutAProgramThrows) {
+    Program program;
+    CHECK_THROWS(program.assembler.edit(0, 0, "    addi x0, x0, 0"));
+}
+
+TEST(aFailedEditLeavesTheProgramAsItWas) {
+    const std::string source =
+        "main: addi x1, x0, 1\n"
+        "loop: addi x1, x1, 1\n"
+        "beq x0, x1, loop\n"
+        "addi x2, x0, 2\n"
+        "exit\n";
+    Session original(SessionOptions{});
+    JsonWriter json, expected;
+    original.assembleAndOutput(source, json);
+    original.execute("run", JsonRequest{}, expected);
+
+    // The beq loses its label in the incremental edit, the bad operand count fails the full assembly
+    for (const std::string& replacement : {std::string(""), std::string("addi x1, x0")}) {
+        Session session(SessionOptions{});
+        session.assembleAndOutput(source, json);
+        std::map<uint32_t, uint32_t> text = session.memory.instructionMemory;
+        CHECK_THROWS(session.editAndOutput(1, 2, replacement, json));
+        CHECK(session.memory.instructionMemory == text);
+        CHECK_EQUAL(session.assembler.getSymbols().getAddress("loop"), 0x4u);
+
+        JsonWriter run;
+        session.execute("run", JsonRequest{}, run);
+        CHECK_EQUAL(run.str(), expected.str());
+    }
+}
+
+TEST(storeDataHandsOutTheProgramAsAssembled) {
+    Program program;
+    program.assembler.assemble(PROGRAM);
+    program.assembler.edit(1, 2, "arr: .word 6, 3, 9, 1");
+    // The program's own run writes its data, copies still start from the assembled image
+    program.memory.storeData(0x10000000, 42);
+
+    Memory copy;
+    program.assembler.storeData(copy);
+    CHECK_EQUAL(int(copy.fetchData(0x10000000)), 6);
+    CHECK_EQUAL(int(copy.fetchData(0x10000010)), 7);
+    CHECK_EQUAL(copy.exitAddress, program.memory.exitAddress);
+
+    copy.storeData(0x10000004, 99);
+    Memory other;
+    program.assembler.storeData(other);
+    CHECK_EQUAL(int(other.fetchData(0x10000004)), 3);
+    CHECK_EQUAL(int(program.memory.fetchData(0x10000004)), 3);
+    CHECK_EQUAL(int(program.memory.fetchData(0x10000000)), 42);
+}
+
+TEST(editBeforeAnAlignmentPadsAgain) {
+    const std::string source =
+        ".data\n"
+        "A: .byte 1\n"
+        ".align 2\n"
+        "B: .word 7\n"
+        "C: .byte 3\n"
+        ".balign 8\n"
+        "D: .half 5\n";
+    checkEditMatchesAssemble(source, 1, 2, "A: .byte 1, 2", {"A", "B", "C", "D"});
+    checkEditMatchesAssemble(source, 1, 2, "A: .byte 1, 2, 3, 4, 5", {"A", "B", "C", "D"});
+    checkEditMatchesAssemble(source, 3, 4, "B: .word 7\n.byte 9", {"A", "B", "C", "D"});
+
+    Program program;
+    program.assembler.assemble(source);
+    program.assembler.edit(1, 2, "A: .byte 1, 2");
+    CHECK_EQUAL(program.assembler.getSymbols().getAddress("B"), uint32_t(0x10000004));
+    CHECK_EQUAL(program.memory.fetchData(0x10000004), uint8_t(7));
+}
+
+TEST(assembleRejectsAWrongOperandCount) {
+    Program program;
+    CHECK_THROWS(program.assembler.assemble(".text\n    add x1, x2\n"));
+    CHECK_THROWS(program.assembler.assemble(".text\n    sw x1\n"));
+    std::string message;
+    try {
+        program.assembler.assemble(".text\n    addi x1, x2\n");
+    } catch (const std::exception& e) {
+        message = e.what();
+    }
+    CHECK(message.find("Incorrect number of operands for 'addi'. Expected 3, got 2") != std::string::npos);
+}
+
+TEST(fillRejectsATotalPastTheDataSegment) {
+    // 0x2000000000000000 x 8 wraps to zero bytes when multiplied unchecked
+    for (const char* fill : {".fill 0x2000000000000000, 8", ".fill 0x2000000000000000, 8, 1", ".fill 0x4000001, 4, 1"}) {
+        Program program;
+        CHECK_THROWS(program.assembler.assemble(std::string(".data\n") + fill + "\n"));
+    }
+
+    Program program;
+    program.assembler.assemble(".data\n.fill 2, 4, 0x01020304\nend: .byte 9\n");
+    CHECK_EQUAL(int(program.memory.fetchData(0x10000004)), 4);
+    CHECK_EQUAL(int(program.memory.fetchData(0x10000007)), 1);
+    CHECK_EQUAL(program.assembler.getSymbols().getAddress("end"), 0x10000008u);
+}
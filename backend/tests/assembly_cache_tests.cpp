@@ -0,0 +1,145 @@
+#include "check.h"
+#include "assembler.h"
+#include "session.h"
+#include <cstdio>
+#include <cstdlib>
+#include <dirent.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+struct Program {
+    Memory memory;
+    Assembler assembler{memory};
+};
+
+std::string program(int value) {
+    return ".text\n    addi x5, x0, " + std::to_string(value) + "\n    exit\n";
+}
+
+void removeDirectory(const std::string& path) {
+    if (DIR* dir = opendir(path.c_str())) {
+        while (dirent* entry = readdir(dir)) {
+            std::string name = entry->d_name;
+            if (name != "." && name != "..") std::remove((path + "/" + name).c_str());
+        }
+        closedir(dir);
+    }
+    rmdir(path.c_str());
+}
+
+}  // namespace
+
+TEST(cacheHitsARepeatedProgram) {
+    Program first, second;
+    first.assembler.assemble(program(1));
+    second.assembler.assemble(program(1));
+    CHECK_EQUAL(first.assembler.getCache().misses.load(), uint64_t(1));
+    CHECK_EQUAL(second.assembler.getCache().misses.load(), uint64_t(1));
+
+    first.memory.instructionMemory.clear();
+    first.assembler.assemble(program(1));
+    CHECK_EQUAL(first.assembler.getCache().hits.load(), uint64_t(1));
+    CHECK(first.memory.instructionMemory == second.memory.instructionMemory);
+    CHECK_EQUAL(first.memory.exitAddress, second.memory.exitAddress);
+}
+
+TEST(cacheIgnoresCommentsAndIndentation) {
+    Program p;
+    p.assembler.assemble(program(1));
+    p.assembler.assemble(".text   # code\n\taddi x5, x0, 1   # five\n    exit\n");
+    CHECK_EQUAL(p.assembler.getCache().hits.load(), uint64_t(1));
+    // A different line count is a different program even if the code matches
+    p.assembler.assemble("\n" + program(1));
+    CHECK_EQUAL(p.assembler.getCache().misses.load(), uint64_t(2));
+}
+
+TEST(cacheEvictsTheLeastRecentlyUsedProgram) {
+    Program p;
+    AssemblyCache& cache = p.assembler.getCache();
+    cache.setCapacity(2);
+    p.assembler.assemble(program(1));
+    p.assembler.assemble(program(2));
+    p.assembler.assemble(program(1));  // hit, 2 is now the oldest
+    p.assembler.assemble(program(3));  // evicts 2
+    CHECK_EQUAL(cache.hits.load(), uint64_t(1));
+    CHECK_EQUAL(cache.misses.load(), uint64_t(3));
+
+    p.assembler.assemble(program(1));
+    CHECK_EQUAL(cache.hits.load(), uint64_t(2));
+    p.assembler.assemble(program(2));
+    CHECK_EQUAL(cache.misses.load(), uint64_t(4));
+}
+
+TEST(cacheWithoutCapacityKeepsNothing) {
+    Program p;
+    p.assembler.getCache().setCapacity(0);
+    p.assembler.assemble(program(1));
+    p.assembler.assemble(program(1));
+    CHECK_EQUAL(p.assembler.getCache().hits.load(), uint64_t(0));
+}
+
+TEST(cacheDirectoryIsSharedBetweenAssemblers) {
+    char pattern[] = "/tmp/assembly_cache_XXXXXX";
+    std::string directory = mkdtemp(pattern);
+
+    Program writer, reader;
+    writer.assembler.getCache().setDirectory(directory);
+    reader.assembler.getCache().setDirectory(directory);
+    writer.assembler.assemble(program(7));
+    reader.assembler.assemble(program(7));
+    CHECK_EQUAL(reader.assembler.getCache().diskHits.load(), uint64_t(1));
+    CHECK(reader.memory.instructionMemory == writer.memory.instructionMemory);
+
+    removeDirectory(directory);
+}
+
+TEST(editAfterACacheHitPatchesTheRestoredProgram) {
+    Program cached, fresh;
+    cached.assembler.assemble(program(1));
+    cached.assembler.assemble(program(1));
+    cached.assembler.edit(1, 2, "    addi x5, x0, 2\n    addi x6, x0, 3");
+    fresh.assembler.assemble(".text\n    addi x5, x0, 2\n    addi x6, x0, 3\n    exit\n");
+    CHECK(cached.memory.instructionMemory == fresh.memory.instructionMemory);
+    CHECK_EQUAL(cached.memory.exitAddress, fresh.memory.exitAddress);
+}
+
+TEST(sessionsShareTheCacheOfTheirOptions) {
+    SessionOptions options;
+    options.cache = options.makeCache();
+    Session first(options), second(options);
+    first.assembler.assemble(program(5));
+    second.assembler.assemble(program(5));
+    CHECK_EQUAL(options.cache->hits.load(), uint64_t(1));
+    CHECK_EQUAL(options.cache->misses.load(), uint64_t(1));
+    CHECK(first.memory.instructionMemory == second.memory.instructionMemory);
+
+    // Without a shared cache every session keeps its own
+    Session own(SessionOptions{});
+    own.assembler.assemble(program(5));
+    CHECK_EQUAL(own.assembler.getCache().misses.load(), uint64_t(1));
+}
+
+TEST(sharedCacheServesConcurrentAssemblers) {
+    auto cache = std::make_shared<AssemblyCache>();
+    cache->setCapacity(4);
+    std::vector<std::thread> threads;
+    std::vector<bool> correct(8, false);
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&, t]() {
+            Memory memory;
+            Assembler assembler(memory, cache);
+            bool ok = true;
+            for (int i = 0; i < 200; i++) {
+                int value = (t + i) % 6;
+                assembler.assemble(program(value));
+                ok &= memory.fetchInstruction(0) == ((uint32_t(value) << 20) | (5u << 7) | 0x13u);
+            }
+            correct[t] = ok;
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+    for (int t = 0; t < 8; t++) CHECK(correct[t]);
+    CHECK_EQUAL(cache->hits.load() + cache->misses.load(), uint64_t(8 * 200));
+}
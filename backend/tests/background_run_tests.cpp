@@ -0,0 +1,104 @@
+#include "check.h"
+#include "background_run.h"
+#include <sstream>
+
+namespace {
+
+const std::string LOOP = ".text\nloop:\n    addi x5, x5, 1\n    beq x0, x0, loop\n";
+
+// Waits until the run reports at least `cycles`, so that it is interrupted mid-way
+void waitForCycles(const BackgroundRun& run, uint64_t cycles) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(10);
+    while (std::chrono::steady_clock::now() < deadline) {
+        JsonWriter json;
+        run.writeStatus(json);
+        size_t at = json.str().find("\"cycles\": ");
+        if (at != std::string::npos && std::stoull(json.str().substr(at + 10)) >= cycles) return;
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+}  // namespace
+
+TEST(backgroundRunPausesResumesAndCancelsAnEndlessLoop) {
+    Session session(SessionOptions{});
+    JsonWriter json;
+    session.assembleAndOutput(LOOP, json);
+    std::ostringstream out, err;
+    std::mutex outputMutex;
+    BackgroundRun run(session, out, err, outputMutex, std::chrono::milliseconds(1));
+    CHECK(!run.stop(RunControl::PAUSE));
+
+    run.start(RunBudget{});
+    waitForCycles(run, 10000);
+    CHECK(run.running());
+    CHECK(run.stop(RunControl::PAUSE));
+    run.wait();
+    CHECK(!run.running());
+    std::string paused = out.str();
+    CHECK(paused.find("\"progress\": { \"cycles\": ") != std::string::npos);
+    CHECK(paused.find("\"stopped\": \"paused\"") != std::string::npos);
+    uint64_t pausedAt = session.cpu.clock;
+    uint32_t counted = session.cpu.registers[5];
+    CHECK(pausedAt >= 10000);
+    CHECK(counted > 0);
+
+    // Resuming carries on from where the pause left the program
+    out.str("");
+    run.start(RunBudget{});
+    waitForCycles(run, pausedAt + 10000);
+    CHECK(run.stop(RunControl::PAUSE));
+    run.wait();
+    CHECK(session.cpu.clock >= pausedAt + 10000);
+    CHECK(session.cpu.registers[5] > counted);
+
+    // Cancelling goes back to the start of the program
+    out.str("");
+    run.start(RunBudget{});
+    waitForCycles(run, session.cpu.clock + 1000);
+    CHECK(run.stop(RunControl::CANCEL));
+    run.wait();
+    CHECK(out.str().find("\"stopped\": \"cancelled\"") != std::string::npos);
+    CHECK_EQUAL(session.cpu.clock, 0u);
+    CHECK_EQUAL(session.cpu.registers[5], 0u);
+    CHECK(err.str().empty());
+}
+
+TEST(backgroundRunStopsAtItsBudget) {
+    Session session(SessionOptions{});
+    JsonWriter json;
+    session.assembleAndOutput(LOOP, json);
+    std::ostringstream out, err;
+    std::mutex outputMutex;
+    BackgroundRun run(session, out, err, outputMutex, std::chrono::milliseconds(0));
+
+    RunBudget budget;
+    budget.cycles = 5000;
+    run.start(budget);
+    run.wait();
+    CHECK(!run.running());
+    CHECK_EQUAL(session.cpu.clock, 5000u);
+    CHECK(out.str().find("\"stopped\": \"cycles\"") != std::string::npos);
+    CHECK(out.str().find("progress") == std::string::npos);
+    json.clear();
+    run.writeStatus(json);
+    CHECK_EQUAL(json.str(), std::string("{ \"running\": false }"));
+}
+
+TEST(backgroundRunKeepsOnlyTheLastCyclePipelineComments) {
+    Session session(SessionOptions{});
+    JsonWriter json;
+    session.assembleAndOutput(LOOP, json);
+    session.cpu.pipeline = true;
+    std::ostringstream out, err;
+    std::mutex outputMutex;
+    BackgroundRun run(session, out, err, outputMutex, std::chrono::milliseconds(0));
+
+    RunBudget budget;
+    budget.cycles = 20000;
+    run.start(budget);
+    run.wait();
+    CHECK_EQUAL(session.cpu.clock, 20000u);
+    // One comment per stage at most, a fetch every cycle would leave about 10000
+    CHECK(session.memory.pipelineComments.size() <= 5);
+}
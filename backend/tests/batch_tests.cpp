@@ -0,0 +1,97 @@
+#include "check.h"
+#include "batch.h"
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+
+namespace {
+
+// A directory of programs, removed again at the end of the test
+struct ProgramDirectory {
+    std::string path;
+
+    ProgramDirectory() {
+        char pattern[] = "/tmp/batch_XXXXXX";
+        path = mkdtemp(pattern);
+    }
+    ~ProgramDirectory() { std::filesystem::remove_all(path); }
+
+    void write(const std::string& name, const std::string& source) {
+        std::filesystem::create_directories(std::filesystem::path(path + "/" + name).parent_path());
+        std::ofstream(path + "/" + name) << source;
+    }
+};
+
+std::vector<std::string> runBatch(const std::string& directory, const Batch::Options& options) {
+    std::ostringstream out;
+    CHECK_EQUAL(Batch::run(directory, options, SessionOptions{}, out), 0u);
+    std::vector<std::string> lines;
+    std::istringstream in(out.str());
+    for (std::string line; std::getline(in, line);) lines.push_back(line);
+    return lines;
+}
+
+// The string value of `"key": "..."` in a record
+std::string field(const std::string& record, const std::string& key) {
+    size_t at = record.find("\"" + key + "\": \"");
+    if (at == std::string::npos) return "";
+    size_t value = at + key.size() + 5;
+    return record.substr(value, record.find('"', value) - value);
+}
+
+// FNV-1a over each written address and byte, the way batch records hash the data segment
+std::string dataHash(const std::vector<std::pair<uint32_t, uint8_t>>& bytes) {
+    uint64_t hash = 0xcbf29ce484222325ull;
+    auto mix = [&](uint8_t byte) {
+        hash ^= byte;
+        hash *= 0x100000001b3ull;
+    };
+    for (auto [address, value] : bytes) {
+        for (int shift = 0; shift < 32; shift += 8) mix(static_cast<uint8_t>(address >> shift));
+        mix(value);
+    }
+    char hex[19];
+    snprintf(hex, sizeof(hex), "0x%016llx", static_cast<unsigned long long>(hash));
+    return hex;
+}
+
+}  // namespace
+
+TEST(batchReportsProgramsInPathOrder) {
+    ProgramDirectory directory;
+    directory.write("b_loop.asm", ".text\nloop:\n    beq x0, x0, loop\n");
+    directory.write("a_store.asm", ".text\n    lui x16, 0x10000\n    addi x5, x0, 7\n    sb x5, 0(x16)\n"
+                                   "    sb x5, 1(x16)\n    exit\n");
+
+    Batch::Options options;
+    options.jobs = 2;
+    options.budget.cycles = 10000;
+    std::vector<std::string> lines = runBatch(directory.path, options);
+    CHECK_EQUAL(lines.size(), 3u);
+    if (lines.size() != 3) return;
+
+    CHECK_EQUAL(field(lines[0], "file"), std::string("a_store.asm"));
+    CHECK_EQUAL(field(lines[0], "status"), std::string("exited"));
+    CHECK_EQUAL(field(lines[0], "data_hash"), dataHash({{0x10000000, 7}, {0x10000001, 7}}));
+    CHECK(lines[0].find("\"data_bytes\": 2 }") != std::string::npos);
+
+    CHECK_EQUAL(field(lines[1], "file"), std::string("b_loop.asm"));
+    CHECK_EQUAL(field(lines[1], "status"), std::string("stopped"));
+    CHECK_EQUAL(field(lines[1], "stopped"), std::string("cycles"));
+
+    CHECK(lines[2].find("\"programs\": 2, \"exited\": 1, \"stopped\": 1, \"errors\": 0, \"jobs\": 2") !=
+          std::string::npos);
+}
+
+TEST(batchStopsLoopingProgramsByDefault) {
+    CHECK_EQUAL(Batch::Options{}.budget.cycles, Batch::DEFAULT_MAX_CYCLES);
+
+    ProgramDirectory directory;
+    directory.write("loop.asm", ".text\nloop:\n    beq x0, x0, loop\n");
+    std::vector<std::string> lines = runBatch(directory.path, Batch::Options{});
+    CHECK_EQUAL(field(lines.at(0), "status"), std::string("stopped"));
+    size_t clock = lines.at(0).find("\"clock_cycles\": ") + 16;
+    CHECK_EQUAL(std::stoull(lines.at(0).substr(clock)), Batch::DEFAULT_MAX_CYCLES);
+}
@@ -0,0 +1,108 @@
+#include "check.h"
+#include "binary_protocol.h"
+#include <sstream>
+
+namespace {
+
+void appendU32(std::string& out, uint32_t value) {
+    for (int i = 0; i < 4; i++) out.push_back(static_cast<char>(value >> (i * 8)));
+}
+
+std::string frame(const std::string& payload) {
+    std::string out;
+    appendU32(out, static_cast<uint32_t>(payload.size()));
+    return out + payload;
+}
+
+std::string request(uint8_t opcode, const std::string& arguments = "") {
+    return frame(std::string(1, static_cast<char>(opcode)) + arguments);
+}
+
+std::string u32s(std::initializer_list<uint32_t> values) {
+    std::string out;
+    for (uint32_t value : values) appendU32(out, value);
+    return out;
+}
+
+uint32_t readU32(const std::string& bytes, size_t at) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(bytes.data()) + at;
+    return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+// Response payloads, without their length prefixes
+std::vector<std::string> serve(const std::string& requests) {
+    Session session(SessionOptions{});
+    std::istringstream in(requests);
+    std::ostringstream out;
+    BinaryProtocol::serve(in, out, session);
+
+    std::vector<std::string> responses;
+    std::string bytes = out.str();
+    for (size_t at = 0; at + 4 <= bytes.size();) {
+        uint32_t length = readU32(bytes, at);
+        responses.push_back(bytes.substr(at + 4, length));
+        at += 4 + length;
+    }
+    return responses;
+}
+
+// Offsets into a state response: status, opcode, then the state body
+constexpr size_t CLOCK = 2 + 8;
+constexpr size_t EXITED = 2 + 187;
+
+const std::string LOOP = ".text\nloop:\n    addi x5, x5, 1\n    beq x0, x0, loop\n";
+
+}  // namespace
+
+TEST(binaryOversizedFrameIsAnsweredWithAnError) {
+    std::string requests;
+    appendU32(requests, BinaryProtocol::MAX_FRAME + 1);
+    requests += std::string(BinaryProtocol::MAX_FRAME + 1, '\x07');
+    requests += request(BinaryProtocol::STATE);
+
+    std::vector<std::string> responses = serve(requests);
+    CHECK_EQUAL(responses.size(), size_t(2));
+    if (responses.size() != 2) return;
+    CHECK_EQUAL(int(responses[0][0]), 1);
+    CHECK(responses[0].find("exceeds the limit") != std::string::npos);
+    // The stream stays in step, the frame after it is served normally
+    CHECK_EQUAL(int(responses[1][0]), 0);
+    CHECK_EQUAL(int(responses[1][1]), int(BinaryProtocol::STATE));
+}
+
+TEST(binaryRunStopsAtItsCycleLimit) {
+    std::vector<std::string> responses = serve(request(BinaryProtocol::ASSEMBLE, LOOP) +
+                                               request(BinaryProtocol::RUN, u32s({1000})) +
+                                               request(BinaryProtocol::RUN, u32s({0, 500})));
+    CHECK_EQUAL(responses.size(), size_t(3));
+    if (responses.size() != 3) return;
+    CHECK_EQUAL(int(responses[1][0]), 0);
+    CHECK_EQUAL(readU32(responses[1], CLOCK), uint32_t(1000));
+    CHECK_EQUAL(int(responses[1][EXITED]), 0);
+    // The instruction limit counts from where the last run stopped
+    CHECK(readU32(responses[2], CLOCK) > 1000);
+    CHECK_EQUAL(int(responses[2][EXITED]), 0);
+}
+
+TEST(binaryRunWithoutLimitsFinishesTheProgram) {
+    std::vector<std::string> responses = serve(
+        request(BinaryProtocol::ASSEMBLE, ".text\n    addi x5, x0, 3\n    exit\n") + request(BinaryProtocol::RUN));
+    CHECK_EQUAL(responses.size(), size_t(2));
+    if (responses.size() != 2) return;
+    CHECK_EQUAL(int(responses[1][EXITED]), 1);
+    CHECK_EQUAL(readU32(responses[1], 2 + 16 + 5 * 4), uint32_t(3));  // x5
+}
+
+TEST(binaryProgramRunsAreLittleEndian) {
+    std::string bytes;
+    for (int i = 0; i < 300; i++) bytes += (i ? ", " : "") + std::to_string(i % 128);
+    std::vector<std::string> responses = serve(
+        request(BinaryProtocol::ASSEMBLE, ".data\n.byte " + bytes + "\n.text\n    addi x5, x0, 3\n"));
+    CHECK_EQUAL(responses.size(), size_t(1));
+    if (responses.size() != 1) return;
+    const std::string& program = responses[0];
+    size_t runs = 2 + 8 + 8 * readU32(program, 2 + 4);
+    CHECK_EQUAL(program.substr(runs, 12), u32s({1, 0x10000000, 300}));
+    CHECK_EQUAL(int(program[runs + 12 + 299]), 299 % 128);
+    CHECK_EQUAL(program.size(), runs + 12 + 300);
+}
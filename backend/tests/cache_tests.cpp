@@ -0,0 +1,142 @@
+#include "check.h"
+#include "cache.h"
+#include "session.h"
+
+namespace {
+
+// 4 KiB, 32 byte lines, 2 ways: 64 sets, so addresses 2 KiB apart share a set
+CacheConfig twoWay(const std::string& options = "") {
+    return CacheConfig::parse("size=4096 line=32 ways=2 hit=1 miss=20 " + options);
+}
+
+constexpr uint32_t SET_STRIDE = 2048;
+
+// Runs a loop summing a 64 word array four times, returns the cycles it took
+uint64_t runArrayLoop(const std::string& cache) {
+    Session session(SessionOptions{});
+    JsonWriter json;
+    JsonRequest request;
+    std::string words;
+    for (int i = 0; i < 64; i++) words += (i ? ", " : "") + std::to_string(i);
+    session.assembleAndOutput(".data\narr: .word " + words + "\n.text\n"
+                              "    addi x7, x0, 4\n"
+                              "outer:\n"
+                              "    lui x16, 0x10000\n"
+                              "    addi x5, x0, 64\n"
+                              "inner:\n"
+                              "    lw x6, 0(x16)\n"
+                              "    add x10, x10, x6\n"
+                              "    addi x16, x16, 4\n"
+                              "    addi x5, x5, -1\n"
+                              "    bne x5, x0, inner\n"
+                              "    addi x7, x7, -1\n"
+                              "    bne x7, x0, outer\n", json);
+    json.clear();
+    session.execute("pipeline", request, json);
+    if (!cache.empty()) {
+        json.clear();
+        session.execute("cache " + cache, request, json);
+    }
+    json.clear();
+    session.execute("run", request, json);
+    CHECK_EQUAL(session.cpu.registers[10], 4u * (63 * 64 / 2));
+    if (session.cpu.dataCache) {
+        const CacheStats& stats = session.cpu.dataCache->stats();
+        CHECK_EQUAL(stats.reads, 256u);
+        // One miss per line on the first pass, the array then stays in the cache
+        CHECK_EQUAL(stats.misses, 8u);
+        CHECK_EQUAL(stats.hits, 248u);
+        CHECK(session.cpu.totalMemoryStallCycles > 0);
+    }
+    return session.cpu.clock;
+}
+
+}  // namespace
+
+TEST(cacheMissesOnceThenHits) {
+    Cache cache(twoWay());
+    CHECK_EQUAL(cache.access(0x100, 4, false), 20u);
+    CHECK_EQUAL(cache.access(0x104, 4, false), 1u);
+    CHECK_EQUAL(cache.access(0x11C, 4, true), 1u);
+    CHECK_EQUAL(cache.stats().reads, 2u);
+    CHECK_EQUAL(cache.stats().writes, 1u);
+    CHECK_EQUAL(cache.stats().misses, 1u);
+    CHECK_EQUAL(cache.stats().hits, 2u);
+    CHECK_EQUAL(cache.stats().evictions, 0u);
+}
+
+TEST(cacheAccessSpanningTwoLinesTouchesBoth) {
+    Cache cache(twoWay());
+    CHECK_EQUAL(cache.access(0x11E, 4, false), 20u);
+    CHECK_EQUAL(cache.stats().misses, 2u);
+    CHECK_EQUAL(cache.access(0x120, 4, false), 1u);
+}
+
+TEST(cacheLruEvictsTheLeastRecentlyUsedWay) {
+    Cache cache(twoWay("replacement=lru"));
+    cache.access(0, 4, false);
+    cache.access(SET_STRIDE, 4, false);
+    cache.access(0, 4, false);
+    cache.access(2 * SET_STRIDE, 4, false);  // replaces SET_STRIDE
+    CHECK_EQUAL(cache.stats().evictions, 1u);
+    CHECK_EQUAL(cache.access(0, 4, false), 1u);
+    CHECK_EQUAL(cache.access(SET_STRIDE, 4, false), 20u);
+}
+
+TEST(cachePlruFollowsTheTree) {
+    Cache cache(CacheConfig::parse("size=4096 line=32 ways=4 replacement=plru"));
+    // Four ways in set 0, then touch ways 0 and 2: the tree points at way 1
+    uint32_t stride = 4096 / 4;
+    for (uint32_t way = 0; way < 4; way++) cache.access(way * stride, 4, false);
+    cache.access(0, 4, false);
+    cache.access(2 * stride, 4, false);
+    cache.access(4 * stride, 4, false);
+    CHECK_EQUAL(cache.access(0, 4, false), 1u);
+    CHECK_EQUAL(cache.access(2 * stride, 4, false), 1u);
+    CHECK_EQUAL(cache.access(3 * stride, 4, false), 1u);
+    CHECK_EQUAL(cache.access(stride, 4, false), 20u);
+}
+
+TEST(cacheWriteBackWritesDirtyVictimsOnly) {
+    Cache cache(twoWay("write=back"));
+    cache.access(0, 4, true);
+    cache.access(SET_STRIDE, 4, false);
+    cache.access(2 * SET_STRIDE, 4, false);  // evicts the dirty line at 0
+    cache.access(3 * SET_STRIDE, 4, false);  // evicts the clean line at SET_STRIDE
+    CHECK_EQUAL(cache.stats().evictions, 2u);
+    CHECK_EQUAL(cache.stats().writebacks, 1u);
+
+    Cache through(twoWay("write=through"));
+    through.access(0, 4, true);
+    through.access(SET_STRIDE, 4, false);
+    through.access(2 * SET_STRIDE, 4, false);
+    CHECK_EQUAL(through.stats().writebacks, 0u);
+}
+
+TEST(cacheStoreMissWithoutAllocateBypassesTheCache) {
+    Cache cache(twoWay("allocate=off"));
+    CHECK_EQUAL(cache.access(0x40, 4, true), 1u);
+    CHECK_EQUAL(cache.stats().misses, 1u);
+    CHECK_EQUAL(cache.access(0x40, 4, false), 20u);
+    CHECK_EQUAL(cache.stats().misses, 2u);
+}
+
+TEST(cacheClearInvalidatesAndZeroesCounters) {
+    Cache cache(twoWay());
+    cache.access(0, 4, false);
+    cache.clear();
+    CHECK_EQUAL(cache.stats().reads, 0u);
+    CHECK_EQUAL(cache.access(0, 4, false), 20u);
+}
+
+TEST(cacheInvalidGeometryIsRejected) {
+    CHECK_THROWS(Cache(CacheConfig::parse("size=3000")));
+    CHECK_THROWS(CacheConfig::parse("ways"));
+    CHECK_THROWS(CacheConfig::parse("colour=red"));
+}
+
+TEST(cacheMissesStallThePipeline) {
+    uint64_t without = runArrayLoop("");
+    uint64_t with = runArrayLoop("dcache size=4096 line=32 ways=2 miss=20");
+    CHECK(with > without);
+}
@@ -0,0 +1,62 @@
+/*
+A minimal test harness. TEST registers a function with the runner in main.cpp,
+CHECK and CHECK_EQUAL report a failed check with its location and carry on, an
+exception thrown out of a test fails it as a whole.
+*/
+
+#pragma once
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+struct TestCase {
+    const char* name;
+    void (*run)();
+};
+
+std::vector<TestCase>& testCases();
+extern int failedChecks;
+
+struct TestRegistrar {
+    TestRegistrar(const char* name, void (*run)()) { testCases().push_back({name, run}); }
+};
+
+#define TEST(name) \
+    static void name(); \
+    static TestRegistrar name##Registrar(#name, name); \
+    static void name()
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            failedChecks++; \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": CHECK(" #condition ") failed\n"; \
+        } \
+    } while (0)
+
+#define CHECK_EQUAL(actual, expected) \
+    do { \
+        auto actualValue = (actual); \
+        auto expectedValue = (expected); \
+        if (!(actualValue == expectedValue)) { \
+            failedChecks++; \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #actual " is " << actualValue \
+                      << ", expected " << expectedValue << "\n"; \
+        } \
+    } while (0)
+
+#define CHECK_THROWS(expression) \
+    do { \
+        bool threw = false; \
+        try { \
+            (void)(expression); \
+        } catch (const std::exception&) { \
+            threw = true; \
+        } \
+        if (!threw) { \
+            failedChecks++; \
+            std::cerr << __FILE__ << ":" << __LINE__ << ": " #expression " did not throw\n"; \
+        } \
+    } while (0)
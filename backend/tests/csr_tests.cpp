@@ -0,0 +1,138 @@
+#include "check.h"
+#include "assembler.h"
+#include "cpu.h"
+
+namespace {
+
+struct Program {
+    Memory memory;
+    Assembler assembler{memory};
+    Cpu cpu{memory};
+
+    explicit Program(const std::string& source) {
+        assembler.assemble(source);
+        cpu.PC = assembler.getEntryPoint();
+    }
+};
+
+// The error of running `source` to its end, empty when it exits
+std::string runError(const std::string& source) {
+    Program program(source);
+    try {
+        program.cpu.runUntil(10000, 10000);
+    } catch (const std::exception& e) {
+        return e.what();
+    }
+    return "";
+}
+
+}  // namespace
+
+TEST(csrInstructionsEncodeAsZicsr) {
+    Program program(".text\n"
+                    "    csrrw x5, mcycle, x6\n"
+                    "    csrrs x5, instret, x0\n"
+                    "    csrr x7, hpmcounter3\n"
+                    "    csrrw x0, 0xB02, x1\n"
+                    "    rdcycle x10\n"
+                    "    rdtime x10\n"
+                    "    rdinstret x10\n");
+    const uint32_t expected[] = {0xB00312F3, 0xC02022F3, 0xC03023F3, 0xB0209073, 0xC0002573, 0xC0102573, 0xC0202573};
+    for (uint32_t i = 0; i < 7; i++) {
+        CHECK_EQUAL(program.memory.fetchInstruction(i * 4), expected[i]);
+    }
+    CHECK_THROWS(Program(".text\n    csrr x5, nocsr\n"));
+    CHECK_THROWS(Program(".text\n    csrr x5, 0x1000\n"));
+}
+
+TEST(rdcycleMeasuresALoop) {
+    // Five cycles to an instruction without pipelining, 22 instructions from the first rdcycle to the second
+    Program program(".text\n"
+                    "    rdcycle x10\n"
+                    "    addi x5, x0, 10\n"
+                    "loop:\n"
+                    "    addi x5, x5, -1\n"
+                    "    bne x5, x0, loop\n"
+                    "    rdcycle x11\n"
+                    "    rdinstret x12\n"
+                    "    sub x13, x11, x10\n"
+                    "    exit\n");
+    CHECK(program.cpu.runUntil(10000, 10000));
+    CHECK_EQUAL(program.cpu.registers[13], 110u);
+    // instret counts the instructions retired before it
+    CHECK_EQUAL(program.cpu.registers[12], 23u);
+}
+
+TEST(writingAUserCounterThrows) {
+    CHECK(runError(".text\n    csrrw x5, cycle, x6\n    exit\n").find("CSR 0xc00 is read only") != std::string::npos);
+    CHECK(runError(".text\n    csrw hpmcounter3, x6\n    exit\n").find("read only") != std::string::npos);
+    // Setting no bits writes nothing
+    CHECK_EQUAL(runError(".text\n    csrrs x5, cycle, x0\n    exit\n"), std::string());
+}
+
+TEST(unwiredCountersAreRejected) {
+    Memory memory;
+    Cpu cpu(memory);
+    CHECK_EQUAL(cpu.readCsr(0xC0C), 0u);  // hpmcounter12, the last one
+    CHECK_THROWS(cpu.readCsr(0xC0D));
+    CHECK_THROWS(cpu.readCsr(0xC14));  // hpmcounter20
+    CHECK_THROWS(cpu.readCsr(0xB94));
+    CHECK_THROWS(cpu.writeCsr(0xB14, 1));
+    CHECK(runError(".text\n    csrr x5, 0xC14\n    exit\n").find("Unsupported CSR 0xc14") != std::string::npos);
+}
+
+TEST(machineCounterWritesOffsetLaterReads) {
+    Memory memory;
+    Cpu cpu(memory);
+    cpu.clock = 100;
+    cpu.writeCsr(0xB00, 7);  // mcycle
+    cpu.clock = 150;
+    CHECK_EQUAL(cpu.readCsr(0xC00), 57u);
+    CHECK_EQUAL(cpu.readCsr(0xC80), 0u);
+    cpu.writeCsr(0xB80, 2);  // mcycleh leaves the low half alone
+    CHECK_EQUAL(cpu.readCsr(0xC80), 2u);
+    CHECK_EQUAL(cpu.readCsr(0xC00), 57u);
+
+    cpu.totalBubbles = 10;
+    cpu.writeCsr(0xB03, 0);  // mhpmcounter3
+    cpu.totalBubbles = 14;
+    CHECK_EQUAL(cpu.readCsr(0xC03), 4u);
+
+    // In a program: the rdcycle right after the write sees the five cycles of one instruction
+    Program program(".text\n    csrw mcycle, x0\n    rdcycle x10\n    exit\n");
+    CHECK(program.cpu.runUntil(10000, 10000));
+    CHECK_EQUAL(program.cpu.registers[10], 5u);
+}
+
+TEST(csrrwToX0DoesNotRead) {
+    Program program(".text\n    addi x6, x0, 9\n    csrrw x0, mhpmcounter3, x6\n    exit\n");
+    for (int i = 0; i < 8; i++) program.cpu.step();  // five cycles of addi, then fetch, decode and execute
+    CHECK(program.memory.comment.find("wrote 9 to CSR") != std::string::npos);
+    CHECK_EQUAL(program.cpu.readCsr(0xC03), 9u);
+}
+
+TEST(hpmcountersMatchTheirCpuCounters) {
+    Memory memory;
+    Cpu cpu(memory);
+    cpu.totalBubbles = 3;
+    cpu.totalDataHazards = 4;
+    cpu.totalDataHazardBubbles = 5;
+    cpu.totalControlHazards = 6;
+    cpu.totalControlHazardBubbles = 7;
+    cpu.totalBranchMissPredictions = 8;
+    cpu.instructionCache = std::make_unique<Cache>(CacheConfig{});
+    cpu.dataCache = std::make_unique<Cache>(CacheConfig{});
+    for (uint32_t line = 0; line < 9; line++) cpu.instructionCache->access(line * 64, 4, false);
+    for (uint32_t line = 0; line < 10; line++) cpu.dataCache->access(0x10000000 + line * 64, 4, false);
+    cpu.totalMemoryStallCycles = 11;
+    cpu.totalFunctionalUnitBubbles = 12;
+    for (uint32_t counter = 3; counter <= 12; counter++) {
+        CHECK_EQUAL(cpu.readCsr(0xC00 + counter), counter);
+    }
+    cpu.clock = 0x100000005ull;
+    cpu.totalInstructions = 2;
+    CHECK_EQUAL(cpu.readCsr(0xC00), 5u);
+    CHECK_EQUAL(cpu.readCsr(0xC80), 1u);
+    CHECK_EQUAL(cpu.readCsr(0xC01), 5u);  // time ticks with cycle
+    CHECK_EQUAL(cpu.readCsr(0xC02), 2u);
+}
@@ -0,0 +1,153 @@
+#include "check.h"
+#include "session.h"
+#include <vector>
+
+namespace {
+
+const std::string LOOP = ".text\nloop:\n    addi x5, x5, 1\n    beq x0, x0, loop\n";
+
+// Sums 1 to `n` into x10 and stores it, then exits
+std::string sumProgram(int n) {
+    return ".data\nsum: .word 0\n.text\n"
+           "    addi x5, x0, " + std::to_string(n) + "\n"
+           "loop:\n"
+           "    add x10, x10, x5\n"
+           "    addi x5, x5, -1\n"
+           "    bne x5, x0, loop\n"
+           "    sw x10, 0(x3)\n"
+           "    exit\n";
+}
+
+std::vector<uint64_t> yields(CycleGenerator& execution) {
+    std::vector<uint64_t> clocks;
+    while (execution.next()) clocks.push_back(execution.value());
+    return clocks;
+}
+
+void checkSameState(const Session& a, const Session& b) {
+    CHECK_EQUAL(a.cpu.clock, b.cpu.clock);
+    CHECK_EQUAL(a.cpu.totalInstructions, b.cpu.totalInstructions);
+    CHECK_EQUAL(a.cpu.PC, b.cpu.PC);
+    for (int i = 0; i < 32; i++) CHECK_EQUAL(a.cpu.registers[i], b.cpu.registers[i]);
+    CHECK_EQUAL(int(a.memory.fetchData(0x10000000)), int(b.memory.fetchData(0x10000000)));
+}
+
+}  // namespace
+
+TEST(executionYieldsEveryCyclesPerYieldAndStopsAtTheClockLimit) {
+    Session session(SessionOptions{});
+    JsonWriter json;
+    session.assembleAndOutput(LOOP, json);
+
+    CycleGenerator execution = session.cpu.execution(100, 1000);
+    CHECK_EQUAL(session.cpu.clock, 0u);  // nothing runs before the first next()
+    CHECK(yields(execution) == (std::vector<uint64_t>{100, 200, 300, 400, 500, 600, 700, 800, 900}));
+    CHECK(execution.done());
+    CHECK(!execution.next());
+    CHECK_EQUAL(session.cpu.clock, 1000u);
+    CHECK(!session.cpu.finished());
+}
+
+TEST(executionStopsAtTheInstructionLimit) {
+    Session session(SessionOptions{});
+    JsonWriter json;
+    session.assembleAndOutput(LOOP, json);
+
+    // Five cycles to an instruction without pipelining
+    CycleGenerator execution = session.cpu.execution(100, UINT64_MAX, 50);
+    CHECK(yields(execution) == (std::vector<uint64_t>{100, 200}));
+    CHECK_EQUAL(session.cpu.totalInstructions, 50u);
+    CHECK_EQUAL(session.cpu.clock, 250u);
+    CHECK_EQUAL(session.cpu.registers[5], 25u);
+}
+
+TEST(executionFinishesAtExit) {
+    Session session(SessionOptions{});
+    JsonWriter json;
+    session.assembleAndOutput(sumProgram(10), json);
+
+    CycleGenerator execution = session.cpu.execution(7);
+    std::vector<uint64_t> clocks = yields(execution);
+    CHECK(session.cpu.finished());
+    CHECK_EQUAL(session.cpu.registers[10], 55u);
+    CHECK_EQUAL(int(session.memory.fetchData(0x10000000)), 55);
+    // A yield after every full slice before the exit
+    CHECK_EQUAL(clocks.size(), size_t((session.cpu.clock - 1) / 7));
+    for (size_t i = 0; i < clocks.size(); i++) CHECK_EQUAL(clocks[i], 7 * (i + 1));
+}
+
+TEST(interleavedExecutionsEndLikeSequentialRuns) {
+    const std::string programs[2] = {sumProgram(20), sumProgram(13)};
+    // The first runs single cycle, the second pipelined with forwarding
+    Session sequential[2] = {Session(SessionOptions{}), Session(SessionOptions{})};
+    Session interleaved[2] = {Session(SessionOptions{}), Session(SessionOptions{})};
+    JsonWriter json;
+    for (int i = 0; i < 2; i++) {
+        sequential[i].assembleAndOutput(programs[i], json);
+        interleaved[i].assembleAndOutput(programs[i], json);
+        sequential[i].cpu.pipeline = interleaved[i].cpu.pipeline = i == 1;
+        sequential[i].cpu.data_forward = interleaved[i].cpu.data_forward = i == 1;
+    }
+    for (Session& session : sequential) {
+        CHECK(session.cpu.runUntil(UINT64_MAX, UINT64_MAX));
+    }
+
+    CycleGenerator executions[2] = {interleaved[0].cpu.execution(3), interleaved[1].cpu.execution(5)};
+    bool running[2] = {true, true};
+    while (running[0] || running[1]) {
+        for (int i = 0; i < 2; i++) {
+            if (running[i]) running[i] = executions[i].next();
+        }
+    }
+    for (int i = 0; i < 2; i++) {
+        CHECK(interleaved[i].cpu.finished());
+        checkSameState(sequential[i], interleaved[i]);
+    }
+    CHECK_EQUAL(interleaved[0].cpu.registers[10], 210u);
+    CHECK_EQUAL(interleaved[1].cpu.registers[10], 91u);
+}
+
+TEST(runSlicesYieldsEverySliceAndReportsTheLimitItStoppedAt) {
+    Session session(SessionOptions{});
+    JsonWriter json;
+    session.assembleAndOutput(LOOP, json);
+
+    RunControl control;
+    control.begin(session.cpu);
+    uint64_t slices = 0;
+    control.onSlice = [&] { slices++; };
+    RunBudget budget;
+    budget.cycles = 3 * Session::SLICE_CYCLES + 10;
+    JsonWriter cycles;
+    {
+        CycleGenerator run = session.runSlices(budget, &control, cycles);
+        std::vector<uint64_t> clocks = yields(run);
+        CHECK(clocks == (std::vector<uint64_t>{Session::SLICE_CYCLES, 2 * Session::SLICE_CYCLES,
+                                               3 * Session::SLICE_CYCLES}));
+    }
+    CHECK_EQUAL(slices, 3u);
+    CHECK_EQUAL(session.cpu.clock, budget.cycles);
+    CHECK(cycles.str().find("\"stopped\": \"cycles\"") != std::string::npos);
+
+    // The instruction limit counts from where the last run stopped
+    uint64_t instructions = session.cpu.totalInstructions;
+    budget = RunBudget{};
+    budget.instructions = 1000;
+    JsonWriter limited;
+    {
+        CycleGenerator run = session.runSlices(budget, nullptr, limited);
+        CHECK(yields(run).empty());
+    }
+    CHECK_EQUAL(session.cpu.totalInstructions, instructions + 1000);
+    CHECK(limited.str().find("\"stopped\": \"instructions\"") != std::string::npos);
+
+    // A finished program reports no stop reason
+    session.assembleAndOutput(sumProgram(4), json);
+    JsonWriter finished;
+    {
+        CycleGenerator run = session.runSlices(RunBudget{}, nullptr, finished);
+        yields(run);
+    }
+    CHECK(session.cpu.finished());
+    CHECK(finished.str().find("\"stopped\"") == std::string::npos);
+}
@@ -0,0 +1,36 @@
+#include "check.h"
+#include "daemon.h"
+#include <sstream>
+
+namespace {
+
+std::string serve(const std::string& input, const SessionOptions& options, std::string& errors) {
+    std::istringstream in(input);
+    std::ostringstream out, err;
+    Daemon::serve(in, out, err, options, 2);
+    errors = err.str();
+    return out.str();
+}
+
+size_t count(const std::string& text, const std::string& part) {
+    size_t found = 0;
+    for (size_t at = text.find(part); at != std::string::npos; at = text.find(part, at + 1)) found++;
+    return found;
+}
+
+const std::string LOOP = "{\"input_code\": \".text\\nloop:\\n    addi x5, x5, 1\\n    beq x0, x0, loop\\n\"}\n";
+
+}  // namespace
+
+TEST(daemonAnalysesOfAnEndlessLoopStopAtTheDefaultBudget) {
+    SessionOptions options;
+    options.analysisCycles = 20000;  // DEFAULT_ANALYSIS_CYCLES takes a minute to sweep
+    std::string errors;
+    std::string out = serve("a assemble\n" + LOOP + "a sweep\na trace\na locality\nb assemble\n" + LOOP +
+                            "b sweep cycles=1000\n", options, errors);
+    CHECK(errors.empty());
+    CHECK_EQUAL(count(out, "\"status\": \"cycles\", \"clock\": 20000,"), 5u);
+    CHECK_EQUAL(count(out, "\"status\": \"cycles\", \"clock\": 1000,"), 5u);
+    CHECK(out.find("a { \"trace\": { \"status\": \"cycles\"") != std::string::npos);
+    CHECK(out.find("a { \"locality\": { \"status\": \"cycles\"") != std::string::npos);
+}
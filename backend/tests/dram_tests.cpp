@@ -0,0 +1,76 @@
+#include "check.h"
+#include "cache.h"
+#include "dram.h"
+
+namespace {
+
+// The default geometry: 8 banks of 2 KiB rows, so 16 KiB apart is the same bank, another row
+constexpr uint32_t BANK_STRIDE = 2048 * 8;
+
+}  // namespace
+
+TEST(dramCountsRowHitsClosedRowsAndConflicts) {
+    Dram dram(DramConfig{});
+    CHECK_EQUAL(dram.read(0, 0), 20u);
+    CHECK_EQUAL(dram.read(64, 100), 10u);
+    CHECK_EQUAL(dram.read(BANK_STRIDE, 200), 30u);
+    CHECK_EQUAL(dram.read(2048, 300), 20u);  // the next bank, still closed
+    CHECK_EQUAL(dram.stats().reads, 4u);
+    CHECK_EQUAL(dram.stats().rowClosed, 2u);
+    CHECK_EQUAL(dram.stats().rowHits, 1u);
+    CHECK_EQUAL(dram.stats().rowConflicts, 1u);
+    CHECK_EQUAL(dram.stats().readCycles, 80u);
+}
+
+TEST(dramBankServesOneRequestAtATime) {
+    Dram dram(DramConfig{});
+    CHECK_EQUAL(dram.read(0, 0), 20u);
+    CHECK_EQUAL(dram.read(64, 0), 30u);    // waits for the first, then a row hit
+    CHECK_EQUAL(dram.read(2048, 0), 20u);  // another bank works in parallel
+}
+
+TEST(dramFullQueueDelaysNewRequests) {
+    Dram dram(DramConfig::parse("queue=1"));
+    CHECK_EQUAL(dram.read(0, 0), 20u);
+    CHECK_EQUAL(dram.read(2048, 0), 40u);
+    CHECK_EQUAL(dram.stats().queueCycles, 20u);
+    // A posted write only waits for its queue entry
+    CHECK_EQUAL(dram.write(4096, 0), 40u);
+    CHECK_EQUAL(dram.write(4096 + 64, 1000), 0u);
+    CHECK_EQUAL(dram.stats().writes, 2u);
+}
+
+TEST(dramClearClosesRowsAndZeroesCounters) {
+    Dram dram(DramConfig{});
+    dram.read(0, 0);
+    dram.clear();
+    CHECK_EQUAL(dram.stats().reads, 0u);
+    CHECK_EQUAL(dram.read(64, 0), 20u);
+    CHECK_EQUAL(dram.stats().rowClosed, 1u);
+}
+
+TEST(dramInvalidOptionsAreRejected) {
+    CHECK_THROWS(DramConfig::parse("banks"));
+    CHECK_THROWS(DramConfig::parse("rows=4"));
+    CHECK_THROWS(Dram(DramConfig::parse("banks=0")));
+}
+
+TEST(dramSequentialMissesStayInOpenRows) {
+    // Every access misses a 1 KiB direct mapped cache, sequential lines share rows while a
+    // stride of one bank's worth of rows conflicts every time
+    CacheConfig config = CacheConfig::parse("size=1024 line=32 ways=1");
+    Cache sequentialCache(config), stridedCache(config);
+    Dram sequential(DramConfig{}), strided(DramConfig{});
+    uint64_t sequentialCycles = 0, stridedCycles = 0;
+    for (uint32_t i = 0; i < 64; i++) {
+        sequentialCycles += sequentialCache.access(i * 32, 4, false, &sequential, sequentialCycles);
+        stridedCycles += stridedCache.access(i * BANK_STRIDE, 4, false, &strided, stridedCycles);
+    }
+    CHECK_EQUAL(sequential.stats().reads, 64u);
+    CHECK_EQUAL(sequential.stats().rowClosed, 1u);
+    CHECK_EQUAL(sequential.stats().rowHits, 63u);
+    CHECK_EQUAL(strided.stats().rowConflicts, 63u);
+    // A miss takes the hit latency plus the fill
+    CHECK_EQUAL(sequentialCycles, 1u + 20 + 63 * (1 + 10));
+    CHECK_EQUAL(stridedCycles, 1u + 20 + 63 * (1 + 30));
+}
@@ -0,0 +1,106 @@
+#include "check.h"
+#include "functional_units.h"
+#include "session.h"
+
+namespace {
+
+constexpr uint32_t FUNCTIONAL_UNIT_BUBBLES = 12;
+
+// Runs `code` after x5 = 6 and x6 = 3, returns the session for its counters
+std::unique_ptr<Session> run(const std::string& code, const std::string& latency, bool pipeline) {
+    auto session = std::make_unique<Session>(SessionOptions{});
+    JsonWriter json;
+    JsonRequest request;
+    session->assembleAndOutput(".text\n    addi x5, x0, 6\n    addi x6, x0, 3\n" + code, json);
+    std::vector<std::string> commands;
+    if (pipeline) commands = {"pipeline", "data_forward"};
+    if (!latency.empty()) commands.push_back("latency " + latency);
+    commands.push_back("run");
+    for (const std::string& command : commands) {
+        json.clear();
+        session->execute(command, request, json);
+    }
+    return session;
+}
+
+uint64_t unitBubbles(const std::string& code, const std::string& latency = "on") {
+    return run(code, latency, true)->cpu.counter(FUNCTIONAL_UNIT_BUBBLES);
+}
+
+}  // namespace
+
+TEST(latencyOfEachOperation) {
+    FunctionalUnits units(FunctionalUnitConfig::parse("mul=4 div=32 rem=16"));
+    CHECK_EQUAL(units.latency("MUL"), 4u);
+    CHECK_EQUAL(units.latency("DIV"), 32u);
+    CHECK_EQUAL(units.latency("REM"), 16u);
+    CHECK_EQUAL(units.latency("ADD"), 1u);
+}
+
+TEST(latencyDependentReadsWaitForTheResult) {
+    FunctionalUnits units(FunctionalUnitConfig{});
+    units.issue("MUL", 7, 10);
+    CHECK_EQUAL(units.readyAt("ADD", 7, 32), 13u);
+    CHECK_EQUAL(units.readyAt("ADD", 32, 7), 13u);
+    CHECK_EQUAL(units.readyAt("ADD", 8, 32), 0u);
+    // The pipelined multiplier takes another MUL right away
+    CHECK_EQUAL(units.readyAt("MUL", 5, 6), 0u);
+    // A single cycle write of the register replaces the pending result
+    units.issue("ADD", 7, 11);
+    CHECK_EQUAL(units.readyAt("ADD", 7, 32), 0u);
+    // x0 is never waited for
+    units.issue("MUL", 0, 12);
+    CHECK_EQUAL(units.readyAt("ADD", 0, 0), 0u);
+}
+
+TEST(latencyBlockingUnitsAreStructuralHazards) {
+    FunctionalUnits units(FunctionalUnitConfig::parse("multiplier=blocking"));
+    units.issue("DIV", 7, 5);
+    CHECK_EQUAL(units.readyAt("DIV", 32, 32), 25u);
+    CHECK_EQUAL(units.readyAt("REM", 32, 32), 25u);  // shares the divider
+    CHECK_EQUAL(units.readyAt("MUL", 32, 32), 0u);
+    units.issue("MUL", 8, 6);
+    CHECK_EQUAL(units.readyAt("MUL", 32, 32), 9u);
+    units.clear();
+    CHECK_EQUAL(units.readyAt("DIV", 7, 32), 0u);
+}
+
+TEST(latencyInvalidOptionsAreRejected) {
+    CHECK_THROWS(FunctionalUnitConfig::parse("mul=0"));
+    CHECK_THROWS(FunctionalUnitConfig::parse("divider=fast"));
+    CHECK_THROWS(FunctionalUnitConfig::parse("add=2"));
+    CHECK_THROWS(FunctionalUnitConfig::parse("mul"));
+}
+
+TEST(latencyStretchesExecuteWithoutPipelining) {
+    const std::string code = "    mul x7, x5, x6\n    div x8, x5, x6\n    rem x9, x5, x6\n";
+    auto plain = run(code, "", false);
+    auto timed = run(code, "on", false);
+    CHECK_EQUAL(timed->cpu.registers[7], 18u);
+    CHECK_EQUAL(timed->cpu.registers[8], 2u);
+    CHECK_EQUAL(timed->cpu.registers[9], 0u);
+    CHECK_EQUAL(plain->cpu.counter(FUNCTIONAL_UNIT_BUBBLES), 0u);
+    CHECK_EQUAL(timed->cpu.counter(FUNCTIONAL_UNIT_BUBBLES), 2u + 19 + 19);
+    CHECK_EQUAL(timed->cpu.clock - plain->cpu.clock, 2u + 19 + 19);
+}
+
+TEST(latencyStallsDependentInstructionsInThePipeline) {
+    uint64_t dependent = unitBubbles("    mul x7, x5, x6\n    add x8, x7, x7\n");
+    uint64_t hidden = unitBubbles("    mul x7, x5, x6\n    addi x10, x0, 1\n    addi x11, x0, 2\n"
+                                  "    addi x12, x0, 3\n    add x8, x7, x7\n");
+    CHECK(dependent > 0);
+    CHECK(hidden < dependent);
+    CHECK_EQUAL(unitBubbles("    mul x7, x5, x6\n    add x8, x7, x7\n", ""), 0u);
+
+    auto session = run("    mul x7, x5, x6\n    add x8, x7, x7\n", "on", true);
+    CHECK_EQUAL(session->cpu.registers[8], 36u);
+    CHECK(session->cpu.totalBubbles >= dependent);
+}
+
+TEST(latencyStallsIndependentDivisionsOnABlockingDivider) {
+    const std::string code = "    div x7, x5, x6\n    div x8, x6, x5\n";
+    uint64_t blocking = unitBubbles(code);
+    uint64_t pipelined = unitBubbles(code, "divider=pipelined");
+    CHECK(blocking >= 18);
+    CHECK_EQUAL(pipelined, 0u);
+}
@@ -0,0 +1,265 @@
+#include "check.h"
+#include "http_server.h"
+#include <arpa/inet.h>
+#include <chrono>
+#include <csignal>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+namespace {
+
+const std::string LOOP = "{\"code\": \".text\\nloop:\\n    addi x5, x5, 1\\n    beq x0, x0, loop\\n\"}";
+
+// The server in a child process, listening on a free loopback port
+struct LoopbackServer {
+    pid_t pid;
+    uint16_t port = 0;
+
+    explicit LoopbackServer(const HttpServer::ServerOptions& server = {}) {
+        int fds[2];
+        if (pipe(fds) < 0) throw std::runtime_error("pipe failed");
+        std::cout.flush();
+        pid = fork();
+        if (pid == 0) {
+            dup2(fds[1], STDOUT_FILENO);
+            ::close(fds[0]);
+            try {
+                HttpServer::serve(server, SessionOptions{});
+            } catch (const std::exception&) {
+            }
+            _exit(1);
+        }
+        ::close(fds[1]);
+        std::string line;
+        char c;
+        while (line.find('}') == std::string::npos && read(fds[0], &c, 1) == 1) {
+            line.push_back(c);
+        }
+        ::close(fds[0]);
+        size_t colon = line.find(':');
+        if (colon == std::string::npos) throw std::runtime_error("Server did not start: " + line);
+        port = static_cast<uint16_t>(std::stoul(line.substr(colon + 1)));
+    }
+
+    ~LoopbackServer() {
+        kill(pid, SIGKILL);
+        waitpid(pid, nullptr, 0);
+    }
+};
+
+struct Client {
+    int fd;
+
+    explicit Client(uint16_t port) {
+        fd = socket(AF_INET, SOCK_STREAM, 0);
+        timeval timeout{10, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(port);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) < 0) {
+            throw std::runtime_error("Cannot connect to the server");
+        }
+    }
+
+    ~Client() { ::close(fd); }
+
+    void send(const std::string& data) {
+        ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    }
+
+    std::string receive(size_t size) {
+        std::string data(size, '\0');
+        for (size_t at = 0; at < size;) {
+            ssize_t n = recv(fd, &data[at], size - at, 0);
+            if (n <= 0) throw std::runtime_error("Connection closed");
+            at += n;
+        }
+        return data;
+    }
+
+    // The response head up to its blank line
+    std::string head() {
+        std::string head;
+        while (head.size() < 4 || head.compare(head.size() - 4, 4, "\r\n\r\n") != 0) {
+            head += receive(1);
+        }
+        return head;
+    }
+
+    // The status code and body of the response
+    std::pair<int, std::string> post(const std::string& path, const std::string& body) {
+        send("POST " + path + " HTTP/1.1\r\nHost: localhost\r\nContent-Type: application/json\r\nContent-Length: " +
+             std::to_string(body.size()) + "\r\n\r\n" + body);
+        std::string response = head();
+        size_t length = response.find("Content-Length: ");
+        std::string content = receive(std::stoul(response.substr(length + 16)));
+        return {std::stoi(response.substr(9, 3)), content};
+    }
+
+    // Upgrades to a WebSocket bound to `id`, returns the status code
+    int upgrade(const std::string& id = "") {
+        send("GET /ws?id=" + id + " HTTP/1.1\r\nHost: localhost\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+             "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n");
+        std::string response = head();
+        int status = std::stoi(response.substr(9, 3));
+        if (status != 101) {
+            size_t length = response.find("Content-Length: ");
+            receive(std::stoul(response.substr(length + 16)));
+        }
+        return status;
+    }
+
+    // One masked frame, with a zero mask
+    void sendFrame(uint8_t opcode, bool fin, const std::string& payload) {
+        std::string frame(1, static_cast<char>((fin ? 0x80 : 0) | opcode));
+        if (payload.size() < 126) {
+            frame.push_back(static_cast<char>(0x80 | payload.size()));
+        } else if (payload.size() <= 0xFFFF) {
+            frame.push_back(static_cast<char>(0x80 | 126));
+            frame.push_back(static_cast<char>(payload.size() >> 8));
+            frame.push_back(static_cast<char>(payload.size()));
+        } else {
+            frame.push_back(static_cast<char>(0x80 | 127));
+            for (int shift = 56; shift >= 0; shift -= 8) frame.push_back(static_cast<char>(payload.size() >> shift));
+        }
+        send(frame + std::string(4, '\0'));
+        send(payload);
+    }
+
+    void sendText(const std::string& text) { sendFrame(1, true, text); }
+
+    std::string receiveText() {
+        std::string header = receive(2);
+        uint64_t length = header[1] & 0x7F;
+        if (length == 126 || length == 127) {
+            std::string extended = receive(length == 126 ? 2 : 8);
+            length = 0;
+            for (char byte : extended) length = (length << 8) | static_cast<uint8_t>(byte);
+        }
+        return receive(length);
+    }
+};
+
+std::string sessionId(const std::string& response) {
+    size_t at = response.find("\"id\": \"");
+    return at == std::string::npos ? "" : response.substr(at + 7, response.find('"', at + 7) - at - 7);
+}
+
+std::string withId(const std::string& id) {
+    return "{\"id\": \"" + id + "\"}";
+}
+
+}  // namespace
+
+TEST(httpRunOfAnEndlessLoopStopsAtTheDefaultBudget) {
+    LoopbackServer server;
+    Client client(server.port);
+    auto [status, body] = client.post("/assemble", LOOP);
+    CHECK_EQUAL(status, 200);
+    std::string id = sessionId(body);
+    CHECK(!id.empty());
+
+    auto started = std::chrono::steady_clock::now();
+    auto [runStatus, state] = client.post("/run", withId(id));
+    CHECK_EQUAL(runStatus, 200);
+    CHECK(state.find("\"stopped\": \"time\"") != std::string::npos);
+    CHECK(state.find("Finished") == std::string::npos);
+    CHECK(std::chrono::steady_clock::now() - started < std::chrono::seconds(5));
+
+    // A client may not ask for more time than the default
+    Client socket(server.port);
+    CHECK_EQUAL(socket.upgrade(id), 101);
+    CHECK_EQUAL(sessionId(socket.receiveText()), id);
+    started = std::chrono::steady_clock::now();
+    socket.sendText("run ms=60000");
+    CHECK(socket.receiveText().find("\"stopped\": \"time\"") != std::string::npos);
+    CHECK(std::chrono::steady_clock::now() - started < std::chrono::seconds(5));
+}
+
+TEST(httpWebSocketRefusesCommandsThatTouchFiles) {
+    LoopbackServer server;
+    Client socket(server.port);
+    CHECK_EQUAL(socket.upgrade(), 101);
+    CHECK(!sessionId(socket.receiveText()).empty());
+
+    socket.sendText("assemble\n{\"input_code\": \"addi x5, x0, 1\\naddi x6, x0, 2\\n\"}");
+    CHECK(socket.receiveText().find("error") == std::string::npos);
+    std::string path = "/tmp/http_server_test_" + std::to_string(getpid());
+    for (const std::string& command : {"save " + path, std::string("load /etc/passwd"), "record " + path}) {
+        socket.sendText(command);
+        CHECK(socket.receiveText().find("Not available over the network") != std::string::npos);
+    }
+    struct stat info;
+    CHECK(stat(path.c_str(), &info) != 0);
+
+    socket.sendText("step 2");
+    CHECK(socket.receiveText().find("error") == std::string::npos);
+    CHECK(socket.receiveText().find("error") == std::string::npos);
+}
+
+TEST(httpIdleSessionsAreEvictedUnlessAWebSocketHoldsThem) {
+    HttpServer::ServerOptions options;
+    options.idleSeconds = 1;
+    LoopbackServer server(options);
+    Client client(server.port);
+    std::string idle = sessionId(client.post("/assemble", LOOP).second);
+    std::string held = sessionId(client.post("/assemble", LOOP).second);
+    Client socket(server.port);
+    CHECK_EQUAL(socket.upgrade(held), 101);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(2500));
+    CHECK_EQUAL(client.post("/step", withId(idle)).first, 400);
+    CHECK_EQUAL(client.post("/step", withId(held)).first, 200);
+}
+
+TEST(httpSessionCapReplacesTheLeastRecentlyUsed) {
+    HttpServer::ServerOptions options;
+    options.maxSessions = 2;
+    LoopbackServer server(options);
+    Client client(server.port);
+    std::string first = sessionId(client.post("/assemble", LOOP).second);
+    std::string second = sessionId(client.post("/assemble", LOOP).second);
+    CHECK_EQUAL(client.post("/step", withId(first)).first, 200);
+    std::string third = sessionId(client.post("/assemble", LOOP).second);
+    CHECK_EQUAL(client.post("/step", withId(second)).first, 400);
+    CHECK_EQUAL(client.post("/step", withId(first)).first, 200);
+    CHECK_EQUAL(client.post("/step", withId(third)).first, 200);
+
+    // Sessions held by WebSockets are never replaced
+    Client a(server.port), b(server.port), c(server.port);
+    CHECK_EQUAL(a.upgrade(first), 101);
+    CHECK_EQUAL(b.upgrade(third), 101);
+    CHECK_EQUAL(c.upgrade(), 503);
+    CHECK_EQUAL(client.post("/assemble", LOOP).first, 503);
+}
+
+TEST(httpRunOfAnExitingProgramSaysFinished) {
+    LoopbackServer server;
+    Client client(server.port);
+    std::string id = sessionId(client.post("/assemble", "{\"code\": \".text\\n    addi x5, x0, 1\\n\"}").second);
+    auto [status, state] = client.post("/run", withId(id));
+    CHECK_EQUAL(status, 200);
+    CHECK(state.find("\"comment\": \"Finished\"") != std::string::npos);
+}
+
+TEST(httpWebSocketMessagesStayWithinTheBodyLimit) {
+    LoopbackServer server;
+    Client socket(server.port);
+    CHECK_EQUAL(socket.upgrade(), 101);
+    CHECK(!sessionId(socket.receiveText()).empty());
+
+    // Fragments of a message are joined, and their total is held to the limit of a single frame
+    socket.sendFrame(1, false, "step");
+    socket.sendFrame(0, true, " 1");
+    CHECK(socket.receiveText().find("error") == std::string::npos);
+    std::string half(40 * 1024 * 1024, ' ');
+    socket.sendFrame(1, false, half);
+    socket.sendFrame(0, true, half);
+    CHECK_EQUAL(socket.receive(4), std::string("\x88\x02\x03\xF1", 4));
+}
@@ -0,0 +1,52 @@
+#include "check.h"
+#include "json_request.h"
+#include <sstream>
+
+TEST(jsonRequestUnescapesStrings) {
+    std::istringstream in("{\"code\": \"a\\\"b\\\\c\\td\\/e\\n\\u0041\\u00e9\\u20ac\"}\n");
+    JsonRequest request;
+    request.read(in);
+    CHECK_EQUAL(request.getString("code"), std::string("a\"b\\c\td/e\nA\xc3\xa9\xe2\x82\xac"));
+}
+
+TEST(jsonRequestJoinsSurrogatePairsAndRejectsLoneOnes) {
+    std::istringstream in("{\"s\": \"\\ud83d\\ude00!\"}\n"
+                          "{\"s\": \"\\ud83d x\"}\n"
+                          "{\"s\": \"\\ude00\"}\n"
+                          "{\"s\": \"\\ud83d\\u0041\"}\n");
+    JsonRequest request;
+    request.read(in);
+    CHECK_EQUAL(request.getString("s"), std::string("\xf0\x9f\x98\x80!"));
+    CHECK_THROWS(request.read(in));
+    CHECK_THROWS(request.read(in));
+    CHECK_THROWS(request.read(in));
+}
+
+TEST(jsonRequestObjectMaySpanSeveralLines) {
+    std::istringstream in("\n  {\n  \"id\": \"abc\",\n  \"first\": 3,\n  \"nested\": {\"a\": [1, \"}\"]},\n"
+                          "  \"last\": 12\n}\nstep\n");
+    JsonRequest request;
+    request.read(in);
+    CHECK_EQUAL(request.getString("id"), std::string("abc"));
+    CHECK_EQUAL(request.getNumber("first"), size_t(3));
+    CHECK_EQUAL(request.getNumber("last"), size_t(12));
+    CHECK(!request.hasString("nested"));
+    // The line break after the object is consumed, the next command follows
+    std::string line;
+    std::getline(in, line);
+    CHECK_EQUAL(line, std::string("step"));
+}
+
+TEST(jsonRequestResynchronisesAfterAMalformedLine) {
+    std::istringstream in("{\"code\": \"x\" \"y\": 1}\n"
+                          "{\"code\": \"bad \\q escape\"}\n"
+                          "{\"code\": \"next\", \"count\": 7}\n");
+    JsonRequest request;
+    CHECK_THROWS(request.read(in));
+    CHECK_THROWS(request.read(in));
+    request.read(in);
+    CHECK_EQUAL(request.getString("code"), std::string("next"));
+    CHECK_EQUAL(request.getNumber("count"), size_t(7));
+    CHECK_THROWS(request.getNumber("code"));
+    CHECK_THROWS(request.getString("missing"));
+}
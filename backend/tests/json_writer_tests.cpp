@@ -0,0 +1,49 @@
+#include "check.h"
+#include "json_writer.h"
+#include <sstream>
+
+TEST(jsonWriterEscapesQuotesBackslashesAndControlCharacters) {
+    JsonWriter json;
+    json.string(std::string("a\"b\\c\nd\te\x01\x1f\x7f", 12));
+    CHECK_EQUAL(json.str(), std::string("\"a\\\"b\\\\c\\nd\\u0009e\\u0001\\u001f\x7f\""));
+
+    // Bytes of UTF-8 text pass through unchanged
+    json.clear();
+    json.string("caf\xc3\xa9");
+    CHECK_EQUAL(json.str(), std::string("\"caf\xc3\xa9\""));
+}
+
+TEST(jsonWriterFormatsNumbersAndHex) {
+    JsonWriter json;
+    json.number(uint64_t(18446744073709551615ull)).raw(' ').number(-42).raw(' ').hex(0xDEADBEEF).raw(' ')
+        .hexKey(0x10).onOff(true);
+    CHECK_EQUAL(json.str(), std::string("18446744073709551615 -42 0xdeadbeef \"0x00000010\": \"On\""));
+}
+
+TEST(jsonWriterReopensTheObjectJustClosed) {
+    JsonWriter json;
+    json.raw("{ \"a\": 1 }").reopen().raw(", \"b\": 2 }");
+    CHECK_EQUAL(json.str(), std::string("{ \"a\": 1, \"b\": 2 }"));
+
+    // Trailing spaces after the brace are dropped as well
+    json.clear();
+    json.raw("{ \"a\": { \"b\": 1 } }  ").reopen().raw(", \"c\": 3 }");
+    CHECK_EQUAL(json.str(), std::string("{ \"a\": { \"b\": 1 }, \"c\": 3 }"));
+
+    // Anything but a closed object is left alone
+    json.clear();
+    json.raw("[1, 2]").reopen();
+    CHECK_EQUAL(json.str(), std::string("[1, 2]"));
+    json.clear();
+    json.reopen();
+    CHECK_EQUAL(json.str(), std::string());
+}
+
+TEST(jsonWriterFlushWritesALineAndClears) {
+    JsonWriter json;
+    std::ostringstream out;
+    json.raw("{ }").flush(out);
+    json.raw("{ \"x\": 1 }").flush(out);
+    CHECK_EQUAL(out.str(), std::string("{ }\n{ \"x\": 1 }\n"));
+    CHECK(json.str().empty());
+}
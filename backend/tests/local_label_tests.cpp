@@ -0,0 +1,81 @@
+#include "check.h"
+#include "assembler.h"
+
+namespace {
+
+struct Program {
+    Memory memory;
+    Assembler assembler{memory};
+};
+
+// The same loop nest written with numeric local labels and with named ones
+const std::string LOCAL =
+    ".text\n"
+    "    addi x5, x0, 3\n"
+    "1:\n"
+    "    addi x6, x0, 2\n"
+    "1:\n"
+    "    addi x6, x6, -1\n"
+    "    bne x6, x0, 1b\n"
+    "    addi x5, x5, -1\n"
+    "    beq x5, x0, 2f\n"
+    "    jal x0, 3f\n"
+    "2:\n"
+    "    exit\n"
+    "3:\n"
+    "    bne x5, x0, 1b\n"
+    "    jal x0, 2b\n";
+
+const std::string NAMED =
+    ".text\n"
+    "    addi x5, x0, 3\n"
+    "outer:\n"
+    "    addi x6, x0, 2\n"
+    "inner:\n"
+    "    addi x6, x6, -1\n"
+    "    bne x6, x0, inner\n"
+    "    addi x5, x5, -1\n"
+    "    beq x5, x0, done\n"
+    "    jal x0, back\n"
+    "done:\n"
+    "    exit\n"
+    "back:\n"
+    "    bne x5, x0, inner\n"
+    "    jal x0, done\n";
+
+}  // namespace
+
+TEST(localLabelsResolveToTheNearestDefinition) {
+    Program local, named;
+    local.assembler.assemble(LOCAL);
+    named.assembler.assemble(NAMED);
+    CHECK(local.memory.instructionMemory == named.memory.instructionMemory);
+    CHECK_EQUAL(local.memory.exitAddress, named.memory.exitAddress);
+}
+
+TEST(localLabelsGetOneSymbolPerDefinition) {
+    Program program;
+    program.assembler.assemble(LOCAL);
+    const SymbolTable& symbols = program.assembler.getSymbols();
+    CHECK_EQUAL(symbols.getAddress("1@0"), uint32_t(4));
+    CHECK_EQUAL(symbols.getAddress("1@1"), uint32_t(8));
+}
+
+TEST(undefinedLocalReferencesAreErrors) {
+    Program program;
+    CHECK_THROWS(program.assembler.assemble(".text\n    beq x0, x0, 1f\n    exit\n"));
+    CHECK_THROWS(program.assembler.assemble(".text\n1:\n    beq x0, x0, 1f\n    exit\n"));
+}
+
+TEST(editAddingALocalLabelRenumbersTheLaterOnes) {
+    Program edited, full;
+    edited.assembler.assemble(LOCAL);
+    // A new `1:` between the two loops makes `bne x5, x0, 1b` at the end target it
+    edited.assembler.edit(9, 9, "1:\n    addi x7, x0, 1");
+    full.assembler.assemble(
+        ".text\n    addi x5, x0, 3\n1:\n    addi x6, x0, 2\n1:\n    addi x6, x6, -1\n    bne x6, x0, 1b\n"
+        "    addi x5, x5, -1\n    beq x5, x0, 2f\n1:\n    addi x7, x0, 1\n    jal x0, 3f\n2:\n    exit\n"
+        "3:\n    bne x5, x0, 1b\n    jal x0, 2b\n");
+    CHECK(edited.memory.instructionMemory == full.memory.instructionMemory);
+    CHECK_EQUAL(edited.memory.exitAddress, full.memory.exitAddress);
+}
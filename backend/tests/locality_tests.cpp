@@ -0,0 +1,124 @@
+#include "check.h"
+#include "locality.h"
+#include <algorithm>
+#include <list>
+
+namespace {
+
+std::string dump(const LocalityAnalysis& analysis) {
+    JsonWriter json;
+    analysis.dump(json);
+    return json.str();
+}
+
+// Every number following `"key": ` inside the array after `"section": [`
+std::vector<std::string> field(const std::string& json, const std::string& section, const std::string& key) {
+    std::vector<std::string> values;
+    size_t start = json.find("\"" + section + "\": [");
+    size_t end = json.find(']', start);
+    for (size_t at = json.find("\"" + key + "\": ", start); at < end; at = json.find("\"" + key + "\": ", at + 1)) {
+        size_t value = at + key.size() + 4;
+        values.push_back(json.substr(value, json.find_first_of(", }", value) - value));
+    }
+    return values;
+}
+
+std::vector<uint64_t> counts(const std::string& json) {
+    std::vector<uint64_t> values;
+    for (const std::string& value : field(json, "histogram", "count")) values.push_back(std::stoull(value));
+    return values;
+}
+
+// The reuse distance histogram of `lines` from an explicit LRU stack
+std::vector<uint64_t> bruteForce(const std::vector<uint32_t>& lines, uint64_t& cold) {
+    std::list<uint32_t> stack;
+    std::vector<uint64_t> histogram;
+    cold = 0;
+    for (uint32_t line : lines) {
+        auto it = std::find(stack.begin(), stack.end(), line);
+        if (it == stack.end()) {
+            cold++;
+        } else {
+            uint32_t distance = static_cast<uint32_t>(std::distance(stack.begin(), it));
+            size_t bucket = 0;
+            while (distance >> bucket) bucket++;
+            if (bucket >= histogram.size()) histogram.resize(bucket + 1, 0);
+            histogram[bucket]++;
+            stack.erase(it);
+        }
+        stack.push_front(line);
+    }
+    return histogram;
+}
+
+}  // namespace
+
+TEST(localityCyclicSweepReusesAtTheSweepLength) {
+    LocalityAnalysis analysis(LocalityConfig{});
+    // Four lines, three times over: every reuse has three other lines in between
+    for (int pass = 0; pass < 3; pass++) {
+        for (uint32_t line = 0; line < 4; line++) analysis.access(line * 64 + 8, false);
+    }
+    std::string json = dump(analysis);
+    CHECK(json.find("\"cold\": 4") != std::string::npos);
+    CHECK(counts(json) == std::vector<uint64_t>({0, 0, 8}));
+    // An LRU cache of two lines misses everything, one of four only the cold misses
+    std::vector<std::string> ratios = field(json, "missRatio", "ratio");
+    CHECK_EQUAL(ratios.size(), 3u);
+    CHECK_EQUAL(ratios[1], std::string("1"));
+    CHECK_EQUAL(ratios[2], std::string("0.333"));
+}
+
+TEST(localityRepeatedLineHasDistanceZero) {
+    LocalityConfig config;
+    config.apply("line=32");
+    LocalityAnalysis analysis(config);
+    for (uint32_t offset = 0; offset < 32; offset += 4) analysis.access(0x1000 + offset, false);
+    analysis.access(0x1020, false);
+    std::string json = dump(analysis);
+    CHECK(json.find("\"cold\": 2") != std::string::npos);
+    CHECK(counts(json) == std::vector<uint64_t>({7}));
+}
+
+TEST(localityMatchesAnLruStackAcrossRenumbering) {
+    LocalityAnalysis analysis(LocalityConfig{});
+    std::vector<uint32_t> lines;
+    uint32_t state = 12345;
+    for (int i = 0; i < 50000; i++) {
+        state = state * 1103515245 + 12345;
+        // Mostly a hot set of 64 lines, sometimes any of 3000
+        uint32_t line = (state >> 16) % 8 ? (state >> 8) % 64 : (state >> 4) % 3000;
+        lines.push_back(line);
+        analysis.access(line << 6, i % 3 == 0);
+    }
+    uint64_t cold;
+    std::vector<uint64_t> expected = bruteForce(lines, cold);
+    std::string json = dump(analysis);
+    CHECK(json.find("\"accesses\": 50000") != std::string::npos);
+    CHECK(json.find("\"cold\": " + std::to_string(cold) + ",") != std::string::npos);
+    CHECK(counts(json) == expected);
+}
+
+TEST(localityCountsPageHeatAndWorkingSets) {
+    LocalityConfig config;
+    config.apply("page=4096");
+    config.apply("window=4");
+    LocalityAnalysis analysis(config);
+    analysis.access(0x1000, false);
+    analysis.access(0x1040, true);
+    analysis.access(0x1000, false);
+    analysis.access(0x3000, true);
+    analysis.access(0x3000, false);
+    std::string json = dump(analysis);
+    CHECK(json.find("{ \"page\": \"0x00001000\", \"reads\": 2, \"writes\": 1 }") != std::string::npos);
+    CHECK(json.find("{ \"page\": \"0x00003000\", \"reads\": 1, \"writes\": 1 }") != std::string::npos);
+    // Three distinct lines in the first window, then a partial window of one
+    CHECK(json.find("\"max\": 3, \"average\": 2, \"lines\": [3, 1]") != std::string::npos);
+}
+
+TEST(localityInvalidOptionsAreRejected) {
+    LocalityConfig config;
+    CHECK_THROWS(config.apply("line=48"));
+    CHECK_THROWS(config.apply("window=0"));
+    CHECK(!config.apply("cycles=10"));
+}
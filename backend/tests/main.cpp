@@ -0,0 +1,30 @@
+#include "check.h"
+
+std::vector<TestCase>& testCases() {
+    static std::vector<TestCase> cases;
+    return cases;
+}
+
+int failedChecks = 0;
+
+// Runs every registered test, or only those whose name contains the first argument
+int main(int argc, char* argv[]) {
+    std::string filter = argc > 1 ? argv[1] : "";
+    size_t failedTests = 0, ran = 0;
+    for (const TestCase& test : testCases()) {
+        if (std::string(test.name).find(filter) == std::string::npos) continue;
+        ran++;
+        int before = failedChecks;
+        try {
+            test.run();
+        } catch (const std::exception& e) {
+            failedChecks++;
+            std::cerr << test.name << ": " << e.what() << "\n";
+        }
+        bool passed = failedChecks == before;
+        failedTests += !passed;
+        std::cout << (passed ? "ok     " : "FAILED ") << test.name << "\n";
+    }
+    std::cout << ran - failedTests << " of " << ran << " tests passed\n";
+    return failedTests == 0 ? 0 : 1;
+}
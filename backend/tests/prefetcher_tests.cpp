@@ -0,0 +1,111 @@
+#include "check.h"
+#include "cache.h"
+#include "prefetcher.h"
+#include "session.h"
+
+namespace {
+
+std::vector<uint32_t> addresses(std::initializer_list<uint32_t> values) {
+    return values;
+}
+
+// Dcache statistics of a pipelined walk over a 256 word array
+CacheStats walkArray(const std::string& prefetch) {
+    Session session(SessionOptions{});
+    JsonWriter json;
+    JsonRequest request;
+    std::string words;
+    for (int i = 0; i < 256; i++) words += (i ? ", " : "") + std::to_string(i);
+    session.assembleAndOutput(".data\narr: .word " + words + "\n.text\n"
+                              "    lui x16, 0x10000\n"
+                              "    addi x5, x0, 256\n"
+                              "loop:\n"
+                              "    lw x6, 0(x16)\n"
+                              "    add x10, x10, x6\n"
+                              "    addi x16, x16, 4\n"
+                              "    addi x5, x5, -1\n"
+                              "    bne x5, x0, loop\n", json);
+    for (const std::string& command : {std::string("pipeline"), std::string("cache dcache line=32 miss=20"), prefetch}) {
+        if (command.empty()) continue;
+        json.clear();
+        session.execute(command, request, json);
+    }
+    json.clear();
+    session.execute("run", request, json);
+    CHECK_EQUAL(session.cpu.registers[10], 255u * 256 / 2);
+    return session.cpu.dataCache->stats();
+}
+
+}  // namespace
+
+TEST(prefetchNextLineOnlyWhenTheFetchEntersALine) {
+    NextLinePrefetcher prefetcher(PrefetcherConfig::parse("degree=2"));
+    CHECK(prefetcher.observe(0, 32) == addresses({32, 64}));
+    CHECK(prefetcher.observe(4, 32).empty());
+    CHECK(prefetcher.observe(36, 32) == addresses({64, 96}));
+    prefetcher.clear();
+    CHECK(prefetcher.observe(36, 32) == addresses({64, 96}));
+}
+
+TEST(prefetchStrideNeedsConfidenceBeforeIssuing) {
+    StridePrefetcher prefetcher(PrefetcherConfig::parse("degree=2 distance=2"));
+    CHECK(prefetcher.observe(0x40, 0x1000).empty());  // new entry
+    CHECK(prefetcher.observe(0x40, 0x1008).empty());  // learns the stride
+    CHECK(prefetcher.observe(0x40, 0x1010).empty());  // confidence 1
+    CHECK(prefetcher.observe(0x40, 0x1018) == addresses({0x1028, 0x1030}));
+    // Negative strides work the same way
+    for (uint32_t address : {0x2000u, 0x1FF0u, 0x1FE0u}) prefetcher.observe(0x80, address);
+    CHECK(prefetcher.observe(0x80, 0x1FD0) == addresses({0x1FB0, 0x1FA0}));
+}
+
+TEST(prefetchStrideLosesConfidenceWhenThePatternBreaks) {
+    StridePrefetcher prefetcher(PrefetcherConfig::parse("entries=4"));
+    for (uint32_t address : {0x100u, 0x104u, 0x108u, 0x10Cu}) prefetcher.observe(0x10, address);
+    CHECK(prefetcher.observe(0x10, 0x110) == addresses({0x114}));
+    CHECK(prefetcher.observe(0x10, 0x500) == addresses({0x504}));  // down to 2, still trusted
+    CHECK(prefetcher.observe(0x10, 0x600).empty());
+    CHECK(prefetcher.observe(0x10, 0x700).empty());
+    CHECK(prefetcher.observe(0x10, 0x800).empty());  // learns the new stride
+    CHECK(prefetcher.observe(0x10, 0x900).empty());
+    CHECK(prefetcher.observe(0x10, 0xA00) == addresses({0xB00}));
+    // A PC sharing the table entry replaces it
+    prefetcher.observe(0x20, 0x900);
+    CHECK(prefetcher.observe(0x10, 0xB00).empty());
+}
+
+TEST(prefetchInvalidOptionsAreRejected) {
+    CHECK_THROWS(PrefetcherConfig::parse("entries=6"));
+    CHECK_THROWS(PrefetcherConfig::parse("degree=0"));
+    CHECK_THROWS(PrefetcherConfig::parse("depth=2"));
+}
+
+TEST(prefetchCountsUsefulLateAndUselessFills) {
+    Cache cache(CacheConfig::parse("size=4096 line=32 ways=2 miss=20"));
+    cache.prefetch(0x100, nullptr, 0);
+    cache.prefetch(0x104, nullptr, 0);  // already present, not issued again
+    CHECK_EQUAL(cache.stats().prefetches, 1u);
+    CHECK_EQUAL(cache.access(0x100, 4, false, nullptr, 30), 1u);
+    CHECK_EQUAL(cache.stats().prefetchUseful, 1u);
+    CHECK_EQUAL(cache.stats().misses, 0u);
+
+    cache.prefetch(0x200, nullptr, 100);
+    CHECK_EQUAL(cache.access(0x200, 4, false, nullptr, 105), 15u);  // waits for the rest of the fill
+    CHECK_EQUAL(cache.stats().prefetchLate, 1u);
+
+    // Two demand lines push an untouched prefetch out of its set
+    cache.prefetch(0x1000, nullptr, 200);
+    cache.access(0x1000 + 2048, 4, false, nullptr, 300);
+    cache.access(0x1000 + 4096, 4, false, nullptr, 300);
+    CHECK_EQUAL(cache.stats().prefetchUseless, 1u);
+    CHECK_EQUAL(cache.stats().prefetches, 3u);
+}
+
+TEST(prefetchStrideHidesArrayMisses) {
+    CacheStats without = walkArray("");
+    CacheStats with = walkArray("prefetch dcache distance=8");
+    CHECK_EQUAL(without.misses, 32u);
+    CHECK_EQUAL(without.prefetches, 0u);
+    CHECK(with.prefetches > 0);
+    CHECK(with.misses < without.misses);
+    CHECK_EQUAL(with.prefetchUseful + with.prefetchLate + with.misses, without.misses);
+}
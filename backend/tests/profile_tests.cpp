@@ -0,0 +1,85 @@
+#include "check.h"
+#include "session.h"
+
+namespace {
+
+std::string execute(Session& session, const std::string& command) {
+    JsonWriter json;
+    JsonRequest request;
+    session.execute(command, request, json);
+    return json.str();
+}
+
+// Assembles `source` and runs it pipelined with forwarding, and with prediction when asked
+std::string profile(const std::string& source, bool prediction, const std::string& command) {
+    Session session(SessionOptions{});
+    JsonWriter json;
+    session.assembleAndOutput(source, json);
+    execute(session, "pipeline");
+    execute(session, "data_forward");
+    if (prediction) execute(session, "branch_prediction");
+    execute(session, "run cycles=1000");
+    return execute(session, command);
+}
+
+// The hot spot object of `json` at `pc`, empty when it is not listed
+std::string hotspot(const std::string& json, const std::string& pc) {
+    size_t at = json.find("{ \"pc\": \"" + pc + "\"");
+    return at == std::string::npos ? "" : json.substr(at, json.find('}', at) - at + 1);
+}
+
+// Four nops between the last instruction and `exit`, so that it retires before the pipeline stops
+const std::string DRAIN = "    addi x0, x0, 0\n    addi x0, x0, 0\n    addi x0, x0, 0\n    addi x0, x0, 0\n    exit\n";
+
+}  // namespace
+
+TEST(profileChargesALoadUseBubbleToBothInstructions) {
+    // With forwarding the add waits one cycle for the loaded value
+    std::string json = profile(".data\nv: .word 7\n.text\nmain:\n    lw x5, 0(x3)\n    add x6, x5, x5\n" + DRAIN, false,
+                               "profile");
+    CHECK(json.find("\"cycles\": 11, \"instructions\": 6,") != std::string::npos);  // 6 + 4 + 1
+    std::string load = hotspot(json, "0x00000000");
+    std::string use = hotspot(json, "0x00000004");
+    CHECK(load.find("\"line\": 5, \"source\": \"lw x5, 0(x3)\", \"label\": \"main\", \"cycles\": 1,") != std::string::npos);
+    CHECK(load.find("\"dataBubblesSuffered\": 0, \"dataBubblesCaused\": 1,") != std::string::npos);
+    CHECK(load.find("\"forwardsOut\": 1 }") != std::string::npos);
+    CHECK(use.find("\"label\": \"main+4\", \"cycles\": 2, \"executions\": 1, \"dataBubblesSuffered\": 1, "
+                   "\"dataBubblesCaused\": 0,") != std::string::npos);
+    CHECK(use.find("\"forwardsIn\": 1,") != std::string::npos);
+}
+
+TEST(profileChargesAMispredictionToTheBranch) {
+    // Predicted not taken, the taken beq costs one bubble and skips the addi to x6
+    std::string json = profile(".text\n    addi x5, x0, 1\n    beq x0, x0, skip\n    addi x6, x0, 9\nskip:\n"
+                               "    addi x7, x0, 2\n" + DRAIN, true, "profile");
+    CHECK(json.find("\"cycles\": 12, \"instructions\": 7,") != std::string::npos);  // 7 + 4 + 1
+    std::string branch = hotspot(json, "0x00000004");
+    CHECK(branch.find("\"source\": \"beq x0, x0, skip\", \"cycles\": 2, \"executions\": 1,") != std::string::npos);
+    CHECK(branch.find("\"controlBubbles\": 1, \"mispredictions\": 1,") != std::string::npos);
+    CHECK(hotspot(json, "0x00000008").empty());  // never fetched into execution
+    CHECK(hotspot(json, "0x0000000c").find("\"label\": \"skip\",") != std::string::npos);
+}
+
+TEST(profileListsTheTopHotSpotsByCycles) {
+    // Without prediction each taken bne loses one fetch slot: 3 runs + 2 bubbles, 3 runs of the addi, then the first addi
+    const std::string loop = ".text\n    addi x5, x0, 3\nloop:\n    addi x5, x5, -1\n    bne x5, x0, loop\n" + DRAIN;
+    std::string json = profile(loop, false, "profile 2");
+    CHECK(json.find("\"cycles\": 17, \"instructions\": 11,") != std::string::npos);  // 11 + 4 + 2
+    size_t first = json.find("\"pc\": \"0x00000008\"");
+    size_t second = json.find("\"pc\": \"0x00000004\"");
+    CHECK(first != std::string::npos && second != std::string::npos && first < second);
+    CHECK(json.find("\"pc\": \"0x00000000\"") == std::string::npos);
+    CHECK(hotspot(json, "0x00000008").find("\"label\": \"loop+4\", \"cycles\": 5, \"executions\": 3,") !=
+          std::string::npos);
+    CHECK(hotspot(json, "0x00000008").find("\"controlBubbles\": 2, \"mispredictions\": 0,") != std::string::npos);
+    CHECK(hotspot(json, "0x00000004").find("\"line\": 4, \"source\": \"addi x5, x5, -1\", \"label\": \"loop\", "
+                                            "\"cycles\": 3,") != std::string::npos);
+
+    // The nops ran once each and tie at one cycle, ties come out in PC order
+    json = profile(loop, false, "profile 10");
+    size_t hotspots = 0;
+    for (size_t at = json.find("\"pc\""); at != std::string::npos; at = json.find("\"pc\"", at + 1)) hotspots++;
+    CHECK_EQUAL(hotspots, 7u);
+    CHECK(json.find("\"pc\": \"0x00000000\"") < json.find("\"pc\": \"0x0000000c\""));
+    CHECK_THROWS(profile(loop, false, "profile many"));
+}
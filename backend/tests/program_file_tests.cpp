@@ -0,0 +1,284 @@
+#include "check.h"
+#include "assembler.h"
+#include "cpu.h"
+#include "session.h"
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <sstream>
+#include <unistd.h>
+
+namespace {
+
+struct Program {
+    Memory memory;
+    Assembler assembler{memory};
+};
+
+const std::string PROGRAM =
+    ".data\n"
+    "arr: .word 5, 3, 9, 1\n"
+    "\n"
+    "msg: .asciz \"hi\"\n"
+    ".text\n"
+    "main:\n"
+    "    lui x16, 0x10000\n"
+    "    lw x10, 0(x16)\n"
+    "    beq x10, x0, main\n"
+    "    exit\n";
+
+// A scratch file removed when the test is done
+struct TempFile {
+    std::string path;
+    explicit TempFile(const std::string& extension) {
+        char pattern[] = "/tmp/program_file_XXXXXX";
+        int fd = mkstemp(pattern);
+        close(fd);
+        std::remove(pattern);
+        path = std::string(pattern) + extension;
+    }
+    ~TempFile() { std::remove(path.c_str()); }
+};
+
+std::vector<uint8_t> readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<uint8_t>(std::istreambuf_iterator<char>(in), {});
+}
+
+void writeFile(const std::string& path, const std::vector<uint8_t>& bytes) {
+    std::ofstream out(path, std::ios::binary | std::ios::trunc);
+    out.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+}
+
+uint32_t u32(const std::vector<uint8_t>& bytes, size_t at) {
+    return bytes[at] | (bytes[at + 1] << 8) | (bytes[at + 2] << 16) | (static_cast<uint32_t>(bytes[at + 3]) << 24);
+}
+
+void patch32(std::vector<uint8_t>& bytes, size_t at, uint32_t value) {
+    for (int i = 0; i < 4; i++) bytes[at + i] = (value >> (i * 8)) & 0xFF;
+}
+
+// The bytes of the data segment, an ELF maps its text as data as well
+std::vector<std::pair<uint32_t, uint8_t>> dataBytes(const Memory& memory) {
+    std::vector<std::pair<uint32_t, uint8_t>> bytes;
+    memory.getDataMemory().forEachWritten([&](uint32_t address, uint8_t value) {
+        if (address >= memory.DATA_START) bytes.push_back({address, value});
+    });
+    return bytes;
+}
+
+// Saves PROGRAM as `extension` and loads it into a fresh assembler
+void checkRoundTrip(const std::string& extension) {
+    TempFile file(extension);
+    Program saved, loaded;
+    saved.assembler.assemble(PROGRAM);
+    saved.assembler.save(file.path);
+    loaded.assembler.load(file.path);
+
+    CHECK(loaded.memory.instructionMemory == saved.memory.instructionMemory);
+    CHECK(dataBytes(loaded.memory) == dataBytes(saved.memory));
+    CHECK_EQUAL(loaded.memory.exitAddress, saved.memory.exitAddress);
+    CHECK_EQUAL(loaded.assembler.getSymbols().getAddress("msg"), saved.assembler.getSymbols().getAddress("msg"));
+    CHECK_EQUAL(loaded.assembler.getEntryPoint(), uint32_t(0));
+}
+
+// An ET_EXEC laid out like a toolchain build: code at 0x10074, data at 0x11000 with 8 bytes of .bss
+std::vector<uint8_t> toolchainElf(const std::vector<uint32_t>& code, uint32_t value) {
+    std::vector<uint8_t> elf(0x100, 0);
+    const uint8_t ident[] = {0x7F, 'E', 'L', 'F', 1, 1, 1};
+    std::copy(std::begin(ident), std::end(ident), elf.begin());
+    auto put16 = [&](size_t at, uint16_t v) { elf[at] = v & 0xFF; elf[at + 1] = v >> 8; };
+    put16(16, 2);    // ET_EXEC
+    put16(18, 243);  // EM_RISCV
+    patch32(elf, 20, 1);
+    patch32(elf, 24, 0x10074);  // entry
+    patch32(elf, 28, 52);       // program headers right after the ELF header
+    put16(40, 52);
+    put16(42, 32);
+    put16(44, 2);
+
+    uint32_t codeSize = static_cast<uint32_t>(code.size() * 4);
+    const uint32_t headers[2][8] = {
+        {1, 0x80, 0x10074, 0x10074, codeSize, codeSize, 5 /* R+X */, 4},
+        {1, 0xC0, 0x11000, 0x11000, 4, 12, 6 /* R+W */, 4},
+    };
+    for (int h = 0; h < 2; h++) {
+        for (int f = 0; f < 8; f++) patch32(elf, 52 + h * 32 + f * 4, headers[h][f]);
+    }
+    for (size_t i = 0; i < code.size(); i++) patch32(elf, 0x80 + i * 4, code[i]);
+    patch32(elf, 0xC0, value);
+    return elf;
+}
+
+}  // namespace
+
+TEST(nativeImageRoundTrip) {
+    checkRoundTrip(".rvi");
+
+    TempFile file(".rvi");
+    Program saved, loaded;
+    saved.assembler.assemble(PROGRAM);
+    saved.assembler.save(file.path);
+    loaded.assembler.load(file.path);
+    size_t line;
+    CHECK(loaded.assembler.findSourceLine(8, line));
+    CHECK_EQUAL(line, size_t(8));
+    CHECK_EQUAL(loaded.assembler.getSourceLine(line), std::string("beq x10, x0, main"));
+    // The source is gone, a loaded image cannot be edited
+    CHECK_THROWS(loaded.assembler.edit(0, 1, ""));
+}
+
+TEST(saveReportsAnEscapedPath) {
+    TempFile file(" \"quoted\" back\\slash.rvi");
+    Session session(SessionOptions{});
+    JsonWriter json;
+    session.assembleAndOutput(PROGRAM, json);
+    JsonWriter saved;
+    session.execute("save " + file.path, JsonRequest{}, saved);
+
+    std::istringstream in(saved.str() + "\n");
+    JsonRequest response;
+    response.read(in);
+    CHECK_EQUAL(response.getString("saved"), file.path);
+    CHECK_EQUAL(response.getString("format"), std::string("native"));
+}
+
+TEST(elfRoundTrip) {
+    checkRoundTrip(".elf");
+}
+
+TEST(nativeImageRejectsAnOutOfRangeLineNumber) {
+    TempFile file(".rvi");
+    Program program;
+    program.assembler.assemble(PROGRAM);
+    program.assembler.save(file.path);
+    std::vector<uint8_t> bytes = readFile(file.path);
+
+    // The line number of the first line map entry
+    patch32(bytes, u32(bytes, 44) + 8, 0xFFFFFFF0);
+    writeFile(file.path, bytes);
+    CHECK_THROWS(program.assembler.load(file.path));
+
+    // More source lines than a program can have
+    bytes = readFile(file.path);
+    patch32(bytes, u32(bytes, 44) + 8, 0);
+    patch32(bytes, 60, 0xFFFFFFFF);
+    writeFile(file.path, bytes);
+    CHECK_THROWS(program.assembler.load(file.path));
+}
+
+TEST(nativeImageRejectsDataOutsideTheDataSegment) {
+    TempFile file(".rvi");
+    Program program;
+    program.assembler.assemble(PROGRAM);
+    program.assembler.save(file.path);
+    std::vector<uint8_t> bytes = readFile(file.path);
+
+    // The address of the first data run
+    patch32(bytes, u32(bytes, 28), 0x7FFFF000);
+    writeFile(file.path, bytes);
+    CHECK_THROWS(program.assembler.load(file.path));
+
+    patch32(bytes, u32(bytes, 28), 0x1FFFFFFE);
+    writeFile(file.path, bytes);
+    CHECK_THROWS(program.assembler.load(file.path));
+}
+
+TEST(truncatedImagesAreRejected) {
+    TempFile file(".rvi");
+    Program program;
+    program.assembler.assemble(PROGRAM);
+    program.assembler.save(file.path);
+    std::vector<uint8_t> bytes = readFile(file.path);
+    bytes.resize(bytes.size() / 2);
+    writeFile(file.path, bytes);
+    CHECK_THROWS(program.assembler.load(file.path));
+}
+
+TEST(elfDataIsMappedWhereItWasLinked) {
+    // The words come from the assembler, none of them is PC-relative
+    Program code;
+    code.assembler.assemble(".text\n    lui x5, 0x11\n    lw x6, 0(x5)\n    addi x6, x6, 1\n"
+                            "    sw x6, 4(x5)\n    sw x6, 8(x5)\n    exit\n");
+    std::vector<uint32_t> words;
+    for (const auto& [address, word] : code.memory.instructionMemory) words.push_back(word);
+
+    TempFile file(".elf");
+    writeFile(file.path, toolchainElf(words, 41));
+    Program program;
+    program.assembler.load(file.path);
+    CHECK_EQUAL(program.assembler.getEntryPoint(), uint32_t(0x10074));
+    CHECK(program.assembler.getUnsupported().empty());
+    CHECK(program.memory.isDataAddress(0x11008));  // .bss
+    CHECK(!program.memory.isDataAddress(0x1100C));
+
+    Cpu cpu(program.memory);
+    cpu.PC = program.assembler.getEntryPoint();
+    CHECK(cpu.runUntil(1000, 1000));
+    CHECK_EQUAL(cpu.registers[6], uint32_t(42));
+    CHECK_EQUAL(program.memory.fetchData(0x11004), uint8_t(42));
+    CHECK_EQUAL(program.memory.fetchData(0x11008), uint8_t(42));
+
+    // A program assembled next has no such mapping
+    program.assembler.assemble(PROGRAM);
+    CHECK(!program.memory.isDataAddress(0x11000));
+}
+
+TEST(elfUnsupportedInstructionsAreReportedOnLoad) {
+    // addi, ecall, fence and the exit marker
+    TempFile file(".elf");
+    writeFile(file.path, toolchainElf({0x00100293, 0x00000073, 0x0FF0000F, 0x77777777}, 0));
+    Program program;
+    program.assembler.load(file.path);
+    CHECK(program.assembler.getUnsupported() == std::vector<uint32_t>({0x10078, 0x1007C}));
+}
+
+TEST(elfCodeReadsConstantsFromItsOwnSegment) {
+    // auipc x10, 0; lw x11, 16(x10); exit; nop; then the constant, as ld places .rodata after .text
+    const std::vector<uint32_t> words = {0x00000517, 0x01052583, 0x77777777, 0x00000013, 0x12345678};
+    TempFile file(".elf");
+    std::vector<uint8_t> elf = toolchainElf(words, 0);
+    writeFile(file.path, elf);
+    Program program;
+    program.assembler.load(file.path);
+    CHECK(program.memory.isDataAddress(0x10084));
+    // Without section headers the whole segment is taken for code
+    CHECK(program.assembler.getUnsupported() == std::vector<uint32_t>({0x10084}));
+
+    Cpu cpu(program.memory);
+    cpu.PC = program.assembler.getEntryPoint();
+    CHECK(cpu.runUntil(1000, 1000));
+    CHECK_EQUAL(cpu.registers[11], uint32_t(0x12345678));
+
+    // With them only .text is code, .rodata is data alone
+    elf.resize(0x100 + 3 * 40, 0);
+    patch32(elf, 32, 0x100);  // e_shoff
+    elf[46] = 40;             // e_shentsize
+    elf[48] = 3;              // e_shnum: null, .text, .rodata
+    const uint32_t sections[2][5] = {
+        {0, 1 /* SHT_PROGBITS */, 6 /* SHF_ALLOC | SHF_EXECINSTR */, 0x10074, 0x80},
+        {0, 1, 2 /* SHF_ALLOC */, 0x10084, 0x90},
+    };
+    for (int i = 0; i < 2; i++) {
+        for (int f = 0; f < 5; f++) patch32(elf, 0x100 + (i + 1) * 40 + f * 4, sections[i][f]);
+        patch32(elf, 0x100 + (i + 1) * 40 + 20, i == 0 ? 16 : 4);  // sh_size
+    }
+    writeFile(file.path, elf);
+    Program split;
+    split.assembler.load(file.path);
+    CHECK(split.assembler.getUnsupported().empty());
+    CHECK(split.memory.instructionMemory.count(0x10084) == 0);
+    Cpu sectioned(split.memory);
+    sectioned.PC = split.assembler.getEntryPoint();
+    CHECK(sectioned.runUntil(1000, 1000));
+    CHECK_EQUAL(sectioned.registers[11], uint32_t(0x12345678));
+}
+
+TEST(elfDataOverlappingTheStackIsRejected) {
+    TempFile file(".elf");
+    std::vector<uint8_t> elf = toolchainElf({0x77777777}, 0);
+    patch32(elf, 52 + 32 + 8, 0x7FFFFFD8);  // vaddr of the data segment
+    writeFile(file.path, elf);
+    Program program;
+    CHECK_THROWS(program.assembler.load(file.path));
+}
@@ -0,0 +1,111 @@
+#include "check.h"
+#include "session.h"
+
+namespace {
+
+// Sums and doubles a small array in place, with loads right before their uses and a backward branch
+const std::string PROGRAM =
+    ".data\n"
+    "arr: .word 1, 2, 3, 4, 5, 6, 7, 8\n"
+    ".text\n"
+    "    lui x16, 0x10000\n"
+    "    addi x5, x0, 8\n"
+    "loop:\n"
+    "    lw x6, 0(x16)\n"
+    "    add x10, x10, x6\n"
+    "    add x6, x6, x6\n"
+    "    sw x6, 0(x16)\n"
+    "    addi x16, x16, 4\n"
+    "    addi x5, x5, -1\n"
+    "    bne x5, x0, loop\n"
+    "    exit\n";
+
+std::string execute(Session& session, const std::string& command) {
+    JsonWriter json;
+    JsonRequest request;
+    session.execute(command, request, json);
+    return json.str();
+}
+
+// The number after `"key": ` in the object of `json` whose config is `config`
+uint64_t rowValue(const std::string& json, const std::string& config, const std::string& key) {
+    size_t row = json.find("\"config\": \"" + config + "\"");
+    size_t at = json.find("\"" + key + "\": ", row);
+    if (row == std::string::npos || at > json.find('}', row)) return UINT64_MAX;
+    return std::stoull(json.substr(at + key.size() + 4));
+}
+
+}  // namespace
+
+TEST(sweepRunsEveryConfigurationAndMatchesADirectRun) {
+    Session session(SessionOptions{});
+    JsonWriter json;
+    session.assembleAndOutput(PROGRAM, json);
+    std::string sweep = execute(session, "sweep");
+
+    size_t rows = 0;
+    for (size_t at = sweep.find("\"config\""); at != std::string::npos; at = sweep.find("\"config\"", at + 1)) rows++;
+    CHECK_EQUAL(rows, 5u);
+    CHECK(sweep.find("\"status\": \"error\"") == std::string::npos);
+
+    Session direct(SessionOptions{});
+    direct.assembleAndOutput(PROGRAM, json);
+    execute(direct, "pipeline");
+    execute(direct, "data_forward");
+    execute(direct, "run");
+    CHECK_EQUAL(rowValue(sweep, "pipeline+forward", "clock"), direct.cpu.clock);
+    CHECK_EQUAL(rowValue(sweep, "pipeline+forward", "instructions"), uint64_t(direct.cpu.totalInstructions));
+    CHECK_EQUAL(rowValue(sweep, "pipeline+forward", "totalBubbles"), uint64_t(direct.cpu.totalBubbles));
+    CHECK_EQUAL(rowValue(sweep, "pipeline+forward", "totalDataHazards"), uint64_t(direct.cpu.totalDataHazards));
+    CHECK_EQUAL(rowValue(sweep, "pipeline+forward", "totalControlHazards"), uint64_t(direct.cpu.totalControlHazards));
+}
+
+TEST(sweepTraceAndLocalityLeaveTheSessionWhereItWas) {
+    Session session(SessionOptions{});
+    JsonWriter json;
+    session.assembleAndOutput(PROGRAM, json);
+    // Past the first store, five steps to an instruction without pipelining
+    for (int i = 0; i < 40; i++) execute(session, "step");
+    uint64_t clock = session.cpu.clock;
+    uint32_t pc = session.cpu.PC;
+    uint32_t sum = session.cpu.registers[10];
+    uint8_t doubled = session.memory.fetchData(0x10000000);
+    CHECK(clock > 0);
+    CHECK_EQUAL(int(doubled), 2);
+
+    // The copies run the whole program from its entry
+    std::string sweep = execute(session, "sweep");
+    CHECK_EQUAL(rowValue(sweep, "single_cycle", "instructions"), 58u);
+    CHECK(execute(session, "trace").find("\"status\": \"exited\", \"instructions\": 58,") != std::string::npos);
+    CHECK(execute(session, "locality").find("\"status\": \"exited\", \"instructions\": 58,") != std::string::npos);
+    CHECK_EQUAL(session.cpu.clock, clock);
+    CHECK_EQUAL(session.cpu.PC, pc);
+    CHECK_EQUAL(session.cpu.registers[10], sum);
+    CHECK_EQUAL(int(session.memory.fetchData(0x10000000)), 2);
+
+    execute(session, "step");
+    CHECK_EQUAL(session.cpu.clock, clock + 1);
+    execute(session, "run");
+    CHECK_EQUAL(session.cpu.registers[10], 36u);
+}
+
+TEST(sweepTraceAndLocalityOfAnEndlessLoopStopAtTheAnalysisBudget) {
+    CHECK_EQUAL(SessionOptions{}.analysisCycles, SessionOptions::DEFAULT_ANALYSIS_CYCLES);
+    SessionOptions options;
+    options.analysisCycles = 20000;
+    Session session(options);
+    JsonWriter json;
+    session.assembleAndOutput(".text\nloop:\n    addi x5, x5, 1\n    beq x0, x0, loop\n", json);
+
+    std::string sweep = execute(session, "sweep");
+    for (const char* config : {"single_cycle", "pipeline", "pipeline+forward", "pipeline+prediction",
+                               "pipeline+forward+prediction"}) {
+        CHECK_EQUAL(rowValue(sweep, config, "clock"), 20000u);
+    }
+    // Five cycles to an instruction without pipelining
+    CHECK(execute(session, "trace").find("\"status\": \"cycles\", \"instructions\": 4000,") != std::string::npos);
+    CHECK(execute(session, "locality").find("\"status\": \"cycles\", \"instructions\": 4000,") != std::string::npos);
+    // A limit of their own replaces the default
+    CHECK(execute(session, "trace instructions=10").find("\"status\": \"instructions\", \"instructions\": 10,") !=
+          std::string::npos);
+}
@@ -0,0 +1,134 @@
+#include "check.h"
+#include "session.h"
+#include "timing_model.h"
+
+namespace {
+
+constexpr uint8_t NONE = 32;  // no such register
+
+TraceRecord alu(uint32_t pc, uint8_t rd, uint8_t rs1, uint8_t rs2 = NONE) {
+    return {pc, 0, TraceKind::ALU, rd, rs1, rs2, false};
+}
+
+TraceRecord load(uint32_t pc, uint8_t rd, uint8_t rs1) {
+    return {pc, 0x10000000, TraceKind::LOAD, rd, rs1, NONE, false};
+}
+
+TraceRecord store(uint32_t pc, uint8_t rs1, uint8_t rs2) {
+    return {pc, 0x10000000, TraceKind::STORE, NONE, rs1, rs2, false};
+}
+
+TraceRecord branch(uint32_t pc, bool taken) {
+    return {pc, taken ? 0x100u : pc + 4, TraceKind::BRANCH, NONE, 0, 0, taken};
+}
+
+TimingModel::Result replay(const Trace& trace, bool dataForward,
+                           TimingModel::Predictor predictor = TimingModel::Predictor::NONE) {
+    TimingModel::Config config;
+    config.dataForward = dataForward;
+    config.predictor = predictor;
+    return TimingModel::replay(trace, config);
+}
+
+std::string execute(Session& session, const std::string& command) {
+    JsonWriter json;
+    JsonRequest request;
+    session.execute(command, request, json);
+    return json.str();
+}
+
+// The number after `"key": ` in the replay row of `config`
+uint64_t rowValue(const std::string& json, const std::string& config, const std::string& key) {
+    size_t row = json.find("\"config\": \"" + config + "\"");
+    size_t at = json.find("\"" + key + "\": ", row);
+    if (row == std::string::npos || at > json.find('}', row)) return UINT64_MAX;
+    return std::stoull(json.substr(at + key.size() + 4));
+}
+
+// Replays the trace of `source` under `config` and runs it on the pipeline with the same modes
+void checkAgainstPipeline(const std::string& source, const std::string& config, bool prediction) {
+    Session session(SessionOptions{});
+    JsonWriter json;
+    session.assembleAndOutput(source, json);
+    execute(session, "trace");
+    std::string replayed = execute(session, "replay");
+
+    execute(session, "pipeline");
+    execute(session, "data_forward");
+    if (prediction) execute(session, "branch_prediction");
+    CHECK(execute(session, "run cycles=1000").find("\"stopped\"") == std::string::npos);
+    const Cpu& cpu = session.cpu;
+    CHECK_EQUAL(rowValue(replayed, config, "clock"), cpu.clock);
+    CHECK_EQUAL(rowValue(replayed, config, "instructions"), uint64_t(cpu.totalInstructions));
+    CHECK_EQUAL(rowValue(replayed, config, "totalBubbles"), uint64_t(cpu.totalBubbles));
+    CHECK_EQUAL(rowValue(replayed, config, "totalDataHazardBubbles"), uint64_t(cpu.totalDataHazardBubbles));
+    CHECK_EQUAL(rowValue(replayed, config, "totalControlHazardBubbles"), uint64_t(cpu.totalControlHazardBubbles));
+    CHECK_EQUAL(rowValue(replayed, config, "totalBranchMissPredictions"), uint64_t(cpu.totalBranchMissPredictions));
+}
+
+// Four nops between the last instruction and `exit`, so that it retires before the pipeline stops
+const std::string DRAIN = "    addi x0, x0, 0\n    addi x0, x0, 0\n    addi x0, x0, 0\n    addi x0, x0, 0\n    exit\n";
+
+}  // namespace
+
+TEST(replayWithoutForwardingWaitsForWriteback) {
+    // Distance 1 costs 2 bubbles, distance 2 costs 1, distance 3 is free
+    Trace trace = {load(0, 5, 3), alu(4, 6, 5), alu(8, 7, 0), alu(12, 8, 6), alu(16, 0, 0), alu(20, 0, 0), alu(24, 9, 8)};
+    TimingModel::Result result = replay(trace, false);
+    CHECK_EQUAL(result.instructions, 7u);
+    CHECK_EQUAL(result.dataHazards, 2u);
+    CHECK_EQUAL(result.dataHazardBubbles, 3u);
+    CHECK_EQUAL(result.forwards, 0u);
+    CHECK_EQUAL(result.bubbles, 3u);
+    CHECK_EQUAL(result.cycles, 7u + 4 + 3);
+}
+
+TEST(replayWithForwardingOnlyStallsOnALoadUse) {
+    // The lw to addi costs one bubble, the addi to add and the lw to the sw data are forwarded for free
+    Trace trace = {load(0, 5, 3), alu(4, 6, 5), alu(8, 7, 6, 0), load(12, 8, 3), store(16, 3, 8)};
+    TimingModel::Result result = replay(trace, true);
+    CHECK_EQUAL(result.dataHazards, 3u);
+    CHECK_EQUAL(result.forwards, 3u);
+    CHECK_EQUAL(result.dataHazardBubbles, 1u);
+    CHECK_EQUAL(result.cycles, 5u + 4 + 1);
+
+    // The store address is not forwarded M to M, a load feeding it stalls
+    result = replay({load(0, 5, 3), store(4, 5, 0)}, true);
+    CHECK_EQUAL(result.dataHazardBubbles, 1u);
+    CHECK_EQUAL(replay({}, true).cycles, 0u);
+}
+
+TEST(replayPredictorsDisagreeOnAlternatingBranches) {
+    // A is always taken and B never: one global bit is always wrong, per-PC counters only miss A once
+    Trace trace = {branch(0x40, true), branch(0x80, false), branch(0x40, true), branch(0x80, false)};
+
+    TimingModel::Result none = replay(trace, true);
+    CHECK_EQUAL(none.controlHazards, 2u);  // the taken ones
+    CHECK_EQUAL(none.branchMispredictions, 0u);
+    CHECK_EQUAL(none.cycles, 4u + 4 + 2);
+
+    TimingModel::Result oneBit = replay(trace, true, TimingModel::Predictor::ONE_BIT);
+    CHECK_EQUAL(oneBit.branchMispredictions, 4u);
+    CHECK_EQUAL(oneBit.controlHazardBubbles, 4u);
+    CHECK_EQUAL(oneBit.cycles, 4u + 4 + 4);
+
+    TimingModel::Result bimodal = replay(trace, true, TimingModel::Predictor::BIMODAL);
+    CHECK_EQUAL(bimodal.branchMispredictions, 1u);
+    CHECK_EQUAL(bimodal.controlHazardBubbles, 1u);
+    CHECK_EQUAL(bimodal.cycles, 4u + 4 + 1);
+
+    // Taken twice, then not: both predictors learn after the first and miss the exit
+    Trace loop = {branch(0x40, true), branch(0x40, true), branch(0x40, false)};
+    CHECK_EQUAL(replay(loop, false, TimingModel::Predictor::ONE_BIT).branchMispredictions, 2u);
+    CHECK_EQUAL(replay(loop, false, TimingModel::Predictor::BIMODAL).branchMispredictions, 2u);
+}
+
+TEST(replayMatchesThePipelineItModels) {
+    // Cpu::step completes these with forwarding; without it, and with prediction on loops, it stops early
+    checkAgainstPipeline(".data\nv: .word 7\n.text\n    lw x5, 0(x3)\n    add x6, x5, x5\n" + DRAIN,
+                         "pipeline+forward", false);
+    checkAgainstPipeline(".text\n    addi x5, x0, 3\nloop:\n    addi x5, x5, -1\n    bne x5, x0, loop\n" + DRAIN,
+                         "pipeline+forward", false);
+    checkAgainstPipeline(".text\n    addi x5, x0, 1\n    beq x0, x0, skip\n    addi x6, x0, 9\nskip:\n"
+                         "    addi x7, x0, 2\n" + DRAIN, "pipeline+forward+one_bit", true);
+}
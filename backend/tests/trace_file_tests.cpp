@@ -0,0 +1,127 @@
+#include "check.h"
+#include "session.h"
+#include "trace_file.h"
+#include <cstdio>
+#include <unistd.h>
+
+namespace {
+
+std::string tracePath(const std::string& name) {
+    return "/tmp/trace_file_test_" + std::to_string(getpid()) + "_" + name + ".rvt";
+}
+
+// Every record of the file, chunk after chunk
+std::vector<TraceEvent> readAll(TraceReader& reader) {
+    std::vector<TraceEvent> all, chunk;
+    for (size_t i = 0; i < reader.chunks().size(); i++) {
+        reader.readChunk(i, chunk);
+        all.insert(all.end(), chunk.begin(), chunk.end());
+    }
+    return all;
+}
+
+}  // namespace
+
+TEST(traceFileRoundTripsEveryRecordAcrossChunks) {
+    std::string path = tracePath("synthetic");
+    const size_t count = 40000;  // several chunks of CHUNK_BYTES
+    {
+        TraceWriter writer(path, true);
+        uint32_t pc = 0;
+        for (uint32_t i = 0; i < count; i++) {
+            // Sequential PCs, backward and forward jumps, word, half and byte accesses
+            pc = i % 7 == 0 ? pc - 24 : i % 11 == 0 ? pc + 0x1000 : pc + 4;
+            if (i % 3 == 0) writer.access(TraceEvent::LOAD, i / 3 % 3, 0x10000000 + i * 4, i * 7);
+            if (i % 5 == 0) writer.access(TraceEvent::STORE, 0, 0x7FFFFFF0 - i, i & 0xFF);
+            writer.retire(pc, i % 4 == 0 ? 32 : i % 31 + 1, i * 0x9E3779B9u);
+            writer.cycle(static_cast<uint8_t>(i & 0x1F));
+        }
+        writer.finish();
+        CHECK_EQUAL(writer.instructions(), static_cast<uint64_t>(count));
+        CHECK_EQUAL(writer.cycles(), static_cast<uint64_t>(count));
+        CHECK(writer.chunks() > 1);
+    }
+
+    TraceReader reader(path);
+    CHECK(reader.occupancy());
+    CHECK(reader.chunks().size() > 1);
+    CHECK_EQUAL(reader.chunks().front().firstInstruction, 0u);
+    std::vector<TraceEvent> events = readAll(reader);
+    CHECK_EQUAL(events.size(), 2 * count);
+
+    uint32_t pc = 0;
+    size_t at = 0;
+    for (uint32_t i = 0; i < count && at + 1 < events.size(); i++) {
+        pc = i % 7 == 0 ? pc - 24 : i % 11 == 0 ? pc + 0x1000 : pc + 4;
+        const TraceEvent& retired = events[at++];
+        CHECK(!retired.cycle);
+        CHECK_EQUAL(retired.pc, pc);
+        CHECK_EQUAL(retired.registerWrite, i % 4 != 0);
+        if (i % 4 != 0) {
+            CHECK_EQUAL(static_cast<uint32_t>(retired.rd), i % 31 + 1);
+            CHECK_EQUAL(retired.value, i * 0x9E3779B9u);
+        }
+        // An instruction holds its last access, so a store replaces the load before it
+        if (i % 5 == 0) {
+            CHECK_EQUAL(static_cast<int>(retired.access), static_cast<int>(TraceEvent::STORE));
+            CHECK_EQUAL(static_cast<uint32_t>(retired.size), 1u);
+            CHECK_EQUAL(retired.address, 0x7FFFFFF0 - i);
+            CHECK_EQUAL(retired.data, i & 0xFF);
+        } else if (i % 3 == 0) {
+            CHECK_EQUAL(static_cast<int>(retired.access), static_cast<int>(TraceEvent::LOAD));
+            CHECK_EQUAL(static_cast<uint32_t>(retired.size), 1u << (i / 3 % 3));
+            CHECK_EQUAL(retired.address, 0x10000000 + i * 4);
+            // Loads narrower than a word keep only the bytes they read
+            uint32_t size = 1u << (i / 3 % 3);
+            CHECK_EQUAL(retired.data, size == 4 ? i * 7 : (i * 7) & ((1u << (8 * size)) - 1));
+        } else {
+            CHECK_EQUAL(static_cast<int>(retired.access), static_cast<int>(TraceEvent::NONE));
+        }
+        const TraceEvent& cycle = events[at++];
+        CHECK(cycle.cycle);
+        CHECK_EQUAL(static_cast<uint32_t>(cycle.stages), i & 0x1F);
+    }
+    std::remove(path.c_str());
+}
+
+TEST(traceFileRecordsARunOfTheSession) {
+    std::string path = tracePath("session");
+    Session session(SessionOptions{});
+    JsonWriter json;
+    JsonRequest request;
+    session.assembleAndOutput(".data\nv: .word 0\n.text\n"
+                              "    lui x16, 0x10000\n"
+                              "    addi x5, x0, 3\n"
+                              "loop:\n"
+                              "    sw x5, 0(x16)\n"
+                              "    lw x6, 0(x16)\n"
+                              "    addi x5, x5, -1\n"
+                              "    bne x5, x0, loop\n", json);
+    json.clear();
+    CHECK(session.execute("record " + path, request, json));
+    json.clear();
+    CHECK(session.execute("run", request, json));
+    json.clear();
+    CHECK(session.execute("record off", request, json));
+    CHECK(json.str().find("\"instructions\": 14") != std::string::npos);
+
+    TraceReader reader(path);
+    CHECK(!reader.occupancy());
+    std::vector<TraceEvent> events = readAll(reader);
+    CHECK_EQUAL(events.size(), 14u);
+    CHECK_EQUAL(events.size(), static_cast<size_t>(session.cpu.totalInstructions));
+    if (events.size() == 14) {
+        CHECK_EQUAL(events[0].pc, 0u);
+        CHECK_EQUAL(static_cast<uint32_t>(events[1].rd), 5u);
+        CHECK_EQUAL(events[1].value, 3u);
+        CHECK_EQUAL(static_cast<int>(events[2].access), static_cast<int>(TraceEvent::STORE));
+        CHECK_EQUAL(events[2].address, 0x10000000u);
+        CHECK_EQUAL(events[2].data, 3u);
+        CHECK_EQUAL(static_cast<int>(events[3].access), static_cast<int>(TraceEvent::LOAD));
+        CHECK_EQUAL(events[3].data, 3u);
+        // The branch back to `loop`
+        CHECK_EQUAL(events[6].pc, 8u);
+        CHECK_EQUAL(events[13].pc, 20u);
+    }
+    std::remove(path.c_str());
+}
@@ -0,0 +1,30 @@
+#include "check.h"
+#include "work_pool.h"
+#include <atomic>
+
+TEST(workPoolRunsEveryTaskOnceBeforeReturning) {
+    WorkPool pool(3);
+    CHECK_EQUAL(pool.size(), 3u);
+    std::vector<std::atomic<int>> runs(100);
+    pool.run(runs.size(), [&](size_t task) { runs[task]++; });
+    for (const std::atomic<int>& count : runs) CHECK_EQUAL(count.load(), 1);
+
+    pool.run(0, [&](size_t) { CHECK(false); });
+}
+
+TEST(workPoolServesSeveralCallersAtOnce) {
+    WorkPool pool(2);
+    std::atomic<size_t> total{0};
+    std::vector<std::thread> callers;
+    for (int caller = 0; caller < 4; caller++) {
+        callers.emplace_back([&] {
+            std::atomic<size_t> own{0};
+            pool.run(50, [&](size_t task) { own += task + 1; });
+            // Every task of this call has finished when run returns
+            CHECK_EQUAL(own.load(), 1275u);
+            total += own;
+        });
+    }
+    for (std::thread& caller : callers) caller.join();
+    CHECK_EQUAL(total.load(), 4 * 1275u);
+}